@@ -0,0 +1,227 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2026 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <stdio.h>
+#include <common/config.h>
+#include "activity.h"
+#include "prssim.h"
+
+struct tc_node {
+  int gid;
+  OnePrsSim *r;			// a driver, for the name
+  int lid;
+  double e;			// energy per transition
+};
+
+L_A_DECL (tc_node, _tc_nodes);
+static ActSim *_tc_sim = NULL;
+static unsigned long *_tc_prev = NULL; // counts at the window start
+static unsigned long _tc_t0;
+
+static void _tc_name (tc_node *n, char *buf, int sz)
+{
+  PrsSim *p = n->r->getPrsSim ();
+  int pos = 0;
+
+  buf[0] = '\0';
+  if (p->getName ()) {
+    p->getName()->sPrint (buf, sz);
+    pos = strlen (buf);
+    if (pos < sz - 1) {
+      buf[pos++] = '.';
+    }
+  }
+  p->sPrintName (buf + pos, sz - pos, n->lid);
+}
+
+static void _tc_walk (ActInstTable *t, char *seen)
+{
+  if (t->obj) {
+    PrsSim *p = dynamic_cast<PrsSim *> (t->obj);
+    if (p) {
+      for (int i=0; i < p->numRules(); i++) {
+	OnePrsSim *r = p->getRule (i);
+	prssim_stmt *s = r->getStmt ();
+	int lid = (s->type == PRSSIM_RULE ? s->vid : s->t2);
+	int gid = p->myGid (lid);
+	if (seen[gid]) continue;
+	seen[gid] = 1;
+	A_NEW (_tc_nodes, tc_node);
+	A_NEXT (_tc_nodes).gid = gid;
+	A_NEXT (_tc_nodes).r = r;
+	A_NEXT (_tc_nodes).lid = lid;
+	A_NEXT (_tc_nodes).e = 0;
+	A_INC (_tc_nodes);
+      }
+    }
+  }
+  if (t->H) {
+    hash_bucket_t *b;
+    hash_iter_t it;
+    hash_iter_init (t->H, &it);
+    while ((b = hash_iter_next (t->H, &it))) {
+      _tc_walk ((ActInstTable *) b->v, seen);
+    }
+  }
+}
+
+/* node list and per-node energy, built once */
+static void _tc_init (ActSim *sim)
+{
+  int nb = sim->getState()->numBools ();
+  struct Hashtable *H = NULL;
+  double vdd = 1.0, cap = 0, *vals = NULL;
+  char *seen;
+  char buf[1024];
+
+  if (_tc_sim == sim) {
+    return;
+  }
+  A_FREE (_tc_nodes);
+  if (_tc_prev) {
+    FREE (_tc_prev);
+  }
+  _tc_sim = sim;
+
+  MALLOC (seen, char, nb + 1);
+  for (int i=0; i < nb; i++) {
+    seen[i] = 0;
+  }
+  _tc_walk (sim->getInstTable (), seen);
+  FREE (seen);
+
+  if (config_exists ("lint.Vdd")) {
+    vdd = config_get_real ("lint.Vdd");
+  }
+  if (config_exists ("sim.prs.node_cap")) {
+    cap = config_get_real ("sim.prs.node_cap");
+  }
+  if (config_exists ("sim.prs.node_cap_names") &&
+      config_exists ("sim.prs.node_cap_values")) {
+    char **names = config_get_table_string ("sim.prs.node_cap_names");
+    int n = config_get_table_size ("sim.prs.node_cap_names");
+    if (n != config_get_table_size ("sim.prs.node_cap_values")) {
+      warning ("sim.prs.node_cap_names and sim.prs.node_cap_values differ in size");
+      if (n > config_get_table_size ("sim.prs.node_cap_values")) {
+	n = config_get_table_size ("sim.prs.node_cap_values");
+      }
+    }
+    vals = config_get_table_real ("sim.prs.node_cap_values");
+    H = hash_new (4);
+    for (int i=0; i < n; i++) {
+      hash_bucket_t *b = hash_add (H, names[i]);
+      b->i = i;
+    }
+  }
+  for (int i=0; i < A_LEN (_tc_nodes); i++) {
+    double c = cap;
+    if (H) {
+      hash_bucket_t *b;
+      _tc_name (&_tc_nodes[i], buf, sizeof (buf));
+      if ((b = hash_lookup (H, buf))) {
+	c = vals[b->i];
+      }
+    }
+    _tc_nodes[i].e = 0.5*c*vdd*vdd;
+  }
+  if (H) {
+    hash_free (H);
+  }
+
+  MALLOC (_tc_prev, unsigned long, nb + 1);
+  for (int i=0; i < nb; i++) {
+    _tc_prev[i] = 0;
+  }
+  _tc_t0 = 0;
+}
+
+void actsim_tc_dump (ActSim *sim, FILE *fp)
+{
+  ActSimState *st = sim->getState ();
+  unsigned long tot = 0;
+  double etot = 0;
+  char buf[1024];
+
+  _tc_init (sim);
+  fprintf (fp, "# node transitions energy(fJ)\n");
+  for (int i=0; i < A_LEN (_tc_nodes); i++) {
+    unsigned long n = st->getTC (_tc_nodes[i].gid);
+    if (n == 0) continue;
+    _tc_name (&_tc_nodes[i], buf, sizeof (buf));
+    fprintf (fp, "%s %lu %g\n", buf, n, n*_tc_nodes[i].e);
+    tot += n;
+    etot += n*_tc_nodes[i].e;
+  }
+  fprintf (fp, "# total %lu %g\n", tot, etot);
+}
+
+void actsim_tc_snapshot (ActSim *sim, FILE *fp, int verbose)
+{
+  ActSimState *st = sim->getState ();
+  unsigned long tot = 0, now = SimDES::CurTimeLo ();
+  double etot = 0;
+  char buf[1024];
+
+  _tc_init (sim);
+  for (int i=0; i < A_LEN (_tc_nodes); i++) {
+    int g = _tc_nodes[i].gid;
+    unsigned long n = st->getTC (g) - _tc_prev[g];
+    tot += n;
+    etot += n*_tc_nodes[i].e;
+  }
+  fprintf (fp, "window %lu %lu transitions %lu energy %g\n", _tc_t0, now,
+	   tot, etot);
+  for (int i=0; i < A_LEN (_tc_nodes); i++) {
+    int g = _tc_nodes[i].gid;
+    unsigned long n = st->getTC (g) - _tc_prev[g];
+    if (verbose && n > 0) {
+      _tc_name (&_tc_nodes[i], buf, sizeof (buf));
+      fprintf (fp, "  %s %lu %g\n", buf, n, n*_tc_nodes[i].e);
+    }
+    _tc_prev[g] = st->getTC (g);
+  }
+  _tc_t0 = now;
+}
+
+void actsim_tc_reset (ActSim *sim)
+{
+  _tc_init (sim);
+  sim->getState()->clearTC ();
+  for (int i=0; i < sim->getState()->numBools(); i++) {
+    _tc_prev[i] = 0;
+  }
+  _tc_t0 = SimDES::CurTimeLo ();
+}
+
+double actsim_tc_energy (ActSim *sim, unsigned long *ntrans)
+{
+  ActSimState *st = sim->getState ();
+  double etot = 0;
+
+  _tc_init (sim);
+  *ntrans = 0;
+  for (int i=0; i < A_LEN (_tc_nodes); i++) {
+    unsigned long n = st->getTC (_tc_nodes[i].gid);
+    *ntrans += n;
+    etot += n*_tc_nodes[i].e;
+  }
+  return etot;
+}
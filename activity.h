@@ -0,0 +1,50 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2026 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#ifndef __ACTSIM_ACTIVITY_H__
+#define __ACTSIM_ACTIVITY_H__
+
+#include "actsim.h"
+
+/*
+ * Activity of the nodes driven by production rules, from the
+ * transition counts kept by the simulation state.
+ *
+ * Each transition of a node costs 0.5*C*Vdd^2, where Vdd is lint.Vdd
+ * and C (in fF) is sim.prs.node_cap, unless the node is listed in the
+ * string table sim.prs.node_cap_names, with its capacitance in the same
+ * position of the real table sim.prs.node_cap_values. Energy is in fJ.
+ */
+
+/* one line per node that switched, then the total */
+void actsim_tc_dump (ActSim *sim, FILE *fp);
+
+/* transitions and energy since the last snapshot (or reset); with
+   verbose, the nodes that switched in the window */
+void actsim_tc_snapshot (ActSim *sim, FILE *fp, int verbose);
+
+/* clear the counts and start a new window */
+void actsim_tc_reset (ActSim *sim);
+
+/* total transitions and energy so far */
+double actsim_tc_energy (ActSim *sim, unsigned long *ntrans);
+
+#endif /* __ACTSIM_ACTIVITY_H__ */
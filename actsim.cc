@@ -23,9 +23,15 @@
 #include "chpsim.h"
 #include "prssim.h"
 #include "xycesim.h"
+#include "checkpoint.h"
 #include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 #include <math.h>
 #include <ctype.h>
+#include <unistd.h>
+#include <sys/resource.h>
 
 /*
 
@@ -47,6 +53,9 @@
 */
 
 
+static void _mon_start (ActSim *);
+static void _mon_end (void);
+
 act_connection *ActSim::runSim (act_connection **cause)
 {
   Event *ret;
@@ -56,7 +65,10 @@ act_connection *ActSim::runSim (act_connection **cause)
     return NULL;
   }
 
+  _mon_start (this);
   ret = SimDES::Run ();
+  ACTSIM_PROF (NULL);
+  _mon_end ();
   
   return NULL;
 }
@@ -69,7 +81,10 @@ act_connection *ActSim::Step (long nsteps)
     return NULL;
   }
 
+  _mon_start (this);
   ret = SimDES::Advance (nsteps);
+  ACTSIM_PROF (NULL);
+  _mon_end ();
 
   return NULL;
 }
@@ -82,7 +97,10 @@ act_connection *ActSim::Advance (long delay)
     return NULL;
   }
 
+  _mon_start (this);
   ret = SimDES::AdvanceTime (delay);
+  ACTSIM_PROF (NULL);
+  _mon_end ();
 
   return NULL;
 }
@@ -102,6 +120,7 @@ ActSim::ActSim (Process *root, SDF *sdf) : ActSimCore (root, sdf)
 ActSim::~ActSim()
 {
   /* stuff here */
+  actsim_ckpt_every (NULL, 0, 0, NULL);
   if (_init_simobjs) {
     listitem_t *li;
     for (li = list_first (_init_simobjs); li; li = list_next (li)) {
@@ -116,13 +135,11 @@ ActSim::~ActSim()
 }
 
 
-bool _match_hseprs (Event *e)
+struct actsim_pending_counts actsim_pending;
+
+bool actsim_reset_pending ()
 {
-  if (dynamic_cast <OnePrsSim *> (e->getObj())) {
-    return true;
-  }
-  ChpSim *x = dynamic_cast <ChpSim *> (e->getObj());
-  if (x && x->isHseMode()) {
+  if (actsim_pending.prs > 0 || actsim_pending.hse > 0) {
     return true;
   }
   return false;
@@ -213,7 +230,7 @@ void ActSim::runInit ()
       int count = 0;
       int max_count = 0;
       max_count = config_get_int ("sim.reset_rounds");
-      while (SimDES::matchPendingEvent (_match_hseprs) && count < max_count) {
+      while (actsim_reset_pending () && count < max_count) {
 	count++;
 	if (SimDES::AdvanceTime (10) != NULL) {
 	  warning ("breakpoint?");
@@ -282,7 +299,7 @@ void ActSim::runInit ()
 	    warning ("breakpoint?");
 	  }
 	  count++;
-	  if (!SimDES::matchPendingEvent (_match_hseprs)) {
+	  if (!actsim_reset_pending ()) {
 	    break;
 	  }
 	} while (count < max_rounds);
@@ -362,17 +379,630 @@ void actsim_log_flush (void)
 
 
 
+
+/*------------------------------------------------------------------------
+ *
+ *  Performance counters
+ *
+ *------------------------------------------------------------------------
+ */
+int actsim_perf_on = 0;
+unsigned long actsim_perf[PERF_NUM];
+unsigned long actsim_perf_left = 0;
+pthread_t actsim_sim_thread;
+
+static const char *_perf_names[PERF_NUM] = {
+  "events.prs",
+  "events.multiprs",
+  "events.chp",
+  "events.xyce",
+  "propagate",
+  "fanout",
+  "event.new",
+  "event.cancel",
+  "watch.check",
+  "extern.call"
+};
+
+static FILE *_perf_fp = NULL;
+static unsigned long _perf_interval = 0;
+
+void actsim_perf_enable (int on)
+{
+  actsim_sim_thread = pthread_self ();
+  actsim_perf_on = on;
+}
+
+void actsim_perf_reset (void)
+{
+  for (int i=0; i < PERF_NUM; i++) {
+    actsim_perf[i] = 0;
+  }
+}
+
+void actsim_perf_print (FILE *fp)
+{
+  unsigned long tot = 0;
+  for (int i=PERF_EV_PRS; i <= PERF_EV_XYCE; i++) {
+    tot += actsim_perf[i];
+  }
+  fprintf (fp, "%-16s %lu\n", "events", tot);
+  for (int i=0; i < PERF_NUM; i++) {
+    fprintf (fp, "%-16s %lu\n", _perf_names[i], actsim_perf[i]);
+  }
+}
+
+void actsim_perf_dump (void)
+{
+  if (!_perf_fp) {
+    return;
+  }
+  fprintf (_perf_fp, "time=");
+  SimDES::CurTime().decPrint (_perf_fp);
+  for (int i=0; i < PERF_NUM; i++) {
+    fprintf (_perf_fp, " %s=%lu", _perf_names[i], actsim_perf[i]);
+  }
+  fprintf (_perf_fp, "\n");
+  fflush (_perf_fp);
+  actsim_perf_left = _perf_interval;
+}
+
+int actsim_perf_dump_start (const char *file, unsigned long interval)
+{
+  if (_perf_fp && _perf_fp != stdout) {
+    fclose (_perf_fp);
+  }
+  _perf_fp = NULL;
+  actsim_perf_left = 0;
+  if (!file) {
+    return 1;
+  }
+  if (strcmp (file, "-") == 0) {
+    _perf_fp = stdout;
+  }
+  else if (!(_perf_fp = fopen (file, "w"))) {
+    return 0;
+  }
+  _perf_interval = interval;
+  actsim_perf_left = interval;
+  actsim_sim_thread = pthread_self ();
+  actsim_perf_on = 1;
+  return 1;
+}
+
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Per-instance profiler
+ *
+ *------------------------------------------------------------------------
+ */
+int actsim_prof_on = 0;
+static ActSimObj *_prof_cur = NULL;
+static unsigned long _prof_last = 0;
+
+static inline unsigned long _prof_cycles (void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc ();
+#else
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec*1000000000UL + ts.tv_nsec;
+#endif
+}
+
+void actsim_prof_event (ActSimObj *obj)
+{
+  unsigned long now = _prof_cycles ();
+
+  if (_prof_cur) {
+    _prof_cur->getProf()->cycles += now - _prof_last;
+  }
+  _prof_cur = obj;
+  _prof_last = now;
+
+  if (obj) {
+    actsim_prof_rec *r = obj->getProf ();
+    unsigned long tm = SimDES::CurTimeLo ();
+    if (!r) {
+      NEW (r, actsim_prof_rec);
+      r->events = 0;
+      r->cycles = 0;
+      r->active = 0;
+      r->last_tm = tm + 1;
+      obj->setProf (r);
+    }
+    r->events++;
+    if (r->last_tm != tm) {
+      r->active++;
+      r->last_tm = tm;
+    }
+  }
+}
+
+void actsim_prof_enable (int on)
+{
+  if (!on) {
+    ACTSIM_PROF (NULL);
+  }
+  _prof_cur = NULL;
+  actsim_prof_on = on;
+}
+
+void actsim_prof_reset (ActInstTable *t)
+{
+  _prof_cur = NULL;
+  if (t->obj && t->obj->getProf()) {
+    FREE (t->obj->getProf());
+    t->obj->setProf (NULL);
+  }
+  if (t->H) {
+    hash_bucket_t *b;
+    hash_iter_t i;
+    hash_iter_init (t->H, &i);
+    while ((b = hash_iter_next (t->H, &i))) {
+      actsim_prof_reset ((ActInstTable *) b->v);
+    }
+  }
+}
+
+struct prof_entry {
+  char *name;			// hierarchical name
+  ActSimObj *obj;
+  unsigned long events, cycles;	// subtree totals
+};
+
+L_A_DECL (prof_entry, _prof_ents);
+
+/*
+  Collect all instances with activity in their subtree; returns the
+  subtree totals.
+*/
+static void _prof_collect (ActInstTable *t, const char *nm,
+			   unsigned long *ev, unsigned long *cyc)
+{
+  int pos;
+  *ev = 0;
+  *cyc = 0;
+
+  A_NEW (_prof_ents, prof_entry);
+  pos = A_LEN (_prof_ents);
+  A_NEXT (_prof_ents).name = Strdup (nm);
+  A_NEXT (_prof_ents).obj = t->obj;
+  A_INC (_prof_ents);
+
+  if (t->obj && t->obj->getProf()) {
+    *ev = t->obj->getProf()->events;
+    *cyc = t->obj->getProf()->cycles;
+  }
+
+  if (t->H) {
+    hash_bucket_t *b;
+    hash_iter_t i;
+    hash_iter_init (t->H, &i);
+    while ((b = hash_iter_next (t->H, &i))) {
+      unsigned long sev, scyc;
+      char *buf;
+      MALLOC (buf, char, strlen (nm) + strlen (b->key) + 2);
+      sprintf (buf, "%s.%s", nm, b->key);
+      _prof_collect ((ActInstTable *) b->v, buf, &sev, &scyc);
+      FREE (buf);
+      *ev += sev;
+      *cyc += scyc;
+    }
+  }
+  if (*ev == 0) {
+    /* nothing happened here */
+    for (int k=pos; k < A_LEN (_prof_ents); k++) {
+      FREE (_prof_ents[k].name);
+    }
+    A_LEN (_prof_ents) = pos;
+  }
+  else {
+    _prof_ents[pos].events = *ev;
+    _prof_ents[pos].cycles = *cyc;
+  }
+}
+
+static void _prof_free (void)
+{
+  for (int i=0; i < A_LEN (_prof_ents); i++) {
+    FREE (_prof_ents[i].name);
+  }
+  A_FREE (_prof_ents);
+}
+
+static int _prof_cmp (const void *a, const void *b)
+{
+  const prof_entry *x = (const prof_entry *) a;
+  const prof_entry *y = (const prof_entry *) b;
+  if (x->cycles > y->cycles) return -1;
+  if (x->cycles < y->cycles) return 1;
+  return strcmp (x->name, y->name);
+}
+
+static void _prof_typename (FILE *fp, Process *p)
+{
+  if (!p) {
+    fprintf (fp, "-");
+    return;
+  }
+  if (p->getns() && p->getns() != ActNamespace::Global()) {
+    char *ns = p->getns()->Name();
+    fprintf (fp, "%s::", ns);
+    FREE (ns);
+  }
+  fprintf (fp, "%s", p->getName());
+}
+
+struct prof_type {
+  Process *p;
+  int count;
+  unsigned long events, cycles, active;
+};
+
+static int _prof_type_cmp (const void *a, const void *b)
+{
+  const prof_type *x = (const prof_type *) a;
+  const prof_type *y = (const prof_type *) b;
+  if (x->cycles > y->cycles) return -1;
+  if (x->cycles < y->cycles) return 1;
+  if (x->events > y->events) return -1;
+  if (x->events < y->events) return 1;
+  return 0;
+}
+
+void actsim_prof_report (FILE *fp, ActInstTable *t, const char *root)
+{
+  unsigned long ev, cyc;
+
+  _prof_collect (t, root, &ev, &cyc);
+  if (A_LEN (_prof_ents) > 1) {
+    qsort (_prof_ents, A_LEN (_prof_ents), sizeof (prof_entry), _prof_cmp);
+  }
+
+  fprintf (fp, "Profile: %lu events, %lu cycles\n", ev, cyc);
+  fprintf (fp, "%14s %6s %14s %10s %10s  instance [type]\n",
+	   "tot-cycles", "%", "self-cycles", "self-ev", "active");
+  for (int i=0; i < A_LEN (_prof_ents); i++) {
+    prof_entry *e = &_prof_ents[i];
+    actsim_prof_rec *r = e->obj ? e->obj->getProf() : NULL;
+    fprintf (fp, "%14lu %6.2f %14lu %10lu %10lu  %s [",
+	     e->cycles, cyc ? 100.0*e->cycles/cyc : 0.0,
+	     r ? r->cycles : 0, r ? r->events : 0, r ? r->active : 0,
+	     e->name);
+    _prof_typename (fp, e->obj ? e->obj->getProc() : NULL);
+    fprintf (fp, "]\n");
+  }
+
+  /* roll up by process type */
+  iHashtable *H = ihash_new (8);
+  A_DECL (prof_type, types);
+  A_INIT (types);
+  for (int i=0; i < A_LEN (_prof_ents); i++) {
+    ActSimObj *obj = _prof_ents[i].obj;
+    if (!obj || !obj->getProf()) continue;
+    ihash_bucket_t *b = ihash_lookup (H, (long)obj->getProc());
+    if (!b) {
+      b = ihash_add (H, (long)obj->getProc());
+      b->i = A_LEN (types);
+      A_NEW (types, prof_type);
+      A_NEXT (types).p = obj->getProc();
+      A_NEXT (types).count = 0;
+      A_NEXT (types).events = 0;
+      A_NEXT (types).cycles = 0;
+      A_NEXT (types).active = 0;
+      A_INC (types);
+    }
+    types[b->i].count++;
+    types[b->i].events += obj->getProf()->events;
+    types[b->i].cycles += obj->getProf()->cycles;
+    types[b->i].active += obj->getProf()->active;
+  }
+  ihash_free (H);
+  if (A_LEN (types) > 1) {
+    qsort (types, A_LEN (types), sizeof (prof_type), _prof_type_cmp);
+  }
+  fprintf (fp, "\nBy process type:\n");
+  fprintf (fp, "%14s %6s %10s %10s %8s  type\n",
+	   "cycles", "%", "events", "active", "count");
+  for (int i=0; i < A_LEN (types); i++) {
+    fprintf (fp, "%14lu %6.2f %10lu %10lu %8d  ",
+	     types[i].cycles, cyc ? 100.0*types[i].cycles/cyc : 0.0,
+	     types[i].events, types[i].active, types[i].count);
+    _prof_typename (fp, types[i].p);
+    fprintf (fp, "\n");
+  }
+  A_FREE (types);
+  _prof_free ();
+}
+
+void actsim_prof_folded (FILE *fp, ActInstTable *t, const char *root)
+{
+  unsigned long ev, cyc;
+
+  _prof_collect (t, root, &ev, &cyc);
+  for (int i=0; i < A_LEN (_prof_ents); i++) {
+    prof_entry *e = &_prof_ents[i];
+    if (!e->obj || !e->obj->getProf() || e->obj->getProf()->cycles == 0) {
+      continue;
+    }
+    for (char *s = e->name; *s; s++) {
+      fputc (*s == '.' ? ';' : *s, fp);
+    }
+    fprintf (fp, " %lu\n", e->obj->getProf()->cycles);
+  }
+  _prof_free ();
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Startup phase timing
+ *
+ *------------------------------------------------------------------------
+ */
+int actsim_startup_on = 0;
+actsim_obj_counts actsim_objcount;
+
+#define MAX_PHASES 64
+
+struct startup_phase {
+  const char *name;
+  int depth;
+  double start, end;		// wall time, seconds
+  long rss_start, rss_end;	// KB
+};
+
+static startup_phase _phases[MAX_PHASES];
+static int _nphases = 0;
+static int _phase_stk[MAX_PHASES];
+static int _phase_depth = 0;
+
+double actsim_wall_time (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/* current RSS if the OS reports it, otherwise the peak */
+static long _rss_kb (void)
+{
+  FILE *fp = fopen ("/proc/self/statm", "r");
+  if (fp) {
+    long sz, res;
+    if (fscanf (fp, "%ld %ld", &sz, &res) == 2) {
+      fclose (fp);
+      return res*(sysconf (_SC_PAGESIZE)/1024);
+    }
+    fclose (fp);
+  }
+  struct rusage ru;
+  getrusage (RUSAGE_SELF, &ru);
+#if defined(__APPLE__)
+  return ru.ru_maxrss/1024;
+#else
+  return ru.ru_maxrss;
+#endif
+}
+
+void actsim_phase_begin (const char *name)
+{
+  if (!actsim_startup_on) {
+    return;
+  }
+  if (_nphases == MAX_PHASES || _phase_depth == MAX_PHASES) {
+    return;
+  }
+  startup_phase *p = &_phases[_nphases];
+  p->name = name;
+  p->depth = _phase_depth;
+  p->rss_start = _rss_kb ();
+  p->start = actsim_wall_time ();
+  p->end = p->start;
+  p->rss_end = p->rss_start;
+  _phase_stk[_phase_depth++] = _nphases++;
+}
+
+void actsim_phase_end (void)
+{
+  if (!actsim_startup_on || _phase_depth == 0) {
+    return;
+  }
+  startup_phase *p = &_phases[_phase_stk[--_phase_depth]];
+  p->end = actsim_wall_time ();
+  p->rss_end = _rss_kb ();
+}
+
+void actsim_phase_report (FILE *fp)
+{
+  double tot = 0;
+  if (!actsim_startup_on) {
+    return;
+  }
+  for (int i=0; i < _nphases; i++) {
+    if (_phases[i].depth == 0) {
+      tot += _phases[i].end - _phases[i].start;
+    }
+  }
+  fprintf (fp, "Startup phases:\n");
+  fprintf (fp, "  %-28s %10s %6s %10s %10s\n", "phase", "wall(s)", "%",
+	   "rss(MB)", "+rss(MB)");
+  for (int i=0; i < _nphases; i++) {
+    startup_phase *p = &_phases[i];
+    double w = p->end - p->start;
+    fprintf (fp, "  %*s%-*s %10.3f %6.1f %10.1f %+10.1f\n",
+	     2*p->depth, "", 28 - 2*p->depth, p->name, w,
+	     tot > 0 ? 100.0*w/tot : 0.0, p->rss_end/1024.0,
+	     (p->rss_end - p->rss_start)/1024.0);
+  }
+  fprintf (fp, "  %-28s %10.3f\n", "total", tot);
+  fprintf (fp, "Objects: chp %d, hse %d, prs %d (%d rules), multi-driver %d, xyce %d\n",
+	   actsim_objcount.chp, actsim_objcount.hse, actsim_objcount.prs,
+	   actsim_objcount.prs_rules, actsim_objcount.multi,
+	   actsim_objcount.xyce);
+  _nphases = 0;
+}
+
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Progress reports and watchdog
+ *
+ *------------------------------------------------------------------------
+ */
+#define MON_CHECK 4096
+
+unsigned long actsim_mon_left = 0;
+
+static double _mon_interval = 0;
+static FILE *_mon_fp = NULL;
+static double _wd_lim[WD_NUM];
+static int _wd_tripped = -1;
+
+static ActSim *_mon_sim;
+static unsigned long _mon_chunk;
+static unsigned long _mon_ev, _mon_ev_last;
+static double _mon_t0, _mon_tlast, _mon_tnext;
+static double _mon_st0, _mon_stlast;
+static unsigned long _mon_it0;
+
+static const char *_wd_names[WD_NUM] = { "wall time", "event", "simulation time" };
+
+int actsim_mon_progress (double secs, const char *file)
+{
+  if (_mon_fp && _mon_fp != stderr) {
+    fclose (_mon_fp);
+  }
+  _mon_fp = NULL;
+  _mon_interval = 0;
+  if (secs <= 0) {
+    return 1;
+  }
+  if (!file) {
+    _mon_fp = stderr;
+  }
+  else if (!(_mon_fp = fopen (file, "w"))) {
+    return 0;
+  }
+  _mon_interval = secs;
+  return 1;
+}
+
+void actsim_mon_watchdog (int kind, double limit)
+{
+  Assert (0 <= kind && kind < WD_NUM, "What?");
+  _wd_lim[kind] = limit > 0 ? limit : 0;
+}
+
+static void _mon_next_chunk (void)
+{
+  _mon_chunk = MON_CHECK;
+  if (_wd_lim[WD_EVENTS] > 0 && _wd_lim[WD_EVENTS] - _mon_ev < _mon_chunk) {
+    _mon_chunk = _wd_lim[WD_EVENTS] - _mon_ev;
+  }
+  if (_mon_chunk == 0) {
+    _mon_chunk = 1;
+  }
+  actsim_mon_left = _mon_chunk;
+}
+
+static void _mon_start (ActSim *sim)
+{
+  int i;
+  actsim_sim_thread = pthread_self ();
+  actsim_ckpt_arm ();
+  for (i=0; i < WD_NUM; i++) {
+    if (_wd_lim[i] > 0) break;
+  }
+  if (i == WD_NUM && _mon_interval == 0 && !actsim_ckpt_on ()) {
+    actsim_mon_left = 0;
+    return;
+  }
+  _mon_sim = sim;
+  _mon_ev = 0;
+  _mon_ev_last = 0;
+  _mon_t0 = actsim_wall_time ();
+  _mon_tlast = _mon_t0;
+  _mon_tnext = _mon_t0 + _mon_interval;
+  _mon_st0 = sim->curTimeMetricUnits ();
+  _mon_stlast = _mon_st0;
+  _mon_it0 = SimDES::CurTimeLo ();
+  _wd_tripped = -1;
+  _mon_next_chunk ();
+}
+
+static void _mon_report (double now, double st)
+{
+  double dt = now - _mon_tlast;
+  if (dt <= 0) {
+    dt = 1e-9;
+  }
+
+  fprintf (_mon_fp, "progress wall=%.1f time=", now - _mon_t0);
+  SimDES::CurTime().decPrint (_mon_fp);
+  fprintf (_mon_fp, " events=%lu ev_per_s=%.0f sim_per_wall=%g queue=%ld rss_kb=%ld\n",
+	   _mon_ev, (_mon_ev - _mon_ev_last)/dt, (st - _mon_stlast)/dt,
+	   actsim_pending.prs + actsim_pending.other, _rss_kb ());
+  fflush (_mon_fp);
+  _mon_tlast = now;
+  _mon_ev_last = _mon_ev;
+  _mon_stlast = st;
+}
+
+void actsim_mon_tick (void)
+{
+  double now = actsim_wall_time ();
+  double st = _mon_sim->curTimeMetricUnits ();
+
+  _mon_ev += _mon_chunk;
+  if (_mon_interval > 0 && now >= _mon_tnext) {
+    _mon_report (now, st);
+    _mon_tnext = now + _mon_interval;
+  }
+  if (_wd_lim[WD_EVENTS] > 0 && _mon_ev >= _wd_lim[WD_EVENTS]) {
+    _wd_tripped = WD_EVENTS;
+  }
+  else if (_wd_lim[WD_WALL] > 0 && now - _mon_t0 >= _wd_lim[WD_WALL]) {
+    _wd_tripped = WD_WALL;
+  }
+  else if (_wd_lim[WD_SIMTIME] > 0 &&
+	   SimDES::CurTimeLo () - _mon_it0 >= _wd_lim[WD_SIMTIME]) {
+    _wd_tripped = WD_SIMTIME;
+  }
+  if (_wd_tripped >= 0) {
+    actsim_mon_left = 0;
+    SimDES::interrupt ();
+    return;
+  }
+  actsim_ckpt_tick (now);
+  _mon_next_chunk ();
+}
+
+static void _mon_end (void)
+{
+  actsim_mon_left = 0;
+  if (_wd_tripped >= 0) {
+    warning ("watchdog: %s limit reached after %lu events; stopping",
+	     _wd_names[_wd_tripped], _mon_ev);
+    _wd_tripped = -1;
+    SimDES::resume ();
+  }
+}
+
+
 /* pending events */
 
 static int _pend_count;
-static int _pend_prs;
+static long _pend_prs;
 
 static bool _match_count (Event *e)
 {
   _pend_count++;
-  if (dynamic_cast <OnePrsSim *> (e->getObj())) {
-    _pend_prs++;
-  }
   return false;
 }
 
@@ -388,7 +1018,11 @@ static bool _match_verbose (Event *e, unsigned long tm)
       mpobj = dynamic_cast<MultiPrsSim *> (e->getObj());
     }
   }
-  Assert (obj || pobj || mpobj, "non-sim-obj in queue?");
+  if (!obj && !pobj && !mpobj) {
+    /* internal events (run-until wakeups, checkpoints, channel
+       environments) have nothing to show */
+    return false;
+  }
 
   printf ("%10lu ", (tm - now));
   if (obj && dynamic_cast<ChpSim *> (obj)) {
@@ -457,13 +1091,13 @@ static bool _match_verbose (Event *e, unsigned long tm)
 void runPending (bool verbose)
 {
   _pend_count = 0;
-  _pend_prs = 0;
+  _pend_prs = actsim_pending.prs;
   SimDES::matchPendingEvent (_match_count);
   printf ("Current time: ");
   SimDES::CurTime().decPrint (stdout);
   printf ("\nPending events: %d", _pend_count);
   if (_pend_prs > 0) {
-    printf ("; prs events: %d", _pend_prs);
+    printf ("; prs events: %ld", _pend_prs);
   }
   printf ("\n");
   if (verbose) {
@@ -487,6 +1121,7 @@ ActSimObj::ActSimObj (ActSimCore *sim, Process *p)
   _abs_port_chan = NULL;
   name = NULL;
   _shared = new WaitForOne(0);
+  _prof = NULL;
 }
 
 
@@ -554,17 +1189,15 @@ void ActSimObj::propagate (void *cause)
 
 ActSimObj::~ActSimObj()
 {
-  if (_abs_port_bool) {
-    FREE (_abs_port_bool);
-  }
-  if (_abs_port_int) {
-    FREE (_abs_port_int);
-  }
-  if (_abs_port_chan) {
-    FREE (_abs_port_chan);
-  }
+  /* port tables are allocated from the simulation arena */
   delete name;
   delete _shared;
+  if (_prof) {
+    FREE (_prof);
+  }
+  if (_prof_cur == this) {
+    _prof_cur = NULL;
+  }
 }
 
 
@@ -614,3 +1247,237 @@ void ActSimObj::msgPrefix (FILE *fp)
   fprintf (fp, ">  ");
 }
 
+
+/*
+ * Map instance names to simulation objects
+ */
+ActInstTable *find_table (ActId *id, ActInstTable *x)
+{
+  char buf[1024];
+  hash_bucket_t *b;
+  
+  if (!id) { return x; }
+
+  if (!x->H) { return NULL; }
+
+  ActId *tmp = id->Rest();
+  id->prune();
+  id->sPrint (buf, 1024);
+  id->Append (tmp);
+
+  b = hash_lookup (x->H, buf);
+  if (!b) {
+    return NULL;
+  }
+  else {
+    return find_table (id->Rest(), (ActInstTable *)b->v);
+  }
+}
+
+ActSimObj *find_object (ActId **id, ActInstTable *x)
+{
+  char buf[1024];
+  hash_bucket_t *b;
+  
+  if (!(*id)) { return x->obj; }
+  if (!x->H) { return x->obj; }
+
+  if ((*id)->isNamespace()) {
+    return x->obj;
+  }
+
+  ActId *tmp = (*id)->Rest();
+  (*id)->prune();
+  (*id)->sPrint (buf, 1024);
+  (*id)->Append (tmp);
+
+  b = hash_lookup (x->H, buf);
+  if (!b) {
+    return x->obj;
+  }
+  else {
+    (*id) = (*id)->Rest();
+    return find_object (id, (ActInstTable *)b->v);
+  }
+}
+
+
+/*
+ * Given an object pointer and the id within it, return the type and
+ * offset.
+ */
+int id_obj_to_siminfo (ActStatePass *sp,
+		       ActSimObj *obj,
+		       ActId *id,
+		       int *ptype,
+		       int *poffset)
+{
+  stateinfo_t *si;
+  act_connection *c;
+  int res;
+  
+  if (!obj || !id) return 0;
+  
+  si = sp->getStateInfo (obj->getProc());
+  if (!si) {
+    fprintf (stderr, "Could not find info for process `%s'\n", obj->getProc()->getName());
+    return 0;
+  }
+
+  InstType *it;
+  if (!(it = si->bnl->cur->FullLookup (id, NULL))) {
+    fprintf (stderr, "Could not find identifier `");
+    id->Print (stderr);
+    fprintf (stderr, "' within process `%s'\n", obj->getProc()->getName());
+    return 0;
+  }
+
+  if (!id->validateDeref (si->bnl->cur)) {
+    fprintf (stderr, "Array index is missing/out of bounds in `");
+    id->Print (stderr);
+    fprintf (stderr, "'!\n");
+    return 0;
+  }
+
+  if (TypeFactory::isParamType (it)) {
+    fprintf (stderr, "Operation only works for a circuit object, not parameter `");
+    id->Print (stderr);
+    fprintf (stderr, "'\n");
+    return 0;
+  }
+
+  // validate the ID first,  then call canonical pointer
+  c = id->Canonical (si->bnl->cur, true);
+  if (!c) {
+    fprintf (stderr, "Identifier `");
+    id->Print (stderr);
+    fprintf (stderr, "' not found in the design.\n");
+    return 0;
+  }
+  Assert (c, "What?");
+
+  int type, offset;
+
+  res = sp->getTypeOffset (si, c, &offset, &type, NULL);
+  if (!res) {
+    /* it is possible that it is an array reference */
+    Array *ta = NULL;
+    ActId *orig = id;
+    while (id->Rest()) {
+      id = id->Rest();
+    }
+    ta = id->arrayInfo();
+    if (ta) {
+      InstType *it;
+      id->setArray (NULL);
+      it = si->bnl->cur->FullLookup (orig, NULL);
+      if (!it) {
+	fprintf (stderr, "Could not find identifier `");
+	orig->Print (stderr);
+	fprintf (stderr, "' within process `%s'\n", obj->getProc()->getName());
+	id->setArray (ta);
+	return 0;
+      }
+      c = orig->Canonical (si->bnl->cur);
+      Assert (c, "Hmm...");
+      res = sp->getTypeOffset (si, c, &offset, &type, NULL);
+      if (res) {
+	Assert (it->arrayInfo(), "What?");
+	offset += it->arrayInfo()->Offset (ta);
+      }
+      id->setArray (ta);
+    }
+    if (!res) {
+      fprintf (stderr, "Could not find identifier `");
+      orig->Print (stderr);
+      fprintf (stderr, "' within process `%s'\n", obj->getProc()->getName());
+      return 0;
+    }
+  }
+  *ptype = type;
+  *poffset = offset;
+  return 1;
+}
+
+
+/*
+ * Set a Boolean (0, 1, or 2 for X) or an integer from the environment,
+ * and propagate the change with the specified cause. Returns 0 if
+ * the value does not fit.
+ */
+int ActSim::setEnv (int type, int offset, BigInt &rd, ActSimDES *cause)
+{
+  if (type == 0) {
+    int val = rd.getVal (0);
+    const watchpt_bucket *nm;
+    ACTSIM_PERF (PERF_WATCH_CHK);
+    if ((nm = chkWatchPt (0, offset))) {
+      int oval = getBool (offset);
+      if (oval != val) {
+	BigInt tm = SimDES::CurTime();
+	printf ("[");
+	tm.decPrint (stdout, 20);
+	printf ("] <[env]> ");
+	printf ("%s := %c\n", nm->s, (val == 2 ? 'X' : ((char)val + '0')));
+
+	BigInt tmpv;
+	tmpv = val;
+
+	recordTrace (nm, type, ACT_CHAN_IDLE, tmpv);
+      }
+    }
+    else if (chkWatchAll (0, offset)) {
+      if (getBool (offset) != val) {
+	BigInt tmpv;
+	tmpv = val;
+	recordTraceAll (0, offset, tmpv);
+      }
+    }
+    setBool (offset, val);
+  }
+  else if (type == 1) {
+    BigInt *otmp = getInt (offset);
+    BigInt before = rd;
+    rd.setWidth (otmp->getWidth());
+    if (before != rd) {
+      return 0;
+    }
+
+    const watchpt_bucket *nm;
+    ACTSIM_PERF (PERF_WATCH_CHK);
+    if ((nm = chkWatchPt (1, offset))) {
+      if (*otmp != rd) {
+	BigInt tm = SimDES::CurTime();
+	printf ("[");
+	tm.decPrint (stdout, 20);
+	printf ("] <[env]> ");
+	printf ("%s := ", nm->s);
+	rd.decPrint (stdout);
+	printf (" (0x");
+	rd.hexPrint (stdout);
+	printf (")\n");
+
+	recordTrace (nm, type, ACT_CHAN_IDLE, rd);
+      }
+    }
+    else if (chkWatchAll (1, offset)) {
+      if (*otmp != rd) {
+	recordTraceAll (1, offset, rd);
+      }
+    }
+    setInt (offset, rd);
+  }
+  else {
+    fatal_error ("Should not be here");
+  }
+
+  SimDES **arr;
+  arr = getFO (offset, type);
+  ACTSIM_PERF_ADD (PERF_FANOUT, numFanout (offset, type));
+  for (int i=0; i < numFanout (offset, type); i++) {
+    ActSimDES *p = dynamic_cast <ActSimDES *> (arr[i]);
+    Assert (p, "Hmm?");
+    p->propagate (cause);
+  }
+  return 1;
+}
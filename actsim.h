@@ -32,11 +32,146 @@
 #include <regex.h>
 #include <stdlib.h>
 #include <math.h>
+#include <pthread.h>
 #include <common/int.h>
 #include "actsim_ext.h"
 #include "state.h"
 #include "channel.h"
 
+/*
+ * Performance counters. They are always compiled in, but only
+ * updated while enabled (the `stats' command, or sim.perf_stats).
+ * The counters and the monitor countdown are plain globals, not
+ * atomics: only the thread that runs events may touch them. That
+ * thread is recorded when counting is enabled and when a run starts;
+ * counter updates made while counting is enabled, and each monitor
+ * tick, check it. Helper threads (the parallel build and the trace
+ * writer) must not use these macros.
+ */
+enum actsim_perf_counter {
+  PERF_EV_PRS,			// events fired, by object kind
+  PERF_EV_MPRS,
+  PERF_EV_CHP,
+  PERF_EV_XYCE,
+  PERF_PROPAGATE,		// propagate calls
+  PERF_FANOUT,			// fanout entries visited
+  PERF_EV_NEW,			// events scheduled by actsim objects
+  PERF_EV_CANCEL,		// events removed
+  PERF_WATCH_CHK,		// watchpoint lookups on value changes
+  PERF_EXTERN,			// external function calls
+  PERF_NUM
+};
+
+extern int actsim_perf_on;
+extern unsigned long actsim_perf[PERF_NUM];
+extern unsigned long actsim_perf_left;	// events to the next dump
+extern unsigned long actsim_mon_left;	// events to the next monitor check
+extern pthread_t actsim_sim_thread;
+
+#define ACTSIM_SIM_THREAD()						\
+  Assert (pthread_equal (pthread_self (), actsim_sim_thread),		\
+	  "Performance counter updated off the simulation thread")
+
+#define ACTSIM_PERF_ADD(c,n)			\
+  do {						\
+    if (actsim_perf_on) {			\
+      ACTSIM_SIM_THREAD ();			\
+      actsim_perf[c] += (n);			\
+    }						\
+  } while (0)
+
+#define ACTSIM_PERF(c) ACTSIM_PERF_ADD(c,1)
+
+/* an event fired; also handles the periodic dump and run monitor */
+#define ACTSIM_PERF_EVENT(c)					\
+  do {								\
+    if (actsim_perf_on) {					\
+      ACTSIM_SIM_THREAD ();					\
+      actsim_perf[c]++;						\
+      if (actsim_perf_left && --actsim_perf_left == 0) {	\
+	actsim_perf_dump ();					\
+      }								\
+    }								\
+    if (actsim_mon_left && --actsim_mon_left == 0) {		\
+      ACTSIM_SIM_THREAD ();					\
+      actsim_mon_tick ();					\
+    }								\
+  } while (0)
+
+void actsim_perf_enable (int on);
+void actsim_perf_reset (void);
+void actsim_perf_print (FILE *fp);
+/* one line of name=value pairs every `interval' events; NULL stops */
+int actsim_perf_dump_start (const char *file, unsigned long interval);
+void actsim_perf_dump (void);
+
+/*
+ * Pending event counts, maintained where the events are scheduled,
+ * cancelled, and fired. Production rule events (including
+ * multi-driver nodes) are counted exactly. HSE events are counted
+ * where ChpSim schedules them (including shared-variable wakeups,
+ * which go through ChpSim::sWakeup) and where ChpSim::Step fires them.
+ * Every other event (CHP, including HSE, channel wakeups from
+ * WaitForOne::Notify, environment and internal objects) is counted
+ * in `other', so prs + other is the depth of the event queue.
+ */
+struct actsim_pending_counts {
+  long prs;			// production rule events
+  long hse;			// HSE process events
+  long other;			// all events that are not prs
+};
+extern struct actsim_pending_counts actsim_pending;
+
+/*
+ * Run monitor: progress reports every `secs' of wall time (file NULL
+ * is stderr), and watchdog limits per run command. A limit of 0 is
+ * off. Limits are checked every few thousand events.
+ */
+enum actsim_wd_limit { WD_WALL, WD_EVENTS, WD_SIMTIME, WD_NUM };
+
+int actsim_mon_progress (double secs, const char *file);
+void actsim_mon_watchdog (int kind, double limit);
+void actsim_mon_tick (void);
+double actsim_wall_time (void);
+
+/*
+ * Per-instance profile. Host time (cycle counter) between two events
+ * is charged to the object that ran the first one.
+ */
+struct actsim_prof_rec {
+  unsigned long events;		// events run
+  unsigned long cycles;		// host cycles spent
+  unsigned long active;		// distinct simulation times with events
+  unsigned long last_tm;
+};
+
+extern int actsim_prof_on;
+
+/*
+ * Startup phases (-v, or sim.profile_startup): wall time and resident
+ * memory of each elaboration step. Phases nest.
+ */
+extern int actsim_startup_on;
+
+struct actsim_obj_counts {
+  int chp, hse;			// CHP and HSE processes
+  int prs, prs_rules;		// PRS processes and production rules
+  int multi;			// multi-driver nodes
+  int xyce;			// analog blocks
+};
+extern actsim_obj_counts actsim_objcount;
+
+void actsim_phase_begin (const char *name);
+void actsim_phase_end (void);
+void actsim_phase_report (FILE *fp);
+
+#define ACTSIM_PROF(obj)			\
+  do {						\
+    if (actsim_prof_on) {			\
+      actsim_prof_event (obj);			\
+    }						\
+  } while (0)
+
 #define E_CHP_VARBOOL  (E_NEWEND + 1)
 #define E_CHP_VARINT   (E_NEWEND + 2)
 #define E_CHP_VARCHAN  (E_NEWEND + 3)
@@ -78,6 +213,41 @@ class MultiPrsSim;
  */
 #define TRACE_NUM_FORMATS 3
 
+/*
+ * The native trace format is written directly by actsim, and uses
+ * the slot after the trace library formats.
+ */
+#define TRACE_NATIVE TRACE_NUM_FORMATS
+#define TRACE_NUM_SLOTS (TRACE_NUM_FORMATS+1)
+
+/*
+ * Simulation-scoped memory. Objects allocated from the arena are
+ * never freed individually; all the memory is released when the
+ * arena is deleted along with the simulation.
+ */
+class ActSimArena {
+public:
+  ActSimArena (int chunk = 65536);
+  ~ActSimArena ();
+
+  void *alloc (int sz);		/* 16-byte aligned, not zeroed */
+  unsigned long bytes () { return _bytes; }
+
+private:
+  struct arena_chunk {
+    struct arena_chunk *next;
+    int sz, used;
+    double _align[1];		/* start of chunk memory */
+  };
+  struct arena_chunk *_hd;	/* current chunk */
+  int _chunk;			/* default chunk size */
+  unsigned long _bytes;		/* total bytes allocated */
+};
+
+#define ARENA_NEW(a,x,type) do { x = (type *) (a)->alloc (sizeof (type)); } while (0)
+#define ARENA_MALLOC(a,x,type,n) do { x = (type *) (a)->alloc (sizeof (type)*(n)); } while (0)
+
+
 class ActSimState {
 public:
   ActSimState (int bools, int ints, int chans);
@@ -89,9 +259,17 @@ public:
   inline bool isSpecialBool (int x) { return bitset_tst (bits, 3*x+2); }
   void mkSpecialBool (int x) { bitset_set (bits, 3*x+2); }
   bool setBool (int x, int v); // success == true
+  void rawSetBool (int x, int v); // no constraint checks
   act_channel_state *getChan (int x);
+  int numBools () { return nbools; }
+  int numInts () { return nints; }
   int numChans () { return nchans; }
 
+  /* Boolean transition counts */
+  inline void incTC (int x) { _tc[x]++; }
+  unsigned long getTC (int x) { return _tc[x]; }
+  void clearTC ();
+
   void *allocState (int sz);
 
   void mkHazard (int v) {
@@ -114,6 +292,7 @@ private:
   bitset_t *hazards;		/* hazard information */
   bitset_t *bits;		/* Booleans */
   int nbools;			/* # of Booleans */
+  unsigned long *_tc;		/* transition counts */
   
   BigInt *ival;			/* integers */
   int nints;			/* number of integers */
@@ -137,6 +316,13 @@ public:
 };
 
 class ActSimObj;
+struct act_inst_plan;
+
+typedef void (*act_change_hook_t) (void *cookie, int type, unsigned long off,
+				   const BigInt &val);
+struct act_build_ctx;
+struct act_plan_sub;
+struct act_plan_port;
 
 struct ActInstTable {
   struct Hashtable *H;	// sub-instances (optional)
@@ -182,7 +368,15 @@ public:
 
   void msgPrefix (FILE *fp = NULL);
 
-  void sWakeup() { _shared->Notify (MAX_LOCAL_PCS); }
+  actsim_prof_rec *getProf () { return _prof; }
+  void setProf (actsim_prof_rec *r) { _prof = r; }
+
+  void sWakeup() {
+    if (sWaiting()) {
+      actsim_pending.other++;
+    }
+    _shared->Notify (MAX_LOCAL_PCS);
+  }
   void sStall () { _shared->AddObject (this); }
   void sRemove() { _shared->DelObject (this); }
   int  sWaiting() { return _shared->isWaiting (this); }
@@ -210,8 +404,17 @@ protected:
   int *_abs_port_int;
 
   WaitForOne *_shared;
+
+  actsim_prof_rec *_prof;	/* profile, if enabled */
 };
 
+void actsim_prof_event (ActSimObj *obj); // NULL: stop charging time
+void actsim_prof_enable (int on);
+void actsim_prof_reset (ActInstTable *t);
+/* sorted report by instance and process type, or folded stacks */
+void actsim_prof_report (FILE *fp, ActInstTable *t, const char *root);
+void actsim_prof_folded (FILE *fp, ActInstTable *t, const char *root);
+
 class ActSimState;
 
 class ActExclConstraint {
@@ -319,6 +522,13 @@ class ChpSimGraph;
 class ChpSim;
 class PrsSim;
 class XyceSim;
+class PrsSimCons;
+class ActSimTraceQueue;
+class ActSimTraceWindow;
+class ChanTokenWriter;
+class ChanReplay;
+struct chantok_port;
+class NatTraceWriter;
 
 /*
  * Core simulation engine. 
@@ -339,12 +549,15 @@ class ActSimCore {
 
      /* get/set the current state */
   ActSimState *getState () { return state; }
+  ActSimArena *getArena () { return _arena; }
+  PrsSimCons *getPrsCons () { return _prs_cons; }
   void setState (ActSimState *);
 
   BigInt *getInt (int x) { return state->getInt (x); }
   void setInt (int x, BigInt &v) { state->setInt (x, v); }
   int getBool (int x) { return state->getBool (x); }
   bool setBool (int x, int v) { return state->setBool (x, v); }
+  void incTC (int x) { state->incTC (x); }
   int isSpecialBool (int x)  { return state->isSpecialBool (x); }
   bool isHazard (int x) { return state->isHazard (x); }
   
@@ -391,6 +604,7 @@ class ActSimCore {
 #endif
 
   void incFanout (int off, int type, SimDES *who);
+  void delFanout (int off, int type, SimDES *who);
   int numFanout (int off, int type) { if (type == 0) return nfo[off]; else return nfo[off+nint_start];
 }
   SimDES **getFO (int off, int type) { if (type == 0) { return fo[off]; } else { return fo[off+nint_start]; } }
@@ -410,7 +624,15 @@ class ActSimCore {
   int isRandomChoice() { return _sim_rand_excl; }
   int isResetMode() { return _prs_sim_mode; }
   void setWarning (int v) { _on_warning = v; }
-  inline int onWarning() { return _on_warning; }
+  unsigned long numWarnings () { return _nwarn; }
+  inline int onWarning() {
+    /* every warning consults this, so it doubles as the warning hook */
+    _nwarn++;
+    if (_trg_warn) {
+      _traceTrigger ();
+    }
+    return _on_warning;
+  }
 
   void registerFragmented (Channel *c);
   ChanMethods *getFragmented (Channel *c);
@@ -465,7 +687,8 @@ class ActSimCore {
   struct watchpt_bucket {
     char *s;
     unsigned int ignore_fmt;
-    void *node[TRACE_NUM_FORMATS];
+    void *node[TRACE_NUM_SLOTS];
+    unsigned long key;		// key in the watchpoint table
   };
 
   inline void addWatchPt (int type, unsigned long off, const char *name) {
@@ -484,8 +707,9 @@ class ActSimCore {
     NEW (w, watchpt_bucket);
     b->v = w;
     w->s = Strdup (name);
+    w->key = ((unsigned long)type) | (off << 2);
     w->ignore_fmt = ~0U;
-    for (int i=0; i < TRACE_NUM_FORMATS; i++) {
+    for (int i=0; i < TRACE_NUM_SLOTS; i++) {
       w->node[i] = NULL;
     }
   }
@@ -545,8 +769,58 @@ class ActSimCore {
 
   int initTrace (int fmt, const  char *name); // clear when it is NULL
   act_trace_t *getTrace (int fmt) { return _tr[fmt]; }
+  int hasNativeTrace () { return _ntr ? 1 : 0; }
   void recordTrace (const watchpt_bucket *w, int type,
 		    act_chan_state_t chan_state, const BigInt &val);
+  void flushTrace ();		// wait for pending trace records
+  void detachTrace ();		// in a forked child: stop tracing, and
+				// leave the parent's trace files alone
+
+  /*
+   * Bulk watchpoints: every Boolean and integer local to the instance
+   * subtree is traced (not printed). Signal names are only generated
+   * when a trace file header is written.
+   */
+  int addWatchAll (ActInstTable *t);
+  inline int chkWatchAll (int type, unsigned long off) {
+    return _wa_bits[type] ? bitset_tst (_wa_bits[type], off) : 0;
+  }
+  void recordTraceAll (int type, unsigned long off, const BigInt &val);
+
+  /*
+   * Change hook: called for every traced change to a Boolean (type 0)
+   * or integer (type 1), with its global offset. addWatchBit marks a
+   * single node so that its changes reach the hook without printing.
+   */
+  void addWatchBit (int type, unsigned long off);
+  void setChangeHook (act_change_hook_t fn, void *cookie);
+
+  /*
+   * Trigger-gated tracing. While armed, trace records are held in a
+   * rolling buffer of the last `pre' time units. A trigger writes
+   * out the buffer, and tracing continues for `post' time units after
+   * the last trigger. Triggers are only seen on traced signals.
+   */
+  void setTraceWindow (unsigned long pre, unsigned long post);
+  void addTrigger (int type, unsigned long off, unsigned long val);
+  void setTriggerOnWarning (int v) { _trg_warn = v ? 1 : 0; }
+  void clearTriggers ();
+
+  /*
+   * Channel token logs for block-level re-simulation (see chantok.h).
+   * Recording logs every completed action on the given channels;
+   * replay attaches a stub to each port channel of the block.
+   */
+  int tokenRecordStart (const char *file, int nports,
+			struct chantok_port *ports);
+  void tokenRecordStop ();
+  int tokenRecording () { return _tok_rec ? 1 : 0; }
+  inline void recordToken (int goff, expr_multires &v) {
+    if (_tok_rec) {
+      _recordToken (goff, v);
+    }
+  }
+  void tokenReplay (struct chantok_port *ports); // takes ownership
 
   void setTimescale (float tm) { _int_to_float_timescale = tm*1e-12; }
   float getTimescale() { return _int_to_float_timescale; }
@@ -676,6 +950,8 @@ protected:
   act_languages *root_lang;	/* languages in the root scope */
 
   ActSimState *state;		/* the state vector */
+  ActSimArena *_arena;		/* simulation-scoped memory */
+  PrsSimCons *_prs_cons;	/* shared prs graphs */
   ActStatePass *sp;		/* the information about states */
   ActBooleanizePass *bp;	/* Booleanize pass */
   
@@ -709,6 +985,49 @@ protected:
   act_extern_trace_func_t *_trfn[TRACE_NUM_FORMATS];
   act_trace_t *_tr[TRACE_NUM_FORMATS];
   static char *_trname[TRACE_NUM_FORMATS];
+  ActSimTraceQueue *_trq;	// asynchronous trace writer, if enabled
+  int _trace_detached;		// forked child; no tracing
+  NatTraceWriter *_ntr;		// native trace file
+  void *_traceAddSignal (int fmt, int type, const char *s, int width);
+  void _writeTrace (void * const *node, unsigned int ignore_fmt, int kind,
+		    act_chan_state_t state, float cur_time,
+		    int tlen, const unsigned long *ptm,
+		    int vlen, const unsigned long *valp);
+  void _recordTrace (void * const *node, unsigned int ignore_fmt, int type,
+		     act_chan_state_t state, const BigInt &val);
+  void _writeRecord (const unsigned long *rec);
+  void _emitRecord (const unsigned long *rec);
+  friend class ActSimTraceQueue;
+  friend class ActSimTraceWindow;
+
+  /*-- trigger-gated tracing --*/
+  struct iHashtable *_T;	// triggers, keyed like _W
+  ActSimTraceWindow *_trw;	// pre-trigger buffer
+  int _trg_state;		// 0 = off, 1 = armed, 2 = window open
+  unsigned long _trg_pre, _trg_post, _trg_stop;
+  unsigned int _trg_warn:1;	// trigger on warnings
+  void _chkTrigger (unsigned long key, const BigInt &val);
+  void _traceTrigger ();
+
+  /*-- channel token logs --*/
+  ChanTokenWriter *_tok_rec;	// current recording
+  list_t *_tok_replay;		// replay stubs
+  list_t *_tok_tables;		// port tables used by the stubs
+  void _recordToken (int goff, expr_multires &v);
+
+  /*-- watchall --*/
+  bitset_t *_wa_bits[2];	// traced bools, ints (global offsets)
+  list_t *_wa_roots;		// instance subtrees being traced
+  void **_wa_node[TRACE_NUM_SLOTS][2]; // trace handles per offset
+  list_t *_wa_names[TRACE_NUM_SLOTS];  // names used by open traces
+  int _watchall_walk (ActInstTable *t, int fmt, bitset_t **seen);
+  void _watchall_close (int fmt);
+  void _watchall_init ();
+
+  act_change_hook_t _chg_fn;	// change hook
+  void *_chg_cookie;
+  void _watchall_values (int fmt, int tmlen, unsigned long *ptm,
+			 float cur_time);
   float _int_to_float_timescale; // units to convert integer units
 				 // to time
   /*-- timing forks --*/
@@ -718,6 +1037,20 @@ protected:
   void _add_language (int lev, act_languages *l);
   void _add_all_inst (Scope *sc);
 
+  /*-- instance tree construction: plan, then create objects --*/
+  int _build_threads;		/* threads used for planning */
+  int _renumber_state;		/* locality-aware state layout */
+  void _plan_tree (act_inst_plan *p, iHashtable *H);
+  void _plan_recipe (act_plan_sub *r, Process *proc, stateinfo_t *si,
+		     act_boolean_netlist_t *mynl,
+		     int *iportbool, int *iportchp);
+  void _plan_port_kind (act_plan_port *r, int off, int space);
+  void _plan_scope (act_inst_plan *p, act_build_ctx *cx, int split);
+  void _plan_renumber (act_inst_plan *root, state_counts *end);
+  void _check_inst_frag (act_inst_plan *q, act_inst_plan *p,
+			 act_boolean_netlist_t *mynl);
+  void _inst_scope (act_inst_plan *p);
+
   ChpSimGraph *_build_chp_graph (act_chp_lang_t *c, ChpSimGraph **stop);
 
   /*- add specific language -*/
@@ -744,6 +1077,7 @@ protected:
 
   /*-- returns the current level selected --*/
   int _getlevel ();
+  int _getlevel (ActId *inst, Process *proc);
 
   void _initSim ();	      /* create simulation */
 
@@ -760,6 +1094,7 @@ protected:
   unsigned int _sim_rand_excl:1; /* 0 = normal, 1 = random excl */
 
   unsigned int _on_warning:2;	/* 0 = nothing, 1 = break, 2 = exit */
+  unsigned long _nwarn;		/* warnings reported */
 
   unsigned int _inf_loop_opt:1;	/* turn on infinite loop optimization */
 
@@ -805,14 +1140,24 @@ public:
 
    
 
-  void saveSim (FILE *);
-  void restoreSim (FILE *);
+  /* checkpoint image; 0 if the state cannot be saved/restored */
+  int saveSim (FILE *);
+  int restoreSim (FILE *);
 
   ActInstTable *getInstTable () { return &I; }
 
+  /* state and fanout table sizes */
+  void printCounts (FILE *fp);
+
+  /* set a Boolean/integer from outside the simulation; 0 if it
+     does not fit */
+  int setEnv (int type, int offset, BigInt &v, ActSimDES *cause);
+
   
 private:
   list_t *_init_simobjs;
+
+  void _ckpt_objects ();
 };
 
 void sim_recordChannel (ActSimCore *sc, ActSimObj *c, ActId *id);
@@ -826,8 +1171,14 @@ extern int debug_metrics;
 
 Act *actsim_Act();
 Process *actsim_top();
+
+ActInstTable *find_table (ActId *id, ActInstTable *x);
+ActSimObj *find_object (ActId **id, ActInstTable *x);
+int id_obj_to_siminfo (ActStatePass *sp, ActSimObj *obj, ActId *id,
+		       int *ptype, int *poffset);
 int is_rand_excl ();
-bool _match_hseprs (Event *);
+
+bool actsim_reset_pending ();	// prs/hse events pending?
 void runPending (bool verbose);
 
 #endif /* __ACT_SIM_H__ */
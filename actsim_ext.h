@@ -33,4 +33,22 @@ typedef struct expr_res {
 
 #define ACT_EXPR_RES_PRINTF "l"
 
+/*
+ * Checkpoint hooks for external libraries. save returns the library
+ * state in a buffer from malloc() and sets *len; restore is handed the
+ * same bytes when a simulation is resumed, and returns 0 on failure.
+ * A library registers its hooks once, when it is loaded; the symbol is
+ * weak so that libraries also load into programs without checkpoints.
+ */
+typedef void *(*actsim_ckpt_save_t) (int *len);
+typedef int (*actsim_ckpt_restore_t) (const void *buf, int len);
+
+#ifdef __cplusplus
+extern "C"
+#endif
+void actsim_checkpoint_register (const char *name,
+				 actsim_ckpt_save_t save,
+				 actsim_ckpt_restore_t restore)
+  __attribute__((weak));
+
 #endif /* __ACTSIM__EXT_H__ */
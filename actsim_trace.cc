@@ -0,0 +1,332 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2026 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <common/misc.h>
+#include <act/tracelib.h>
+#include "nattrace.h"
+
+/*
+ * Reader for actsim native trace files
+ */
+
+static void usage (char *name)
+{
+  fprintf (stderr, "Usage: %s <file> list\n", name);
+  fprintf (stderr, "       %s <file> dump [-s <signal>]* [-t <t0> <t1>]\n", name);
+  fprintf (stderr, "       %s <file> vcd <out.vcd> [-s <signal>]* [-t <t0> <t1>]\n", name);
+  fprintf (stderr, "\n");
+  fprintf (stderr, " Times are in integer simulation units.\n");
+  exit (1);
+}
+
+static const char *_type_name (int type)
+{
+  switch (type) {
+  case NATTRACE_BOOL: return "bool";
+  case NATTRACE_INT: return "int";
+  case NATTRACE_CHAN: return "chan";
+  default: return "?";
+  }
+}
+
+static const char *_state_name (int state)
+{
+  switch (state) {
+  case ACT_CHAN_IDLE: return "idle";
+  case ACT_CHAN_VALUE: return "value";
+  case ACT_CHAN_SEND_BLOCKED: return "send-blocked";
+  case ACT_CHAN_RECV_BLOCKED: return "recv-blocked";
+  default: return "?";
+  }
+}
+
+/* print a multi-word value in binary, most significant bit first */
+static void _print_bin (FILE *fp, int width, int nv, const unsigned long *v)
+{
+  int started = 0;
+  if (width <= 0) {
+    width = 64*nv;
+  }
+  for (int i=width-1; i >= 0; i--) {
+    int w = i / 64;
+    int b = (w < nv) ? ((v[w] >> (i % 64)) & 1) : 0;
+    if (b || started || i == 0) {
+      fputc (b ? '1' : '0', fp);
+      started = 1;
+    }
+  }
+}
+
+static void _print_hex (FILE *fp, int nv, const unsigned long *v)
+{
+  int i = nv - 1;
+  while (i > 0 && v[i] == 0) {
+    i--;
+  }
+  fprintf (fp, "0x%lx", v[i]);
+  for (i--; i >= 0; i--) {
+    fprintf (fp, "%016lx", v[i]);
+  }
+}
+
+/*------------------------------------------------------------------------
+ *
+ *  dump
+ *
+ *------------------------------------------------------------------------
+ */
+static void _dump_change (void *cookie, const struct nattrace_change *c)
+{
+  NatTraceReader *r = (NatTraceReader *) cookie;
+  const struct nattrace_sig *s = r->getSignal (c->id);
+
+  printf ("%lu %s ", c->tm, s->name);
+  if (s->type == NATTRACE_BOOL) {
+    printf ("%c\n", c->v[0] == NATTRACE_VX ? 'X' : (char)('0' + c->v[0]));
+  }
+  else {
+    if (s->type == NATTRACE_CHAN) {
+      printf ("%s ", _state_name (c->state));
+    }
+    if (c->nv > 0) {
+      _print_hex (stdout, c->nv, c->v);
+    }
+    printf ("\n");
+  }
+}
+
+/*------------------------------------------------------------------------
+ *
+ *  VCD conversion
+ *
+ *------------------------------------------------------------------------
+ */
+struct vcd_out {
+  FILE *fp;
+  NatTraceReader *r;
+  char **ids;
+  unsigned long last;
+  int started;
+};
+
+static char *_vcd_id (int n)
+{
+  char buf[16];
+  int i = 0;
+  do {
+    buf[i++] = '!' + (n % 94);
+    n /= 94;
+  } while (n > 0);
+  buf[i] = '\0';
+  return Strdup (buf);
+}
+
+static const char *_vcd_timescale (double ts)
+{
+  static const char *units[] = { "s", "ms", "us", "ns", "ps", "fs" };
+  static char buf[32];
+  double m = 1;
+  for (int i=0; i < 6; i++) {
+    for (int k=1; k <= 100; k *= 10) {
+      if (ts > k*m*0.999 && ts < k*m*1.001) {
+	snprintf (buf, 32, "%d %s", k, units[i]);
+	return buf;
+      }
+    }
+    m /= 1000;
+  }
+  return "1 ps";
+}
+
+static void _vcd_change (void *cookie, const struct nattrace_change *c)
+{
+  struct vcd_out *o = (struct vcd_out *) cookie;
+  const struct nattrace_sig *s = o->r->getSignal (c->id);
+
+  if (s->type == NATTRACE_CHAN && c->state != ACT_CHAN_VALUE) {
+    return;
+  }
+  if (!o->started || c->tm != o->last) {
+    fprintf (o->fp, "#%lu\n", c->tm);
+    o->last = c->tm;
+    o->started = 1;
+  }
+  if (s->type == NATTRACE_BOOL) {
+    fprintf (o->fp, "%c%s\n",
+	     c->v[0] == NATTRACE_VX ? 'x' : (char)('0' + c->v[0]), o->ids[c->id]);
+  }
+  else {
+    fputc ('b', o->fp);
+    _print_bin (o->fp, s->width, c->nv, c->v);
+    fprintf (o->fp, " %s\n", o->ids[c->id]);
+  }
+}
+
+static int _write_vcd (NatTraceReader *r, const char *file,
+		       unsigned long t0, unsigned long t1,
+		       const unsigned char *sel)
+{
+  struct vcd_out o;
+  int ret;
+
+  o.fp = fopen (file, "w");
+  if (!o.fp) {
+    fprintf (stderr, "Could not open `%s' for writing\n", file);
+    return 0;
+  }
+  o.r = r;
+  o.started = 0;
+  o.last = 0;
+  MALLOC (o.ids, char *, r->numSignals() + 1);
+
+  fprintf (o.fp, "$comment\n  converted from actsim native trace\n$end\n");
+  fprintf (o.fp, "$timescale %s $end\n", _vcd_timescale (r->getTimescale()));
+  fprintf (o.fp, "$scope module top $end\n");
+  for (int i=0; i < r->numSignals(); i++) {
+    const struct nattrace_sig *s = r->getSignal (i);
+    o.ids[i] = _vcd_id (i);
+    if (sel && !sel[i]) continue;
+    fprintf (o.fp, "$var wire %d %s %s $end\n",
+	     s->type == NATTRACE_BOOL ? 1 : s->width, o.ids[i], s->name);
+  }
+  fprintf (o.fp, "$upscope $end\n");
+  fprintf (o.fp, "$enddefinitions $end\n");
+
+  /* values before the window are not known */
+  fprintf (o.fp, "#%lu\n$dumpvars\n", t0);
+  for (int i=0; i < r->numSignals(); i++) {
+    const struct nattrace_sig *s = r->getSignal (i);
+    if (sel && !sel[i]) continue;
+    if (s->type == NATTRACE_BOOL) {
+      fprintf (o.fp, "x%s\n", o.ids[i]);
+    }
+    else {
+      fprintf (o.fp, "bx %s\n", o.ids[i]);
+    }
+  }
+  fprintf (o.fp, "$end\n");
+  o.last = t0;
+  o.started = 1;
+
+  ret = r->scan (t0, t1, sel, _vcd_change, &o);
+
+  fclose (o.fp);
+  for (int i=0; i < r->numSignals(); i++) {
+    FREE (o.ids[i]);
+  }
+  FREE (o.ids);
+  return ret;
+}
+
+
+int main (int argc, char **argv)
+{
+  NatTraceReader *r;
+  unsigned long t0, t1;
+  unsigned char *sel;
+  const char *out;
+  int i, ret;
+
+  if (argc < 3) {
+    usage (argv[0]);
+  }
+
+  r = NatTraceReader::open (argv[1]);
+  if (!r) {
+    fprintf (stderr, "%s: could not read trace file `%s'\n", argv[0], argv[1]);
+    return 1;
+  }
+
+  if (strcmp (argv[2], "list") == 0) {
+    if (argc != 3) {
+      usage (argv[0]);
+    }
+    for (i=0; i < r->numSignals(); i++) {
+      const struct nattrace_sig *s = r->getSignal (i);
+      printf ("%s %s %d\n", s->name, _type_name (s->type), s->width);
+    }
+    delete r;
+    return 0;
+  }
+
+  if (strcmp (argv[2], "dump") == 0) {
+    out = NULL;
+    i = 3;
+  }
+  else if (strcmp (argv[2], "vcd") == 0) {
+    if (argc < 4) {
+      usage (argv[0]);
+    }
+    out = argv[3];
+    i = 4;
+  }
+  else {
+    usage (argv[0]);
+    return 1;
+  }
+
+  t0 = 0;
+  t1 = ~0UL;
+  sel = NULL;
+  for (; i < argc; i++) {
+    if (strcmp (argv[i], "-s") == 0 && i+1 < argc) {
+      int id = r->findSignal (argv[i+1]);
+      if (id == -1) {
+	fprintf (stderr, "%s: signal `%s' not found\n", argv[0], argv[i+1]);
+	return 1;
+      }
+      if (!sel) {
+	MALLOC (sel, unsigned char, r->numSignals());
+	for (int j=0; j < r->numSignals(); j++) {
+	  sel[j] = 0;
+	}
+      }
+      sel[id] = 1;
+      i++;
+    }
+    else if (strcmp (argv[i], "-t") == 0 && i+2 < argc) {
+      t0 = strtoul (argv[i+1], NULL, 0);
+      t1 = strtoul (argv[i+2], NULL, 0);
+      i += 2;
+    }
+    else {
+      usage (argv[0]);
+    }
+  }
+
+  if (out) {
+    ret = _write_vcd (r, out, t0, t1, sel);
+  }
+  else {
+    ret = r->scan (t0, t1, sel, _dump_change, r);
+  }
+  if (!ret) {
+    fprintf (stderr, "%s: error reading `%s'\n", argv[0], argv[1]);
+  }
+  if (sel) {
+    FREE (sel);
+  }
+  delete r;
+  return ret ? 0 : 1;
+}
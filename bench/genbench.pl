@@ -0,0 +1,330 @@
+#!/usr/bin/perl
+#
+# genbench.pl: generate scalable actsim benchmarks
+#
+#  Usage: genbench.pl <kind> <size...>
+#
+#    ring  <stages> <rings>     : PRS ring oscillators (run with advance)
+#    wchb  <stages> <tokens>    : dual-rail WCHB FIFO, CHP environment
+#    pchb  <stages> <tokens>    : dual-rail PCHB FIFO, CHP environment
+#    mesh  <w> <h> <packets>    : CHP 2D mesh NoC, XY routing
+#    mixed <stages> <tokens>    : alternating CHP/PRS stages on a1of2
+#    ext   <procs> <calls>      : simlib random number calls
+#
+# The ACT file is written to stdout; the top-level process is "test".
+#
+
+die "Usage: $0 <kind> <size...>\n" unless $#ARGV >= 1;
+
+$kind = shift @ARGV;
+
+if ($kind eq "ring") {
+    &ring (@ARGV);
+}
+elsif ($kind eq "wchb" || $kind eq "pchb") {
+    &fifo ($kind, @ARGV);
+}
+elsif ($kind eq "mesh") {
+    &mesh (@ARGV);
+}
+elsif ($kind eq "mixed") {
+    &mixed (@ARGV);
+}
+elsif ($kind eq "ext") {
+    &ext (@ARGV);
+}
+else {
+    die "$0: unknown benchmark `$kind'\n";
+}
+exit 0;
+
+
+sub reset_init {
+    print "Initialize {\n";
+    print "  actions { Reset+ };\n";
+    print "  actions { Reset- }\n";
+    print "}\n";
+}
+
+#
+# ring oscillators: <rings> independent rings of <stages> inverters
+#
+sub ring {
+    my ($n, $m) = @_;
+    $m = 1 if !defined $m;
+    $n++ if ($n % 2) == 0;
+
+    print "import globals;\n\n";
+    print "defproc ring ()\n{\n";
+    print "  bool x[$n];\n";
+    print "  prs {\n";
+    print "    Reset | x[", $n-1, "] => x[0]-\n";
+    for (my $i=1; $i < $n; $i++) {
+	print "    x[", $i-1, "] => x[$i]-\n";
+    }
+    print "  }\n}\n\n";
+    print "defproc test ()\n{\n";
+    print "  ring r[$m];\n";
+    print "}\n\n";
+    &reset_init ();
+}
+
+sub env {
+    my ($tok) = @_;
+    print <<EOF;
+defproc src (a1of2! R)
+{
+  int i;
+  chp {
+    i := 0;
+   *[ i < $tok -> R!(i & 1); i := i + 1 ]
+  }
+}
+
+defproc sink (a1of2? L)
+{
+  int v;
+  chp {
+   *[ L?v ]
+  }
+}
+
+EOF
+}
+
+sub wchb_stage {
+    print <<'EOF';
+defproc wchb (a1of2? L; a1of2! R)
+{
+  bool _rt, _rf, _v, en;
+  prs {
+    ~Reset & L.t & en -> _rt-
+    Reset | ~L.t & ~en -> _rt+
+    ~Reset & L.f & en -> _rf-
+    Reset | ~L.f & ~en -> _rf+
+    _rt => R.t-
+    _rf => R.f-
+    R.t | R.f => _v-
+    _v => L.a-
+    R.a => en-
+  }
+}
+
+EOF
+}
+
+sub pchb_stage {
+    print <<'EOF';
+defproc pchb (a1of2? L; a1of2! R)
+{
+  bool _rt, _rf, _lv, _rv, _la, en, re;
+  prs {
+    ~Reset & en & re & L.t -> _rt-
+    Reset | ~en & ~re -> _rt+
+    ~Reset & en & re & L.f -> _rf-
+    Reset | ~en & ~re -> _rf+
+    _rt => R.t-
+    _rf => R.f-
+    L.t | L.f => _lv-
+    R.t | R.f => _rv-
+    ~_lv & ~_rv -> _la-
+    Reset | _lv & _rv -> _la+
+    _la => L.a-
+    L.a => en-
+    R.a => re-
+  }
+}
+
+EOF
+}
+
+#
+# linear FIFO of <stages> PRS stages
+#
+sub fifo {
+    my ($kind, $n, $tok) = @_;
+    $tok = 1000 if !defined $tok;
+
+    print "import globals;\nimport std;\nopen std::channel;\n\n";
+    if ($kind eq "wchb") {
+	&wchb_stage ();
+    }
+    else {
+	&pchb_stage ();
+    }
+    &env ($tok);
+    print "defproc test ()\n{\n";
+    print "  $kind b[$n];\n";
+    print "  src s(b[0].L);\n";
+    print "  sink t(b[", $n-1, "].R);\n";
+    print "  (i:", $n-1, ": b[i].R = b[i+1].L;)\n";
+    print "}\n\n";
+    &reset_init ();
+}
+
+#
+# alternating CHP buffers and PRS WCHB stages
+#
+sub mixed {
+    my ($n, $tok) = @_;
+    $tok = 1000 if !defined $tok;
+
+    print "import globals;\nimport std;\nopen std::channel;\n\n";
+    &wchb_stage ();
+    print <<'EOF';
+defproc cbuf (a1of2? L; a1of2! R)
+{
+  int v;
+  chp {
+   *[ L?v; R!v ]
+  }
+}
+
+defproc pair (a1of2? L; a1of2! R)
+{
+  cbuf c(L);
+  wchb w(c.R, R);
+}
+
+EOF
+    &env ($tok);
+    print "defproc test ()\n{\n";
+    print "  pair p[$n];\n";
+    print "  src s(p[0].L);\n";
+    print "  sink t(p[", $n-1, "].R);\n";
+    print "  (i:", $n-1, ": p[i].R = p[i+1].L;)\n";
+    print "}\n\n";
+    &reset_init ();
+}
+
+#
+# W x H mesh. Ports: 0 = north, 1 = south, 2 = east, 3 = west, 4 = local.
+# Packets are {y, x} of the destination.
+#
+sub mesh {
+    my ($w, $h, $npk) = @_;
+    $h = $w if !defined $h;
+    $npk = 100 if !defined $npk;
+
+    print <<'EOF';
+template<pint X, Y>
+defproc route (chan?(int<16>) I; chan!(int<16>) O[5])
+{
+  int<16> p;
+  chp {
+   *[ I?p;
+      [ p{7..0} > X -> O[2]!p
+     [] p{7..0} < X -> O[3]!p
+     [] p{7..0} = X & p{15..8} > Y -> O[0]!p
+     [] p{7..0} = X & p{15..8} < Y -> O[1]!p
+     [] p{7..0} = X & p{15..8} = Y -> O[4]!p
+      ]
+    ]
+  }
+}
+
+defproc merge (chan?(int<16>) I[5]; chan!(int<16>) O)
+{
+  int<16> p;
+  chp {
+   *[ [| #I[0] -> I[0]?p
+      [] #I[1] -> I[1]?p
+      [] #I[2] -> I[2]?p
+      [] #I[3] -> I[3]?p
+      [] #I[4] -> I[4]?p
+      |];
+      O!p
+    ]
+  }
+}
+
+template<pint X, Y>
+defproc router (chan?(int<16>) I[5]; chan!(int<16>) O[5])
+{
+  route<X,Y> r[5];
+  merge m[5];
+  (i:5: r[i].I = I[i]; m[i].O = O[i]; (j:5: r[i].O[j] = m[j].I[i];))
+}
+
+template<pint X, Y, W, H, N>
+defproc nsrc (chan!(int<16>) O)
+{
+  int<32> s;
+  int<8> dx, dy;
+  int i;
+  chp {
+    s := X*H + Y + 1;
+    i := 0;
+   *[ i < N -> s := s*1103515245 + 12345;
+               dx := (s >> 16) % W;
+               dy := (s >> 8) % H;
+               O!{dy,dx};
+               i := i + 1
+    ]
+  }
+}
+
+defproc nsink (chan?(int<16>) I)
+{
+  int<16> p;
+  int n;
+  chp {
+    n := 0;
+   *[ I?p; n := n + 1 ]
+  }
+}
+
+EOF
+    print "defproc test ()\n{\n";
+    for (my $x=0; $x < $w; $x++) {
+	for (my $y=0; $y < $h; $y++) {
+	    print "  router<$x,$y> r_${x}_${y};\n";
+	    print "  nsrc<$x,$y,$w,$h,$npk> s_${x}_${y}(r_${x}_${y}.I[4]);\n";
+	    print "  nsink k_${x}_${y}(r_${x}_${y}.O[4]);\n";
+	}
+    }
+    for (my $x=0; $x < $w; $x++) {
+	for (my $y=0; $y < $h; $y++) {
+	    if ($x+1 < $w) {
+		my $e = ($x+1) . "_$y";
+		print "  r_${x}_${y}.O[2] = r_$e.I[3];\n";
+		print "  r_$e.O[3] = r_${x}_${y}.I[2];\n";
+	    }
+	    if ($y+1 < $h) {
+		my $n = "${x}_" . ($y+1);
+		print "  r_${x}_${y}.O[0] = r_$n.I[1];\n";
+		print "  r_$n.O[1] = r_${x}_${y}.I[0];\n";
+	    }
+	}
+    }
+    print "}\n";
+}
+
+#
+# <procs> processes, each making <calls> calls into simlib
+#
+sub ext {
+    my ($n, $calls) = @_;
+    $calls = 1000 if !defined $calls;
+
+    print <<EOF;
+import sim;
+
+defproc rgen ()
+{
+  int i, x, s;
+  int idx;
+  chp {
+    i := 0;
+    s := 0;
+    idx := sim::rand::init_range(8, 0, 255);
+   *[ i < $calls -> x := sim::rand::get(idx); s := s + x; i := i + 1 ]
+  }
+}
+
+defproc test ()
+{
+  rgen g[$n];
+}
+EOF
+}
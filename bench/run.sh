@@ -0,0 +1,100 @@
+#!/bin/sh
+#
+# Run the benchmark suite. One line per benchmark:
+#
+#   bench=<name> size=<args> events=<n> startup=<s> run=<s> ev_per_s=<n> rss_kb=<n>
+#
+# and, for the socket server, the rate of pipelined GET requests:
+#
+#   bench=server ops=<n> time=<s> ops_per_s=<n>
+#
+# startup is the time to load and build the simulation with no events;
+# run is the remaining time. BENCH_SCALE multiplies the default sizes,
+# and BENCH_CNF names a configuration file to use (for example,
+# renumber.conf to compare against the locality-aware state layout).
+#
+
+ARCH=`$ACT_HOME/scripts/getarch`
+OS=`$ACT_HOME/scripts/getos`
+EXT=${ARCH}_${OS}
+if [ ! x$ACT_TEST_INSTALL = x ] || [ ! -f ../actsim.$EXT ]; then
+  ACTTOOL=$ACT_HOME/bin/actsim
+else
+  ACTTOOL=../actsim.$EXT
+fi
+
+if [ x$BENCH_SCALE = x ]; then
+  BENCH_SCALE=1
+fi
+
+if [ x$BENCH_CNF = x ]; then
+  CNF=""
+else
+  CNF="-cnf=$BENCH_CNF"
+fi
+
+if [ ! -d runs ]
+then
+	mkdir runs
+fi
+
+if [ -x /usr/bin/time ]; then
+  TIMER="/usr/bin/time -f %M -o"
+else
+  TIMER=""
+fi
+
+now()
+{
+  date +%s.%N
+}
+
+# run_one <name> <script> <kind> <size...>
+run_one()
+{
+  name=$1
+  scr=$2
+  shift 2
+  ./genbench.pl "$@" > runs/$name.act || exit 1
+
+  t0=`now`
+  echo "" | $ACTTOOL $CNF runs/$name.act test > /dev/null 2>&1
+  t1=`now`
+  if [ "x$TIMER" = x ]; then
+    printf "stats on\n$scr\nstats\n" | $ACTTOOL $CNF runs/$name.act test > runs/$name.out 2> runs/$name.err
+    rss=-
+  else
+    printf "stats on\n$scr\nstats\n" | $TIMER runs/$name.rss $ACTTOOL $CNF runs/$name.act test > runs/$name.out 2> runs/$name.err
+    rss=`tail -1 runs/$name.rss`
+  fi
+  t2=`now`
+
+  shift
+  size=`echo "$@" | tr ' ' ','`
+  ev=`awk '$1 == "events" { print $2 }' runs/$name.out`
+  if [ "x$ev" = x ]; then
+    ev=0
+  fi
+  echo "$t0 $t1 $t2" | awk -v name=$name -v size=$size -v ev=$ev -v rss=$rss \
+    '{ st = $2 - $1; rt = ($3 - $2) - st; if (rt <= 0) { rt = 1e-6; }
+       printf "bench=%s size=%s events=%d startup=%.3f run=%.3f ev_per_s=%.0f rss_kb=%s\n", name, size, ev, st, rt, ev/rt, rss }'
+}
+
+S=$BENCH_SCALE
+
+run_one ring    "advance `expr 100000 \* $S`" ring `expr 101 \* $S` 16
+run_one wchb    "cycle" wchb `expr 64 \* $S` 2000
+run_one pchb    "cycle" pchb `expr 64 \* $S` 2000
+run_one mixed   "cycle" mixed `expr 32 \* $S` 2000
+run_one mesh    "cycle" mesh `expr 4 \* $S` `expr 4 \* $S` 200
+run_one ext     "cycle" ext `expr 16 \* $S` 5000
+
+# socket server: pipelined GET requests from test/srvclient.c
+if ${CC:-cc} -o runs/srvclient ../test/srvclient.c > /dev/null 2>&1; then
+  ./genbench.pl ring 101 1 > runs/server.act || exit 1
+  rm -f runs/server.sock
+  echo "server runs/server.sock" | $ACTTOOL $CNF runs/server.act test > /dev/null 2>&1 &
+  runs/srvclient -b runs/server.sock "r[0].x[0]" `expr 200000 \* $S` | \
+    awk '/^ops=/ { print "bench=server " $0 }'
+  wait
+fi
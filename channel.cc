@@ -486,6 +486,7 @@ int ChanMethods::runMethod (ActSimCore *sim,
 	}
 	if (v == -1) {
 	  const ActSim::watchpt_bucket *nm;
+	  ACTSIM_PERF (PERF_WATCH_CHK);
 	  if ((nm = sim->chkWatchPt (0, b->i))) {
 	    BigInt tmpv;
 	    ch->_dummy->msgPrefix ();
@@ -494,6 +495,11 @@ int ChanMethods::runMethod (ActSimCore *sim,
 	    tmpv = (_ops[idx].op[from].type == CHAN_OP_BOOL_T ? 1 : 0);
 	    sim->recordTrace (nm, 0, ACT_CHAN_IDLE, tmpv);
 	  }
+	  else if (sim->chkWatchAll (0, b->i)) {
+	    BigInt tmpv;
+	    tmpv = (_ops[idx].op[from].type == CHAN_OP_BOOL_T ? 1 : 0);
+	    sim->recordTraceAll (0, b->i, tmpv);
+	  }
 	  ch->_dummy->boolProp (b->i);
 	}
       }
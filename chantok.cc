@@ -0,0 +1,423 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2026 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include "chantok.h"
+
+#define CHANTOK_MAGIC   "ACTSIMCT"
+#define CHANTOK_VERSION 1
+
+/* event types used by the environment stub */
+#define CHANENV_EV_START  0
+#define CHANENV_EV_WAKEUP 1
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Recording
+ *
+ *------------------------------------------------------------------------
+ */
+ChanTokenWriter::ChanTokenWriter ()
+{
+  _fp = NULL;
+  _H = NULL;
+  _last = 0;
+}
+
+ChanTokenWriter::~ChanTokenWriter ()
+{
+  if (_fp) {
+    fclose (_fp);
+  }
+  if (_H) {
+    ihash_free (_H);
+  }
+}
+
+void ChanTokenWriter::_put (unsigned long x)
+{
+  while (x >= 0x80) {
+    fputc ((int)(x & 0x7f) | 0x80, _fp);
+    x >>= 7;
+  }
+  fputc ((int)x, _fp);
+}
+
+ChanTokenWriter *ChanTokenWriter::create (const char *file, int nports,
+					  struct chantok_port *ports)
+{
+  ChanTokenWriter *w;
+  FILE *fp;
+
+  fp = fopen (file, "wb");
+  if (!fp) {
+    return NULL;
+  }
+  w = new ChanTokenWriter ();
+  w->_fp = fp;
+  w->_H = ihash_new (4);
+  w->_last = SimDES::CurTime().getVal (0);
+
+  fwrite (CHANTOK_MAGIC, 1, 8, fp);
+  w->_put (CHANTOK_VERSION);
+  w->_put (w->_last);
+  w->_put (nports);
+  for (int i=0; i < nports; i++) {
+    int len = strlen (ports[i].name);
+    w->_put (len);
+    fwrite (ports[i].name, 1, len, fp);
+    w->_put (ports[i].dir);
+    ihash_bucket_t *b = ihash_add (w->_H, ports[i].goff);
+    b->i = i;
+  }
+  return w;
+}
+
+void ChanTokenWriter::token (int goff, const expr_multires &v)
+{
+  ihash_bucket_t *b = ihash_lookup (_H, goff);
+  if (!b) {
+    return;
+  }
+  unsigned long tm = SimDES::CurTime().getVal (0);
+  _put (b->i);
+  _put (tm - _last);
+  _last = tm;
+  _put (v.nvals);
+  for (int i=0; i < v.nvals; i++) {
+    _put (v.v[i].getWidth());
+    _put (v.v[i].getLen());
+    for (int j=0; j < v.v[i].getLen(); j++) {
+      _put (v.v[i].getVal (j));
+    }
+  }
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Reading a log
+ *
+ *------------------------------------------------------------------------
+ */
+static int _get (FILE *fp, unsigned long *x)
+{
+  unsigned long v = 0;
+  int shift = 0;
+  int c;
+  do {
+    c = fgetc (fp);
+    if (c == EOF || shift > 63) {
+      return 0;
+    }
+    v |= ((unsigned long)(c & 0x7f)) << shift;
+    shift += 7;
+  } while (c & 0x80);
+  *x = v;
+  return 1;
+}
+
+void ChanReplay::freePorts (struct chantok_port *p)
+{
+  for (int i=0; p[i].name; i++) {
+    for (int j=0; j < A_LEN (p[i].tok); j++) {
+      for (int k=0; k < p[i].tok[j].nvals; k++) {
+	p[i].tok[j].v[k].~BigInt();
+      }
+      if (p[i].tok[j].nvals > 0) {
+	FREE (p[i].tok[j].v);
+      }
+    }
+    A_FREE (p[i].tok);
+    FREE (p[i].name);
+  }
+  FREE (p);
+}
+
+struct chantok_port *ChanReplay::load (const char *file, int *nports)
+{
+  FILE *fp;
+  char magic[8];
+  unsigned long x, tm, np;
+  struct chantok_port *p;
+
+  fp = fopen (file, "rb");
+  if (!fp) {
+    return NULL;
+  }
+  if (fread (magic, 1, 8, fp) != 8 || memcmp (magic, CHANTOK_MAGIC, 8) != 0
+      || !_get (fp, &x) || x != CHANTOK_VERSION
+      || !_get (fp, &tm) || !_get (fp, &np) || np == 0) {
+    fclose (fp);
+    return NULL;
+  }
+
+  MALLOC (p, struct chantok_port, np + 1);
+  for (int i=0; i <= (int)np; i++) {
+    p[i].name = NULL;
+    p[i].goff = -1;
+    A_INIT (p[i].tok);
+  }
+  for (int i=0; i < (int)np; i++) {
+    if (!_get (fp, &x) || x > 4096) {
+      goto fail;
+    }
+    MALLOC (p[i].name, char, x + 1);
+    p[i].name[0] = '\0';
+    if (fread (p[i].name, 1, x, fp) != x) {
+      goto fail;
+    }
+    p[i].name[x] = '\0';
+    if (!_get (fp, &x)) {
+      goto fail;
+    }
+    p[i].dir = x;
+  }
+
+  /* tokens, until the end of the file */
+  while (_get (fp, &x)) {
+    unsigned long dt, nv;
+    if (x >= np || !_get (fp, &dt) || !_get (fp, &nv)) {
+      goto fail;
+    }
+    tm += dt;
+    A_NEW (p[x].tok, struct chantok_token);
+    struct chantok_token *t = &A_NEXT (p[x].tok);
+    t->tm = tm;
+    t->nvals = nv;
+    t->v = NULL;
+    A_INC (p[x].tok);
+    if (nv > 0) {
+      MALLOC (t->v, BigInt, nv);
+      for (int i=0; i < (int)nv; i++) {
+	new (&t->v[i]) BigInt;
+      }
+    }
+    for (int i=0; i < (int)nv; i++) {
+      unsigned long width, len, w;
+      if (!_get (fp, &width) || !_get (fp, &len)) {
+	goto fail;
+      }
+      BigInt b (width, 0, 0);
+      for (int j=0; j < (int)len; j++) {
+	if (!_get (fp, &w)) {
+	  goto fail;
+	}
+	b.setVal (j, w);
+      }
+      t->v[i] = b;
+    }
+  }
+  fclose (fp);
+  *nports = np;
+  return p;
+
+fail:
+  fclose (fp);
+  freePorts (p);
+  return NULL;
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Environment stubs
+ *
+ *  The stub follows the same handshake on the channel state as a CHP
+ *  process at the other end (see ChpSim::varSend/varRecv).
+ *
+ *------------------------------------------------------------------------
+ */
+ChanEnvStub::ChanEnvStub (ActSimCore *sc, int goff)
+{
+  _sc = sc;
+  _goff = goff;
+  _send = 0;
+}
+
+ChanEnvStub::~ChanEnvStub ()
+{
+}
+
+void ChanEnvStub::startSend (const expr_multires &v, int delay)
+{
+  _send = 1;
+  _val = v;
+  new Event (this, SIM_EV_MKTYPE (CHANENV_EV_START, 0), delay);
+  actsim_pending.other++;
+}
+
+void ChanEnvStub::startRecv (int delay)
+{
+  _send = 0;
+  new Event (this, SIM_EV_MKTYPE (CHANENV_EV_START, 0), delay);
+  actsim_pending.other++;
+}
+
+int ChanEnvStub::Step (Event *ev)
+{
+  int ev_type = SIM_EV_TYPE (ev->getType());
+  act_channel_state *c = _sc->getChan (_goff);
+
+  actsim_pending.other--;
+  if (ev_type == CHANENV_EV_WAKEUP) {
+    /* the process arrived at the other end */
+    if (_send) {
+      c->count++;
+      done (NULL);
+    }
+    else {
+      expr_multires tmp (c->data);
+      done (&tmp);
+    }
+    return 1;
+  }
+
+  if (_send) {
+    if (WAITING_RECEIVER (c)) {
+      c->data = _val;
+      c->w->Notify (c->recv_here-1, this);
+      actsim_pending.other++;
+      c->recv_here = 0;
+      c->count++;
+      done (NULL);
+    }
+    else {
+      if (WAITING_RECV_PROBE (c)) {
+	c->probe->Notify (c->recv_here-1, this);
+	actsim_pending.other++;
+	c->recv_here = 0;
+	c->receiver_probe = 0;
+      }
+      c->data2 = _val;
+      c->send_here = CHANENV_EV_WAKEUP + 1;
+      if (!c->w->isWaiting (this)) {
+	c->w->AddObject (this);
+      }
+    }
+  }
+  else {
+    if (WAITING_SENDER (c)) {
+      expr_multires tmp (c->data2);
+      c->w->Notify (c->send_here-1, this);
+      actsim_pending.other++;
+      c->send_here = 0;
+      done (&tmp);
+    }
+    else {
+      if (WAITING_SEND_PROBE (c)) {
+	c->probe->Notify (c->send_here-1, this);
+	actsim_pending.other++;
+	c->send_here = 0;
+	c->sender_probe = 0;
+      }
+      c->recv_here = CHANENV_EV_WAKEUP + 1;
+      if (!c->w->isWaiting (this)) {
+	c->w->AddObject (this);
+      }
+    }
+  }
+  return 1;
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Replay stubs
+ *
+ *------------------------------------------------------------------------
+ */
+ChanReplay::ChanReplay (ActSimCore *sc, struct chantok_port *p)
+  : ChanEnvStub (sc, p->goff)
+{
+  _p = p;
+  _pos = 0;
+  _mismatch = 0;
+  _schedule ();
+}
+
+ChanReplay::~ChanReplay ()
+{
+}
+
+void ChanReplay::sPrintCause (char *buf, int sz)
+{
+  snprintf (buf, sz, "replay:%s", _p->name);
+}
+
+/* start the next token, no earlier than its recorded time */
+void ChanReplay::_schedule ()
+{
+  if (_pos >= A_LEN (_p->tok)) {
+    return;
+  }
+  unsigned long now = SimDES::CurTime().getVal (0);
+  struct chantok_token *t = &_p->tok[_pos];
+  int delay = t->tm > now ? (int)(t->tm - now) : 0;
+
+  if (_p->dir == CHANTOK_IN) {
+    /* the logged value, in the shape of the channel data */
+    expr_multires m (_sc->getChan (_goff)->data);
+    if (m.nvals == t->nvals) {
+      for (int i=0; i < t->nvals; i++) {
+	int w = m.v[i].getWidth();
+	m.v[i] = t->v[i];
+	m.v[i].setWidth (w);
+      }
+    }
+    else if (t->nvals == 1) {
+      m.setSingle (t->v[0]);
+    }
+    startSend (m, delay);
+  }
+  else {
+    startRecv (delay);
+  }
+}
+
+/* finished the current token; v is the value received, if any */
+void ChanReplay::done (const expr_multires *v)
+{
+  struct chantok_token *t = &_p->tok[_pos];
+
+  if (v) {
+    int ok = (v->nvals == t->nvals);
+    for (int i=0; ok && i < t->nvals; i++) {
+      BigInt a = v->v[i];
+      BigInt b = t->v[i];
+      a.setWidth (b.getWidth());
+      ok = (a == b);
+    }
+    if (!ok) {
+      _mismatch++;
+      BigInt tm = SimDES::CurTime();
+      printf ("[");
+      tm.decPrint (stdout, 20);
+      printf ("] <replay> WARNING: token #%d on `%s' differs from the log\n",
+	      _pos, _p->name);
+      if (_sc->onWarning() == 2) {
+	exit (2);
+      }
+    }
+  }
+  _pos++;
+  _schedule ();
+}
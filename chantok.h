@@ -0,0 +1,138 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2026 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#ifndef __ACTSIM_CHANTOK_H__
+#define __ACTSIM_CHANTOK_H__
+
+#include "actsim.h"
+
+/*
+ * Channel token logs, used to re-simulate one block with its
+ * environment replaced by replay stubs.
+ *
+ *  header : "ACTSIMCT", version, port table (name, direction)
+ *  tokens : port, time delta, number of values, and for each value
+ *           its bit-width followed by its words
+ *
+ * All integers are unsigned varints. Directions are relative to the
+ * recorded block: CHANTOK_IN is a token the environment sent to the
+ * block.
+ */
+
+#define CHANTOK_IN  0
+#define CHANTOK_OUT 1
+
+struct chantok_token {
+  unsigned long tm;		// completion time
+  int nvals;
+  BigInt *v;
+};
+
+struct chantok_port {
+  char *name;			// relative to the block
+  int dir;			// CHANTOK_IN/OUT
+  int goff;			// channel, when in use
+  A_DECL (chantok_token, tok);	// only used for replay
+};
+
+
+class ChanTokenWriter {
+public:
+  /* returns NULL on failure */
+  static ChanTokenWriter *create (const char *file, int nports,
+				  struct chantok_port *ports);
+  ~ChanTokenWriter ();
+
+  /* log a completed action if the channel is one of the ports */
+  void token (int goff, const expr_multires &v);
+
+private:
+  ChanTokenWriter ();
+  void _put (unsigned long x);
+
+  FILE *_fp;
+  struct iHashtable *_H;	// goff -> port
+  unsigned long _last;
+};
+
+
+/*
+ * Environment at the other end of a channel: one send or receive at
+ * a time, with the same handshake on the channel state as a CHP
+ * process (see ChpSim::varSend/varRecv). Only channels that are not
+ * fragmented are supported. done() is called when the action
+ * completes, with the value for a receive and NULL for a send.
+ */
+class ChanEnvStub : public ActSimDES {
+public:
+  ChanEnvStub (ActSimCore *sc, int goff);
+  virtual ~ChanEnvStub ();
+
+  int Step (Event *ev);
+
+protected:
+  /* start the action after delay */
+  void startSend (const expr_multires &v, int delay);
+  void startRecv (int delay);
+  virtual void done (const expr_multires *v) = 0;
+
+  ActSimCore *_sc;
+  int _goff;
+
+private:
+  int _send;			// 1 for a send
+  expr_multires _val;		// value being sent
+};
+
+
+/*
+ * Environment stub for one port: sends (CHANTOK_IN) or receives
+ * (CHANTOK_OUT) the recorded tokens, no earlier than their recorded
+ * times. Received values are checked against the log.
+ */
+class ChanReplay : public ChanEnvStub {
+public:
+  ChanReplay (ActSimCore *sc, struct chantok_port *p);
+  ~ChanReplay ();
+
+  void sPrintCause (char *buf, int sz);
+
+  int numMismatch () { return _mismatch; }
+
+  /*
+   * Read a log; returns the port table, terminated by an entry with
+   * a NULL name, or NULL on failure
+   */
+  static struct chantok_port *load (const char *file, int *nports);
+  static void freePorts (struct chantok_port *p);
+
+protected:
+  void done (const expr_multires *v);
+
+private:
+  void _schedule ();
+
+  struct chantok_port *_p;
+  int _pos;			// next token
+  int _mismatch;
+};
+
+#endif /* __ACTSIM_CHANTOK_H__ */
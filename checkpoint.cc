@@ -0,0 +1,1183 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2026 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "checkpoint.h"
+#include "chpsim.h"
+#include "prssim.h"
+
+#define CKPT_MAGIC     "ACTSIMCK"
+#define CKPT_DMAGIC    "ACTSIMCD"
+#define CKPT_VERSION   1
+
+/* owners of pending events */
+#define CKPT_EV_CHP   0
+#define CKPT_EV_PRS   1
+#define CKPT_EV_MULTI 2
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Image I/O
+ *
+ *------------------------------------------------------------------------
+ */
+void ckpt_put (FILE *fp, unsigned long x)
+{
+  fwrite (&x, sizeof (unsigned long), 1, fp);
+}
+
+int ckpt_get (FILE *fp, unsigned long *x)
+{
+  return fread (x, sizeof (unsigned long), 1, fp) == 1 ? 1 : 0;
+}
+
+static void _put_bytes (FILE *fp, const void *buf, int len)
+{
+  unsigned long pad = 0;
+  ckpt_put (fp, len);
+  if (len > 0) {
+    fwrite (buf, 1, len, fp);
+  }
+  if (len % sizeof (unsigned long)) {
+    fwrite (&pad, 1, sizeof (unsigned long) - len % sizeof (unsigned long), fp);
+  }
+}
+
+/* result is allocated with MALLOC, and NUL-terminated */
+static int _get_bytes (FILE *fp, char **buf, int *len)
+{
+  unsigned long x;
+  int sz;
+  if (!ckpt_get (fp, &x) || x > (1UL << 30)) {
+    return 0;
+  }
+  *len = x;
+  sz = x + (x % sizeof (unsigned long) ?
+	    sizeof (unsigned long) - x % sizeof (unsigned long) : 0);
+  MALLOC (*buf, char, sz + 1);
+  if (sz > 0 && fread (*buf, 1, sz, fp) != (size_t)sz) {
+    FREE (*buf);
+    return 0;
+  }
+  (*buf)[x] = '\0';
+  return 1;
+}
+
+static void _put_int (FILE *fp, BigInt &v)
+{
+  ckpt_put (fp, v.getWidth());
+  ckpt_put (fp, v.getLen());
+  for (int j=0; j < v.getLen(); j++) {
+    ckpt_put (fp, v.getVal (j));
+  }
+}
+
+static int _get_int (FILE *fp, BigInt *v)
+{
+  unsigned long width, len, w;
+  if (!ckpt_get (fp, &width) || !ckpt_get (fp, &len) || len > 4096) {
+    return 0;
+  }
+  BigInt b (width, 0, 0);
+  for (int j=0; j < (int)len; j++) {
+    if (!ckpt_get (fp, &w)) {
+      return 0;
+    }
+    b.setVal (j, w);
+  }
+  *v = b;
+  return 1;
+}
+
+static void _put_multires (FILE *fp, expr_multires &v)
+{
+  ckpt_put (fp, v.nvals);
+  for (int i=0; i < v.nvals; i++) {
+    _put_int (fp, v.v[i]);
+  }
+}
+
+static int _get_multires (FILE *fp, expr_multires *v)
+{
+  unsigned long n;
+  if (!ckpt_get (fp, &n) || n > (1UL << 20)) {
+    return 0;
+  }
+  if ((int)n != v->nvals) {
+    v->setRaw (n);
+  }
+  for (int i=0; i < (int)n; i++) {
+    if (!_get_int (fp, &v->v[i])) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  External library hooks
+ *
+ *------------------------------------------------------------------------
+ */
+struct ckpt_ext {
+  char *name;
+  actsim_ckpt_save_t save;
+  actsim_ckpt_restore_t restore;
+  char *pend;			// restored state, until the library loads
+  int plen;
+};
+
+L_A_DECL (ckpt_ext, _ck_ext);
+
+static ckpt_ext *_ext_find (const char *name)
+{
+  for (int i=0; i < A_LEN (_ck_ext); i++) {
+    if (strcmp (_ck_ext[i].name, name) == 0) {
+      return &_ck_ext[i];
+    }
+  }
+  A_NEW (_ck_ext, ckpt_ext);
+  A_NEXT (_ck_ext).name = Strdup (name);
+  A_NEXT (_ck_ext).save = NULL;
+  A_NEXT (_ck_ext).restore = NULL;
+  A_NEXT (_ck_ext).pend = NULL;
+  A_NEXT (_ck_ext).plen = 0;
+  A_INC (_ck_ext);
+  return &_ck_ext[A_LEN (_ck_ext)-1];
+}
+
+static void _ext_apply (ckpt_ext *e)
+{
+  if (!e->pend || !e->restore) {
+    return;
+  }
+  if (!(*e->restore) (e->pend, e->plen)) {
+    warning ("checkpoint: could not restore the state of `%s'", e->name);
+  }
+  FREE (e->pend);
+  e->pend = NULL;
+}
+
+extern "C" void actsim_checkpoint_register (const char *name,
+					   actsim_ckpt_save_t save,
+					   actsim_ckpt_restore_t restore)
+{
+  ckpt_ext *e = _ext_find (name);
+  e->save = save;
+  e->restore = restore;
+  _ext_apply (e);
+}
+
+static void _ext_save (FILE *fp)
+{
+  ckpt_put (fp, A_LEN (_ck_ext));
+  for (int i=0; i < A_LEN (_ck_ext); i++) {
+    _put_bytes (fp, _ck_ext[i].name, strlen (_ck_ext[i].name));
+    if (_ck_ext[i].save) {
+      int len = 0;
+      void *buf = (*_ck_ext[i].save) (&len);
+      _put_bytes (fp, buf, buf ? len : 0);
+      if (buf) {
+	free (buf);
+      }
+    }
+    else {
+      /* not loaded since the last resume */
+      _put_bytes (fp, _ck_ext[i].pend, _ck_ext[i].plen);
+    }
+  }
+}
+
+static int _ext_restore (FILE *fp)
+{
+  unsigned long n;
+  if (!ckpt_get (fp, &n)) {
+    return 0;
+  }
+  for (int i=0; i < (int)n; i++) {
+    char *name, *buf;
+    int len;
+    if (!_get_bytes (fp, &name, &len)) {
+      return 0;
+    }
+    if (!_get_bytes (fp, &buf, &len)) {
+      FREE (name);
+      return 0;
+    }
+    ckpt_ext *e = _ext_find (name);
+    FREE (name);
+    if (e->pend) {
+      FREE (e->pend);
+    }
+    e->pend = buf;
+    e->plen = len;
+    _ext_apply (e);
+  }
+  return 1;
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Simulation objects and pending events
+ *
+ *------------------------------------------------------------------------
+ */
+struct ckpt_event {
+  SimDES *obj;
+  int type;
+  unsigned long tm;
+  int seq;
+};
+
+L_A_DECL (ActSimObj *, _ck_objs);	// instance table order
+static struct pHashtable *_ck_objH;	// object -> index
+
+L_A_DECL (ckpt_event, _ck_ev);
+static struct pHashtable *_ck_evH;	// object -> list of pending pcs
+
+static const char *_ck_bad;		// why the image was not written
+
+class CkptObject : public ActSimDES {
+public:
+  int Step (Event *ev);
+  void sPrintCause (char *buf, int sz) { snprintf (buf, sz, "-checkpoint-"); }
+};
+
+static CkptObject *_ck_obj = NULL;
+static Event *_ck_event = NULL;		// pending checkpoint event
+
+static void _obj_add (ActSimObj *o)
+{
+  if (phash_lookup (_ck_objH, o)) {
+    return;
+  }
+  phash_bucket_t *b = phash_add (_ck_objH, o);
+  b->i = A_LEN (_ck_objs);
+  A_NEW (_ck_objs, ActSimObj *);
+  A_NEXT (_ck_objs) = o;
+  A_INC (_ck_objs);
+}
+
+static void _obj_walk (ActInstTable *t)
+{
+  if (t->obj) {
+    _obj_add (t->obj);
+  }
+  if (t->H) {
+    hash_bucket_t *b;
+    hash_iter_t i;
+    hash_iter_init (t->H, &i);
+    while ((b = hash_iter_next (t->H, &i))) {
+      _obj_walk ((ActInstTable *) b->v);
+    }
+  }
+}
+
+static void _obj_free (void)
+{
+  A_FREE (_ck_objs);
+  if (_ck_objH) {
+    phash_free (_ck_objH);
+    _ck_objH = NULL;
+  }
+}
+
+static bool _ev_collect (Event *e, unsigned long tm)
+{
+  if (e == _ck_event) {
+    /* not part of the simulation */
+    return false;
+  }
+  A_NEW (_ck_ev, ckpt_event);
+  A_NEXT (_ck_ev).obj = e->getObj ();
+  A_NEXT (_ck_ev).type = e->getType ();
+  A_NEXT (_ck_ev).tm = tm;
+  A_NEXT (_ck_ev).seq = A_LEN (_ck_ev);
+  A_INC (_ck_ev);
+  return false;
+}
+
+static int _ev_cmp (const void *a, const void *b)
+{
+  const ckpt_event *x = (const ckpt_event *) a;
+  const ckpt_event *y = (const ckpt_event *) b;
+  if (x->tm != y->tm) {
+    return x->tm < y->tm ? -1 : 1;
+  }
+  return x->seq - y->seq;
+}
+
+static void _ev_free (void)
+{
+  A_FREE (_ck_ev);
+  if (_ck_evH) {
+    phash_bucket_t *b;
+    phash_iter_t it;
+    phash_iter_init (_ck_evH, &it);
+    while ((b = phash_iter_next (_ck_evH, &it))) {
+      list_free ((list_t *) b->v);
+    }
+    phash_free (_ck_evH);
+    _ck_evH = NULL;
+  }
+}
+
+int ckpt_has_event (SimDES *obj, int pc)
+{
+  phash_bucket_t *b;
+  if (!_ck_evH || !(b = phash_lookup (_ck_evH, obj))) {
+    return 0;
+  }
+  for (listitem_t *li = list_first ((list_t *) b->v); li; li = list_next (li)) {
+    if (list_ivalue (li) == pc) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* find the owner of each pending event; 0 if one cannot be saved */
+static int _ev_owners (ActSimCore *sc)
+{
+  _ck_evH = phash_new (8);
+  for (int i=0; i < A_LEN (_ck_ev); i++) {
+    SimDES *o = _ck_ev[i].obj;
+    if (dynamic_cast<ChpSim *> (o)) {
+      if (!phash_lookup (_ck_objH, o)) {
+	_ck_bad = "pending event of an unknown CHP process";
+	return 0;
+      }
+      phash_bucket_t *b = phash_lookup (_ck_evH, o);
+      if (!b) {
+	b = phash_add (_ck_evH, o);
+	b->v = list_new ();
+      }
+      list_iappend ((list_t *) b->v, SIM_EV_TYPE (_ck_ev[i].type));
+    }
+    else if (!dynamic_cast<OnePrsSim *> (o) &&
+	     !dynamic_cast<MultiPrsSim *> (o)) {
+      _ck_bad = "pending events from channel traces, replay, or the environment";
+      return 0;
+    }
+  }
+  return 1;
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  The image
+ *
+ *------------------------------------------------------------------------
+ */
+void ActSim::_ckpt_objects ()
+{
+  if (_ck_objH) {
+    return;
+  }
+  _ck_objH = phash_new (8);
+  _obj_walk (&I);
+  if (_init_simobjs) {
+    /* initialize blocks: alternate object and graph */
+    for (listitem_t *li = list_first (_init_simobjs); li;
+	 li = list_next (list_next (li))) {
+      _obj_add ((ActSimObj *) list_value (li));
+    }
+  }
+}
+
+int ActSim::saveSim (FILE *fp)
+{
+  ActSimState *st = getState ();
+  unsigned long w;
+  int ret = 0;
+
+  _ck_bad = NULL;
+  if (actsim_objcount.xyce > 0) {
+    _ck_bad = "analog blocks cannot be saved";
+    return 0;
+  }
+  for (int i=0; i < st->numChans(); i++) {
+    act_channel_state *c = st->getChan (i);
+    if (c->sfrag_st || c->rfrag_st || c->sufrag_st || c->rufrag_st) {
+      _ck_bad = "fragmented channel in the middle of a handshake";
+      return 0;
+    }
+  }
+
+  _ckpt_objects ();
+  SimDES::matchPendingEvent (_ev_collect);
+  if (A_LEN (_ck_ev) > 1) {
+    qsort (_ck_ev, A_LEN (_ck_ev), sizeof (ckpt_event), _ev_cmp);
+  }
+  if (!_ev_owners (this)) {
+    goto done;
+  }
+
+  fwrite (CKPT_MAGIC, 1, 8, fp);
+  ckpt_put (fp, CKPT_VERSION);
+  ckpt_put (fp, st->numBools());
+  ckpt_put (fp, st->numInts());
+  ckpt_put (fp, st->numChans());
+  ckpt_put (fp, A_LEN (_ck_objs));
+  ckpt_put (fp, SimDES::CurTimeLo ());
+  ckpt_put (fp, _seed);
+  ckpt_put (fp, isResetMode ());
+
+  /* Booleans: two bits each */
+  w = 0;
+  for (int i=0; i < st->numBools(); i++) {
+    w |= ((unsigned long) st->getBool (i)) << (2*(i % 32));
+    if ((i % 32) == 31) {
+      ckpt_put (fp, w);
+      w = 0;
+    }
+  }
+  if (st->numBools() % 32) {
+    ckpt_put (fp, w);
+  }
+
+  for (int i=0; i < st->numInts(); i++) {
+    _put_int (fp, *st->getInt (i));
+  }
+
+  for (int i=0; i < st->numChans(); i++) {
+    act_channel_state *c = st->getChan (i);
+    w = c->send_here | ((unsigned long)c->sender_probe << 16)
+      | ((unsigned long)c->recv_here << 17)
+      | ((unsigned long)c->receiver_probe << 33)
+      | ((unsigned long)c->frag_warn << 34)
+      | ((unsigned long)c->send_flavor << 35)
+      | ((unsigned long)c->recv_flavor << 36)
+      | ((unsigned long)c->skip_action << 37);
+    ckpt_put (fp, w);
+    ckpt_put (fp, c->count);
+    _put_multires (fp, c->data);
+    _put_multires (fp, c->data2);
+  }
+
+  for (int i=0; i < A_LEN (_ck_objs); i++) {
+    ChpSim *c = dynamic_cast<ChpSim *> (_ck_objs[i]);
+    if (c) {
+      ckpt_put (fp, 1);
+      c->ckptSave (fp);
+    }
+    else {
+      ckpt_put (fp, 0);
+    }
+  }
+
+  /* events, as delays from now */
+  ckpt_put (fp, A_LEN (_ck_ev));
+  for (int i=0; i < A_LEN (_ck_ev); i++) {
+    SimDES *o = _ck_ev[i].obj;
+    OnePrsSim *p;
+    MultiPrsSim *mp;
+    if ((p = dynamic_cast<OnePrsSim *> (o))) {
+      PrsSim *ps = p->getPrsSim ();
+      phash_bucket_t *b = phash_lookup (_ck_objH, ps);
+      Assert (b, "Production rule outside the instance table?");
+      ckpt_put (fp, CKPT_EV_PRS);
+      ckpt_put (fp, b->i);
+      ckpt_put (fp, p - ps->getRule (0));
+    }
+    else if ((mp = dynamic_cast<MultiPrsSim *> (o))) {
+      ckpt_put (fp, CKPT_EV_MULTI);
+      ckpt_put (fp, mp->causeGlobalIdx ());
+      ckpt_put (fp, 0);
+    }
+    else {
+      ckpt_put (fp, CKPT_EV_CHP);
+      ckpt_put (fp, phash_lookup (_ck_objH, o)->i);
+      ckpt_put (fp, 0);
+    }
+    ckpt_put (fp, _ck_ev[i].type);
+    ckpt_put (fp, _ck_ev[i].tm - SimDES::CurTimeLo ());
+  }
+
+  _ext_save (fp);
+  fwrite (CKPT_MAGIC, 1, 8, fp);
+  ret = ferror (fp) ? 0 : 1;
+
+done:
+  _ev_free ();
+  ChpSim::ckptDone ();
+  return ret;
+}
+
+
+class CkptTimer : public ActSimDES {
+public:
+  int Step (Event *ev) { actsim_pending.other--; return 0; }
+};
+
+static bool _ev_any (Event *e)
+{
+  return true;
+}
+
+int ActSim::restoreSim (FILE *fp)
+{
+  ActSimState *st = getState ();
+  unsigned long x, tm, seed, mode, nev;
+  char magic[8];
+  int ret = 0;
+
+  _ck_bad = "damaged checkpoint";
+  if (fread (magic, 1, 8, fp) != 8 || memcmp (magic, CKPT_MAGIC, 8) != 0 ||
+      !ckpt_get (fp, &x) || x != CKPT_VERSION) {
+    return 0;
+  }
+  _ckpt_objects ();
+  if (!ckpt_get (fp, &x) || (int)x != st->numBools() ||
+      !ckpt_get (fp, &x) || (int)x != st->numInts() ||
+      !ckpt_get (fp, &x) || (int)x != st->numChans() ||
+      !ckpt_get (fp, &x) || (int)x != A_LEN (_ck_objs)) {
+    _ck_bad = "checkpoint is for a different design";
+    return 0;
+  }
+  if (!ckpt_get (fp, &tm) || !ckpt_get (fp, &seed) || !ckpt_get (fp, &mode)) {
+    return 0;
+  }
+  if (tm < SimDES::CurTimeLo ()) {
+    _ck_bad = "simulation is already past the checkpoint";
+    return 0;
+  }
+
+  /*-- drop the current run: waits, then events --*/
+  for (int i=0; i < A_LEN (_ck_objs); i++) {
+    ChpSim *c = dynamic_cast<ChpSim *> (_ck_objs[i]);
+    PrsSim *p;
+    if (c) {
+      c->ckptClear ();
+    }
+    else if ((p = dynamic_cast<PrsSim *> (_ck_objs[i]))) {
+      for (int j=0; j < p->numRules(); j++) {
+	p->getRule (j)->flushPending ();
+      }
+    }
+  }
+  A_LEN (_ck_ev) = 0;
+  SimDES::matchPendingEvent (_ev_collect);
+  for (int i=0; i < A_LEN (_ck_ev); i++) {
+    Event *e = SimDES::matchPendingEvent (_ev_any);
+    if (e) {
+      e->Remove ();
+    }
+  }
+  _ev_free ();
+  actsim_pending.prs = 0;
+  actsim_pending.hse = 0;
+  actsim_pending.other = _ck_event ? 1 : 0;
+
+  /*-- move time forward --*/
+  {
+    CkptTimer t;
+    while (SimDES::CurTimeLo () < tm) {
+      unsigned long d = tm - SimDES::CurTimeLo ();
+      if (d > (1UL << 30)) {
+	d = (1UL << 30);
+      }
+      new Event (&t, SIM_EV_MKTYPE (0, 0), (int)d);
+      actsim_pending.other++;
+      SimDES::Run ();
+    }
+  }
+  _seed = seed;
+  setMode (mode);
+
+  /*-- state --*/
+  for (int i=0; i < st->numBools(); i += 32) {
+    if (!ckpt_get (fp, &x)) {
+      goto done;
+    }
+    for (int j=i; j < st->numBools() && j < i + 32; j++) {
+      st->rawSetBool (j, (x >> (2*(j-i))) & 3);
+    }
+  }
+  for (int i=0; i < st->numInts(); i++) {
+    if (!_get_int (fp, st->getInt (i))) {
+      goto done;
+    }
+  }
+  for (int i=0; i < st->numChans(); i++) {
+    act_channel_state *c = st->getChan (i);
+    if (!ckpt_get (fp, &x)) {
+      goto done;
+    }
+    c->send_here = x & 0xffff;
+    c->sender_probe = (x >> 16) & 1;
+    c->recv_here = (x >> 17) & 0xffff;
+    c->receiver_probe = (x >> 33) & 1;
+    c->frag_warn = (x >> 34) & 1;
+    c->send_flavor = (x >> 35) & 1;
+    c->recv_flavor = (x >> 36) & 1;
+    c->skip_action = (x >> 37) & 1;
+    if (!ckpt_get (fp, &x)) {
+      goto done;
+    }
+    c->count = x;
+    if (!_get_multires (fp, &c->data) || !_get_multires (fp, &c->data2)) {
+      goto done;
+    }
+  }
+
+  for (int i=0; i < A_LEN (_ck_objs); i++) {
+    ChpSim *c = dynamic_cast<ChpSim *> (_ck_objs[i]);
+    if (!ckpt_get (fp, &x) || (x ? 1 : 0) != (c ? 1 : 0)) {
+      goto done;
+    }
+    if (c && !c->ckptRestore (fp)) {
+      goto done;
+    }
+  }
+
+  /*-- events --*/
+  if (!ckpt_get (fp, &nev)) {
+    goto done;
+  }
+  for (unsigned long i=0; i < nev; i++) {
+    unsigned long kind, id, sub, type, dt;
+    if (!ckpt_get (fp, &kind) || !ckpt_get (fp, &id) || !ckpt_get (fp, &sub)
+	|| !ckpt_get (fp, &type) || !ckpt_get (fp, &dt)) {
+      goto done;
+    }
+    if (kind == CKPT_EV_CHP) {
+      ChpSim *c = id < (unsigned long)A_LEN (_ck_objs) ?
+	dynamic_cast<ChpSim *> (_ck_objs[id]) : NULL;
+      if (!c) {
+	goto done;
+      }
+      new Event (c, type, dt);
+      actsim_pending.other++;
+      if (c->isHseMode()) {
+	actsim_pending.hse++;
+      }
+    }
+    else if (kind == CKPT_EV_PRS) {
+      PrsSim *p = id < (unsigned long)A_LEN (_ck_objs) ?
+	dynamic_cast<PrsSim *> (_ck_objs[id]) : NULL;
+      if (!p || (int)sub >= p->numRules()) {
+	goto done;
+      }
+      OnePrsSim *r = p->getRule (sub);
+      r->setPending (new Event (r, type, dt), SIM_EV_TYPE (type));
+      actsim_pending.prs++;
+    }
+    else if (kind == CKPT_EV_MULTI) {
+      MultiPrsSim *mp = getMulti (id);
+      if (!mp) {
+	goto done;
+      }
+      mp->getOneDriver (0)->setPending (new Event (mp, type, dt),
+					SIM_EV_TYPE (type));
+      actsim_pending.prs++;
+    }
+    else {
+      goto done;
+    }
+  }
+
+  if (!_ext_restore (fp) || fread (magic, 1, 8, fp) != 8 ||
+      memcmp (magic, CKPT_MAGIC, 8) != 0) {
+    goto done;
+  }
+  _ck_bad = NULL;
+  ret = 1;
+
+done:
+  ChpSim::ckptDone ();
+  return ret;
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Checkpoint directories
+ *
+ *------------------------------------------------------------------------
+ */
+static ActSim *_ck_sim = NULL;
+static char *_ck_dir = NULL;
+static int _ck_kind;
+static double _ck_interval;
+static double _ck_next;			// wall time or simulation time
+static int _ck_seq, _ck_base;		// next checkpoint; start of chain
+static char *_ck_prev = NULL;		// last image written
+static size_t _ck_prevlen;
+static int _ck_failed = 0;
+static int _ck_slow = 0;
+static double _ck_tlast;
+
+static double _ck_now (void)
+{
+  if (_ck_kind == CKPT_WALLTIME) {
+    return actsim_wall_time ();
+  }
+  return SimDES::CurTimeLo ();
+}
+
+/* the next checkpoint: a multiple of the interval in simulation time */
+static double _ck_boundary (void)
+{
+  double now = _ck_now ();
+  if (_ck_kind == CKPT_WALLTIME) {
+    return now + _ck_interval;
+  }
+  return (floor (now/_ck_interval) + 1)*_ck_interval;
+}
+
+/* schedule the checkpoint event at _ck_next (simulation time only) */
+static void _ck_arm (void)
+{
+  unsigned long now, d;
+
+  if (!_ck_sim || _ck_kind != CKPT_SIMTIME || _ck_event) {
+    return;
+  }
+  now = SimDES::CurTimeLo ();
+  d = (_ck_next > now) ? (unsigned long) ceil (_ck_next - now) : 0;
+  if (d > (1UL << 30)) {
+    d = (1UL << 30);
+  }
+  if (!_ck_obj) {
+    _ck_obj = new CkptObject ();
+  }
+  _ck_event = new Event (_ck_obj, SIM_EV_MKTYPE (0, 0), (int)d);
+  actsim_pending.other++;
+}
+
+static void _ck_disarm (void)
+{
+  if (_ck_event) {
+    _ck_event->Remove ();
+    _ck_event = NULL;
+    actsim_pending.other--;
+  }
+}
+
+static char *_ck_path (const char *name, int n)
+{
+  char *buf;
+  MALLOC (buf, char, strlen (_ck_dir) + strlen (name) + 32);
+  if (n >= 0) {
+    sprintf (buf, "%s/%s.%d", _ck_dir, name, n);
+  }
+  else {
+    sprintf (buf, "%s/%s", _ck_dir, name);
+  }
+  return buf;
+}
+
+/* read <dir>/latest; returns 0 if there is none */
+static int _ck_latest (const char *dir, int *base, int *seq, int *kind,
+		       double *interval)
+{
+  char *buf;
+  FILE *fp;
+  int ret = 0;
+
+  MALLOC (buf, char, strlen (dir) + 10);
+  sprintf (buf, "%s/latest", dir);
+  fp = fopen (buf, "r");
+  FREE (buf);
+  if (!fp) {
+    return 0;
+  }
+  if (fscanf (fp, "ACTSIMCK %d %d %d %lg", base, seq, kind, interval) == 4
+      && *base <= *seq) {
+    ret = 1;
+  }
+  fclose (fp);
+  return ret;
+}
+
+static int _ck_rename (const char *tmp, const char *file)
+{
+  if (rename (tmp, file) != 0) {
+    unlink (tmp);
+    return 0;
+  }
+  return 1;
+}
+
+/* write checkpoint _ck_seq; returns 0 on failure */
+static int _ck_write (void)
+{
+  char *img = NULL;
+  size_t len = 0;
+  FILE *fp;
+  int full, npages, ret = 0;
+  unsigned char *pay, *cbuf = NULL;
+  unsigned long plen, clen;
+  char *file, *tmp;
+
+  fp = open_memstream (&img, &len);
+  if (!fp) {
+    _ck_bad = "out of memory";
+    return 0;
+  }
+  if (!_ck_sim->saveSim (fp)) {
+    fclose (fp);
+    free (img);
+    return 0;
+  }
+  fclose (fp);
+
+  full = (!_ck_prev || _ck_seq - _ck_base >= CKPT_FULL);
+
+  /* the changed pages */
+  npages = (len + CKPT_PAGE - 1)/CKPT_PAGE;
+  MALLOC (pay, unsigned char, len + npages*sizeof (unsigned long) + 1);
+  plen = 0;
+  for (int i=0; i < npages; i++) {
+    size_t off = (size_t)i*CKPT_PAGE;
+    size_t sz = (len - off < CKPT_PAGE ? len - off : CKPT_PAGE);
+    if (!full && off + sz <= _ck_prevlen &&
+	memcmp (img + off, _ck_prev + off, sz) == 0) {
+      continue;
+    }
+    unsigned long idx = i;
+    memcpy (pay + plen, &idx, sizeof (unsigned long));
+    plen += sizeof (unsigned long);
+    memcpy (pay + plen, img + off, sz);
+    plen += sz;
+  }
+  clen = compressBound (plen);
+  MALLOC (cbuf, unsigned char, clen);
+  if (compress2 (cbuf, &clen, pay, plen, Z_BEST_SPEED) != Z_OK) {
+    _ck_bad = "compression failed";
+    goto done;
+  }
+
+  file = _ck_path ("ckpt", _ck_seq);
+  MALLOC (tmp, char, strlen (file) + 5);
+  sprintf (tmp, "%s.tmp", file);
+  fp = fopen (tmp, "wb");
+  if (fp) {
+    fwrite (CKPT_DMAGIC, 1, 8, fp);
+    ckpt_put (fp, CKPT_VERSION);
+    ckpt_put (fp, _ck_seq);
+    ckpt_put (fp, full);
+    ckpt_put (fp, len);
+    ckpt_put (fp, plen);
+    ckpt_put (fp, clen);
+    fwrite (cbuf, 1, clen, fp);
+    fflush (fp);
+    if (ferror (fp) || fsync (fileno (fp)) != 0) {
+      fclose (fp);
+      unlink (tmp);
+      fp = NULL;
+    }
+    else {
+      fclose (fp);
+    }
+  }
+  if (fp && _ck_rename (tmp, file)) {
+    int ob = _ck_base;
+    FREE (tmp);
+    tmp = _ck_path ("latest.tmp", -1);
+    FREE (file);
+    file = _ck_path ("latest", -1);
+    if (full) {
+      _ck_base = _ck_seq;
+    }
+    fp = fopen (tmp, "w");
+    if (fp) {
+      fprintf (fp, "ACTSIMCK %d %d %d %.17g\n", _ck_base, _ck_seq, _ck_kind,
+	       _ck_interval);
+      fflush (fp);
+      fsync (fileno (fp));
+      fclose (fp);
+      ret = _ck_rename (tmp, file);
+    }
+    if (ret) {
+      /* the old chain is no longer needed */
+      if (full) {
+	for (int i=ob; i < _ck_seq; i++) {
+	  char *old = _ck_path ("ckpt", i);
+	  unlink (old);
+	  FREE (old);
+	}
+      }
+      _ck_seq++;
+      if (_ck_prev) {
+	free (_ck_prev);
+      }
+      _ck_prev = img;
+      _ck_prevlen = len;
+      img = NULL;
+    }
+    else {
+      _ck_base = ob;
+    }
+  }
+  if (!ret) {
+    _ck_bad = "could not write to the checkpoint directory";
+  }
+  FREE (file);
+  FREE (tmp);
+
+done:
+  FREE (pay);
+  FREE (cbuf);
+  if (img) {
+    free (img);
+  }
+  return ret;
+}
+
+static void _ck_take (void)
+{
+  double t0 = actsim_wall_time ();
+
+  if (_ck_write ()) {
+    double t1 = actsim_wall_time ();
+    if (_ck_tlast > 0 && !_ck_slow && (t1 - t0) > 0.1*(t0 - _ck_tlast)) {
+      warning ("checkpoint: writing took %.2fs, over 10%% of the interval",
+	       t1 - t0);
+      _ck_slow = 1;
+    }
+    _ck_tlast = t1;
+    _ck_failed = 0;
+    _ck_next = _ck_boundary ();
+  }
+  else {
+    if (!_ck_failed) {
+      warning ("checkpoint skipped: %s; will retry", _ck_bad);
+    }
+    _ck_failed = 1;
+    _ck_next = _ck_now () + _ck_interval/10;
+  }
+}
+
+int CkptObject::Step (Event *ev)
+{
+  _ck_event = NULL;
+  actsim_pending.other--;
+  if (!_ck_sim) {
+    return 1;
+  }
+  if (_ck_kind == CKPT_SIMTIME) {
+    /* an idle simulation is not kept running by checkpoints; the
+       next run re-arms the event */
+    if (SimDES::CurTimeLo () >= _ck_next) {
+      _ck_take ();
+    }
+    if (!SimDES::isEmpty ()) {
+      _ck_arm ();
+    }
+  }
+  else {
+    _ck_take ();
+  }
+  return 1;
+}
+
+int actsim_ckpt_on (void)
+{
+  return (_ck_sim && _ck_kind == CKPT_WALLTIME) ? 1 : 0;
+}
+
+void actsim_ckpt_arm (void)
+{
+  _ck_arm ();
+}
+
+void actsim_ckpt_tick (double now)
+{
+  if (!_ck_sim || _ck_kind != CKPT_WALLTIME || _ck_event) {
+    return;
+  }
+  if (now < _ck_next) {
+    return;
+  }
+  if (!_ck_obj) {
+    _ck_obj = new CkptObject ();
+  }
+  _ck_event = new Event (_ck_obj, SIM_EV_MKTYPE (0, 0), 0);
+  actsim_pending.other++;
+}
+
+int actsim_ckpt_every (ActSim *sim, int kind, double interval,
+		       const char *dir)
+{
+  int base, seq, k;
+  double iv;
+
+  _ck_disarm ();
+  if (!sim || interval <= 0) {
+    _ck_sim = NULL;
+    _obj_free ();
+    return 1;
+  }
+  if (actsim_objcount.xyce > 0) {
+    warning ("checkpoint: analog blocks cannot be saved");
+    return 0;
+  }
+  if (mkdir (dir, 0777) != 0 && errno != EEXIST) {
+    return 0;
+  }
+  if (!_ck_dir || strcmp (_ck_dir, dir) != 0) {
+    /* new directory: the first checkpoint is a full one */
+    if (_ck_dir) {
+      FREE (_ck_dir);
+    }
+    _ck_dir = Strdup (dir);
+    if (_ck_prev) {
+      free (_ck_prev);
+      _ck_prev = NULL;
+    }
+    if (_ck_latest (dir, &base, &seq, &k, &iv)) {
+      _ck_base = base;
+      _ck_seq = seq + 1;
+    }
+    else {
+      _ck_base = 0;
+      _ck_seq = 0;
+    }
+  }
+  _ck_sim = sim;
+  _ck_kind = kind;
+  _ck_interval = interval;
+  _ck_next = _ck_boundary ();
+  _ck_failed = 0;
+  _ck_slow = 0;
+  _ck_tlast = actsim_wall_time ();
+  _ck_arm ();
+  return 1;
+}
+
+/* apply ckpt.<n> to the image */
+static int _ck_apply (int n, char **img, size_t *len)
+{
+  char *file = _ck_path ("ckpt", n);
+  FILE *fp = fopen (file, "rb");
+  char magic[8];
+  unsigned long v, seq, full, ilen, plen, clen;
+  unsigned char *pay = NULL, *cbuf = NULL;
+  int ret = 0;
+
+  FREE (file);
+  if (!fp) {
+    return 0;
+  }
+  if (fread (magic, 1, 8, fp) != 8 || memcmp (magic, CKPT_DMAGIC, 8) != 0 ||
+      !ckpt_get (fp, &v) || v != CKPT_VERSION ||
+      !ckpt_get (fp, &seq) || seq != (unsigned long)n ||
+      !ckpt_get (fp, &full) || !ckpt_get (fp, &ilen) ||
+      !ckpt_get (fp, &plen) || !ckpt_get (fp, &clen)) {
+    fclose (fp);
+    return 0;
+  }
+  MALLOC (cbuf, unsigned char, clen + 1);
+  MALLOC (pay, unsigned char, plen + 1);
+  if (fread (cbuf, 1, clen, fp) == clen) {
+    uLongf dlen = plen;
+    if (uncompress (pay, &dlen, cbuf, clen) == Z_OK && dlen == plen) {
+      *img = (char *) realloc (*img, ilen + 1);
+      *len = ilen;
+      ret = 1;
+      for (unsigned long off = 0; off < plen; ) {
+	unsigned long idx, sz;
+	memcpy (&idx, pay + off, sizeof (unsigned long));
+	off += sizeof (unsigned long);
+	if (idx*CKPT_PAGE >= ilen) {
+	  ret = 0;
+	  break;
+	}
+	sz = ilen - idx*CKPT_PAGE;
+	if (sz > CKPT_PAGE) {
+	  sz = CKPT_PAGE;
+	}
+	if (off + sz > plen) {
+	  ret = 0;
+	  break;
+	}
+	memcpy (*img + idx*CKPT_PAGE, pay + off, sz);
+	off += sz;
+      }
+    }
+  }
+  fclose (fp);
+  FREE (cbuf);
+  FREE (pay);
+  return ret;
+}
+
+int actsim_ckpt_resume (ActSim *sim, const char *dir)
+{
+  int base, seq, kind;
+  double interval;
+  char *img = NULL;
+  size_t len = 0;
+  FILE *fp;
+
+  if (!_ck_latest (dir, &base, &seq, &kind, &interval)) {
+    warning ("checkpoint: no checkpoint in `%s'", dir);
+    return 0;
+  }
+  _ck_disarm ();
+  if (_ck_dir) {
+    FREE (_ck_dir);
+  }
+  _ck_dir = Strdup (dir);
+  for (int i=base; i <= seq; i++) {
+    if (!_ck_apply (i, &img, &len)) {
+      warning ("checkpoint: `%s/ckpt.%d' is damaged", dir, i);
+      if (img) {
+	free (img);
+      }
+      return 0;
+    }
+  }
+  fp = fmemopen (img, len, "rb");
+  if (!fp || !sim->restoreSim (fp)) {
+    warning ("checkpoint: could not restore `%s': %s", dir,
+	     _ck_bad ? _ck_bad : "out of memory");
+    if (fp) {
+      fclose (fp);
+    }
+    free (img);
+    return 0;
+  }
+  fclose (fp);
+
+  /* keep checkpointing to the same chain */
+  if (_ck_prev) {
+    free (_ck_prev);
+  }
+  _ck_prev = img;
+  _ck_prevlen = len;
+  _ck_base = base;
+  _ck_seq = seq + 1;
+  return actsim_ckpt_every (sim, kind, interval, dir);
+}
@@ -0,0 +1,78 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2026 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#ifndef __ACTSIM_CHECKPOINT_H__
+#define __ACTSIM_CHECKPOINT_H__
+
+#include "actsim.h"
+
+/*
+ * Periodic checkpoints.
+ *
+ * ActSim::saveSim() writes an image of the simulation: state, the
+ * event queue, CHP program counters, and the state of external
+ * libraries that registered checkpoint hooks (see actsim_ext.h). The
+ * image is made of fixed-width words, so that state that did not
+ * change stays on the same page.
+ *
+ * A checkpoint directory holds
+ *
+ *   ckpt.<n> : the pages of image n that differ from image n-1, zlib
+ *              compressed; every CKPT_FULL checkpoints, all of them
+ *   latest   : the last complete checkpoint, and the full image the
+ *              chain starts from
+ *
+ * Checkpoints are taken between events. In simulation time, a
+ * checkpoint event is scheduled at each multiple of the interval. A
+ * run whose other events are exhausted ends at the next multiple,
+ * and no further checkpoint is scheduled until the next run.
+ * In wall time, the run monitor checks the interval every few
+ * thousand events and schedules a zero-delay checkpoint event once it
+ * has elapsed.
+ */
+
+#define CKPT_SIMTIME  0		// interval in simulation time units
+#define CKPT_WALLTIME 1		// interval in seconds
+
+#define CKPT_PAGE 4096
+#define CKPT_FULL 64
+
+/* returns 0 if checkpoints cannot be written to dir; interval 0 is off */
+int actsim_ckpt_every (ActSim *sim, int kind, double interval,
+		       const char *dir);
+/* 1 if the run monitor has to check the wall-time interval */
+int actsim_ckpt_on (void);
+void actsim_ckpt_tick (double now);
+/* start of a run: schedule the next simulation time checkpoint */
+void actsim_ckpt_arm (void);
+
+/* restore the latest checkpoint in dir, and continue checkpointing
+   there; returns 0 on failure */
+int actsim_ckpt_resume (ActSim *sim, const char *dir);
+
+/* image I/O, in words */
+void ckpt_put (FILE *fp, unsigned long x);
+int ckpt_get (FILE *fp, unsigned long *x);
+
+/* while an image is written: is there a pending event for (obj, pc)? */
+int ckpt_has_event (SimDES *obj, int pc);
+
+#endif /* __ACTSIM_CHECKPOINT_H__ */
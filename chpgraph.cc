@@ -1224,7 +1224,7 @@ static chpsimstmt *gc_to_chpsim (act_chp_gc_t *gc, ActSimCore *s, const int anno
   ret = NULL;
   if (!gc) return ret;
 
-  NEW (ret, chpsimstmt);
+  ARENA_NEW (s->getArena(), ret, chpsimstmt);
   ret->type = CHPSIM_COND;
   ret->delay_cost = (annotate_mode) ? _get_detailed_costs(dda_pos, 0, s->cursi()) : config_get_int ("sim.chp.default_delay");
   ret->energy_cost = (annotate_mode) ? _get_detailed_costs(dea_pos, 1, s->cursi()) : config_get_int ("sim.chp.default_energy");
@@ -1243,7 +1243,7 @@ static chpsimstmt *gc_to_chpsim (act_chp_gc_t *gc, ActSimCore *s, const int anno
       tmp = &ret->u.cond.c;
     }
     else {
-      NEW (tmp->next, chpsimcond);
+      ARENA_NEW (s->getArena(), tmp->next, chpsimcond);
       tmp = tmp->next;
     }
     tmp->next = NULL;
@@ -1325,7 +1325,7 @@ chpsimgraph_info *ChpSimGraph::buildChpSimGraph (ActSimCore *sc,
 
 	// build chpsimstmt
 	
-	NEW (branch, chpsimstmt);
+	ARENA_NEW (sc->getArena(), branch, chpsimstmt);
 	branch->type = CHPSIM_COND;
 	branch->delay_cost = 0;
 	branch->energy_cost = 0;
@@ -1334,12 +1334,12 @@ chpsimgraph_info *ChpSimGraph::buildChpSimGraph (ActSimCore *sc,
 	branch->u.cond.is_shared = 0;
 	branch->u.cond.is_probe = 0;
 
-	bstmt = new ChpSimGraph (sc);
+	bstmt = new (sc) ChpSimGraph (sc);
 	MALLOC (bstmt->all, ChpSimGraph *, len);
 	bstmt->stmt = branch;
 
 	// dummy next: empty statement!
-	bstmt->next = new ChpSimGraph (sc);
+	bstmt->next = new (sc) ChpSimGraph (sc);
 	
 	// we need a guarded command now!
 	tmp = NULL;
@@ -1353,7 +1353,7 @@ chpsimgraph_info *ChpSimGraph::buildChpSimGraph (ActSimCore *sc,
 	    tmp = &branch->u.cond.c;
 	  }
 	  else {
-	    NEW (tmp->next, chpsimcond);
+	    ARENA_NEW (sc->getArena(), tmp->next, chpsimcond);
 	    tmp = tmp->next;
 	  }
 	  tmp->next = NULL;
@@ -1393,7 +1393,7 @@ chpsimgraph_info *ChpSimGraph::buildChpSimGraph (ActSimCore *sc,
     gi->e = NULL;
     return gi;
   }
-  stop = new ChpSimGraph (sc);
+  stop = new (sc) ChpSimGraph (sc);
   int dda_pos = 0;
   int dea_pos = 0;
   gi->g = _buildChpSimGraph (sc, c, &stop, annotate_mode, dda_pos, dea_pos);
@@ -1407,8 +1407,8 @@ chpsimgraph_info *ChpSimGraph::buildChpSimGraph (ActSimCore *sc,
 
 static ChpSimGraph *_gen_nop (ActSimCore *sc)
 {
-  ChpSimGraph *ret = new ChpSimGraph (sc);
-  NEW (ret->stmt, chpsimstmt);
+  ChpSimGraph *ret = new (sc) ChpSimGraph (sc);
+  ARENA_NEW (sc->getArena(), ret->stmt, chpsimstmt);
   ret->stmt->type = CHPSIM_NOP;
   ret->stmt->delay_cost = 1;
   ret->stmt->energy_cost = 0;
@@ -1553,9 +1553,9 @@ ChpSimGraph *ChpSimGraph::_buildChpSimGraph (ActSimCore *sc,
       _update_label (&labels, c->label, ret);
       return ret;
     }
-    ret = new ChpSimGraph (sc);
+    ret = new (sc) ChpSimGraph (sc);
     ostop = *stop;
-    *stop = new ChpSimGraph (sc);
+    *stop = new (sc) ChpSimGraph (sc);
     tmp = cur_pending_count++;
     if (cur_pending_count > max_pending_count) {
       max_pending_count = cur_pending_count;
@@ -1579,7 +1579,7 @@ ChpSimGraph *ChpSimGraph::_buildChpSimGraph (ActSimCore *sc,
     }
     if (count > 0) {
       _dump_debug (c);
-      NEW (ret->stmt, chpsimstmt);
+      ARENA_NEW (sc->getArena(), ret->stmt, chpsimstmt);
       ret->stmt->delay_cost = (annotate_mode) ? _get_detailed_costs(dda_pos, 0, sc->cursi()) : 0;
       ret->stmt->energy_cost = (annotate_mode) ? _get_detailed_costs(dea_pos, 1, sc->cursi()) : 0;
       ret->stmt->bw_cost = 0;
@@ -1590,8 +1590,7 @@ ChpSimGraph *ChpSimGraph::_buildChpSimGraph (ActSimCore *sc,
     }
     else {
       FREE (ret->all);
-      FREE (ret);
-      FREE (*stop);
+      /* ret and *stop are arena-allocated */
       *stop = ostop;
       ret = NULL;
     }
@@ -1600,7 +1599,7 @@ ChpSimGraph *ChpSimGraph::_buildChpSimGraph (ActSimCore *sc,
   case ACT_CHP_SELECT:
   case ACT_CHP_SELECT_NONDET:
   case ACT_CHP_LOOP:
-    ret = new ChpSimGraph (sc);
+    ret = new (sc) ChpSimGraph (sc);
     _dump_debug (c);
     ret->stmt = gc_to_chpsim (c->u.gc, sc, annotate_mode, dda_pos, dea_pos);
     if (c->type == ACT_CHP_LOOP) {
@@ -1616,7 +1615,7 @@ ChpSimGraph *ChpSimGraph::_buildChpSimGraph (ActSimCore *sc,
     Assert (i >= 1, "What?");
     MALLOC (ret->all, ChpSimGraph *, i);
       
-    (*stop) = new ChpSimGraph (sc);
+    (*stop) = new (sc) ChpSimGraph (sc);
 
     //if (c->type == ACT_CHP_LOOP) {
     ret->next = (*stop);
@@ -1655,7 +1654,7 @@ ChpSimGraph *ChpSimGraph::_buildChpSimGraph (ActSimCore *sc,
       ChpSimGraph *ntmp;
       ChpSimGraph *nret = _buildChpSimGraph (sc, c->u.gc->s, &ntmp, annotate_mode, dda_pos, dea_pos);
 
-      ret = new ChpSimGraph (sc);
+      ret = new (sc) ChpSimGraph (sc);
 
       if (!nret) {
 	nret = _gen_nop (sc);
@@ -1665,7 +1664,7 @@ ChpSimGraph *ChpSimGraph::_buildChpSimGraph (ActSimCore *sc,
       _dump_debug (c);
       ret->stmt = gc_to_chpsim (c->u.gc, sc, annotate_mode, dda_pos, dea_pos);
       ret->stmt->type = CHPSIM_LOOP;
-      (*stop) = new ChpSimGraph (sc);
+      (*stop) = new (sc) ChpSimGraph (sc);
       ret->next = (*stop);
       MALLOC (ret->all, ChpSimGraph *, 1);
       ret->all[0] = _buildChpSimGraph (sc, c->u.gc->s, &tmp2, annotate_mode, dda_pos, dea_pos);
@@ -1699,8 +1698,8 @@ ChpSimGraph *ChpSimGraph::_buildChpSimGraph (ActSimCore *sc,
 	ch_struct = 1;
       }
 
-      ret = new ChpSimGraph (sc);
-      NEW (ret->stmt, chpsimstmt);
+      ret = new (sc) ChpSimGraph (sc);
+      ARENA_NEW (sc->getArena(), ret->stmt, chpsimstmt);
       if (annotate_mode) {
         _dump_debug (c);
         _get_detailed_costs (dda_pos, dea_pos, sc->cursi(), ret->stmt);
@@ -1800,8 +1799,8 @@ ChpSimGraph *ChpSimGraph::_buildChpSimGraph (ActSimCore *sc,
       if (TypeFactory::isStructure (ch->datatype())) {
 	ch_struct = 1;
       }
-      ret = new ChpSimGraph (sc);
-      NEW (ret->stmt, chpsimstmt);
+      ret = new (sc) ChpSimGraph (sc);
+      ARENA_NEW (sc->getArena(), ret->stmt, chpsimstmt);
       if (annotate_mode) {
         _dump_debug (c);
         _get_detailed_costs (dda_pos, dea_pos, sc->cursi(), ret->stmt);
@@ -1897,8 +1896,8 @@ ChpSimGraph *ChpSimGraph::_buildChpSimGraph (ActSimCore *sc,
         || strcmp (string_char (c->u.func.name), "warn") == 0
       ) {
       listitem_t *li;
-      ret = new ChpSimGraph (sc);
-      NEW (ret->stmt, chpsimstmt);
+      ret = new (sc) ChpSimGraph (sc);
+      ARENA_NEW (sc->getArena(), ret->stmt, chpsimstmt);
       ret->stmt->delay_cost = 0;
       ret->stmt->energy_cost = 0;
       ret->stmt->bw_cost = 0;
@@ -1924,8 +1923,8 @@ ChpSimGraph *ChpSimGraph::_buildChpSimGraph (ActSimCore *sc,
     else if (strcmp (string_char (c->u.func.name), "assert") == 0) {
       listitem_t *li;
       bool condition = true;
-      ret = new ChpSimGraph (sc);
-      NEW (ret->stmt, chpsimstmt);
+      ret = new (sc) ChpSimGraph (sc);
+      ARENA_NEW (sc->getArena(), ret->stmt, chpsimstmt);
       ret->stmt->delay_cost = 0;
       ret->stmt->energy_cost = 0;
       ret->stmt->bw_cost = 0;
@@ -1958,8 +1957,8 @@ ChpSimGraph *ChpSimGraph::_buildChpSimGraph (ActSimCore *sc,
     else if (strcmp (string_char (c->u.func.name), "log_nl") == 0 || strcmp (string_char (c->u.func.name), "log_st") == 0) {
       listitem_t *li;
       bool condition = true;
-      ret = new ChpSimGraph (sc);
-      NEW (ret->stmt, chpsimstmt);
+      ret = new (sc) ChpSimGraph (sc);
+      ARENA_NEW (sc->getArena(), ret->stmt, chpsimstmt);
       ret->stmt->delay_cost = 0;
       ret->stmt->energy_cost = 0;
       ret->stmt->bw_cost = 0;
@@ -1980,8 +1979,8 @@ ChpSimGraph *ChpSimGraph::_buildChpSimGraph (ActSimCore *sc,
       int type, width;
       int flags = 0;
 
-      ret = new ChpSimGraph (sc);
-      NEW (ret->stmt, chpsimstmt);
+      ret = new (sc) ChpSimGraph (sc);
+      ARENA_NEW (sc->getArena(), ret->stmt, chpsimstmt);
 
       if (annotate_mode) {
         _dump_debug (c);
@@ -2295,11 +2294,8 @@ ChpSimGraph::~ChpSimGraph ()
 	_free_chp_expr (stmt->u.cond.c.g);
 	x = stmt->u.cond.c.next;
 	while (x) {
-	  struct chpsimcond *t;
 	  _free_chp_expr (x->g);
-	  t = x->next;
-	  FREE (x);
-	  x = t;
+	  x = x->next;
 	  nguards++;
 	}
 	Assert (next, "What?");
@@ -2363,7 +2359,7 @@ ChpSimGraph::~ChpSimGraph ()
       fatal_error ("What type is this (%d) in ~ChpSimGraph()?", stmt->type);
       break;
     }
-    FREE (stmt);
+    /* stmt is allocated from the simulation arena */
   }
   if (next) {
     if (next->wait > 1) {
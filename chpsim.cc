@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <common/config.h>
 #include "chpsim.h"
+#include "checkpoint.h"
 #include <common/simdes.h>
 #include <dlfcn.h>
 #include <common/pp.h>
@@ -47,77 +48,14 @@ class ChanTraceDelayed : public SimDES {
   ~ChanTraceDelayed () { _n = NULL; }
 
   int Step (Event *ev) {
-    BigInt xtm = SimDES::CurTime();
-    float tm = glob_sim->curTimeMetricUnits ();
-    int len = xtm.getLen();
-    unsigned long tval;
-    unsigned long *ptm;
-    if (len == 1) {
-      tval = xtm.getVal (0);
-      ptm = &tval;
-    }
-    else {
-      MALLOC (ptm, unsigned long, len);
-      for (int i=0; i < len; i++) {
-	ptm[i] = xtm.getVal (i);
-      }
-    }
-    unsigned long *value;
-    value = NULL;
+    actsim_pending.other--;
     if (_has_val) {
-      if (_v.getLen() > 1) {
-	MALLOC (value, unsigned long, _v.getLen());
-	for (int i=0; i < _v.getLen(); i++) {
-	  value[i] = _v.getVal (i);
-	}
-      }
+      glob_sim->recordTrace (_n, 2, ACT_CHAN_VALUE, _v);
     }
-    
-    for (int fmt=0; fmt < TRACE_NUM_FORMATS; fmt++) {
-      act_trace_t *tr = glob_sim->getTrace (fmt);
-      if (tr && !((_n->ignore_fmt >> fmt) & 1)) {
-	if (act_trace_has_alt (tr->t)) {
-	  if (_has_val) {
-	    if (_v.getLen() == 1) {
-	      act_trace_chan_change_alt (tr, _n->node[fmt], len, ptm,
-					 ACT_CHAN_VALUE, _v.getVal (0));
-	    }
-	    else {
-	      act_trace_wide_chan_change_alt (tr, _n->node[fmt], len, ptm,
-					      ACT_CHAN_VALUE,
-					      _v.getLen(), value);
-	    }
-	  }
-	  else {
-	    act_trace_chan_change_alt (tr, _n->node[fmt], len, ptm,
-				       ACT_CHAN_IDLE, 0);
-	  }
-	}
-	else {
-	  if (_has_val) {
-	    if (_v.getLen() == 1) {
-	      act_trace_chan_change (tr, _n->node[fmt], tm,
-				     ACT_CHAN_VALUE, _v.getVal (0));
-	    }
-	    else {
-	      act_trace_wide_chan_change (tr, _n->node[fmt], tm,
-					  ACT_CHAN_VALUE, _v.getLen(), value);
-	    }
-	  }
-	  else {
-	    act_trace_chan_change (tr, _n->node[fmt], tm, ACT_CHAN_IDLE, 0);
-	  }
-	}
-      }
-    }
-    if (len > 1) {
-      FREE (ptm);
-    }
-
-    if (_has_val && _v.getLen() > 1) {
-      FREE (value);
+    else {
+      BigInt zero;
+      glob_sim->recordTrace (_n, 2, ACT_CHAN_IDLE, zero);
     }
-    
     delete this;
     return 1;
   }
@@ -313,6 +251,8 @@ ChpSim::ChpSim (chpsimgraph_info *cgi,
   _stalled_pc = list_new ();
   _probe = NULL;
   _savedc = c;
+  _root = g;
+  _maxcnt = max_cnt;
   _energy_cost = 0;
   _leakage_cost = 0.0;
   _area_cost = 0;
@@ -456,6 +396,11 @@ int ChpSim::_nextEvent (int pc, int bw_cost)
   if (_pc[pc]) {
     new Event (this, SIM_EV_MKTYPE (pc,0) /* pc */,
 	       _sc->getDelay (_pc[pc]->stmt->delay_cost + bw_cost));
+    ACTSIM_PERF (PERF_EV_NEW);
+    actsim_pending.other++;
+    if (_hse_mode) {
+      actsim_pending.hse++;
+    }
     return 1;
   }
   return 0;
@@ -947,6 +892,14 @@ int ChpSim::Step (Event *ev)
   int _breakpt = 0;
   int sh_wakeup = 0;
 
+  actsim_pending.other--;
+  ACTSIM_PERF_EVENT (PERF_EV_CHP);
+  ACTSIM_PROF (this);
+
+  if (_hse_mode) {
+    actsim_pending.hse--;
+  }
+
   if (pc == MAX_LOCAL_PCS) {
     // wake-up from a shared variable block.
     
@@ -977,6 +930,8 @@ int ChpSim::Step (Event *ev)
   if (!_hse_mode && _sc->isResetMode() && _proc != NULL) {
     /*-- this is a real process: wait for run mode --*/
     new Event (this, SIM_EV_MKTYPE (pc, 0), 10);
+    ACTSIM_PERF (PERF_EV_NEW);
+    actsim_pending.other++;
     return 1;
   }
 
@@ -1177,6 +1132,16 @@ int ChpSim::Step (Event *ev)
 #ifdef DUMP_ALL
 	printf ("send done");
 #endif
+	if (_sc->tokenRecording ()) {
+	  if (!flag) {
+	    _sc->recordToken (goff, vs);
+	  }
+	  else {
+	    /* woken up: the value was left in the channel */
+	    act_channel_state *ch = _sc->getChan (goff);
+	    _sc->recordToken (goff, frag ? ch->data : ch->data2);
+	  }
+	}
 	_energy_cost += stmt->energy_cost;
 	if (stmt->u.sendrecv.is_structx) {
 	  if (type != -1 && skipwrite == 0) {
@@ -1292,6 +1257,10 @@ int ChpSim::Step (Event *ev)
 #ifdef DUMP_ALL	
 	printf ("recv got %lu!", v.getVal (0));
 #endif	
+	if (frag) {
+	  /* the sender is not CHP, so log the token here */
+	  _sc->recordToken (goff, vs);
+	}
 	if (type != -1 && skipwrite == 0) {
 	  if (stmt->u.sendrecv.is_struct == 0) {
 	    if (type == 0) {
@@ -1491,6 +1460,8 @@ int ChpSim::Step (Event *ev)
 	  Event *ev = SimDES::matchPendingEvent (_matchme);
 	  if (ev) {
 	    ev->Remove();
+	    ACTSIM_PERF (PERF_EV_CANCEL);
+	    actsim_pending.other--;
 #ifdef DUMP_ALL
 	    printf (" [pruned ev]");
 #endif
@@ -1778,6 +1749,7 @@ int ChpSim::varSend (int pc, int wakeup, int id, int off, int flavor,
       c->skip_action = 0;
     }
     c->w->Notify (c->recv_here-1, this);
+    actsim_pending.other++;
     c->recv_here = 0;
     if (c->send_here != 0) {
       act_connection *x;
@@ -1810,6 +1782,7 @@ int ChpSim::varSend (int pc, int wakeup, int id, int off, int flavor,
       printf (" [waiting-recvprobe %d]", c->recv_here-1);
 #endif
       c->probe->Notify (c->recv_here-1, this);
+      actsim_pending.other++;
       c->recv_here = 0;
       c->receiver_probe = 0;
     }
@@ -2014,6 +1987,7 @@ int ChpSim::varRecv (int pc, int wakeup, int id, int off, int flavor,
       c->data = xchg;
     }
     c->w->Notify (c->send_here-1, this);
+    actsim_pending.other++;
     c->send_here = 0;
     Assert (c->recv_here == 0 && c->receiver_probe == 0 &&
 	    c->sender_probe == 0, "What?");
@@ -2028,6 +2002,7 @@ int ChpSim::varRecv (int pc, int wakeup, int id, int off, int flavor,
       printf (" [waiting-sendprobe %d]", c->send_here-1);
 #endif      
       c->probe->Notify (c->send_here-1, this);
+      actsim_pending.other++;
       c->send_here = 0;
       c->sender_probe = 0;
     }
@@ -2500,6 +2475,7 @@ BigInt ChpSim::funcEval (Function *f, int nargs, void **vargs)
 	extargs[i].v = ((BigInt *)vargs[i])->getVal (0);
       }
     }
+    ACTSIM_PERF (PERF_EXTERN);
     extret = (*extcall) (nargs, extargs);
     if (nargs > 0) {
       FREE (extargs);
@@ -3960,7 +3936,9 @@ unsigned long ChpSim::getArea (void)
 
 void ChpSim::propagate (void *cause)
 {
-  ActSimObj::propagate (cause);
+  ACTSIM_PERF (PERF_PROPAGATE);
+  /* same as ActSimObj::propagate, with the HSE event count */
+  sWakeup ();
 }
 
 static void _add_deref_struct2 (Data *d,
@@ -4116,6 +4094,7 @@ void ChpSim::boolProp (int glob_off)
 {
   SimDES **arr;
   arr = _sc->getFO (glob_off, 0);
+  ACTSIM_PERF_ADD (PERF_FANOUT, _sc->numFanout (glob_off, 0));
 
 #ifdef DUMP_ALL
 #if 0
@@ -4153,6 +4132,7 @@ void ChpSim::intProp (int glob_off)
 {
   SimDES **arr;
   arr = _sc->getFO (glob_off, 1);
+  ACTSIM_PERF_ADD (PERF_FANOUT, _sc->numFanout (glob_off, 1));
 
 #ifdef DUMP_ALL
 #if 0
@@ -4226,6 +4206,9 @@ int ChpSim::_chkWatchBreakPt (int verb,
 	printf ("*** breakpoint %s\n", nm2);
 	ret_break = 1;
       }
+      if (verb & 4) {
+	_sc->recordTraceAll (type, goff, v);
+      }
     }
   }
   else if (type == 1) {
@@ -4252,6 +4235,9 @@ int ChpSim::_chkWatchBreakPt (int verb,
 	printf ("*** breakpoint %s\n", nm2);
 	ret_break = 1;
       }	    
+      if (verb & 4) {
+	_sc->recordTraceAll (type, goff, v);
+      }
     }
   }
   else if (type == 2) {
@@ -4325,16 +4311,19 @@ int ChpSim::_chkWatchBreakPt (int verb,
 	  _sc->recordTrace (nm, 2, ACT_CHAN_SEND_BLOCKED, v);
 	  ChanTraceDelayed *obj = new ChanTraceDelayed (nm, v);
 	  new Event (obj, SIM_EV_MKTYPE (0, 0), 1);
+	  actsim_pending.other++;
 	}
 	else {
 	  _sc->recordTrace (nm, 2, ACT_CHAN_VALUE, v);
 	  ChanTraceDelayed *obj = new ChanTraceDelayed (nm);
 	  new Event (obj, SIM_EV_MKTYPE (0, 0), 1);
+	  actsim_pending.other++;
 	}
       }
       else {
 	ChanTraceDelayed *obj = new ChanTraceDelayed (nm);
 	new Event (obj, SIM_EV_MKTYPE (0, 0), 1);
+	actsim_pending.other++;
 	printf ("%s : send complete", nm->s);
 	if (cause) {
 	  char buf[1024];
@@ -4371,9 +4360,13 @@ int ChpSim::chkWatchBreakPt (int type, int loff, int goff, const BigInt& v,
   int verb = 0;
   const ActSim::watchpt_bucket *nm;
   const char *nm2;
+  ACTSIM_PERF (PERF_WATCH_CHK);
   if ((nm = _sc->chkWatchPt (type == 3 ? 2 : type, goff))) {
     verb = 1;
   }
+  else if (type < 2 && _sc->chkWatchAll (type, goff)) {
+    verb = 4;
+  }
   if ((nm2 = _sc->chkBreakPt (type == 3 ? 2 : type, goff))) {
     verb |= 2;
   }
@@ -4395,9 +4388,13 @@ int ChpSim::chkWatchBreakPt (int type, int loff, int goff, const expr_multires&
   int ret_break = 0;
   const ActSim::watchpt_bucket *nm;
   const char *nm2;
+  ACTSIM_PERF (PERF_WATCH_CHK);
   if ((nm = _sc->chkWatchPt (type == 3 ? 2 : type, goff))) {
     verb = 1;
   }
+  else if (type < 2 && _sc->chkWatchAll (type, goff)) {
+    verb = 4;
+  }
   if ((nm2 = _sc->chkBreakPt (type == 3 ? 2 : type, goff))) {
     verb |= 2;
   }
@@ -4593,6 +4590,11 @@ void ChpSim::awakenDeadlockedGC ()
       x = list_delete_ihead (_deadlock_pc);
       if (_pc[x]) {
 	new Event (this, SIM_EV_MKTYPE (x,0), 0);
+	ACTSIM_PERF (PERF_EV_NEW);
+	actsim_pending.other++;
+	if (_hse_mode) {
+	  actsim_pending.hse++;
+	}
       }
     }
   }
@@ -4627,10 +4629,12 @@ void ChpSim::skipChannelAction (int is_send, int offset)
   // clear the channel state
   if (is_send) {
     c->w->Notify (chk_pc);
+    actsim_pending.other++;
     c->send_here = 0;
   }
   else {
     c->w->Notify (chk_pc);
+    actsim_pending.other++;
     c->recv_here = 0;
   }
 }
@@ -4669,3 +4673,315 @@ int ChpSim::jumpTo (const char *l)
   _pc[slot] = (ChpSimGraph *) b->v;
   return 1;
 }
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Checkpoints
+ *
+ *  A program counter is saved as the depth-first index of its graph
+ *  node. The wait lists of the event library are not saved; they are
+ *  rebuilt from what each program counter is blocked on.
+ *
+ *------------------------------------------------------------------------
+ */
+#define CKPT_WAIT_NONE  0
+#define CKPT_WAIT_CHAN  1	// blocked on a send/receive
+#define CKPT_WAIT_GUARD 2	// blocked on a selection
+
+struct ckpt_graph {
+  struct pHashtable *H;		// node -> index
+  A_DECL (ChpSimGraph *, n);	// index -> node
+};
+
+static struct pHashtable *_ckpt_graphs = NULL; // root -> ckpt_graph
+
+static void _ckpt_number (ckpt_graph *cg, ChpSimGraph *g)
+{
+  while (g && !phash_lookup (cg->H, g)) {
+    phash_bucket_t *b = phash_add (cg->H, g);
+    b->i = A_LEN (cg->n);
+    A_NEW (cg->n, ChpSimGraph *);
+    A_NEXT (cg->n) = g;
+    A_INC (cg->n);
+    if (g->stmt) {
+      if (g->stmt->type == CHPSIM_FORK) {
+	for (int i=0; i < g->stmt->u.fork; i++) {
+	  _ckpt_number (cg, g->all[i]);
+	}
+      }
+      else if (g->stmt->type == CHPSIM_COND ||
+	       g->stmt->type == CHPSIM_CONDARB ||
+	       g->stmt->type == CHPSIM_LOOP) {
+	int cnt = 0;
+	for (struct chpsimcond *x = &g->stmt->u.cond.c; x; x = x->next) {
+	  _ckpt_number (cg, g->all[cnt]);
+	  cnt++;
+	}
+      }
+    }
+    g = g->next;
+  }
+}
+
+static ckpt_graph *_ckpt_graph (ChpSimGraph *root)
+{
+  phash_bucket_t *b;
+  ckpt_graph *cg;
+
+  if (!_ckpt_graphs) {
+    _ckpt_graphs = phash_new (4);
+  }
+  b = phash_lookup (_ckpt_graphs, root);
+  if (b) {
+    return (ckpt_graph *) b->v;
+  }
+  NEW (cg, ckpt_graph);
+  cg->H = phash_new (16);
+  A_INIT (cg->n);
+  _ckpt_number (cg, root);
+  b = phash_add (_ckpt_graphs, root);
+  b->v = cg;
+  return cg;
+}
+
+void ChpSim::ckptDone ()
+{
+  phash_bucket_t *b;
+  phash_iter_t it;
+
+  if (!_ckpt_graphs) {
+    return;
+  }
+  phash_iter_init (_ckpt_graphs, &it);
+  while ((b = phash_iter_next (_ckpt_graphs, &it))) {
+    ckpt_graph *cg = (ckpt_graph *) b->v;
+    phash_free (cg->H);
+    A_FREE (cg->n);
+    FREE (cg);
+  }
+  phash_free (_ckpt_graphs);
+  _ckpt_graphs = NULL;
+}
+
+static int _ckpt_inlist (list_t *l, int pc)
+{
+  if (!l) {
+    return 0;
+  }
+  for (listitem_t *li = list_first (l); li; li = list_next (li)) {
+    if (list_ivalue (li) == pc) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void _ckpt_put_list (FILE *fp, list_t *l)
+{
+  ckpt_put (fp, l ? list_length (l) : 0);
+  if (l) {
+    for (listitem_t *li = list_first (l); li; li = list_next (li)) {
+      ckpt_put (fp, list_ivalue (li));
+    }
+  }
+}
+
+static int _ckpt_get_list (FILE *fp, list_t *l)
+{
+  unsigned long n, x;
+  if (!ckpt_get (fp, &n)) {
+    return 0;
+  }
+  for (unsigned long i=0; i < n; i++) {
+    if (!ckpt_get (fp, &x)) {
+      return 0;
+    }
+    list_iappend (l, (int)x);
+  }
+  return 1;
+}
+
+int ChpSim::_ckpt_wait (int pc)
+{
+  chpsimstmt *stmt = _pc[pc]->stmt;
+
+  if (!stmt) {
+    return CKPT_WAIT_NONE;
+  }
+  if (stmt->type == CHPSIM_SEND || stmt->type == CHPSIM_RECV) {
+    int off = getGlobalOffset (stmt->u.sendrecv.chvar, 2);
+    if (_sc->getChan (off)->w->isWaiting (this)) {
+      return CKPT_WAIT_CHAN;
+    }
+  }
+  else if (stmt->type == CHPSIM_COND || stmt->type == CHPSIM_CONDARB) {
+    /* all guards were false, unless it is about to be evaluated */
+    if (!ckpt_has_event (this, pc) && !_ckpt_inlist (_deadlock_pc, pc)) {
+      return CKPT_WAIT_GUARD;
+    }
+  }
+  return CKPT_WAIT_NONE;
+}
+
+void ChpSim::ckptSave (FILE *fp)
+{
+  ckpt_graph *cg = _root ? _ckpt_graph (_root) : NULL;
+
+  ckpt_put (fp, _npc);
+  if (_npc == 0) {
+    return;
+  }
+  ckpt_put (fp, _pcused);
+  for (int i=0; i < _npc; i++) {
+    if (_pc[i]) {
+      phash_bucket_t *b;
+      Assert (cg, "Program counter without a graph?");
+      b = phash_lookup (cg->H, _pc[i]);
+      Assert (b, "Program counter outside the graph?");
+      ckpt_put (fp, b->i + 1);
+      ckpt_put (fp, _ckpt_wait (i));
+    }
+    else {
+      ckpt_put (fp, 0);
+      ckpt_put (fp, CKPT_WAIT_NONE);
+    }
+    ckpt_put (fp, (unsigned long)(long)_holes[i]);
+  }
+  ckpt_put (fp, _maxcnt);
+  for (int i=0; i < _maxcnt; i++) {
+    ckpt_put (fp, _tot[i]);
+  }
+  _ckpt_put_list (fp, _stalled_pc);
+  _ckpt_put_list (fp, _deadlock_pc);
+  ckpt_put (fp, sWaiting() ? 1 : 0);
+  ckpt_put (fp, _energy_cost);
+  ckpt_put (fp, _maxstats);
+  for (int i=0; i < _maxstats; i++) {
+    ckpt_put (fp, _stats[i]);
+  }
+}
+
+void ChpSim::ckptClear ()
+{
+  for (int i=0; i < _npc; i++) {
+    if (!_pc[i] || !_pc[i]->stmt) continue;
+    chpsimstmt *stmt = _pc[i]->stmt;
+    if (stmt->type == CHPSIM_SEND || stmt->type == CHPSIM_RECV) {
+      act_channel_state *c =
+	_sc->getChan (getGlobalOffset (stmt->u.sendrecv.chvar, 2));
+      if (c->w->isWaiting (this)) {
+	c->w->DelObject (this);
+      }
+    }
+    else if (stmt->type == CHPSIM_COND || stmt->type == CHPSIM_CONDARB) {
+      _add_waitcond (&stmt->u.cond.c, i, 1);
+    }
+  }
+  if (sWaiting ()) {
+    sRemove ();
+  }
+  list_free (_stalled_pc);
+  _stalled_pc = list_new ();
+  if (_deadlock_pc) {
+    list_free (_deadlock_pc);
+    _deadlock_pc = NULL;
+  }
+}
+
+int ChpSim::ckptRestore (FILE *fp)
+{
+  unsigned long x, y, z;
+  ckpt_graph *cg;
+  int *wait;
+  int ret = 0;
+
+  if (!ckpt_get (fp, &x) || (int)x != _npc) {
+    return 0;
+  }
+  if (_npc == 0) {
+    return 1;
+  }
+  cg = _root ? _ckpt_graph (_root) : NULL;
+  if (!ckpt_get (fp, &x)) {
+    return 0;
+  }
+  _pcused = x;
+
+  MALLOC (wait, int, _npc);
+  for (int i=0; i < _npc; i++) {
+    if (!ckpt_get (fp, &x) || !ckpt_get (fp, &y) || !ckpt_get (fp, &z)) {
+      goto done;
+    }
+    if (x == 0) {
+      _pc[i] = NULL;
+    }
+    else {
+      if (!cg || x > (unsigned long)A_LEN (cg->n)) {
+	goto done;
+      }
+      _pc[i] = cg->n[x-1];
+    }
+    wait[i] = y;
+    _holes[i] = (int)(long)z;
+  }
+  if (!ckpt_get (fp, &x) || (int)x != _maxcnt) {
+    goto done;
+  }
+  for (int i=0; i < _maxcnt; i++) {
+    if (!ckpt_get (fp, &x)) {
+      goto done;
+    }
+    _tot[i] = x;
+  }
+  if (!_ckpt_get_list (fp, _stalled_pc)) {
+    goto done;
+  }
+  _deadlock_pc = list_new ();
+  if (!_ckpt_get_list (fp, _deadlock_pc)) {
+    goto done;
+  }
+  if (list_isempty (_deadlock_pc)) {
+    list_free (_deadlock_pc);
+    _deadlock_pc = NULL;
+  }
+  if (!ckpt_get (fp, &z) || !ckpt_get (fp, &x)) {
+    goto done;
+  }
+  _energy_cost = x;
+  if (!ckpt_get (fp, &x) || (int)x != _maxstats) {
+    goto done;
+  }
+  for (int i=0; i < _maxstats; i++) {
+    if (!ckpt_get (fp, &x)) {
+      goto done;
+    }
+    _stats[i] = x;
+  }
+
+  /* rebuild the waits; channel state has been restored already */
+  for (int i=0; i < _npc; i++) {
+    chpsimstmt *stmt = _pc[i] ? _pc[i]->stmt : NULL;
+    if (!stmt) continue;
+    if (wait[i] == CKPT_WAIT_CHAN &&
+	(stmt->type == CHPSIM_SEND || stmt->type == CHPSIM_RECV)) {
+      act_channel_state *c =
+	_sc->getChan (getGlobalOffset (stmt->u.sendrecv.chvar, 2));
+      if (!c->w->isWaiting (this)) {
+	c->w->AddObject (this);
+      }
+    }
+    else if (wait[i] == CKPT_WAIT_GUARD &&
+	     (stmt->type == CHPSIM_COND || stmt->type == CHPSIM_CONDARB)) {
+      _add_waitcond (&stmt->u.cond.c, i);
+    }
+  }
+  if (z) {
+    sStall ();
+  }
+  ret = 1;
+
+done:
+  FREE (wait);
+  return ret;
+}
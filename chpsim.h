@@ -149,6 +149,13 @@ class ChpSimGraph {
  public:
   ChpSimGraph (ActSimCore *);
   ~ChpSimGraph ();
+
+  /* graph nodes are allocated from the simulation arena */
+  void *operator new (size_t sz, ActSimCore *s) {
+    return s->getArena()->alloc (sz);
+  }
+  void operator delete (void *p) { }
+  void operator delete (void *p, ActSimCore *s) { }
   
   ActSimCore *state;
   chpsimstmt *stmt;		/* object to simulate */
@@ -211,6 +218,8 @@ class ChpSim : public ActSimObj {
   unsigned long getArea (void);
 
   void dumpStats (FILE *fp);
+  int numStats () { return _maxstats; }
+  unsigned long *getStats () { return _stats; }
   
   int getBool (int glob_off) { return _sc->getBool (glob_off); }
   bool setBool (int glob_off, int val) { return _sc->setBool (glob_off, val); }
@@ -223,9 +232,29 @@ class ChpSim : public ActSimObj {
 
   BigInt exprEval (Expr *e);
 
-  void setHseMode() { _hse_mode = 1; }
+  void setHseMode() {
+    if (!_hse_mode && _pc && _pc[0]) {
+      /* count the initial event scheduled by the constructor */
+      actsim_pending.hse++;
+    }
+    _hse_mode = 1;
+  }
+
+  /* shared-variable wakeup: one event, if we are waiting */
+  void sWakeup() {
+    if (_hse_mode && sWaiting()) {
+      actsim_pending.hse++;
+    }
+    ActSimObj::sWakeup ();
+  }
   int isHseMode() { return _hse_mode; }
 
+  /* checkpoints: see checkpoint.h */
+  void ckptSave (FILE *fp);
+  int ckptRestore (FILE *fp);
+  void ckptClear ();		// drop the waits of the current state
+  static void ckptDone ();	// release graph numbering
+
   void sPrintCause (char *buf, int sz) {
     if (_npc == 0) {
       snprintf (buf, sz, "chan-method");
@@ -245,6 +274,8 @@ class ChpSim : public ActSimObj {
   ChpSimGraph **_pc;		/* current PC state of simulation */
   int *_holes;			/* available slots in the _pc array */
   int *_tot;			/* current pending concurrent count */
+  int _maxcnt;			/* size of _tot */
+  ChpSimGraph *_root;		/* entry point of the graph */
 
   list_t *_deadlock_pc;
   list_t *_stalled_pc;
@@ -309,6 +340,8 @@ class ChpSim : public ActSimObj {
   int _collect_sharedvars (Expr *e, int pc, int undo);
   void _remove_me (int pc);
 
+  int _ckpt_wait (int pc);
+
   int _nextEvent (int pc, int bw_delay);
   void _initEvent ();
   void _zeroAllIntsChans (ChpSimGraph *g);
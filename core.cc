@@ -23,9 +23,15 @@
 #include "chpsim.h"
 #include "prssim.h"
 #include "xycesim.h"
+#include "nattrace.h"
+#include "chantok.h"
 #include <time.h>
 #include <math.h>
 #include <ctype.h>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 
 
 /*
@@ -40,6 +46,254 @@ struct process_info {
 };
 
 
+/*
+ * Trace records. Values are encoded as one of:
+ *   0 = digital, 1 = wide digital, 2 = channel, 3 = wide channel
+ */
+#define TRACE_REC_DIGITAL    0
+#define TRACE_REC_WDIGITAL   1
+#define TRACE_REC_CHAN       2
+#define TRACE_REC_WCHAN      3
+#define TRACE_REC_PAD        0xff  /* skip to the start of the ring */
+
+/* header: meta word, time word, one node per format */
+#define TRACE_REC_HDR  (2 + TRACE_NUM_SLOTS)
+
+/* total length of a record */
+#define TRACE_REC_LEN(r) \
+  (TRACE_REC_HDR + (((r)[0] >> 24) & 0xffff) + (((r)[0] >> 40) & 0xffffff))
+
+/* words used on the stack before falling back to the heap */
+#define TRACE_SMALL_WORDS 8
+
+/*
+ * Single-producer, single-consumer ring of trace records. The
+ * simulation thread appends records; a writer thread drains them into
+ * the open trace files. Records are contiguous in the ring; a pad
+ * record is used to wrap around.
+ *
+ * Either side that has to wait (the writer on an empty ring, the
+ * simulation thread on a full one or in flush) spins for a short while
+ * and then sleeps on a condition variable. The other side only takes
+ * the lock to wake it when the sleeping flag is set.
+ */
+#define TRACE_SPIN 64
+
+class ActSimTraceQueue {
+public:
+  ActSimTraceQueue (ActSimCore *sc, int lg_words) {
+    _sc = sc;
+    _sz = 1UL << lg_words;
+    _mask = _sz - 1;
+    MALLOC (_buf, unsigned long, _sz);
+    _head = 0;
+    _tail = 0;
+    _done = false;
+    _wsleep = false;
+    _psleep = false;
+    _th = std::thread (&ActSimTraceQueue::_drain, this);
+  }
+
+  ~ActSimTraceQueue () {
+    flush ();
+    {
+      std::lock_guard<std::mutex> l (_lock);
+      _done = true;
+    }
+    _more.notify_one ();
+    _th.join ();
+    FREE (_buf);
+  }
+
+  /* largest record that can be queued */
+  unsigned long maxRecord () { return _sz/2; }
+
+  /* space for n contiguous words */
+  unsigned long *reserve (unsigned long n) {
+    unsigned long tl = _tail.load (std::memory_order_relaxed);
+    unsigned long pos = tl & _mask;
+    if (pos + n > _sz) {
+      _wait (_sz - pos);
+      _buf[pos] = TRACE_REC_PAD;
+      tl += _sz - pos;
+      _tail.store (tl);
+      _wake_writer ();
+      pos = 0;
+    }
+    _wait (n);
+    return &_buf[pos];
+  }
+
+  void commit (unsigned long n) {
+    _tail.store (_tail.load (std::memory_order_relaxed) + n);
+    _wake_writer ();
+  }
+
+  /* wait until the writer has caught up */
+  void flush () {
+    _wait (_sz);
+  }
+
+private:
+  ActSimCore *_sc;
+  unsigned long *_buf;
+  unsigned long _sz, _mask;
+  std::atomic<unsigned long> _head, _tail;
+  std::atomic<bool> _done;
+  std::thread _th;
+
+  std::mutex _lock;
+  std::condition_variable _more;	// records queued
+  std::condition_variable _space;	// records written
+  std::atomic<bool> _wsleep;	// writer is waiting on _more
+  std::atomic<bool> _psleep;	// simulation is waiting on _space
+
+  bool _has_space (unsigned long n) {
+    return _sz - (_tail.load (std::memory_order_relaxed) - _head.load ()) >= n;
+  }
+
+  void _wait (unsigned long n) {
+    for (int i=0; i < TRACE_SPIN; i++) {
+      if (_has_space (n)) {
+	return;
+      }
+      std::this_thread::yield ();
+    }
+    std::unique_lock<std::mutex> l (_lock);
+    _psleep = true;
+    while (!_has_space (n)) {
+      _space.wait (l);
+    }
+    _psleep = false;
+  }
+
+  /* the flag is set before the sleeper re-checks the ring, so a store
+     it did not see is always followed by a wakeup */
+  void _wake_writer () {
+    if (_wsleep) {
+      std::lock_guard<std::mutex> l (_lock);
+      _more.notify_one ();
+    }
+  }
+
+  void _wake_sim () {
+    if (_psleep) {
+      std::lock_guard<std::mutex> l (_lock);
+      _space.notify_one ();
+    }
+  }
+
+  /* wait for records at hd; false once the queue is empty and closed */
+  bool _sleep (unsigned long hd) {
+    for (int i=0; i < TRACE_SPIN; i++) {
+      if (hd != _tail.load ()) {
+	return true;
+      }
+      std::this_thread::yield ();
+    }
+    std::unique_lock<std::mutex> l (_lock);
+    _wsleep = true;
+    while (hd == _tail.load () && !_done) {
+      _more.wait (l);
+    }
+    _wsleep = false;
+    return hd != _tail.load ();
+  }
+
+  void _drain () {
+    while (1) {
+      unsigned long hd = _head.load (std::memory_order_relaxed);
+      if (hd == _tail.load ()) {
+	if (!_sleep (hd)) {
+	  return;
+	}
+	continue;
+      }
+      unsigned long pos = hd & _mask;
+      unsigned long *r = &_buf[pos];
+      if (r[0] == TRACE_REC_PAD) {
+	_head.store (hd + (_sz - pos));
+      }
+      else {
+	_sc->_writeRecord (r);
+	_head.store (hd + TRACE_REC_LEN (r));
+      }
+      _wake_sim ();
+    }
+  }
+};
+
+
+/*
+ * Rolling pre-trigger buffer. Records use the same layout as the
+ * trace queue, and are kept in time order.
+ */
+class ActSimTraceWindow {
+public:
+  ActSimTraceWindow (ActSimCore *sc) {
+    _sc = sc;
+    _sz = 1024;
+    MALLOC (_buf, unsigned long, _sz);
+    _head = 0;
+    _tail = 0;
+  }
+
+  ~ActSimTraceWindow () {
+    FREE (_buf);
+  }
+
+  void clear () {
+    _head = 0;
+    _tail = 0;
+  }
+
+  /* drop records before time tm */
+  void trim (unsigned long tm) {
+    while (_head < _tail && _buf[_head + TRACE_REC_HDR] < tm) {
+      _head += TRACE_REC_LEN (&_buf[_head]);
+    }
+    if (_head == _tail) {
+      clear ();
+    }
+  }
+
+  unsigned long *reserve (unsigned long n) {
+    if (_tail + n > _sz) {
+      if (_head >= _sz/2) {
+	memmove (_buf, _buf + _head, (_tail - _head)*sizeof (unsigned long));
+	_tail -= _head;
+	_head = 0;
+      }
+      while (_tail + n > _sz) {
+	_sz *= 2;
+	REALLOC (_buf, unsigned long, _sz);
+      }
+    }
+    return &_buf[_tail];
+  }
+
+  void commit (unsigned long n) {
+    _tail += n;
+  }
+
+  /* write out records from time tm onward, and empty the buffer */
+  void replay (unsigned long tm) {
+    trim (tm);
+    for (unsigned long pos = _head; pos < _tail;
+	 pos += TRACE_REC_LEN (&_buf[pos])) {
+      _sc->_emitRecord (&_buf[pos]);
+    }
+    clear ();
+  }
+
+private:
+  ActSimCore *_sc;
+  unsigned long *_buf;
+  unsigned long _sz, _head, _tail;
+};
+
+
+
 /*
  * Record multi-driver information
  */
@@ -133,6 +387,20 @@ ActSimCore::ActSimCore (Process *p, SDF *sdf)
   }
 
   A_INIT (_rand_init);
+
+  /* a new simulation starts with an empty event queue */
+  actsim_pending.prs = 0;
+  actsim_pending.hse = 0;
+  actsim_pending.other = 0;
+
+  memset (&actsim_objcount, 0, sizeof (actsim_objcount));
+  if (config_exists ("sim.profile_startup") &&
+      (config_get_int ("sim.profile_startup") == 1)) {
+    actsim_startup_on = 1;
+  }
+
+  _arena = new ActSimArena ();
+  _prs_cons = new PrsSimCons ();
   
   if (!p) {
     root_is_ns = 1;
@@ -192,6 +460,7 @@ ActSimCore::ActSimCore (Process *p, SDF *sdf)
   */
   state_counts globals = sp->getGlobals();
 
+  actsim_phase_begin ("state");
   state = new ActSimState (si->ports.numAllBools() + si->all.numAllBools()
 			   + globals.numAllBools(),
 			   si->ports.numInts() + si->all.numInts() +
@@ -219,6 +488,7 @@ ActSimCore::ActSimCore (Process *p, SDF *sdf)
     fo = NULL;
   }
   hfo = NULL;
+  actsim_phase_end ();
 
   _seed = 0;
   _rand_min = 1;
@@ -228,6 +498,7 @@ ActSimCore::ActSimCore (Process *p, SDF *sdf)
   _sim_rand_when = 0;
   _prs_sim_mode = 0;
   _on_warning = 0;
+  _nwarn = 0;
 
   _chp_sim_objects = list_new ();
   
@@ -240,6 +511,67 @@ ActSimCore::ActSimCore (Process *p, SDF *sdf)
   _multi_driver = phash_new (4);
   _global_multi = NULL;
 
+  _wa_bits[0] = NULL;
+  _wa_bits[1] = NULL;
+  _wa_roots = NULL;
+  for (int i=0; i < TRACE_NUM_SLOTS; i++) {
+    _wa_node[i][0] = NULL;
+    _wa_node[i][1] = NULL;
+    _wa_names[i] = NULL;
+  }
+  _ntr = NULL;
+
+  _T = NULL;
+  _trw = NULL;
+  _trg_state = 0;
+  _trg_pre = 0;
+  _trg_post = 0;
+  _trg_stop = 0;
+  _trg_warn = 0;
+
+  _tok_rec = NULL;
+  _tok_replay = list_new ();
+
+  _chg_fn = NULL;
+  _chg_cookie = NULL;
+  _tok_tables = list_new ();
+
+  _trace_detached = 0;
+  _trq = NULL;
+  if (config_exists ("sim.trace_async") &&
+      (config_get_int ("sim.trace_async") == 1)) {
+    int lg = 20;
+    if (config_exists ("sim.trace_buffer_lg")) {
+      lg = config_get_int ("sim.trace_buffer_lg");
+      if (lg < 10) {
+	lg = 10;
+      }
+    }
+    _trq = new ActSimTraceQueue (this, lg);
+  }
+
+  _build_threads = 1;
+  if (config_exists ("sim.build_threads")) {
+    _build_threads = config_get_int ("sim.build_threads");
+    if (_build_threads < 1) {
+      _build_threads = 1;
+    }
+  }
+  _renumber_state = 0;
+  if (config_exists ("sim.renumber") &&
+      (config_get_int ("sim.renumber") == 1)) {
+    _renumber_state = 1;
+  }
+
+  actsim_perf_reset ();
+  if (config_exists ("sim.perf_stats") &&
+      (config_get_int ("sim.perf_stats") == 1)) {
+    actsim_perf_enable (1);
+  }
+  if (config_exists ("sim.progress_interval")) {
+    actsim_mon_progress (config_get_real ("sim.progress_interval"), NULL);
+  }
+
   _initSim();
 
   /* add in handlers for the exclhi/excllo directives in prs bodies */
@@ -253,7 +585,7 @@ ActSimCore::ActSimCore (Process *p, SDF *sdf)
 }
 
 
-static void _delete_sim_objs (ActInstTable *I, int del)
+static void _delete_sim_objs (ActInstTable *I)
 {
   hash_bucket_t *b;
   hash_iter_t hi;
@@ -268,14 +600,12 @@ static void _delete_sim_objs (ActInstTable *I, int del)
     hash_iter_init (I->H, &hi);
     while ((b = hash_iter_next (I->H, &hi))) {
       ActInstTable *x = (ActInstTable *)b->v;
-      _delete_sim_objs (x, 1);
+      _delete_sim_objs (x);
     }
     hash_free (I->H);
   }
   I->H = NULL;
-  if (del) {
-    FREE (I);
-  }
+  /* table entries are allocated from the arena */
 }
 
 ActSimCore::~ActSimCore()
@@ -305,14 +635,14 @@ ActSimCore::~ActSimCore()
 	if (pgi->hse) {
 	  delete pgi->hse;
 	}
-	if (pgi->prs) {
-	  delete pgi->prs;
-	}
 	delete pgi;
       }
     }
     ihash_free (map);
   }
+  /* prs graphs are shared between process types */
+  delete _prs_cons;
+  _prs_cons = NULL;
 
   if (chan) {
     phash_iter_t iter;
@@ -369,14 +699,47 @@ ActSimCore::~ActSimCore()
   ihash_free (_B);
 
   /*-- instance tables --*/
-  _delete_sim_objs (&I, 0);
+  _delete_sim_objs (&I);
 
-  /*-- close any pending trace files --*/
+  /*-- close any pending trace files; untriggered records are dropped --*/
+  if (_trq) {
+    delete _trq;
+    _trq = NULL;
+  }
+  clearTriggers ();
+  if (_trw) {
+    delete _trw;
+    _trw = NULL;
+  }
+  tokenRecordStop ();
+  for (listitem_t *li = list_first (_tok_replay); li; li = list_next (li)) {
+    delete (ChanReplay *) list_value (li);
+  }
+  list_free (_tok_replay);
+  for (listitem_t *li = list_first (_tok_tables); li; li = list_next (li)) {
+    ChanReplay::freePorts ((struct chantok_port *) list_value (li));
+  }
+  list_free (_tok_tables);
   for (int i=0; i < TRACE_NUM_FORMATS; i++) {
     if (_tr[i]) {
       act_trace_close (_tr[i]);
     }
   }
+  if (_ntr) {
+    delete _ntr;
+    _ntr = NULL;
+  }
+  for (int i=0; i < TRACE_NUM_SLOTS; i++) {
+    _watchall_close (i);
+  }
+  for (int i=0; i < 2; i++) {
+    if (_wa_bits[i]) {
+      bitset_free (_wa_bits[i]);
+    }
+  }
+  if (_wa_roots) {
+    list_free (_wa_roots);
+  }
 
   /*-- delete SDF, if it exists --*/
   if (_sdf) {
@@ -407,6 +770,10 @@ ActSimCore::~ActSimCore()
     }
     ihash_free (_global_multi);
   }
+
+  /*-- release all simulation-scoped memory --*/
+  delete _arena;
+  _arena = NULL;
 }
 
 
@@ -478,6 +845,7 @@ ChpSim *ActSimCore::_add_chp (act_chp *c)
   else {
     x = new ChpSim (NULL, NULL, this, _curproc);
   }
+  actsim_objcount.chp++;
   x->setName (_curinst);
   x->setOffsets (&_curoffset);
   x->setPorts (_cur_abs_port_bool, _cur_abs_port_int, _cur_abs_port_chan);
@@ -557,6 +925,7 @@ ChpSim *ActSimCore::_add_hse (act_chp *c)
   }
   ChpSim *x = new ChpSim (pgi->hse, c->c, this, _curproc);
   x->setHseMode ();
+  actsim_objcount.hse++;
   x->setName (_curinst);
   x->setOffsets (&_curoffset);
   x->setPorts (_cur_abs_port_bool, _cur_abs_port_int, _cur_abs_port_chan);
@@ -613,10 +982,12 @@ PrsSim *ActSimCore::_add_prs (act_prs *p)
     }
     /* di is the generic cell delay, non-instance specific */
     pgi->prs = PrsSimGraph::buildPrsSimGraph (this, p, di);
+    pgi->prs = _prs_cons->graph (pgi->prs, pgi->ci ? 0 : 1);
   }
   
   /* need prs simulation graph */
   PrsSim *x = new PrsSim (pgi->prs, this, _curproc);
+  actsim_objcount.prs++;
   x->setName (_curinst);
   x->setOffsets (&_curoffset);
   x->setPorts (_cur_abs_port_bool, _cur_abs_port_int, _cur_abs_port_chan);
@@ -631,6 +1002,7 @@ PrsSim *ActSimCore::_add_prs (act_prs *p)
 XyceSim *ActSimCore::_add_xyce ()
 {
   XyceSim *x = new XyceSim (this, _curproc);
+  actsim_objcount.xyce++;
   x->setName (_curinst);
   x->setOffsets (&_curoffset);
   x->setPorts (_cur_abs_port_bool, _cur_abs_port_int, _cur_abs_port_chan);
@@ -996,16 +1368,21 @@ void ActSimCore::_add_spec (ActSimObj *obj, act_spec *s)
  * instance/process combination.
  */
 int ActSimCore::_getlevel ()
+{
+  return _getlevel (_curinst, _curproc);
+}
+
+int ActSimCore::_getlevel (ActId *inst, Process *proc)
 {
   int lev;
 
   lev = -1;
   
-  if (_curinst) {
-    lev = ActNamespace::Act()->getLevel (_curinst);
+  if (inst) {
+    lev = ActNamespace::Act()->getLevel (inst);
   }
-  if (lev == -1 && _curproc) {
-    lev = ActNamespace::Act()->getLevel (_curproc);
+  if (lev == -1 && proc) {
+    lev = ActNamespace::Act()->getLevel (proc);
   }
   if (lev == -1) {
     lev = ActNamespace::Act()->getLevel ();
@@ -1211,360 +1588,723 @@ static void _prop_used_flags (act_boolean_netlist_t *bnl, act_connection *c)
 }
 
 
+/*------------------------------------------------------------------------
+ *
+ *  Instance tree construction
+ *
+ *    Construction proceeds in three phases. First, the instance tree
+ *    is enumerated: instance names, simulation levels and instance
+ *    table entries are created for every process instance, and the
+ *    port connections of every process type are looked up once and
+ *    cached as port recipes. This phase uses the ACT data structures
+ *    and is serial. Second, state offsets and absolute port indices
+ *    are computed from the recipes. This is pure arithmetic on the
+ *    plan, and so sibling subtrees are laid out concurrently. Third,
+ *    the simulation objects are created from the plan, in exactly
+ *    the same order as a serial walk of the instance tree. Object
+ *    creation schedules events and draws random delays, so this
+ *    phase is also serial.
+ *
+ *------------------------------------------------------------------------
+ */
+
 /*
- * Add simulation objects required for this scope. All instances
- * within the scope are added to the simulation.
+ * Where a port of a sub-instance is found in its parent
  */
-void ActSimCore::_add_all_inst (Scope *sc)
-{
-  int lev;
-  int iportbool, iportchp;
-  act_boolean_netlist_t *mynl;
-  int *_my_port_int, *_my_port_chan, *_my_port_bool;
-  stateinfo_t *mysi;
-  state_counts myoffset;
-  ActInstTable *myI;
+#define PLAN_PORT_GLOBAL 0	/* global index */
+#define PLAN_PORT_PARENT 1	/* port of the parent */
+#define PLAN_PORT_LOCAL  2	/* local state of the parent */
+
+struct act_plan_port {
+  unsigned int kind:2;		/* PLAN_PORT_... */
+  unsigned int space:2;		/* 0 = bool, 1 = int, 2 = chan */
+  int idx;
+};
 
-  Assert (sc->isExpanded(), "What?");
+/*
+ * Port recipe for a sub-instance. This only depends on the type of
+ * the parent and on the position of the sub-instance within it, and
+ * so it is computed once per process type.
+ */
+struct act_plan_sub {
+  act_plan_port *port_bool, *port_int, *port_chan;
+  int nbool, nint, nchan;	/* ports used */
+  int abool, aint, achan;	/* port array sizes */
+  int iportbool, iportchp;	/* first port index in the parent */
+};
 
-  iportbool = 0;
-  iportchp = 0;
-  mynl = bp->getBNL (_curproc);
-  _my_port_int = _cur_abs_port_int;
-  _my_port_bool = _cur_abs_port_bool;
-  _my_port_chan = _cur_abs_port_chan;
-  mysi = _cursi;
-  myoffset = _curoffset;
-  myI = _curI;
+/*
+ * Port recipes for all sub-instances of a process type, in the
+ * order of the instance walk
+ */
+struct act_plan_type {
+  A_DECL (act_plan_sub, sub);
+};
 
-  /* -- increment cur offset after allocating all the items -- */
-  if (!_cursi) {
-    return;
-  }
+/*
+ * Plan for one process instance
+ */
+struct act_inst_plan {
+  ValueIdx *vx;			/* instance */
+  Process *proc;		/* process type */
+  Scope *sc;			/* scope for the process */
+  stateinfo_t *si;		/* state info (can be NULL) */
+  ActId *path;			/* full instance path */
+  int lev;			/* simulation level */
+  ActInstTable *I;		/* instance table entry */
 
-  stack_push (_si_stack, mysi);
-  stack_push (_obj_stack, myI->obj);
-  
-  _curoffset.addVar (_cursi->local);
+  act_plan_sub *ports;		/* port recipe within the parent */
 
-  ActUniqProcInstiter ipt(sc);
+  unsigned int rel:1;		/* 1 if offsets are relative to the
+				   base of the planning task */
+  state_counts offset;		/* offset when the object is created */
 
-  if (ipt.begin() != ipt.end()) {
-    myI->H = hash_new (4);
-  }
+  int *port_bool, *port_int, *port_chan; /* absolute port indices */
+  int nbool, nint, nchan;
 
-  for (ipt = ipt.begin(); ipt != ipt.end(); ipt++) {
-    ValueIdx *vx = (*ipt);
-    stateinfo_t *si;
-    Process *x = dynamic_cast<Process *> (vx->t->BaseType());
-    Arraystep *as = NULL;
-    Assert (x->isExpanded(), "What?");
+  int iportbool, iportchp;	/* first port index in the parent */
 
-    if (vx->t->arrayInfo()) {
-      as = new Arraystep (vx->t->arrayInfo());
-    }
-    else {
-      as = NULL;
+  A_DECL (act_inst_plan *, sub); /* process sub-instances */
+};
+
+/*
+ * Cursor state for one planning task
+ */
+struct act_build_ctx {
+  state_counts offset;		/* running state offset */
+  unsigned int rel:1;		/* offset is relative to the task base */
+};
+
+/*
+ * Local state offsets computed inside a planning task are relative to
+ * the (unknown) base of the task, and are tagged with this encoding
+ * until the task is complete.
+ */
+#define PLAN_REL_ENCODE(x) (-1 - (x))
+#define PLAN_REL_DECODE(x) (-1 - (x))
+
+static act_inst_plan *_plan_alloc (void)
+{
+  act_inst_plan *p = new act_inst_plan;
+  p->vx = NULL;
+  p->proc = NULL;
+  p->sc = NULL;
+  p->si = NULL;
+  p->path = NULL;
+  p->lev = -1;
+  p->I = NULL;
+  p->ports = NULL;
+  p->rel = 0;
+  p->port_bool = NULL;
+  p->port_int = NULL;
+  p->port_chan = NULL;
+  p->nbool = 0;
+  p->nint = 0;
+  p->nchan = 0;
+  p->iportbool = 0;
+  p->iportchp = 0;
+  A_INIT (p->sub);
+  return p;
+}
+
+/*
+ * Release the plan. Port arrays and instance table entries live in
+ * the simulation arena.
+ */
+static void _plan_free (act_inst_plan *p)
+{
+  for (int i=0; i < A_LEN (p->sub); i++) {
+    act_inst_plan *q = p->sub[i];
+    _plan_free (q);
+    if (q->path) {
+      delete q->path;
     }
+    delete q;
+  }
+  A_FREE (p->sub);
+}
 
-    ActId *tmpid, *previd;
+/*
+ * Release the port recipes
+ */
+static void _plan_free_types (iHashtable *H)
+{
+  ihash_iter_t it;
+  ihash_bucket_t *b;
 
-    if (!_curinst) {
-      _curinst = new ActId (vx->getName());
-      tmpid = _curinst;
-      previd = NULL;
+  ihash_iter_init (H, &it);
+  while ((b = ihash_iter_next (H, &it))) {
+    act_plan_type *t = (act_plan_type *) b->v;
+    for (int i=0; i < A_LEN (t->sub); i++) {
+      if (t->sub[i].port_bool) {
+	FREE (t->sub[i].port_bool);
+      }
+      if (t->sub[i].port_int) {
+	FREE (t->sub[i].port_int);
+      }
+      if (t->sub[i].port_chan) {
+	FREE (t->sub[i].port_chan);
+      }
     }
-    else {
-      tmpid = _curinst->Tail();
-      tmpid->Append (new ActId (vx->getName()));
-      previd = tmpid;
-      tmpid = tmpid->Rest();
+    A_FREE (t->sub);
+    delete t;
+  }
+  ihash_free (H);
+}
+
+/*
+ * Convert relative offsets in the subtree rooted at p to absolute
+ * offsets, given the base offset of the planning task.
+ */
+static void _plan_fixup (act_inst_plan *p, state_counts *base)
+{
+  if (p->rel) {
+    state_counts tmp = *base;
+    tmp.addVar (p->offset);
+    p->offset = tmp;
+    p->rel = 0;
+  }
+  for (int i=0; i < p->nbool; i++) {
+    if (p->port_bool[i] < 0) {
+      p->port_bool[i] = base->numAllBools() + PLAN_REL_DECODE (p->port_bool[i]);
+    }
+  }
+  for (int i=0; i < p->nint; i++) {
+    if (p->port_int[i] < 0) {
+      p->port_int[i] = base->numInts() + PLAN_REL_DECODE (p->port_int[i]);
+    }
+  }
+  for (int i=0; i < p->nchan; i++) {
+    if (p->port_chan[i] < 0) {
+      p->port_chan[i] = base->numChans() + PLAN_REL_DECODE (p->port_chan[i]);
     }
+  }
+  for (int i=0; i < A_LEN (p->sub); i++) {
+    _plan_fixup (p->sub[i], base);
+  }
+}
 
-    si = sp->getStateInfo (x);
-    _cursi = si;
 
-    do {
-      _curproc = x;
-      _cursi = si;
+/*
+ * Classify a local offset within the parent state info.
+ */
+void ActSimCore::_plan_port_kind (act_plan_port *r, int off, int space)
+{
+  r->space = space;
+  if (sp->isGlobalOffset (off)) {
+    r->kind = PLAN_PORT_GLOBAL;
+    r->idx = sp->globalIdx (off);
+  }
+  else if (sp->isPortOffset (off)) {
+    r->kind = PLAN_PORT_PARENT;
+    r->idx = sp->portIdx (off);
+  }
+  else {
+    r->kind = PLAN_PORT_LOCAL;
+    r->idx = off;
+  }
+}
 
-      if (!as || vx->isPrimary (as->index())) {
-	if (as) {
-	  tmpid->setArray (as->toArray());
-	}
+/*
+ * Compute the port recipe for a sub-instance of type proc within a
+ * parent with state info si and netlist mynl. iportbool and iportchp
+ * are the current positions in the parent's instance port lists, and
+ * are advanced past the ports of the sub-instance.
+ */
+void ActSimCore::_plan_recipe (act_plan_sub *r, Process *proc,
+			       stateinfo_t *si, act_boolean_netlist_t *mynl,
+			       int *iportbool, int *iportchp)
+{
+  act_boolean_netlist_t *bnl = bp->getBNL (proc);
 
-	/*-- tmpid = name of the id --*/
+  int ports_exist = 0;
+  int chpports_exist_int = 0;
+  int chpports_exist_bool = 0;
+  int chpports_exist_chan = 0;
 
-	char buf[1024];
-	hash_bucket_t *ib;
-	ActInstTable *iT;
-	tmpid->sPrint (buf, 1024);
-	ib = hash_add (myI->H, buf);
-	NEW (iT, ActInstTable);
-	iT->obj = NULL;
-	iT->H = NULL;
-	ib->v = iT;
-	_curI = iT;
-
-	/*-- compute ports for this process --*/
-	lev = _getlevel();
-	act_boolean_netlist_t *bnl = bp->getBNL (_curproc);
-
-	int ports_exist = 0;
-	int chpports_exist_int = 0;
-	int chpports_exist_bool = 0;
-	int chpports_exist_chan = 0;
-
-	for (int i=0; i < A_LEN (bnl->ports); i++) {
-	  if (bnl->ports[i].omit == 0) {
-	    ports_exist++;
-	  }
-	}
-	for (int i=0; i < A_LEN (bnl->chpports); i++) {
-	  if (bnl->chpports[i].omit == 0) {
-	    ValueIdx *lvx = bnl->chpports[i].c->getvx();
-	    Assert (lvx, "What?");
-	    if (TypeFactory::isChanType (lvx->t)) {
-	      chpports_exist_chan++;
-	    }
-	    else if (TypeFactory::isBoolType (lvx->t)) {
-	      chpports_exist_bool++;
-	    }
-	    else {
-	      chpports_exist_int++;
-	    }
-	  }
-	}
+  for (int i=0; i < A_LEN (bnl->ports); i++) {
+    if (bnl->ports[i].omit == 0) {
+      ports_exist++;
+    }
+  }
+  for (int i=0; i < A_LEN (bnl->chpports); i++) {
+    if (bnl->chpports[i].omit == 0) {
+      ValueIdx *lvx = bnl->chpports[i].c->getvx();
+      Assert (lvx, "What?");
+      if (TypeFactory::isChanType (lvx->t)) {
+	chpports_exist_chan++;
+      }
+      else if (TypeFactory::isBoolType (lvx->t)) {
+	chpports_exist_bool++;
+      }
+      else {
+	chpports_exist_int++;
+      }
+    }
+  }
 
-	/* compute port bool, int and chan ports */
-	_cur_abs_port_bool = NULL;
-	_cur_abs_port_int = NULL;
-	_cur_abs_port_chan = NULL;
+  r->port_bool = NULL;
+  r->port_int = NULL;
+  r->port_chan = NULL;
+  r->achan = chpports_exist_chan;
+  r->aint = chpports_exist_int;
+  r->abool = chpports_exist_bool + ports_exist;
+  if (r->achan) {
+    MALLOC (r->port_chan, act_plan_port, r->achan);
+  }
+  if (r->aint) {
+    MALLOC (r->port_int, act_plan_port, r->aint);
+  }
+  if (r->abool) {
+    MALLOC (r->port_bool, act_plan_port, r->abool);
+  }
 
-	if (chpports_exist_bool || chpports_exist_int || chpports_exist_chan ||
-	    ports_exist) {
-	  if (chpports_exist_chan) {
-	    MALLOC (_cur_abs_port_chan, int, chpports_exist_chan);
-	  }
-	  if (chpports_exist_int) {
-	    MALLOC (_cur_abs_port_int, int, chpports_exist_int);
-	  }
-	  if (chpports_exist_bool || ports_exist) {
-	    MALLOC (_cur_abs_port_bool, int, chpports_exist_bool + ports_exist);
-	  }
-	}
+  r->iportbool = *iportbool;
+  r->iportchp = *iportchp;
 
-	int ibool = 0;
-	int iportbool_orig = iportbool;
-	if (ports_exist) {
-	  for (int i=0; i < A_LEN (bnl->ports); i++) {
-	    if (bnl->ports[i].omit) continue;
-	    Assert (iportbool < A_LEN (mynl->instports), "What?");
+  int ibool = 0;
+  if (ports_exist) {
+    for (int i=0; i < A_LEN (bnl->ports); i++) {
+      if (bnl->ports[i].omit) continue;
+      Assert (*iportbool < A_LEN (mynl->instports), "What?");
 
-	    act_connection *c = mynl->instports[iportbool];
+      act_connection *c = mynl->instports[*iportbool];
+      int off = getLocalOffset (c, si, NULL);
 
-	    if (bnl->ports[i].used) {
-	      checkFragmentation (c, NULL, myI->obj, mysi,
-				  bnl->ports[i].bidir ? 0 :
-				  bnl->ports[i].input);
-	    }
+      _plan_port_kind (&r->port_bool[ibool++], off, 0);
+      (*iportbool)++;
+    }
+  }
 
-	    int off = getLocalOffset (c, mysi, NULL);
+  int ichan = 0;
+  int iint = 0;
+  if (chpports_exist_int|| chpports_exist_bool || chpports_exist_chan) {
+    /* then we use the chp instports */
+    for (int i=0; i < A_LEN (bnl->chpports); i++) {
+      if (bnl->chpports[i].omit) continue;
+      Assert (*iportchp < A_LEN (mynl->instchpports), "What?");
+      ValueIdx *lvx = bnl->chpports[i].c->getvx();
+      Assert (lvx, "Hmm");
 
-	    if (sp->isGlobalOffset (off)) {
-	      off = sp->globalIdx (off);
-	    }
-	    else if (sp->isPortOffset (off)) {
-	      off = sp->portIdx (off);
-	      off = _my_port_bool[off];
-	    }
-	    else {
-	      /* local state */
-	      off += myoffset.numAllBools();
-	    }
-	    _cur_abs_port_bool[ibool++] = off;
-	    iportbool++;
-	  }
-	}
-	
-	int ichan = 0;
-	int iint = 0;
-	int iportchp_orig = iportchp;
-	if (chpports_exist_int|| chpports_exist_bool || chpports_exist_chan) {
-	  /* then we use the chp instports */
-	  for (int i=0; i < A_LEN (bnl->chpports); i++) {
-	    if (bnl->chpports[i].omit) continue;
-	    Assert (iportchp < A_LEN (mynl->instchpports), "What?");
-	    ValueIdx *lvx = bnl->chpports[i].c->getvx();
-	    Assert (lvx, "Hmm");
-
-	    act_connection *c = mynl->instchpports[iportchp];
-
-	    if (bnl->chpports[i].used) {
-	      checkFragmentation (c, NULL, myI->obj, mysi, bnl->chpports[i].input);
-	    }
+      act_connection *c = mynl->instchpports[*iportchp];
 
-	    iportchp++;
+      (*iportchp)++;
 
-	    ihash_bucket_t *xb = ihash_lookup (bnl->cH, (long)bnl->chpports[i].c);
-	    if (xb) {
-	      act_booleanized_var_t *v;
-	      v = (act_booleanized_var_t *)xb->v;
-	      if (v->used) continue; /* already covered */
-	    }
+      ihash_bucket_t *xb = ihash_lookup (bnl->cH, (long)bnl->chpports[i].c);
+      if (xb) {
+	act_booleanized_var_t *v;
+	v = (act_booleanized_var_t *)xb->v;
+	if (v->used) continue; /* already covered */
+      }
 
-	    int type;
-	    int off = getLocalOffset (c, mysi, &type);
+      int type;
+      int off = getLocalOffset (c, si, &type);
+      int space;
 
-	    if (sp->isGlobalOffset (off)) {
-	      off = sp->globalIdx (off);
-	    }
-	    else if (sp->isPortOffset (off)) {
-	      off = sp->portIdx (off);
-	      if (type == 2 || type == 3) {
-		off = _my_port_chan[off];
-	      }
-	      else if (type == 1) {
-		off = _my_port_int[off];
-	      }
-	      else {
-		off = _my_port_bool[off];
-	      }
-	    }
-	    else {
-	      /* local state */
-	      if (type == 2 || type == 3) {
-		off += myoffset.numChans();
-	      }
-	      else if (type == 1) {
-		off += myoffset.numInts();
-	      }
-	      else {
-		off += myoffset.numAllBools();
-	      }
-	    }
-	    if (TypeFactory::isChanType (lvx->t)) {
-	      _cur_abs_port_chan[ichan++] = off;
-	    }
-	    else if (TypeFactory::isBoolType (lvx->t)) {
-	      _cur_abs_port_bool[ibool++] = off;
-	    }
-	    else {
-	      _cur_abs_port_int[iint++] = off;
-	    }
-	  }
-	}
+      if (type == 2 || type == 3) {
+	space = 2;
+      }
+      else if (type == 1) {
+	space = 1;
+      }
+      else {
+	space = 0;
+      }
+      if (TypeFactory::isChanType (lvx->t)) {
+	_plan_port_kind (&r->port_chan[ichan++], off, space);
+      }
+      else if (TypeFactory::isBoolType (lvx->t)) {
+	_plan_port_kind (&r->port_bool[ibool++], off, space);
+      }
+      else {
+	_plan_port_kind (&r->port_int[iint++], off, space);
+      }
+    }
+  }
 
-	for (int i=0; i < ibool/2; i++) {
-	  int x = _cur_abs_port_bool[i];
-	  _cur_abs_port_bool[i] = _cur_abs_port_bool[ibool-1-i];
-	  _cur_abs_port_bool[ibool-1-i] = x;
-	}
-	for (int i=0; i < iint/2; i++) {
-	  int x = _cur_abs_port_int[i];
-	  _cur_abs_port_int[i] = _cur_abs_port_int[iint-1-i];
-	  _cur_abs_port_int[iint-1-i] = x;
-	}
-	for (int i=0; i < ichan/2; i++) {
-	  int x = _cur_abs_port_chan[i];
-	  _cur_abs_port_chan[i] = _cur_abs_port_chan[ichan-1-i];
-	  _cur_abs_port_chan[ichan-1-i] = x;
-	}
+  for (int i=0; i < ibool/2; i++) {
+    act_plan_port x = r->port_bool[i];
+    r->port_bool[i] = r->port_bool[ibool-1-i];
+    r->port_bool[ibool-1-i] = x;
+  }
+  for (int i=0; i < iint/2; i++) {
+    act_plan_port x = r->port_int[i];
+    r->port_int[i] = r->port_int[iint-1-i];
+    r->port_int[iint-1-i] = x;
+  }
+  for (int i=0; i < ichan/2; i++) {
+    act_plan_port x = r->port_chan[i];
+    r->port_chan[i] = r->port_chan[ichan-1-i];
+    r->port_chan[ichan-1-i] = x;
+  }
+  r->nbool = ibool;
+  r->nint = iint;
+  r->nchan = ichan;
+}
 
-#if 0
-	printf ("inst: "); _curinst->Print (stdout); printf ("\n");
-	printf ("  [bool %d] ", ibool);
-	for (int i=0; i < ibool; i++) {
-	  printf (" %d", _cur_abs_port_bool[i]);
-	}
-	printf ("\n");
-	printf ("  [int %d] ", iint);
-	for (int i=0; i < iint; i++) {
-	  printf (" %d", _cur_abs_port_int[i]);
-	}
-	printf ("\n");
-	printf ("  [chan %d] ", ichan);
-	for (int i=0; i < ichan; i++) {
-	  printf(" %d", _cur_abs_port_chan[i]);
-	}
-	printf ("\n");
-#endif
 
-	// XXX: add multi-driver instances needed for the current process!
-	_add_multidrivers (x, _curoffset.numBools(), _cur_abs_port_bool);
-	_add_language (lev, x->getlang());
+/*
+ * Enumerate all process instances within the scope of p, creating
+ * their names, levels and instance table entries. H caches the port
+ * recipes of each process type. This phase is serial.
+ */
+void ActSimCore::_plan_tree (act_inst_plan *p, iHashtable *H)
+{
+  act_boolean_netlist_t *mynl;
+  act_plan_type *t;
+  ihash_bucket_t *b;
+  int iportbool, iportchp;
+  int fresh, k;
 
-	if (lev != ACT_MODEL_DEVICE) {
-	  /* a device level model applies to the *entire* sub-tree */
-	  _add_all_inst (x->CurScope());
-	}
+  if (!p->si) {
+    return;
+  }
+  Assert (p->sc->isExpanded(), "What?");
 
+  mynl = bp->getBNL (p->proc);
 
-	iportbool = iportbool_orig;
-	if (ports_exist) {
-	  for (int i=0; i < A_LEN (bnl->ports); i++) {
-	    if (bnl->ports[i].omit) continue;
-	    Assert (iportbool < A_LEN (mynl->instports), "What?");
-	    act_connection *c = mynl->instports[iportbool];
+  b = ihash_lookup (H, (long)p->proc);
+  if (b) {
+    t = (act_plan_type *) b->v;
+    fresh = 0;
+  }
+  else {
+    b = ihash_add (H, (long)p->proc);
+    t = new act_plan_type;
+    A_INIT (t->sub);
+    b->v = t;
+    fresh = 1;
+  }
+  iportbool = 0;
+  iportchp = 0;
 
-	    if (bnl->ports[i].used) {
-	      //_prop_used_flags (mysi->bnl, c);
-	      checkFragmentation (c, NULL, myI->obj, mysi, bnl->ports[i].bidir ? 0 : bnl->ports[i].input);
-	    }
-	    iportbool++;
-	  }
-	}
-	iportchp = iportchp_orig;
-	if (chpports_exist_int|| chpports_exist_bool || chpports_exist_chan) {
-	  /* then we use the chp instports */
-	  for (int i=0; i < A_LEN (bnl->chpports); i++) {
-	    if (bnl->chpports[i].omit) continue;
-	    Assert (iportchp < A_LEN (mynl->instchpports), "What?");
-	    act_connection *c = mynl->instchpports[iportchp];
-
-	    if (bnl->chpports[i].used) {
-	      //_prop_used_flags (mysi->bnl, c);
-	      checkFragmentation (c, NULL, myI->obj, mysi, bnl->chpports[i].input);
-	    }
+  ActUniqProcInstiter ipt(p->sc);
 
-	    iportchp++;
-	  }
-	}
+  if (ipt.begin() != ipt.end()) {
+    p->I->H = hash_new (4);
+  }
 
+  /*-- enumerate sub-instances --*/
+  for (ipt = ipt.begin(); ipt != ipt.end(); ipt++) {
+    ValueIdx *vx = (*ipt);
+    Process *x = dynamic_cast<Process *> (vx->t->BaseType());
+    Arraystep *as = NULL;
+    Assert (x->isExpanded(), "What?");
+
+    if (vx->t->arrayInfo()) {
+      as = new Arraystep (vx->t->arrayInfo());
+    }
+    else {
+      as = NULL;
+    }
+
+    do {
+      if (!as || vx->isPrimary (as->index())) {
+	act_inst_plan *q = _plan_alloc ();
+	ActId *tmpid;
+
+	q->vx = vx;
+	q->proc = x;
+	q->sc = x->CurScope();
+	q->si = sp->getStateInfo (x);
+
+	tmpid = new ActId (vx->getName());
 	if (as) {
-	  Array *atmp = tmpid->arrayInfo();
-	  delete atmp;
-	  tmpid->setArray (NULL);
+	  tmpid->setArray (as->toArray());
+	}
+	if (p->path) {
+	  q->path = p->path->Clone();
+	  q->path->Tail()->Append (tmpid);
+	}
+	else {
+	  q->path = tmpid;
 	}
+	ARENA_NEW (_arena, q->I, ActInstTable);
 
+	/*-- tmpid = name of the id --*/
+	char buf[1024];
+	hash_bucket_t *ib;
+	tmpid->sPrint (buf, 1024);
+	ib = hash_add (p->I->H, buf);
+	q->I->obj = NULL;
+	q->I->H = NULL;
+	ib->v = q->I;
+
+	q->lev = _getlevel (q->path, x);
+
+	if (fresh) {
+	  A_NEW (t->sub, act_plan_sub);
+	  _plan_recipe (&A_NEXT (t->sub), x, p->si, mynl,
+			&iportbool, &iportchp);
+	  A_INC (t->sub);
+	}
+
+	A_NEW (p->sub, act_inst_plan *);
+	A_NEXT (p->sub) = q;
+	A_INC (p->sub);
       }
-      
       if (as) {
 	as->step();
       }
     } while (as && !as->isend());
 
-    if (previd) {
-      previd->prune();
-      delete tmpid;
+    if (as) {
+      delete as;
+    }
+  }
+  if (fresh) {
+    Assert (iportbool == A_LEN (mynl->instports), "What?");
+    Assert (iportchp == A_LEN (mynl->instchpports), "What?");
+  }
+  Assert (A_LEN (t->sub) == A_LEN (p->sub), "What?");
+
+  for (k=0; k < A_LEN (p->sub); k++) {
+    act_inst_plan *q = p->sub[k];
+    act_plan_sub *r = &t->sub[k];
+
+    q->ports = r;
+    q->iportbool = r->iportbool;
+    q->iportchp = r->iportchp;
+    if (r->achan) {
+      ARENA_MALLOC (_arena, q->port_chan, int, r->achan);
+    }
+    if (r->aint) {
+      ARENA_MALLOC (_arena, q->port_int, int, r->aint);
+    }
+    if (r->abool) {
+      ARENA_MALLOC (_arena, q->port_bool, int, r->abool);
+    }
+    q->nbool = r->nbool;
+    q->nint = r->nint;
+    q->nchan = r->nchan;
+
+    if (q->lev != ACT_MODEL_DEVICE) {
+      /* a device level model applies to the *entire* sub-tree */
+      _plan_tree (q, H);
+    }
+  }
+}
+
+
+/*
+ * Evaluate one port recipe for a sub-instance of p.
+ */
+static int _plan_port_eval (act_plan_port *r, act_inst_plan *p)
+{
+  int off = r->idx;
+
+  switch (r->kind) {
+  case PLAN_PORT_GLOBAL:
+    return off;
+
+  case PLAN_PORT_PARENT:
+    if (r->space == 2) {
+      return p->port_chan[off];
+    }
+    else if (r->space == 1) {
+      return p->port_int[off];
+    }
+    return p->port_bool[off];
+
+  default:
+    /* local state */
+    if (r->space == 2) {
+      off += p->offset.numChans();
+    }
+    else if (r->space == 1) {
+      off += p->offset.numInts();
     }
     else {
-      delete _curinst;
-      _curinst = NULL;
+      off += p->offset.numAllBools();
     }
-    if (as) {
-      delete as;
+    if (p->rel) {
+      off = PLAN_REL_ENCODE (off);
+    }
+    return off;
+  }
+}
+
+/*
+ * Compute the absolute port indices for instance q within its parent
+ * p from its port recipe.
+ */
+static void _plan_ports (act_inst_plan *q, act_inst_plan *p)
+{
+  act_plan_sub *r = q->ports;
+
+  for (int i=0; i < r->nbool; i++) {
+    q->port_bool[i] = _plan_port_eval (&r->port_bool[i], p);
+  }
+  for (int i=0; i < r->nint; i++) {
+    q->port_int[i] = _plan_port_eval (&r->port_int[i], p);
+  }
+  for (int i=0; i < r->nchan; i++) {
+    q->port_chan[i] = _plan_port_eval (&r->port_chan[i], p);
+  }
+}
+
+
+/*
+ * Lay out the state of all process instances within the scope of p.
+ * The offset in the context is advanced past the state of the entire
+ * subtree. If split is set and there are at least two sub-instances,
+ * each sub-instance is laid out as a separate task on the build
+ * thread pool. This only reads the plan and the state info, and
+ * writes the offsets and port arrays of the subtree.
+ */
+void ActSimCore::_plan_scope (act_inst_plan *p, act_build_ctx *cx, int split)
+{
+  if (!p->si) {
+    return;
+  }
+
+  /* -- increment cur offset after allocating all the items -- */
+  cx->offset.addVar (p->si->local);
+
+  for (int i=0; i < A_LEN (p->sub); i++) {
+    _plan_ports (p->sub[i], p);
+  }
+
+  if (split && !cx->rel && _build_threads > 1 && A_LEN (p->sub) > 1) {
+    /*-- lay out each sub-instance as a separate task --*/
+    int n = A_LEN (p->sub);
+    act_build_ctx *cxs = new act_build_ctx[n];
+    std::atomic<int> next (0);
+
+    for (int i=0; i < n; i++) {
+      cxs[i].rel = 1;
+      p->sub[i]->offset = cxs[i].offset;
+      p->sub[i]->rel = 1;
+    }
+
+    auto worker = [&] ()
+    {
+      int i;
+      while ((i = next++) < n) {
+	if (p->sub[i]->lev != ACT_MODEL_DEVICE) {
+	  _plan_scope (p->sub[i], &cxs[i], 0);
+	}
+      }
+    };
+
+    int nth = (_build_threads < n ? _build_threads : n) - 1;
+    std::thread *th = new std::thread[nth];
+    for (int i=0; i < nth; i++) {
+      th[i] = std::thread (worker);
+    }
+    worker ();
+    for (int i=0; i < nth; i++) {
+      th[i].join();
     }
+    delete [] th;
+
+    /*-- sequence the tasks: same offsets as the serial walk --*/
+    for (int i=0; i < n; i++) {
+      _plan_fixup (p->sub[i], &cx->offset);
+      cx->offset.addVar (cxs[i].offset);
+    }
+    delete [] cxs;
+  }
+  else {
+    for (int i=0; i < A_LEN (p->sub); i++) {
+      act_inst_plan *q = p->sub[i];
+      q->offset = cx->offset;
+      q->rel = cx->rel;
+      if (q->lev != ACT_MODEL_DEVICE) {
+	/* a device level model applies to the *entire* sub-tree */
+	_plan_scope (q, cx, split && (A_LEN (p->sub) == 1));
+      }
+    }
+  }
+}
+
+
+/*
+ * Fragmentation checks for the ports of instance q within its
+ * parent p.
+ */
+void ActSimCore::_check_inst_frag (act_inst_plan *q, act_inst_plan *p,
+				   act_boolean_netlist_t *mynl)
+{
+  act_boolean_netlist_t *bnl = bp->getBNL (q->proc);
+  int iportbool = q->iportbool;
+  int iportchp = q->iportchp;
+
+  for (int i=0; i < A_LEN (bnl->ports); i++) {
+    if (bnl->ports[i].omit) continue;
+    Assert (iportbool < A_LEN (mynl->instports), "What?");
+    act_connection *c = mynl->instports[iportbool];
+
+    if (bnl->ports[i].used) {
+      //_prop_used_flags (mysi->bnl, c);
+      checkFragmentation (c, NULL, p->I->obj, p->si,
+			  bnl->ports[i].bidir ? 0 : bnl->ports[i].input);
+    }
+    iportbool++;
   }
-  Assert (iportbool == A_LEN (mynl->instports), "What?");
-  Assert (iportchp == A_LEN (mynl->instchpports), "What?");
+  for (int i=0; i < A_LEN (bnl->chpports); i++) {
+    if (bnl->chpports[i].omit) continue;
+    Assert (iportchp < A_LEN (mynl->instchpports), "What?");
+    act_connection *c = mynl->instchpports[iportchp];
+
+    if (bnl->chpports[i].used) {
+      //_prop_used_flags (mysi->bnl, c);
+      checkFragmentation (c, NULL, p->I->obj, p->si, bnl->chpports[i].input);
+    }
+    iportchp++;
+  }
+}
+
+
+/*
+ * Create the simulation objects for all instances within the scope
+ * of p, in the order of the serial instance walk.
+ */
+void ActSimCore::_inst_scope (act_inst_plan *p)
+{
+  act_boolean_netlist_t *mynl;
+
+  if (!p->si) {
+    return;
+  }
+  mynl = bp->getBNL (p->proc);
+
+  stack_push (_si_stack, p->si);
+  stack_push (_obj_stack, p->I->obj);
+
+  for (int i=0; i < A_LEN (p->sub); i++) {
+    act_inst_plan *q = p->sub[i];
+
+    _curproc = q->proc;
+    _cursi = q->si;
+    _curinst = q->path;
+    _curI = q->I;
+    _curoffset = q->offset;
+    _cur_abs_port_bool = q->port_bool;
+    _cur_abs_port_int = q->port_int;
+    _cur_abs_port_chan = q->port_chan;
+
+    _check_inst_frag (q, p, mynl);
+
+    // XXX: add multi-driver instances needed for the current process!
+    _add_multidrivers (q->proc, _curoffset.numBools(), _cur_abs_port_bool);
+    _add_language (q->lev, q->proc->getlang());
+
+    if (q->lev != ACT_MODEL_DEVICE) {
+      _inst_scope (q);
+      _curinst = q->path;
+    }
+
+    _check_inst_frag (q, p, mynl);
+  }
+  _curinst = p->path;
 
   _cursuffix = NULL;
-  ActInstiter it(sc);
+  ActInstiter it(p->sc);
   for (it = it.begin(); it != it.end(); it++) {
     ValueIdx *vx = (*it);
     if (!TypeFactory::isProcessType (vx->t)) {
-      _check_add_spec (vx->getName(), vx->t, myI->obj);
+      _check_add_spec (vx->getName(), vx->t, p->I->obj);
     }
   }
 
@@ -1572,6 +2312,327 @@ void ActSimCore::_add_all_inst (Scope *sc)
   stack_pop (_obj_stack);
 }
 
+
+/*
+ * Locality-aware state layout.
+ *
+ * The local state of each planned instance is a contiguous block of
+ * Booleans and integers, and the blocks of all instances below the
+ * root tile the index range above the local state of the root. The
+ * default layout is the order of the instance walk. With renumbering,
+ * the blocks are placed in the order of a breadth-first walk that
+ * goes from an instance to every instance that shares a net with it,
+ * so cells that drive each other are stored together even when the
+ * netlist declares them in an arbitrary order.
+ *
+ * Only the instance offsets and the absolute port tables are
+ * rewritten, and this happens before any simulation object is
+ * created. Every global index seen by the rest of the simulator is
+ * already in the new layout.
+ */
+
+/* nets with more references than this (resets, enables) are not
+   followed by the walk */
+#define PLAN_HUB_REFS 32
+
+static int _plan_count (act_inst_plan *p)
+{
+  int n = 0;
+  for (int i=0; i < A_LEN (p->sub); i++) {
+    n += 1 + _plan_count (p->sub[i]);
+  }
+  return n;
+}
+
+/* pre-order, which is the order in which local state was allocated */
+static void _plan_collect (act_inst_plan *p, act_inst_plan **pl, int *n)
+{
+  for (int i=0; i < A_LEN (p->sub); i++) {
+    pl[(*n)++] = p->sub[i];
+    _plan_collect (p->sub[i], pl, n);
+  }
+}
+
+/* block that contains index v, or -1 */
+static int _plan_owner (int *base, int *len, int n, int v)
+{
+  int lo = 0, hi = n-1, k = -1;
+  while (lo <= hi) {
+    int m = (lo + hi)/2;
+    if (base[m] <= v) {
+      k = m;
+      lo = m + 1;
+    }
+    else {
+      hi = m - 1;
+    }
+  }
+  if (k == -1 || v >= base[k] + len[k]) {
+    return -1;
+  }
+  return k;
+}
+
+void ActSimCore::_plan_renumber (act_inst_plan *root, state_counts *end)
+{
+  act_inst_plan **pl;
+  int n, nb, ni;
+  int b0, b1, i0, i1;
+  int *bbase, *blen, *ibase, *ilen;
+  int *rcnt, *rstart, *refs;
+  int *order, *nbb, *nib;
+  char *seen;
+
+  if (!root->si) {
+    return;
+  }
+  n = _plan_count (root);
+  if (n < 2) {
+    return;
+  }
+
+  b0 = root->offset.numAllBools() + root->si->local.numAllBools();
+  i0 = root->offset.numInts() + root->si->local.numInts();
+  b1 = end->numAllBools();
+  i1 = end->numInts();
+  nb = b1 - b0;
+  ni = i1 - i0;
+
+  MALLOC (pl, act_inst_plan *, n);
+  n = 0;
+  _plan_collect (root, pl, &n);
+
+  /*-- local state blocks --*/
+  MALLOC (bbase, int, n);
+  MALLOC (blen, int, n);
+  MALLOC (ibase, int, n);
+  MALLOC (ilen, int, n);
+  {
+    int b = b0, i = i0;
+    for (int k=0; k < n; k++) {
+      act_inst_plan *q = pl[k];
+      bbase[k] = q->offset.numAllBools();
+      ibase[k] = q->offset.numInts();
+      if (q->si && q->lev != ACT_MODEL_DEVICE) {
+	blen[k] = q->si->local.numAllBools();
+	ilen[k] = q->si->local.numInts();
+      }
+      else {
+	blen[k] = 0;
+	ilen[k] = 0;
+      }
+      Assert (bbase[k] == b && ibase[k] == i, "Instance state is not contiguous?");
+      b += blen[k];
+      i += ilen[k];
+    }
+    Assert (b == b1 && i == i1, "What?");
+  }
+
+  /*-- instances that refer to each net through a port --*/
+#define NET_BOOL(v) (((v) >= b0 && (v) < b1) ? (v) - b0 : -1)
+#define NET_INT(v)  (((v) >= i0 && (v) < i1) ? nb + (v) - i0 : -1)
+
+  MALLOC (rcnt, int, nb + ni + 1);
+  MALLOC (rstart, int, nb + ni + 1);
+  for (int x=0; x <= nb + ni; x++) {
+    rcnt[x] = 0;
+  }
+  for (int k=0; k < n; k++) {
+    for (int j=0; j < pl[k]->nbool; j++) {
+      int x = NET_BOOL (pl[k]->port_bool[j]);
+      if (x != -1) rcnt[x]++;
+    }
+    for (int j=0; j < pl[k]->nint; j++) {
+      int x = NET_INT (pl[k]->port_int[j]);
+      if (x != -1) rcnt[x]++;
+    }
+  }
+  rstart[0] = 0;
+  for (int x=0; x < nb + ni; x++) {
+    rstart[x+1] = rstart[x] + rcnt[x];
+    rcnt[x] = 0;
+  }
+  MALLOC (refs, int, rstart[nb+ni] + 1);
+  for (int k=0; k < n; k++) {
+    for (int j=0; j < pl[k]->nbool; j++) {
+      int x = NET_BOOL (pl[k]->port_bool[j]);
+      if (x != -1) refs[rstart[x] + rcnt[x]++] = k;
+    }
+    for (int j=0; j < pl[k]->nint; j++) {
+      int x = NET_INT (pl[k]->port_int[j]);
+      if (x != -1) refs[rstart[x] + rcnt[x]++] = k;
+    }
+  }
+
+  /*-- breadth-first walk over instances --*/
+  MALLOC (order, int, n);
+  MALLOC (seen, char, n);
+  for (int k=0; k < n; k++) {
+    seen[k] = 0;
+  }
+  int head = 0, tail = 0;
+
+  auto visit = [&] (int k)
+  {
+    if (k != -1 && !seen[k]) {
+      seen[k] = 1;
+      order[tail++] = k;
+    }
+  };
+  auto visit_net = [&] (int x)
+  {
+    if (rcnt[x] > PLAN_HUB_REFS) {
+      return;
+    }
+    for (int j=0; j < rcnt[x]; j++) {
+      visit (refs[rstart[x] + j]);
+    }
+  };
+
+  for (int start=0; start < n; start++) {
+    visit (start);
+    while (head < tail) {
+      int k = order[head++];
+      act_inst_plan *q = pl[k];
+      for (int j=0; j < q->nbool; j++) {
+	int x = NET_BOOL (q->port_bool[j]);
+	if (x != -1) {
+	  visit (_plan_owner (bbase, blen, n, q->port_bool[j]));
+	  visit_net (x);
+	}
+      }
+      for (int j=0; j < q->nint; j++) {
+	int x = NET_INT (q->port_int[j]);
+	if (x != -1) {
+	  visit (_plan_owner (ibase, ilen, n, q->port_int[j]));
+	  visit_net (x);
+	}
+      }
+      for (int j=0; j < blen[k]; j++) {
+	visit_net (bbase[k] - b0 + j);
+      }
+      for (int j=0; j < ilen[k]; j++) {
+	visit_net (nb + ibase[k] - i0 + j);
+      }
+    }
+  }
+  Assert (tail == n, "What?");
+  FREE (seen);
+  FREE (refs);
+  FREE (rstart);
+  FREE (rcnt);
+
+  /*-- new block positions --*/
+  MALLOC (nbb, int, n);
+  MALLOC (nib, int, n);
+  {
+    int b = b0, i = i0;
+    for (int t=0; t < n; t++) {
+      int k = order[t];
+      nbb[k] = b;
+      nib[k] = i;
+      b += blen[k];
+      i += ilen[k];
+    }
+  }
+  FREE (order);
+
+  int *bmap, *imap;
+  MALLOC (bmap, int, nb + 1);
+  MALLOC (imap, int, ni + 1);
+  for (int k=0; k < n; k++) {
+    for (int j=0; j < blen[k]; j++) {
+      bmap[bbase[k] - b0 + j] = nbb[k] + j;
+    }
+    for (int j=0; j < ilen[k]; j++) {
+      imap[ibase[k] - i0 + j] = nib[k] + j;
+    }
+  }
+
+  /*-- rewrite offsets and port tables --*/
+  for (int k=0; k < n; k++) {
+    act_inst_plan *q = pl[k];
+    q->offset.addBool (nbb[k] - bbase[k]);
+    q->offset.addInt (nib[k] - ibase[k]);
+    for (int j=0; j < q->nbool; j++) {
+      int x = NET_BOOL (q->port_bool[j]);
+      if (x != -1) {
+	q->port_bool[j] = bmap[x];
+      }
+    }
+    for (int j=0; j < q->nint; j++) {
+      int x = NET_INT (q->port_int[j]);
+      if (x != -1) {
+	q->port_int[j] = imap[x - nb];
+      }
+    }
+  }
+#undef NET_BOOL
+#undef NET_INT
+
+  FREE (bmap);
+  FREE (imap);
+  FREE (nbb);
+  FREE (nib);
+  FREE (bbase);
+  FREE (blen);
+  FREE (ibase);
+  FREE (ilen);
+  FREE (pl);
+}
+
+
+/*
+ * Add simulation objects required for this scope. All instances
+ * within the scope are added to the simulation. The current cursor
+ * state describes the process that owns the scope.
+ */
+void ActSimCore::_add_all_inst (Scope *sc)
+{
+  act_inst_plan root;
+  act_build_ctx cx;
+  iHashtable *H;
+
+  Assert (sc->isExpanded(), "What?");
+
+  root.vx = NULL;
+  root.proc = _curproc;
+  root.sc = sc;
+  root.si = _cursi;
+  root.path = _curinst;
+  root.lev = -1;
+  root.I = _curI;
+  root.ports = NULL;
+  root.rel = 0;
+  root.offset = _curoffset;
+  root.port_bool = _cur_abs_port_bool;
+  root.port_int = _cur_abs_port_int;
+  root.port_chan = _cur_abs_port_chan;
+  root.nbool = 0;
+  root.nint = 0;
+  root.nchan = 0;
+  root.iportbool = 0;
+  root.iportchp = 0;
+  A_INIT (root.sub);
+
+  cx.offset = _curoffset;
+  cx.rel = 0;
+
+  H = ihash_new (4);
+  _plan_tree (&root, H);
+  _plan_scope (&root, &cx, 1);
+  if (_renumber_state) {
+    actsim_phase_begin ("renumber");
+    _plan_renumber (&root, &cx.offset);
+    actsim_phase_end ();
+  }
+  _inst_scope (&root);
+
+  _curoffset = cx.offset;
+  _plan_free (&root);
+  _plan_free_types (H);
+}
+
 /*
  * Compute the fanout of every instance in the simulation. Traversal
  * is done through the instance table created after the simulation is
@@ -1601,6 +2662,21 @@ void ActSimCore::computeFanout (ActInstTable *I)
  * objects for all instances, and then computing the fanout tables for
  * event propagation across simulation objects.
  */
+void ActSimCore::printCounts (FILE *fp)
+{
+  unsigned long tot = 0;
+  int maxfo = 0;
+
+  for (int i=0; i < nfo_len; i++) {
+    tot += nfo[i];
+    if (nfo[i] > maxfo) {
+      maxfo = nfo[i];
+    }
+  }
+  fprintf (fp, "State: %d bools, %d ints, %d chans; fanout: %lu entries (max %d)\n",
+	   nint_start, nfo_len - nint_start, state->numChans(), tot, maxfo);
+}
+
 void ActSimCore::_initSim ()
 {
   /* 
@@ -1665,13 +2741,14 @@ void ActSimCore::_initSim ()
   if (chpports_exist_bool || chpports_exist_int || chpports_exist_chan ||
       ports_exist) {
     if (chpports_exist_chan) {
-      MALLOC (_cur_abs_port_chan, int, chpports_exist_chan);
+      ARENA_MALLOC (_arena, _cur_abs_port_chan, int, chpports_exist_chan);
     }
     if (chpports_exist_int) {
-      MALLOC (_cur_abs_port_int, int, chpports_exist_int);
+      ARENA_MALLOC (_arena, _cur_abs_port_int, int, chpports_exist_int);
     }
     if (chpports_exist_bool || ports_exist) {
-      MALLOC (_cur_abs_port_bool, int, chpports_exist_bool + ports_exist);
+      ARENA_MALLOC (_arena, _cur_abs_port_bool, int,
+		    chpports_exist_bool + ports_exist);
     }
   }
 
@@ -1694,7 +2771,9 @@ void ActSimCore::_initSim ()
   }
 
   /*-- compute multi-drivers --*/
+  actsim_phase_begin ("multi-drivers");
   _computeMultiDrivers (_curproc);
+  actsim_phase_end ();
 
   /*-- create simulation data structures --*/
   _si_stack = list_new ();
@@ -1702,9 +2781,11 @@ void ActSimCore::_initSim ()
 
 
   // create multi-driver objects for the current scope!
+  actsim_phase_begin ("instances");
   _add_multidrivers (_curproc, _curoffset.numBools(), _cur_abs_port_bool);
   _add_language (_getlevel(), root_lang);
   _add_all_inst (root_scope);
+  actsim_phase_end ();
 
   if (simroot && _sdf) {
     char buf[1024];
@@ -1730,7 +2811,9 @@ void ActSimCore::_initSim ()
   /*
     Now compute all the fanout dependencies
   */
+  actsim_phase_begin ("fanout");
   computeFanout(&I);
+  actsim_phase_end ();
 
   /* 
      Add the initialization environment, if needed:
@@ -1948,6 +3031,29 @@ void ActSimCore::incFanout (int off, int type, SimDES *who)
   nfo[off]++;
 }
 
+void ActSimCore::delFanout (int off, int type, SimDES *who)
+{
+  int idx = (type == 0 ? off : off + nint_start);
+
+  for (int i=0; i < nfo[idx]; i++) {
+    if (fo[idx][i] == who) {
+      for (; i < nfo[idx]-1; i++) {
+	fo[idx][i] = fo[idx][i+1];
+      }
+      nfo[idx]--;
+      /* below the high fanout threshold, sizes are exact again */
+      if (hfo && nfo[idx] < 8 && ihash_lookup (hfo, idx)) {
+	ihash_delete (hfo, idx);
+      }
+      if (nfo[idx] == 0) {
+	FREE (fo[idx]);
+	fo[idx] = NULL;
+      }
+      return;
+    }
+  }
+}
+
 
 
 /*------------------------------------------------------------------------
@@ -2142,10 +3248,149 @@ void ActSimCore::_add_hazard (int *ids, int sz)
  *------------------------------------------------------------------------
  */
 
+void ActSimCore::flushTrace ()
+{
+  if (_trq) {
+    _trq->flush ();
+  }
+}
+
+/*
+ * The writer thread and the trace file buffers belong to the parent,
+ * so they are dropped without being flushed or closed.
+ */
+void ActSimCore::detachTrace ()
+{
+  _trq = NULL;
+  _ntr = NULL;
+  for (int i=0; i < TRACE_NUM_FORMATS; i++) {
+    _tr[i] = NULL;
+  }
+  _trg_state = 0;
+  _trace_detached = 1;
+}
+
+/*
+ * Emit one change to all formats that are not ignored
+ */
+void ActSimCore::_writeTrace (void * const *node, unsigned int ignore_fmt,
+			      int kind, act_chan_state_t state,
+			      float cur_time, int len, const unsigned long *ptm,
+			      int vlen, const unsigned long *valp)
+{
+  unsigned long *tp = (unsigned long *) ptm;
+  unsigned long *vp = (unsigned long *) valp;
+
+  if (!((ignore_fmt >> TRACE_NATIVE) & 1) && _ntr) {
+    _ntr->change ((int) ((long) node[TRACE_NATIVE] - 1), tp[0],
+		  (kind == TRACE_REC_CHAN || kind == TRACE_REC_WCHAN) ?
+		  (int) state : 0, vlen, vp);
+  }
+
+  for (int fmt=0; fmt < TRACE_NUM_FORMATS; fmt++) {
+    if ((ignore_fmt >> fmt) & 1) {
+      continue;
+    }
+    int alt = act_trace_has_alt (_trfn[fmt]);
+    switch (kind) {
+    case TRACE_REC_DIGITAL:
+      if (alt) {
+	act_trace_digital_change_alt (_tr[fmt], node[fmt], len, tp, vp[0]);
+      }
+      else {
+	act_trace_digital_change (_tr[fmt], node[fmt], cur_time, vp[0]);
+      }
+      break;
+
+    case TRACE_REC_WDIGITAL:
+      if (alt) {
+	act_trace_wide_digital_change_alt (_tr[fmt], node[fmt], len, tp,
+					   vlen, vp);
+      }
+      else {
+	act_trace_wide_digital_change (_tr[fmt], node[fmt], cur_time,
+				       vlen, vp);
+      }
+      break;
+
+    case TRACE_REC_CHAN:
+      if (alt) {
+	act_trace_chan_change_alt (_tr[fmt], node[fmt], len, tp, state,
+				   vp[0]);
+      }
+      else {
+	act_trace_chan_change (_tr[fmt], node[fmt], cur_time, state, vp[0]);
+      }
+      break;
+
+    case TRACE_REC_WCHAN:
+      if (alt) {
+	act_trace_wide_chan_change_alt (_tr[fmt], node[fmt], len, tp,
+					state, vlen, vp);
+      }
+      else {
+	act_trace_wide_chan_change (_tr[fmt], node[fmt], cur_time,
+				    state, vlen, vp);
+      }
+      break;
+    }
+  }
+}
+
+/*
+ * Write a queued record to the trace files
+ */
+void ActSimCore::_writeRecord (const unsigned long *r)
+{
+  int kind = r[0] & 0xff;
+  act_chan_state_t st = (act_chan_state_t) ((r[0] >> 8) & 0xff);
+  unsigned int ign = (r[0] >> 16) & 0xff;
+  int tlen = (r[0] >> 24) & 0xffff;
+  int vlen = (r[0] >> 40) & 0xffffff;
+  float tm;
+
+  memcpy (&tm, &r[1], sizeof (float));
+  _writeTrace ((void * const *)&r[2], ign, kind, st, tm,
+	       tlen, r + TRACE_REC_HDR, vlen, r + TRACE_REC_HDR + tlen);
+}
+
+/*
+ * Send a buffered record to the writer thread, or write it out
+ */
+void ActSimCore::_emitRecord (const unsigned long *r)
+{
+  unsigned long n = TRACE_REC_LEN (r);
+  if (_trq && n <= _trq->maxRecord()) {
+    memcpy (_trq->reserve (n), r, n*sizeof (unsigned long));
+    _trq->commit (n);
+  }
+  else {
+    if (_trq) {
+      _trq->flush ();
+    }
+    _writeRecord (r);
+  }
+}
+
 void ActSimCore::recordTrace (const watchpt_bucket *w, int type, 
 			      act_chan_state_t state, const BigInt &val)
 {
-  if (w->ignore_fmt == ~0U) {
+  if (_T) {
+    _chkTrigger (w->key, val);
+  }
+  if (_chg_fn) {
+    (*_chg_fn) (_chg_cookie, w->key & 3, w->key >> 2, val);
+  }
+  _recordTrace (w->node, w->ignore_fmt, type, state, val);
+}
+
+void ActSimCore::_recordTrace (void * const *node, unsigned int ignore_fmt,
+			       int type, act_chan_state_t state,
+			       const BigInt &val)
+{
+  int kind, vlen;
+  
+  if (ignore_fmt == ~0U || _trace_detached) {
     return;
   }
   
@@ -2153,19 +3398,79 @@ void ActSimCore::recordTrace (const watchpt_bucket *w, int type,
 
   BigInt tm = SimDES::CurTime();
   int len = tm.getLen();
-  unsigned long v;
-  unsigned long *ptm;
-  if (len == 1) {
-    v = tm.getVal (0);
-    ptm = &v;
+
+  if (type == 0) {
+    kind = TRACE_REC_DIGITAL;
+    vlen = 1;
+  }
+  else if (type == 1) {
+    if (ACT_TRACE_WIDE_NUM (val.getWidth()) <= 1) {
+      kind = TRACE_REC_DIGITAL;
+      vlen = 1;
+    }
+    else {
+      kind = TRACE_REC_WDIGITAL;
+      vlen = val.getLen();
+    }
   }
   else {
-    MALLOC (ptm, unsigned long, len);
-    for (int i=0; i < len; i++) {
-      ptm[i] = tm.getVal (i);
+    Assert (type == 2, "What?");
+    if (ACT_TRACE_WIDE_NUM (val.getWidth()) > 1) {
+      kind = TRACE_REC_WCHAN;
+      vlen = ACT_TRACE_WIDE_NUM (val.getWidth());
+    }
+    else {
+      kind = TRACE_REC_CHAN;
+      vlen = 1;
     }
   }
-  
+
+  /*-- time and value go directly into the ring, or on the stack --*/
+  unsigned long tbuf[TRACE_SMALL_WORDS], vbuf[TRACE_SMALL_WORDS];
+  unsigned long *rec, *ptm, *valp;
+  unsigned long n = TRACE_REC_HDR + len + vlen;
+  int held = 0;
+
+  if (_trg_state == 2 && tm.getVal (0) > _trg_stop) {
+    /* trigger window closed */
+    _trg_state = 1;
+  }
+
+  rec = NULL;
+  if (_trg_state == 1) {
+    unsigned long now = tm.getVal (0);
+    _trw->trim (now >= _trg_pre ? now - _trg_pre : 0);
+    rec = _trw->reserve (n);
+    ptm = rec + TRACE_REC_HDR;
+    valp = ptm + len;
+    held = 1;
+  }
+  else if (_trq && n <= _trq->maxRecord()) {
+    rec = _trq->reserve (n);
+    ptm = rec + TRACE_REC_HDR;
+    valp = ptm + len;
+  }
+  else {
+    if (_trq) {
+      _trq->flush ();
+    }
+    if (len <= TRACE_SMALL_WORDS) {
+      ptm = tbuf;
+    }
+    else {
+      MALLOC (ptm, unsigned long, len);
+    }
+    if (vlen <= TRACE_SMALL_WORDS) {
+      valp = vbuf;
+    }
+    else {
+      MALLOC (valp, unsigned long, vlen);
+    }
+  }
+
+  for (int i=0; i < len; i++) {
+    ptm[i] = tm.getVal (i);
+  }
   if (type == 0) {
     int v = val.getVal (0);
     if (v == 0) {
@@ -2174,104 +3479,71 @@ void ActSimCore::recordTrace (const watchpt_bucket *w, int type,
     else if (v == 1) {
       v = ACT_SIG_BOOL_TRUE;
     }
-    else if (v == 2) {
-      v = ACT_SIG_BOOL_X;
-    }
-    for (int fmt=0; fmt < TRACE_NUM_FORMATS; fmt++) {
-      if (!((w->ignore_fmt >> fmt) & 1)) {
-	if (act_trace_has_alt (_trfn[fmt])) {
-	  act_trace_digital_change_alt (_tr[fmt], w->node[fmt],
-					len, ptm, v);
-	}
-	else {
-	  act_trace_digital_change (_tr[fmt], w->node[fmt], cur_time, v);
-	}
-      }
-    }
-  }
-  else if (type == 1) {
-    if (ACT_TRACE_WIDE_NUM (val.getWidth()) <= 1) {
-      for (int fmt=0; fmt < TRACE_NUM_FORMATS; fmt++) {
-	if (!((w->ignore_fmt >> fmt) & 1)) {
-	  if (act_trace_has_alt (_trfn[fmt])) {
-	    act_trace_digital_change_alt (_tr[fmt], w->node[fmt], len, ptm,
-					  val.getVal (0));
-	  }
-	  else {
-	    act_trace_digital_change (_tr[fmt], w->node[fmt], cur_time,
-				      val.getVal (0));
-	  }
-	}
-      }
-    }
-    else {
-      unsigned long *valp;
-      MALLOC (valp, unsigned long, val.getLen());
-      for (int i=0; i < val.getLen(); i++) {
+    else if (v == 2) {
+      v = ACT_SIG_BOOL_X;
+    }
+    valp[0] = v;
+  }
+  else {
+    for (int i=0; i < vlen; i++) {
+      if (i < val.getLen()) {
 	valp[i] = val.getVal (i);
       }
-      for (int fmt=0; fmt < TRACE_NUM_FORMATS; fmt++) {
-	if (!((w->ignore_fmt >> fmt) & 1)) {
-	  if (act_trace_has_alt (_trfn[fmt])) {
-	    act_trace_wide_digital_change_alt (_tr[fmt], w->node[fmt], len, ptm,
-					   val.getLen(), valp);
-	  }
-	  else {
-	    act_trace_wide_digital_change (_tr[fmt], w->node[fmt], cur_time,
-					   val.getLen(), valp);
-	  }
-	}
+      else {
+	valp[i] = 0;
       }
-      FREE (valp);
     }
   }
-  else if (type == 2) {
-    if (ACT_TRACE_WIDE_NUM (val.getWidth()) > 1) {
-      unsigned long *valp;
-      MALLOC (valp, unsigned long, ACT_TRACE_WIDE_NUM (val.getWidth()));
-      for (int i=0; i < ACT_TRACE_WIDE_NUM(val.getWidth()); i++) {
-	if (i < val.getLen()) {
-	  valp[i] = val.getVal (i);
-	}
-	else {
-	  valp[i] = 0;
-	}
-      }
-      for (int fmt = 0; fmt < TRACE_NUM_FORMATS; fmt++) {
-	if (!((w->ignore_fmt >> fmt) & 1)) {
-	  if (act_trace_has_alt (_trfn[fmt])) {
-	    act_trace_wide_chan_change_alt (_tr[fmt], w->node[fmt], len, ptm,
-					    state,
-					    ACT_TRACE_WIDE_NUM (val.getWidth()),
-					    valp);
-	  }
-	  else {
-	    act_trace_wide_chan_change (_tr[fmt], w->node[fmt], cur_time,
-					state,
-					ACT_TRACE_WIDE_NUM (val.getWidth()),
-					valp);
-	  }
-	}
-      }
-      FREE (valp);
+
+  if (rec) {
+    rec[0] = ((unsigned long)kind) | (((unsigned long)state) << 8) |
+      (((unsigned long)(ignore_fmt & 0xff)) << 16) |
+      (((unsigned long)len) << 24) | (((unsigned long)vlen) << 40);
+    rec[1] = 0;
+    memcpy (&rec[1], &cur_time, sizeof (float));
+    for (int i=0; i < TRACE_NUM_SLOTS; i++) {
+      rec[2+i] = (unsigned long) node[i];
+    }
+    if (held) {
+      _trw->commit (n);
     }
     else {
-      for (int fmt = 0; fmt < TRACE_NUM_FORMATS; fmt++) {
-	if (!((w->ignore_fmt >> fmt) & 1)) {
-	  if (act_trace_has_alt (_trfn[fmt])) {
-	    act_trace_chan_change_alt (_tr[fmt], w->node[fmt], len, ptm, state,
-				       val.getVal (0));
-	  }
-	  else {
-	    act_trace_chan_change (_tr[fmt], w->node[fmt], cur_time, state,
-				   val.getVal (0));
-	  }
-	}
-      }
+      _trq->commit (n);
+    }
+  }
+  else {
+    _writeTrace (node, ignore_fmt, kind, state, cur_time,
+		 len, ptm, vlen, valp);
+    if (ptm != tbuf) {
+      FREE (ptm);
+    }
+    if (valp != vbuf) {
+      FREE (valp);
     }
   }
-  if (len > 1) {
-    FREE (ptm);
+}
+
+/*
+ * Add a signal to an open trace; type is 0/1/2 for bool/int/chan.
+ * Native trace handles are the signal id + 1, so that NULL means no
+ * signal.
+ */
+void *ActSimCore::_traceAddSignal (int fmt, int type, const char *s, int width)
+{
+  if (fmt == TRACE_NATIVE) {
+    int id = _ntr->addSignal (type == 0 ? NATTRACE_BOOL :
+			      (type == 1 ? NATTRACE_INT : NATTRACE_CHAN),
+			      s, width);
+    return (void *) (long) (id + 1);
+  }
+  if (type == 0) {
+    return act_trace_add_signal (_tr[fmt], ACT_SIG_BOOL, s, 0);
+  }
+  else if (type == 1) {
+    return act_trace_add_signal (_tr[fmt], ACT_SIG_INT, s, width);
+  }
+  else {
+    return act_trace_add_signal (_tr[fmt], ACT_SIG_CHAN, s, width);
   }
 }
 
@@ -2280,14 +3552,31 @@ int ActSimCore::initTrace (int fmt, const char *file)
   double cur_time = curTimeMetricUnits ();
   double tm = cur_time + 1;
 
-  Assert (0 <= fmt && fmt < TRACE_NUM_FORMATS, "Illegal format!");
+  Assert (0 <= fmt && fmt < TRACE_NUM_SLOTS, "Illegal format!");
+
+  if (_trace_detached) {
+    warning ("Tracing is not available in a branch or ensemble run");
+    return 0;
+  }
+
+  /* the writer thread must be idle before the trace files change */
+  flushTrace ();
+  if (_trw) {
+    _trw->clear ();
+  }
 
-  if (_tr[fmt]) {
+  if (fmt == TRACE_NATIVE) {
+    if (_ntr) {
+      delete _ntr;
+      _ntr = NULL;
+    }
+  }
+  else if (_tr[fmt]) {
     act_trace_close (_tr[fmt]);
+    _tr[fmt] = NULL;
   }
+  _watchall_close (fmt);
   if (!file) {
-    _tr[fmt] = NULL;
-
     if (_W) {
       ihash_bucket_t *b;
       watchpt_bucket *w;
@@ -2302,32 +3591,43 @@ int ActSimCore::initTrace (int fmt, const char *file)
     return 1;
   }
 
-  if (!_trfn[fmt]) {
-    _trfn[fmt] = act_trace_load_format (_trname[fmt], NULL);
-  }
-  if (!_trfn[fmt]) {
-    return 0;
-  }
-  if (!act_trace_fmt_has_writer (_trfn[fmt])) {
-    act_trace_close_format (_trfn[fmt]);
-    _trfn[fmt] = NULL;
-    return 0;
+  if (fmt == TRACE_NATIVE) {
+    _ntr = NatTraceWriter::create (file, _int_to_float_timescale);
+    if (!_ntr) {
+      return 0;
+    }
   }
+  else {
+    if (!_trfn[fmt]) {
+      _trfn[fmt] = act_trace_load_format (_trname[fmt], NULL);
+    }
+    if (!_trfn[fmt]) {
+      return 0;
+    }
+    if (!act_trace_fmt_has_writer (_trfn[fmt])) {
+      act_trace_close_format (_trfn[fmt]);
+      _trfn[fmt] = NULL;
+      return 0;
+    }
 
-  _tr[fmt] = act_trace_create (_trfn[fmt], file, tm, _int_to_float_timescale,
-			       act_trace_has_alt (_trfn[fmt]) ? 1 : 0);
+    _tr[fmt] = act_trace_create (_trfn[fmt], file, tm,
+				 _int_to_float_timescale,
+				 act_trace_has_alt (_trfn[fmt]) ? 1 : 0);
   
-  if (!_tr[fmt]) {
-    return 0;
+    if (!_tr[fmt]) {
+      return 0;
+    }
   }
   
-  if (_W) {
+  if (_W || _wa_roots) {
     ihash_bucket_t *b;
     watchpt_bucket *w;
     ihash_iter_t it;
 
-    ihash_iter_init (_W, &it);
-    while ((b = ihash_iter_next (_W, &it))) {
+    if (_W) {
+      ihash_iter_init (_W, &it);
+    }
+    while (_W && (b = ihash_iter_next (_W, &it))) {
       unsigned long off = b->key;
       int type = off & 0x3;
       off >>= 2;
@@ -2335,17 +3635,42 @@ int ActSimCore::initTrace (int fmt, const char *file)
       w = (watchpt_bucket *) b->v;
       w->ignore_fmt &= ~(1 << fmt);
       if (type == 0) {
-	w->node[fmt] = act_trace_add_signal (_tr[fmt], ACT_SIG_BOOL, w->s, 0);
+	w->node[fmt] = _traceAddSignal (fmt, 0, w->s, 0);
       }
       else if (type == 1) {
 	BigInt *tmp = getInt (off);
-	w->node[fmt] = act_trace_add_signal (_tr[fmt], ACT_SIG_INT, w->s,
-					     tmp->getWidth());
+	w->node[fmt] = _traceAddSignal (fmt, 1, w->s, tmp->getWidth());
       }
       else if (type == 2) {
 	act_channel_state *ch = getChan (off);
-	w->node[fmt] = act_trace_add_signal (_tr[fmt], ACT_SIG_CHAN, w->s,
-					     ch->width);
+	w->node[fmt] = _traceAddSignal (fmt, 2, w->s, ch->width);
+      }
+    }
+    if (_wa_roots) {
+      /* names for bulk watchpoints are only created here */
+      bitset_t *seen[2];
+      seen[0] = nint_start > 0 ? bitset_new (nint_start) : NULL;
+      seen[1] = nfo_len > nint_start ? bitset_new (nfo_len - nint_start) : NULL;
+      if (nint_start > 0) {
+	MALLOC (_wa_node[fmt][0], void *, nint_start);
+	for (int i=0; i < nint_start; i++) {
+	  _wa_node[fmt][0][i] = NULL;
+	}
+      }
+      if (nfo_len > nint_start) {
+	MALLOC (_wa_node[fmt][1], void *, nfo_len - nint_start);
+	for (int i=0; i < nfo_len - nint_start; i++) {
+	  _wa_node[fmt][1][i] = NULL;
+	}
+      }
+      _wa_names[fmt] = list_new ();
+      for (listitem_t *li = list_first (_wa_roots); li; li = list_next (li)) {
+	_watchall_walk ((ActInstTable *) list_value (li), fmt, seen);
+      }
+      for (int i=0; i < 2; i++) {
+	if (seen[i]) {
+	  bitset_free (seen[i]);
+	}
       }
     }
 
@@ -2354,6 +3679,8 @@ int ActSimCore::initTrace (int fmt, const char *file)
     int tmlen = tm.getLen ();
     unsigned long tmpv;
     unsigned long *ptm;
+    void *node[TRACE_NUM_SLOTS];
+    unsigned int ignore = ~(1U << fmt);
     if (tmlen == 1) {
       tmpv = tm.getVal (0);
       ptm = &tmpv;
@@ -2364,17 +3691,25 @@ int ActSimCore::initTrace (int fmt, const char *file)
 	ptm[i] = tm.getVal (i);
       }
     }
-    
-    act_trace_init_start (_tr[fmt]);
-    ihash_iter_init (_W, &it);
-    while ((b = ihash_iter_next (_W, &it))) {
+    for (int i=0; i < TRACE_NUM_SLOTS; i++) {
+      node[i] = NULL;
+    }
+
+    if (fmt != TRACE_NATIVE) {
+      act_trace_init_start (_tr[fmt]);
+    }
+    if (_W) {
+      ihash_iter_init (_W, &it);
+    }
+    while (_W && (b = ihash_iter_next (_W, &it))) {
       unsigned long off = b->key;
       int type = off & 0x3;
       off >>= 2;
 
       w = (watchpt_bucket *) b->v;
+      node[fmt] = w->node[fmt];
       if (type == 0) {
-	int v = getBool (off);
+	unsigned long v = getBool (off);
 	if (v == 0) {
 	  v = ACT_SIG_BOOL_FALSE;
 	}
@@ -2384,24 +3719,15 @@ int ActSimCore::initTrace (int fmt, const char *file)
 	else if (v == 2) {
 	  v = ACT_SIG_BOOL_X;
 	}
-	if (act_trace_has_alt (_trfn[fmt])) {
-	  act_trace_digital_change_alt (_tr[fmt], w->node[fmt], tmlen, ptm, v);
-	}
-	else {
-	  act_trace_digital_change (_tr[fmt], w->node[fmt], cur_time, v);
-	}
+	_writeTrace (node, ignore, TRACE_REC_DIGITAL, ACT_CHAN_IDLE,
+		     cur_time, tmlen, ptm, 1, &v);
       }
       else if (type == 1) {
 	BigInt *tmp = getInt (off);
 	if (ACT_TRACE_WIDE_NUM (tmp->getWidth()) <= 1) {
-	  if (act_trace_has_alt (_trfn[fmt])) {
-	    act_trace_digital_change_alt (_tr[fmt], w->node[fmt], tmlen, ptm,
-				      tmp->getVal (0));
-	  }
-	  else {
-	    act_trace_digital_change (_tr[fmt], w->node[fmt], cur_time,
-				      tmp->getVal (0));
-	  }
+	  unsigned long v = tmp->getVal (0);
+	  _writeTrace (node, ignore, TRACE_REC_DIGITAL, ACT_CHAN_IDLE,
+		       cur_time, tmlen, ptm, 1, &v);
 	}
 	else {
 	  unsigned long *v;
@@ -2409,15 +3735,8 @@ int ActSimCore::initTrace (int fmt, const char *file)
 	  for (int i=0; i < tmp->getLen(); i++) {
 	    v[i] = tmp->getVal (i);
 	  }
-	  if (act_trace_has_alt (_trfn[fmt])) {
-	    act_trace_wide_digital_change_alt (_tr[fmt], w->node[fmt],
-					       tmlen, ptm, 
-					       tmp->getLen(), v);
-	  }
-	  else {
-	    act_trace_wide_digital_change (_tr[fmt], w->node[fmt], cur_time,
-					   tmp->getLen(), v);
-	  }
+	  _writeTrace (node, ignore, TRACE_REC_WDIGITAL, ACT_CHAN_IDLE,
+		       cur_time, tmlen, ptm, tmp->getLen(), v);
 	  FREE (v);
 	}
       }
@@ -2439,39 +3758,340 @@ int ActSimCore::initTrace (int fmt, const char *file)
 	  for (int i=0; i < ACT_TRACE_WIDE_NUM(ch->width); i++) {
 	    v[i] = 0;
 	  }
-	  if (act_trace_has_alt (_trfn[fmt])) {
-	    act_trace_wide_chan_change_alt (_tr[fmt], w->node[fmt],
-					    tmlen, ptm, state,
-					    ACT_TRACE_WIDE_NUM (ch->width), v);
-	  }
-	  else {
-	    act_trace_wide_chan_change (_tr[fmt], w->node[fmt], cur_time,
-					state, ACT_TRACE_WIDE_NUM (ch->width),
-					v);
-	  }
+	  _writeTrace (node, ignore, TRACE_REC_WCHAN, state, cur_time,
+		       tmlen, ptm, ACT_TRACE_WIDE_NUM (ch->width), v);
 	  FREE (v);
 	}
 	else {
-	  if (act_trace_has_alt (_trfn[fmt])) {
-	    act_trace_chan_change_alt (_tr[fmt], w->node[fmt], tmlen, ptm,
-				       state, 0);
-	  }
-	  else {
-	    act_trace_chan_change (_tr[fmt], w->node[fmt], cur_time, state, 0);
-	  }
+	  unsigned long v = 0;
+	  _writeTrace (node, ignore, TRACE_REC_CHAN, state, cur_time,
+		       tmlen, ptm, 1, &v);
 	}
       }
     }
+    _watchall_values (fmt, tmlen, ptm, cur_time);
     if (tmlen > 1) {
       FREE (ptm);
     }
-    act_trace_init_end (_tr[fmt]);
+    if (fmt != TRACE_NATIVE) {
+      act_trace_init_end (_tr[fmt]);
+    }
   }
   return 1;
 }
 
 
 
+/*
+ * Bulk watchpoints.
+ *
+ *  fmt == -1 : mark the locals of every object in the subtree
+ *  otherwise : add trace signals for marked locals to format fmt
+ *
+ * Each global offset is local to exactly one simulation object, so
+ * names are taken from the object that owns the offset.
+ */
+int ActSimCore::_watchall_walk (ActInstTable *t, int fmt, bitset_t **seen)
+{
+  int count = 0;
+  
+  if (!t) {
+    return 0;
+  }
+  if (t->obj && t->obj->getProc()) {
+    ActSimObj *o = t->obj;
+    stateinfo_t *si = sp->getStateInfo (o->getProc());
+    if (si) {
+      int n[2];
+      n[0] = si->local.numAllBools();
+      n[1] = si->local.numInts();
+      for (int type=0; type < 2; type++) {
+	for (int k=0; k < n[type]; k++) {
+	  int g = o->getGlobalOffset (k, type);
+	  if (fmt == -1) {
+	    if (!bitset_tst (_wa_bits[type], g)) {
+	      bitset_set (_wa_bits[type], g);
+	      count++;
+	    }
+	    continue;
+	  }
+	  if (!bitset_tst (_wa_bits[type], g) || bitset_tst (seen[type], g)) {
+	    continue;
+	  }
+	  bitset_set (seen[type], g);
+	  if (chkWatchPt (type, g)) {
+	    /* traced by its own watchpoint */
+	    continue;
+	  }
+
+	  char buf[1024];
+	  int pos = 0;
+	  int dx;
+	  act_connection *c = getConnFromOffset (o->getProc(), k, type, &dx);
+	  if (!c) {
+	    continue;
+	  }
+	  buf[0] = '\0';
+	  if (o->getName()) {
+	    o->getName()->sPrint (buf, 1020);
+	    pos = strlen (buf);
+	    buf[pos++] = '.';
+	    buf[pos] = '\0';
+	  }
+	  ActId *tid = c->toid();
+	  tid->sPrint (buf + pos, 1024 - pos);
+	  delete tid;
+	  if (dx != -1) {
+	    pos = strlen (buf);
+	    snprintf (buf + pos, 1024 - pos, "[%d]", dx);
+	  }
+
+	  char *s = Strdup (buf);
+	  list_append (_wa_names[fmt], s);
+	  _wa_node[fmt][type][g] =
+	    _traceAddSignal (fmt, type, s, type == 0 ? 0 : getInt (g)->getWidth());
+	  count++;
+	}
+      }
+    }
+  }
+  if (t->H) {
+    hash_bucket_t *b;
+    hash_iter_t it;
+    hash_iter_init (t->H, &it);
+    while ((b = hash_iter_next (t->H, &it))) {
+      count += _watchall_walk ((ActInstTable *) b->v, fmt, seen);
+    }
+  }
+  return count;
+}
+
+void ActSimCore::_watchall_init ()
+{
+  if (!_wa_bits[0] && nint_start > 0) {
+    _wa_bits[0] = bitset_new (nint_start);
+  }
+  if (!_wa_bits[1] && nfo_len > nint_start) {
+    _wa_bits[1] = bitset_new (nfo_len - nint_start);
+  }
+}
+
+int ActSimCore::addWatchAll (ActInstTable *t)
+{
+  if (!_wa_roots) {
+    _wa_roots = list_new ();
+  }
+  _watchall_init ();
+  list_append (_wa_roots, t);
+  return _watchall_walk (t, -1, NULL);
+}
+
+/*
+ * Report changes to a single node to the change hook without adding
+ * a watchpoint.
+ */
+void ActSimCore::addWatchBit (int type, unsigned long off)
+{
+  _watchall_init ();
+  if (type == 0 && _wa_bits[0] && off < (unsigned long)nint_start) {
+    bitset_set (_wa_bits[0], off);
+  }
+  else if (type == 1 && _wa_bits[1] && off < (unsigned long)(nfo_len - nint_start)) {
+    bitset_set (_wa_bits[1], off);
+  }
+}
+
+void ActSimCore::setChangeHook (act_change_hook_t fn, void *cookie)
+{
+  _chg_fn = fn;
+  _chg_cookie = cookie;
+}
+
+void ActSimCore::recordTraceAll (int type, unsigned long off,
+				 const BigInt &val)
+{
+  void *node[TRACE_NUM_SLOTS];
+  unsigned int ignore = ~0U;
+
+  if (_chg_fn) {
+    (*_chg_fn) (_chg_cookie, type, off, val);
+  }
+  for (int fmt=0; fmt < TRACE_NUM_SLOTS; fmt++) {
+    node[fmt] = NULL;
+    if (_wa_node[fmt][type] && _wa_node[fmt][type][off]) {
+      node[fmt] = _wa_node[fmt][type][off];
+      ignore &= ~(1U << fmt);
+    }
+  }
+  if (_T) {
+    _chkTrigger (((unsigned long)type) | (off << 2), val);
+  }
+  _recordTrace (node, ignore, type, ACT_CHAN_IDLE, val);
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Trigger-gated tracing
+ *
+ *------------------------------------------------------------------------
+ */
+void ActSimCore::setTraceWindow (unsigned long pre, unsigned long post)
+{
+  if (!_trw) {
+    _trw = new ActSimTraceWindow (this);
+  }
+  _trg_pre = pre;
+  _trg_post = post;
+  if (_trg_state == 0) {
+    _trg_state = 1;
+  }
+}
+
+void ActSimCore::addTrigger (int type, unsigned long off, unsigned long val)
+{
+  ihash_bucket_t *b;
+  unsigned long key;
+
+  if (type == 3) { type = 2; }
+  key = ((unsigned long)type) | (off << 2);
+  if (!_T) {
+    _T = ihash_new (4);
+  }
+  b = ihash_lookup (_T, key);
+  if (!b) {
+    b = ihash_add (_T, key);
+  }
+  b->v = (void *) val;
+}
+
+void ActSimCore::clearTriggers ()
+{
+  if (_T) {
+    ihash_free (_T);
+    _T = NULL;
+  }
+  _trg_warn = 0;
+  _trg_state = 0;
+  if (_trw) {
+    _trw->clear ();
+  }
+}
+
+/*
+ * Triggers on channels compare the completed action count; others
+ * compare the new value.
+ */
+void ActSimCore::_chkTrigger (unsigned long key, const BigInt &val)
+{
+  ihash_bucket_t *b = ihash_lookup (_T, key);
+  if (!b) {
+    return;
+  }
+  if ((key & 3) == 2) {
+    if (getChan (key >> 2)->count != (unsigned long) b->v) {
+      return;
+    }
+  }
+  else if (val.getVal (0) != (unsigned long) b->v) {
+    return;
+  }
+  _traceTrigger ();
+}
+
+void ActSimCore::_traceTrigger ()
+{
+  unsigned long now;
+
+  if (_trg_state == 0) {
+    return;
+  }
+  now = SimDES::CurTime().getVal (0);
+  if (_trg_state == 1) {
+    _trw->replay (now >= _trg_pre ? now - _trg_pre : 0);
+    _trg_state = 2;
+    _trg_stop = now + _trg_post;
+  }
+  else if (now + _trg_post > _trg_stop) {
+    _trg_stop = now + _trg_post;
+  }
+}
+
+void ActSimCore::_watchall_close (int fmt)
+{
+  for (int i=0; i < 2; i++) {
+    if (_wa_node[fmt][i]) {
+      FREE (_wa_node[fmt][i]);
+      _wa_node[fmt][i] = NULL;
+    }
+  }
+  if (_wa_names[fmt]) {
+    for (listitem_t *li = list_first (_wa_names[fmt]); li;
+	 li = list_next (li)) {
+      FREE (list_value (li));
+    }
+    list_free (_wa_names[fmt]);
+    _wa_names[fmt] = NULL;
+  }
+}
+
+/*
+ * Initial values for bulk watchpoints; called between
+ * act_trace_init_start and act_trace_init_end
+ */
+void ActSimCore::_watchall_values (int fmt, int tmlen, unsigned long *ptm,
+				   float cur_time)
+{
+  void *node[TRACE_NUM_SLOTS];
+  unsigned int ignore = ~0U & ~(1U << fmt);
+
+  for (int i=0; i < TRACE_NUM_SLOTS; i++) {
+    node[i] = NULL;
+  }
+  if (_wa_node[fmt][0]) {
+    for (int g=0; g < nint_start; g++) {
+      if (!_wa_node[fmt][0][g]) continue;
+      unsigned long v = getBool (g);
+      if (v == 0) {
+	v = ACT_SIG_BOOL_FALSE;
+      }
+      else if (v == 1) {
+	v = ACT_SIG_BOOL_TRUE;
+      }
+      else {
+	v = ACT_SIG_BOOL_X;
+      }
+      node[fmt] = _wa_node[fmt][0][g];
+      _writeTrace (node, ignore, TRACE_REC_DIGITAL, ACT_CHAN_IDLE, cur_time,
+		   tmlen, ptm, 1, &v);
+    }
+  }
+  if (_wa_node[fmt][1]) {
+    for (int g=0; g < nfo_len - nint_start; g++) {
+      if (!_wa_node[fmt][1][g]) continue;
+      BigInt *tmp = getInt (g);
+      node[fmt] = _wa_node[fmt][1][g];
+      if (ACT_TRACE_WIDE_NUM (tmp->getWidth()) <= 1) {
+	unsigned long v = tmp->getVal (0);
+	_writeTrace (node, ignore, TRACE_REC_DIGITAL, ACT_CHAN_IDLE,
+		     cur_time, tmlen, ptm, 1, &v);
+      }
+      else {
+	unsigned long *v;
+	MALLOC (v, unsigned long, tmp->getLen());
+	for (int i=0; i < tmp->getLen(); i++) {
+	  v[i] = tmp->getVal (i);
+	}
+	_writeTrace (node, ignore, TRACE_REC_WDIGITAL, ACT_CHAN_IDLE,
+		     cur_time, tmlen, ptm, tmp->getLen(), v);
+	FREE (v);
+      }
+    }
+  }
+}
+
+
+
 /*------------------------------------------------------------------------
  *
  *  API to check for fragmentation. A "fragmented" channel/etc. are
@@ -3005,8 +4625,50 @@ void ActSimCore::_add_multidrivers (Process *p, int booloffset, int *ports)
 	if (!gb) {
 	  gb = ihash_add (_global_multi, gid);
 	  gb->v = new MultiPrsSim (ib->i);
+	  actsim_objcount.multi++;
 	}
       }
     }
   }
 }
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Channel token recording
+ *
+ *------------------------------------------------------------------------
+ */
+int ActSimCore::tokenRecordStart (const char *file, int nports,
+				  struct chantok_port *ports)
+{
+  tokenRecordStop ();
+  _tok_rec = ChanTokenWriter::create (file, nports, ports);
+  return _tok_rec ? 1 : 0;
+}
+
+void ActSimCore::tokenRecordStop ()
+{
+  if (_tok_rec) {
+    delete _tok_rec;
+    _tok_rec = NULL;
+  }
+}
+
+/*
+ * Attach replay stubs to all ports that have been mapped to a channel
+ */
+void ActSimCore::tokenReplay (struct chantok_port *ports)
+{
+  list_append (_tok_tables, ports);
+  for (int i=0; ports[i].name; i++) {
+    if (ports[i].goff != -1) {
+      list_append (_tok_replay, new ChanReplay (this, &ports[i]));
+    }
+  }
+}
+
+void ActSimCore::_recordToken (int goff, expr_multires &v)
+{
+  _tok_rec->token (goff, v);
+}
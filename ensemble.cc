@@ -0,0 +1,198 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2026 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "ensemble.h"
+#include "chpsim.h"
+
+/* all CHP processes, in instance table order (identical after fork) */
+static void _collect_chp (ActInstTable *t, list_t *l)
+{
+  if (t->obj) {
+    ChpSim *c = dynamic_cast<ChpSim *> (t->obj);
+    if (c && c->numStats() > 0) {
+      list_append (l, c);
+    }
+  }
+  if (t->H) {
+    hash_bucket_t *b;
+    hash_iter_t i;
+    hash_iter_init (t->H, &i);
+    while ((b = hash_iter_next (t->H, &i))) {
+      _collect_chp ((ActInstTable *) b->v, l);
+    }
+  }
+}
+
+static char *_ens_file (const char *prefix, unsigned seed, const char *sfx)
+{
+  char *buf;
+  int len = strlen (prefix) + strlen (sfx) + 16;
+  MALLOC (buf, char, len);
+  snprintf (buf, len, "%s.%u.%s", prefix, seed, sfx);
+  return buf;
+}
+
+static void _ens_child (ActSim *sim, unsigned seed, const char *prefix,
+			int (*run) (void *), void *cookie, list_t *chp)
+{
+  char *fname;
+  int fd, ret;
+  listitem_t *li;
+
+  sim->detachTrace ();
+  fname = _ens_file (prefix, seed, "log");
+  fd = open (fname, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+  FREE (fname);
+  if (fd < 0) {
+    _exit (3);
+  }
+  dup2 (fd, 1);
+  dup2 (fd, 2);
+  close (fd);
+
+  sim->setRandomSeed (seed);
+  ret = (*run) (cookie);
+  fflush (stdout);
+  fflush (stderr);
+
+  /* coverage counts back to the parent */
+  fname = _ens_file (prefix, seed, "cov");
+  FILE *fp = fopen (fname, "wb");
+  FREE (fname);
+  if (fp) {
+    for (li = list_first (chp); li; li = list_next (li)) {
+      ChpSim *c = (ChpSim *) list_value (li);
+      fwrite (c->getStats(), sizeof (unsigned long), c->numStats(), fp);
+    }
+    fclose (fp);
+  }
+  if (ret != 0) {
+    _exit (1);
+  }
+  _exit (sim->numWarnings() > 0 ? 1 : 0);
+}
+
+static void _ens_merge (const char *prefix, unsigned seed, list_t *chp)
+{
+  char *fname = _ens_file (prefix, seed, "cov");
+  FILE *fp = fopen (fname, "rb");
+  listitem_t *li;
+
+  if (fp) {
+    for (li = list_first (chp); li; li = list_next (li)) {
+      ChpSim *c = (ChpSim *) list_value (li);
+      unsigned long *s = c->getStats ();
+      for (int i=0; i < c->numStats(); i++) {
+	unsigned long v;
+	if (fread (&v, sizeof (unsigned long), 1, fp) != 1) {
+	  break;
+	}
+	s[i] += v;
+      }
+    }
+    fclose (fp);
+    unlink (fname);
+  }
+  FREE (fname);
+}
+
+int actsim_ensemble (ActSim *sim, int n, int jobs, unsigned seed0,
+		     const char *prefix,
+		     int (*run) (void *), void *cookie,
+		     unsigned *first_fail)
+{
+  pid_t *pids;
+  int running = 0, started = 0, nfail = 0;
+  list_t *chp;
+
+  if (n <= 0 || jobs <= 0) {
+    return -1;
+  }
+  chp = list_new ();
+  _collect_chp (sim->getInstTable(), chp);
+
+  MALLOC (pids, pid_t, n);
+
+  /* nothing buffered may be inherited by the children */
+  sim->flushTrace ();
+  fflush (NULL);
+
+  while (started < n || running > 0) {
+    while (started < n && running < jobs) {
+      pid_t p = fork ();
+      if (p < 0) {
+	warning ("ensemble: fork failed (%s)", strerror (errno));
+	break;
+      }
+      if (p == 0) {
+	_ens_child (sim, seed0 + started, prefix, run, cookie, chp);
+      }
+      pids[started++] = p;
+      running++;
+    }
+    if (running == 0) {
+      /* fork failed with nothing left to wait for */
+      nfail += n - started;
+      break;
+    }
+
+    int status;
+    pid_t p = wait (&status);
+    if (p < 0) {
+      if (errno == EINTR) {
+	continue;
+      }
+      break;
+    }
+    int idx;
+    for (idx=0; idx < started; idx++) {
+      if (pids[idx] == p) break;
+    }
+    if (idx == started) {
+      continue;
+    }
+    running--;
+    unsigned seed = seed0 + idx;
+    _ens_merge (prefix, seed, chp);
+    if (!WIFEXITED (status) || WEXITSTATUS (status) != 0) {
+      if (nfail == 0 || seed < *first_fail) {
+	*first_fail = seed;
+      }
+      nfail++;
+      printf ("ensemble: seed %u failed", seed);
+      if (WIFSIGNALED (status)) {
+	printf (" (signal %d)", WTERMSIG (status));
+      }
+      else {
+	printf (" (exit %d)", WEXITSTATUS (status));
+      }
+      printf ("; see %s.%u.log\n", prefix, seed);
+    }
+  }
+  FREE (pids);
+  list_free (chp);
+  return nfail;
+}
@@ -0,0 +1,46 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2026 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#ifndef __ACTSIM_ENSEMBLE_H__
+#define __ACTSIM_ENSEMBLE_H__
+
+#include "actsim.h"
+
+/*
+ * Run `n' copies of the simulation from its current state, each in a
+ * forked child with random seed seed0 + i, at most `jobs' at a time.
+ * The elaborated design is shared copy-on-write.
+ *
+ * Each child calls run(cookie) with stdout and stderr sent to
+ * <prefix>.<seed>.log, and passes if run returns 0, it exits
+ * normally, and no warnings were reported. CHP guard coverage counts
+ * from all children are added into the parent's processes, so the
+ * `coverage' command reports their union.
+ *
+ * Returns the number of failed runs, or -1 on error; *first_fail is
+ * the lowest failing seed.
+ */
+int actsim_ensemble (ActSim *sim, int n, int jobs, unsigned seed0,
+		     const char *prefix,
+		     int (*run) (void *), void *cookie,
+		     unsigned *first_fail);
+
+#endif /* __ACTSIM_ENSEMBLE_H__ */
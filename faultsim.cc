@@ -0,0 +1,160 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2026 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <stdio.h>
+#include "faultsim.h"
+#include "prslane.h"
+#include "prssim.h"
+
+struct fault {
+  int gid;
+  int kind;
+  int det;			// vector that detected it, or -1
+};
+
+static const char *_fault_names[] = { "sa0", "sa1", "str", "stf" };
+
+static void _fault_print (FILE *fp, PrsLaneSim *ls, fault *f)
+{
+  char buf[1024];
+  int pos = 0;
+  OnePrsSim *r = ls->getDriver (f->gid);
+  PrsSim *p = r->getPrsSim ();
+
+  buf[0] = '\0';
+  if (p->getName ()) {
+    p->getName()->sPrint (buf, sizeof (buf));
+    pos = strlen (buf);
+    if (pos < (int)sizeof (buf) - 1) {
+      buf[pos++] = '.';
+    }
+  }
+  p->sPrintName (buf + pos, sizeof (buf) - pos, r->getStmt()->vid);
+  fprintf (fp, "%s %s ", buf, _fault_names[f->kind]);
+  if (f->det >= 0) {
+    fprintf (fp, "detected %d\n", f->det + 1);
+  }
+  else {
+    fprintf (fp, "undetected\n");
+  }
+}
+
+int actsim_faultsim (ActSim *sim, int kinds,
+		     int nin, int *ins, int nout, int *outs,
+		     int nvec, const char *vecs,
+		     FILE *report, int *ndet)
+{
+  PrsLaneSim *ls = new PrsLaneSim (sim);
+  A_DECL (fault, f);
+  int nf;
+
+  if (!ls->isValid ()) {
+    warning ("faultsim: pass transistors are not supported");
+    delete ls;
+    return -1;
+  }
+  A_INIT (f);
+  for (int i=0; i < ls->numNodes(); i++) {
+    for (int k=0; k < FAULT_NUM; k++) {
+      if (kinds & (1 << k)) {
+	A_NEW (f, fault);
+	A_NEXT (f).gid = ls->getNode (i);
+	A_NEXT (f).kind = k;
+	A_NEXT (f).det = -1;
+	A_INC (f);
+      }
+    }
+  }
+  nf = A_LEN (f);
+  *ndet = 0;
+
+  /* PRS_LANES-1 faults at a time; lane 0 is fault-free */
+  for (int b=0; b < nf; b += PRS_LANES-1) {
+    int nb = (nf - b < PRS_LANES-1 ? nf - b : PRS_LANES-1);
+    unsigned long live = 0;
+
+    ls->clearForces ();
+    ls->loadState ();
+    for (int j=0; j < nb; j++) {
+      unsigned long bit = 1UL << (j+1);
+      live |= bit;
+      if (f[b+j].kind == FAULT_SA0 || f[b+j].kind == FAULT_SA1) {
+	ls->forceLanes (f[b+j].gid, bit, f[b+j].kind == FAULT_SA0 ? 0 : 1);
+      }
+    }
+    ls->touchAll ();
+
+    for (int v=0; v < nvec && live; v++) {
+      const char *vec = vecs + v*nin;
+
+      /* transition faults hold their node for this vector */
+      for (int j=0; j < nb; j++) {
+	int k = f[b+j].kind;
+	if ((k == FAULT_STR || k == FAULT_STF) && (live & (1UL << (j+1)))) {
+	  int cur = ls->getLane (f[b+j].gid, j+1);
+	  if ((k == FAULT_STR && cur == 0) || (k == FAULT_STF && cur == 1)) {
+	    ls->forceLanes (f[b+j].gid, 1UL << (j+1), cur);
+	  }
+	}
+      }
+      for (int i=0; i < nin; i++) {
+	ls->setLanes (ins[i], ~0UL, vec[i]);
+      }
+      ls->run ();
+
+      for (int i=0; i < nout; i++) {
+	int g = ls->getLane (outs[i], 0);
+	unsigned long diff;
+	if (g == 2) continue;
+	diff = ls->getMask (outs[i], 1 - g) & live;
+	for (int j=0; j < nb && diff; j++) {
+	  if (diff & (1UL << (j+1))) {
+	    f[b+j].det = v;
+	    (*ndet)++;
+	  }
+	}
+	live &= ~diff;
+      }
+
+      /* release the holds, and let the slow nodes catch up */
+      int held = 0;
+      for (int j=0; j < nb; j++) {
+	int k = f[b+j].kind;
+	if (k == FAULT_STR || k == FAULT_STF) {
+	  ls->forceLanes (f[b+j].gid, 1UL << (j+1), -1);
+	  held = 1;
+	}
+      }
+      if (held) {
+	ls->run ();
+      }
+    }
+  }
+
+  if (report) {
+    for (int i=0; i < nf; i++) {
+      _fault_print (report, ls, &f[i]);
+    }
+  }
+  A_FREE (f);
+  delete ls;
+  return nf;
+}
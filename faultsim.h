@@ -0,0 +1,61 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2026 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#ifndef __ACTSIM_FAULTSIM_H__
+#define __ACTSIM_FAULTSIM_H__
+
+#include "actsim.h"
+
+/*
+ * Fault simulation of the production rules, using the lanes of
+ * PrsLaneSim: lane 0 is the good circuit, and every other lane has one
+ * fault on the output of a production rule. Stuck-at faults hold the
+ * node at 0 or 1. A slow-to-rise (fall) node cannot rise (fall) while
+ * a vector is applied, and catches up on the next one.
+ *
+ * The vectors are applied in order from the current state. A fault is
+ * detected, and dropped, at the first vector where an observed node
+ * is 0/1 in the good circuit and the opposite value with the fault.
+ */
+#define FAULT_SA0 0
+#define FAULT_SA1 1
+#define FAULT_STR 2
+#define FAULT_STF 3
+#define FAULT_NUM 4
+
+#define FAULT_STUCK ((1 << FAULT_SA0)|(1 << FAULT_SA1))
+#define FAULT_TRANS ((1 << FAULT_STR)|(1 << FAULT_STF))
+
+/*
+ * kinds: mask of fault types
+ * ins/outs: global Boolean offsets of the inputs and observed nodes
+ * vecs: nvec x nin values, 0, 1, or 2 (X)
+ * report: if not NULL, one line per fault
+ *
+ * Returns the number of faults, or -1 on error; *ndet is the number
+ * that were detected.
+ */
+int actsim_faultsim (ActSim *sim, int kinds,
+		     int nin, int *ins, int nout, int *outs,
+		     int nvec, const char *vecs,
+		     FILE *report, int *ndet);
+
+#endif /* __ACTSIM_FAULTSIM_H__ */
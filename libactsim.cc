@@ -0,0 +1,508 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2026 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <stdio.h>
+#include <string.h>
+#include <act/act.h>
+#include <act/passes.h>
+#include <common/config.h>
+#include "actsim.h"
+#include "chpsim.h"
+#include "libactsim.h"
+
+/*
+ * Globals that are provided by the command-line interface when actsim
+ * is built as an executable.
+ */
+ActSim *glob_sim;
+int debug_metrics;
+
+static Act *lib_act;
+static Process *lib_top;
+static ActStatePass *lib_sp;
+
+Act *actsim_Act()
+{
+  return lib_act;
+}
+
+Process *actsim_top()
+{
+  return lib_top;
+}
+
+int is_rand_excl()
+{
+  return glob_sim->isRandomChoice();
+}
+
+/* cause for changes made by the application */
+class LibEnvObject : public ActSimDES {
+ public:
+  LibEnvObject() { gid = -1; }
+  ~LibEnvObject() { }
+
+  int Step (Event *ev) { return 1; }
+  int causeGlobalIdx() { return gid; }
+  void setGid (int id) { gid = id; }
+  void sPrintCause (char *buf, int sz) { snprintf (buf, sz, "-lib-"); }
+
+ private:
+  int gid;
+};
+
+static LibEnvObject *lib_env;
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Handles
+ *
+ *------------------------------------------------------------------------
+ */
+struct lib_handle {
+  int type;			// global type
+  int goff;			// global offset
+  actsim_lib_cb_t fn;		// watch callback
+  void *cookie;
+};
+
+static struct Hashtable *lib_names = NULL;	// name -> handle
+static struct iHashtable *lib_watch = NULL;	// node -> list of handles
+static struct lib_handle *lib_h = NULL;
+static int lib_nh = 0, lib_maxh = 0;
+
+static void _clear_handles ()
+{
+  if (lib_names) {
+    hash_free (lib_names);
+    lib_names = NULL;
+  }
+  if (lib_watch) {
+    ihash_bucket_t *b;
+    ihash_iter_t it;
+    ihash_iter_init (lib_watch, &it);
+    while ((b = ihash_iter_next (lib_watch, &it))) {
+      list_free ((list_t *) b->v);
+    }
+    ihash_free (lib_watch);
+    lib_watch = NULL;
+  }
+  if (lib_h) {
+    FREE (lib_h);
+    lib_h = NULL;
+  }
+  lib_nh = 0;
+  lib_maxh = 0;
+}
+
+static struct lib_handle *_get_handle (int h)
+{
+  if (!glob_sim || h < 0 || h >= lib_nh) {
+    return NULL;
+  }
+  return &lib_h[h];
+}
+
+static void _lib_change (void *cookie, int type, unsigned long off,
+			 const BigInt &val)
+{
+  ihash_bucket_t *b;
+  listitem_t *li, *next;
+  unsigned long w[1], *v;
+  int nw;
+
+  if (type > 1 || !lib_watch) {
+    return;
+  }
+  b = ihash_lookup (lib_watch, ((unsigned long)type) | (off << 2));
+  if (!b) {
+    return;
+  }
+  unsigned long tm = SimDES::CurTime().getVal (0);
+  if (type == 0) {
+    w[0] = val.getVal (0);
+    nw = 1;
+    v = w;
+  }
+  else {
+    nw = val.getLen();
+    MALLOC (v, unsigned long, nw);
+    for (int i=0; i < nw; i++) {
+      v[i] = val.getVal (i);
+    }
+  }
+  /* a callback may remove its own watch */
+  for (li = list_first ((list_t *) b->v); li; li = next) {
+    int hid = list_ivalue (li);
+    next = list_next (li);
+    (*lib_h[hid].fn) (lib_h[hid].cookie, hid, tm, nw, v);
+  }
+  if (v != w) {
+    FREE (v);
+  }
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Setup
+ *
+ *------------------------------------------------------------------------
+ */
+void actsim_lib_init (int *argc, char ***argv)
+{
+  config_set_default_int ("sim.chp.default_delay", 10);
+  config_set_default_int ("sim.chp.default_energy", 0);
+  config_set_default_real ("sim.chp.default_leakage", 0);
+  config_set_default_int ("sim.chp.default_area", 0);
+  config_set_default_int ("sim.chp.debug_metrics", 0);
+  config_set_default_int ("sim.chp.detailed_delay_annotation", 0);
+  config_set_int ("net.emit_parasitics", 1);
+
+  list_t *l = list_new ();
+  list_append (l, "actsim.conf");
+  list_append (l, "lint.conf");
+
+  Act::Init (argc, argv, l);
+  list_free (l);
+
+  debug_metrics = config_get_int ("sim.chp.debug_metrics");
+  config_set_default_int ("sim.sdf_mangled_names", 1);
+  if (config_exists ("sim.profile_startup") &&
+      (config_get_int ("sim.profile_startup") == 1)) {
+    actsim_startup_on = 1;
+  }
+}
+
+static void _build_sim ()
+{
+  SimDES::Init ();
+  actsim_phase_begin ("state pass");
+  lib_sp = new ActStatePass (lib_act);
+  lib_sp->run (lib_top);
+  actsim_phase_end ();
+
+  SDF *sdf_data = NULL;
+  if (config_exists ("sim.sdf_file")) {
+    sdf_data = new SDF (config_get_int ("sim.sdf_mangled_names") ? true : false);
+    if (!sdf_data->Read (config_get_string ("sim.sdf_file"))) {
+      warning ("SDF file `%s': reading failed; omitting.",
+	       config_get_string ("sim.sdf_file"));
+      delete sdf_data;
+      sdf_data = NULL;
+    }
+  }
+  ActExclMonitor::enable = false;
+
+  actsim_phase_begin ("build");
+  glob_sim = new ActSim (lib_top, sdf_data);
+  actsim_phase_end ();
+  if (!lib_env) {
+    lib_env = new LibEnvObject ();
+  }
+  actsim_phase_begin ("init");
+  glob_sim->runInit ();
+  actsim_phase_end ();
+  ActExclConstraint::_sc = glob_sim;
+  if (actsim_startup_on) {
+    actsim_phase_report (stderr);
+    glob_sim->printCounts (stderr);
+  }
+  glob_sim->setChangeHook (_lib_change, NULL);
+}
+
+static void _free_sim ()
+{
+  _clear_handles ();
+  if (glob_sim) {
+    delete glob_sim;
+    glob_sim = NULL;
+  }
+  if (lib_sp) {
+    delete lib_sp;
+    lib_sp = NULL;
+  }
+}
+
+int actsim_lib_load (const char *file, const char *proc)
+{
+  Process *p;
+  Act *a;
+
+  if (lib_act) {
+    fprintf (stderr, "actsim_lib_load: a design is already loaded\n");
+    return 0;
+  }
+  actsim_phase_begin ("read");
+  a = new Act (file);
+  actsim_phase_end ();
+  actsim_phase_begin ("expand");
+  a->Expand ();
+  actsim_phase_end ();
+
+  /* lib_act is only set once the design can be simulated, so that a
+     failed load can be retried */
+  p = a->findProcess (proc, true);
+  if (!p) {
+    fprintf (stderr, "actsim_lib_load: could not find process `%s' in file `%s'\n",
+	     proc, file);
+    return 0;
+  }
+  if (!p->isExpanded()) {
+    p = p->Expand (ActNamespace::Global(), p->CurScope(), 0, NULL);
+  }
+  if (!p->isExpanded()) {
+    fprintf (stderr, "actsim_lib_load: process `%s' is not expanded\n", proc);
+    return 0;
+  }
+  lib_act = a;
+  lib_top = p;
+  _build_sim ();
+  return 1;
+}
+
+int actsim_lib_reset (void)
+{
+  if (!lib_top) {
+    return 0;
+  }
+  _free_sim ();
+  _build_sim ();
+  return 1;
+}
+
+void actsim_lib_end (void)
+{
+  _free_sim ();
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Running the simulation
+ *
+ *------------------------------------------------------------------------
+ */
+int actsim_lib_step (unsigned long n)
+{
+  if (!glob_sim || n == 0) {
+    return 0;
+  }
+  glob_sim->Step (n);
+  return SimDES::hasPendingEvent() ? 1 : 0;
+}
+
+int actsim_lib_advance (unsigned long delay)
+{
+  if (!glob_sim || delay == 0) {
+    return 0;
+  }
+  glob_sim->Advance (delay);
+  return SimDES::hasPendingEvent() ? 1 : 0;
+}
+
+int actsim_lib_run (void)
+{
+  if (!glob_sim) {
+    return 0;
+  }
+  glob_sim->runSim (NULL);
+  return SimDES::hasPendingEvent() ? 1 : 0;
+}
+
+unsigned long actsim_lib_time (void)
+{
+  return SimDES::CurTime().getVal (0);
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  State access
+ *
+ *------------------------------------------------------------------------
+ */
+int actsim_lib_handle (const char *name)
+{
+  hash_bucket_t *b;
+  int type, offset;
+
+  if (!glob_sim) {
+    return -1;
+  }
+  if (lib_names && (b = hash_lookup (lib_names, name))) {
+    return b->i;
+  }
+
+  ActId *id = ActId::parseId (name);
+  if (!id) {
+    fprintf (stderr, "Could not parse `%s' into an identifier\n", name);
+    return -1;
+  }
+  ActId *tmp = id;
+  ActSimObj *obj = find_object (&tmp, glob_sim->getInstTable());
+  if (!obj) {
+    fprintf (stderr, "Could not find `%s' in simulation\n", name);
+    delete id;
+    return -1;
+  }
+  if (!id_obj_to_siminfo (lib_sp, obj, tmp, &type, &offset)) {
+    delete id;
+    return -1;
+  }
+  delete id;
+
+  if (type == 3) {
+    type = 2;
+  }
+  if (!lib_names) {
+    lib_names = hash_new (64);
+  }
+  if (lib_nh == lib_maxh) {
+    lib_maxh = (lib_maxh == 0 ? 64 : lib_maxh*2);
+    REALLOC (lib_h, struct lib_handle, lib_maxh);
+  }
+  lib_h[lib_nh].type = type;
+  lib_h[lib_nh].goff = obj->getGlobalOffset (offset, type);
+  lib_h[lib_nh].fn = NULL;
+  lib_h[lib_nh].cookie = NULL;
+  b = hash_add (lib_names, name);
+  b->i = lib_nh;
+  return lib_nh++;
+}
+
+int actsim_lib_type (int h)
+{
+  struct lib_handle *x = _get_handle (h);
+  return x ? x->type : -1;
+}
+
+int actsim_lib_get (int h, int nw, unsigned long *v)
+{
+  struct lib_handle *x = _get_handle (h);
+
+  if (!x) {
+    return -1;
+  }
+  if (x->type == 0) {
+    if (nw > 0) {
+      v[0] = glob_sim->getBool (x->goff);
+    }
+    return 1;
+  }
+  else if (x->type == 1) {
+    BigInt *b = glob_sim->getInt (x->goff);
+    for (int i=0; i < nw && i < b->getLen(); i++) {
+      v[i] = b->getVal (i);
+    }
+    return b->getLen();
+  }
+  else {
+    act_channel_state *c = glob_sim->getChan (x->goff);
+    unsigned long st;
+    if (WAITING_SENDER (c)) {
+      st = 1;
+    }
+    else if (WAITING_SEND_PROBE (c)) {
+      st = 2;
+    }
+    else if (WAITING_RECEIVER (c)) {
+      st = 3;
+    }
+    else if (WAITING_RECV_PROBE (c)) {
+      st = 4;
+    }
+    else {
+      st = 0;
+    }
+    if (nw > 0) {
+      v[0] = st;
+    }
+    return 1;
+  }
+}
+
+int actsim_lib_set (int h, int nw, const unsigned long *v)
+{
+  struct lib_handle *x = _get_handle (h);
+
+  if (!x || x->type == 2 || nw <= 0) {
+    return 0;
+  }
+  if (x->type == 0 && v[0] > 2) {
+    return 0;
+  }
+  BigInt b (64*nw, 0, 0);
+  for (int i=0; i < nw; i++) {
+    b.setVal (i, v[i]);
+  }
+  lib_env->setGid (x->goff);
+  return glob_sim->setEnv (x->type, x->goff, b, lib_env);
+}
+
+int actsim_lib_watch (int h, actsim_lib_cb_t fn, void *cookie)
+{
+  struct lib_handle *x = _get_handle (h);
+  unsigned long key;
+  ihash_bucket_t *b;
+
+  if (!x || x->type == 2) {
+    return 0;
+  }
+  key = ((unsigned long)x->type) | (((unsigned long)x->goff) << 2);
+  if (!lib_watch) {
+    lib_watch = ihash_new (4);
+  }
+  b = ihash_lookup (lib_watch, key);
+  if (!fn) {
+    if (b && x->fn) {
+      listitem_t *li, *prev = NULL;
+      for (li = list_first ((list_t *) b->v); li; li = list_next (li)) {
+	if (list_ivalue (li) == h) {
+	  break;
+	}
+	prev = li;
+      }
+      if (li) {
+	list_delete_next ((list_t *) b->v, prev);
+      }
+      if (list_isempty ((list_t *) b->v)) {
+	list_free ((list_t *) b->v);
+	ihash_delete (lib_watch, key);
+      }
+    }
+    x->fn = NULL;
+    return 1;
+  }
+  if (!b) {
+    b = ihash_add (lib_watch, key);
+    b->v = list_new ();
+  }
+  /* several handles can name the same node */
+  if (!x->fn) {
+    list_iappend ((list_t *) b->v, h);
+  }
+  x->fn = fn;
+  x->cookie = cookie;
+  glob_sim->addWatchBit (x->type, x->goff);
+  return 1;
+}
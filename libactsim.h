@@ -0,0 +1,92 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2026 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#ifndef __ACTSIM_LIBACTSIM_H__
+#define __ACTSIM_LIBACTSIM_H__
+
+/*
+ * Embedding interface to actsim.
+ *
+ * There is one simulation per process. The application is linked
+ * with libactsim and the same ACT libraries as the actsim executable.
+ *
+ * Names use the same syntax as the command-line interface. A handle
+ * is a small integer for a resolved name, and stays valid until the
+ * design is reloaded or reset.
+ *
+ * Values are arrays of 64-bit words, least significant first.
+ * Booleans are a single word that is 0, 1, or 2 (X).
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ACTSIM_LIB_BOOL 0
+#define ACTSIM_LIB_INT  1
+#define ACTSIM_LIB_CHAN 2
+
+/* called for each change to a watched Boolean or integer */
+typedef void (*actsim_lib_cb_t) (void *cookie, int h, unsigned long tm,
+				 int nw, const unsigned long *v);
+
+/* read configuration files; call once, before anything else */
+void actsim_lib_init (int *argc, char ***argv);
+
+/* load a design and build the simulation; returns 0 on failure */
+int actsim_lib_load (const char *file, const char *proc);
+
+/* discard the simulation state, and start over from the same design */
+int actsim_lib_reset (void);
+
+void actsim_lib_end (void);
+
+/* run events; returns 1 if there are pending events */
+int actsim_lib_step (unsigned long n);
+int actsim_lib_advance (unsigned long delay);
+int actsim_lib_run (void);
+
+unsigned long actsim_lib_time (void);
+
+int actsim_lib_handle (const char *name);	/* -1 if not found */
+int actsim_lib_type (int h);			/* -1 if invalid */
+
+/*
+ * Read the value of a Boolean or integer into v[0..nw-1]; returns the
+ * number of words in the value, or -1 on error. Channels return the
+ * same status code as the `get' command.
+ */
+int actsim_lib_get (int h, int nw, unsigned long *v);
+
+/* returns 0 if the handle is not a Boolean/integer or v does not fit */
+int actsim_lib_set (int h, int nw, const unsigned long *v);
+
+/*
+ * Register (or remove, with fn == NULL) the callback of a handle.
+ * Handles that name the same node each get their own callback.
+ */
+int actsim_lib_watch (int h, actsim_lib_cb_t fn, void *cookie);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ACTSIM_LIBACTSIM_H__ */
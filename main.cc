@@ -25,11 +25,23 @@
 #include <unistd.h>
 #include <string.h>
 #include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <getopt.h>
 #include <act/act.h>
 #include <act/passes.h>
 #include <common/config.h>
 #include "actsim.h"
 #include "chpsim.h"
+#include "chantok.h"
+#include "server.h"
+#include "runcond.h"
+#include "ensemble.h"
+#include "checkpoint.h"
+#include "prslane.h"
+#include "faultsim.h"
+#include "activity.h"
 #include <lisp.h>
 #include <lispCli.h>
 #include <ctype.h>
@@ -61,6 +73,8 @@ static void usage (char *name)
   fprintf (stderr, " -S <sdf>  : use delay from the specified SDF file.\n");
   fprintf (stderr, " -p <proc> : set <proc> as the top-level for simulation.\n");
   fprintf (stderr, " -m        : monitor exclusive high/low spec constraints.\n");
+  fprintf (stderr, " -v        : report time and memory used by each startup phase.\n");
+  fprintf (stderr, " --resume <dir> : restart from the latest checkpoint in <dir>.\n");
   exit (1);
 }
 
@@ -100,7 +114,7 @@ int process_cycle (int argc, char **argv)
 
   if (glob_sim->isResetMode()) {
     while (!LispInterruptExecution) {
-      if (!SimDES::matchPendingEvent (_match_hseprs)) {
+      if (!actsim_reset_pending ()) {
 	// no prs or hse pending events!
 	break;
       }
@@ -160,6 +174,8 @@ int process_advance (int argc, char **argv)
   }
 }
 
+static void name_index_clear ();
+
 int process_initialize (int argc, char **argv)
 {
   if (argc != 2) {
@@ -176,6 +192,7 @@ int process_initialize (int argc, char **argv)
     return LISP_RET_ERROR;
   }
   if (glob_sim) {
+    name_index_clear ();
     delete glob_sim;
     delete glob_sp;
   }
@@ -314,58 +331,6 @@ static unsigned long _get_energy (FILE *fp,
   return tot;
 }
 
-ActInstTable *find_table (ActId *id, ActInstTable *x)
-{
-  char buf[1024];
-  hash_bucket_t *b;
-  
-  if (!id) { return x; }
-
-  if (!x->H) { return NULL; }
-
-  ActId *tmp = id->Rest();
-  id->prune();
-  id->sPrint (buf, 1024);
-  id->Append (tmp);
-
-  b = hash_lookup (x->H, buf);
-  if (!b) {
-    return NULL;
-  }
-  else {
-    return find_table (id->Rest(), (ActInstTable *)b->v);
-  }
-}
-
-ActSimObj *find_object (ActId **id, ActInstTable *x)
-{
-  char buf[1024];
-  hash_bucket_t *b;
-  
-  if (!(*id)) { return x->obj; }
-  if (!x->H) { return x->obj; }
-
-  if ((*id)->isNamespace()) {
-    return x->obj;
-  }
-
-  ActId *tmp = (*id)->Rest();
-  (*id)->prune();
-  (*id)->sPrint (buf, 1024);
-  (*id)->Append (tmp);
-
-  b = hash_lookup (x->H, buf);
-  if (!b) {
-    return x->obj;
-  }
-  else {
-    (*id) = (*id)->Rest();
-    return find_object (id, (ActInstTable *)b->v);
-  }
-}
-
-
-
 int process_procinfo (int argc, char **argv)
 {
   ActId *id;
@@ -471,10 +436,16 @@ int process_getenergy (int argc, char **argv)
 
   if (!id) {
     /*-- print state of each process --*/
+    unsigned long ntrans;
+    double e;
     fprintf (fp, "Total: %lu",
 	     _get_energy (fp, glob_sim->getInstTable (), &lk, &area,
 			  flag));
     fprintf (fp, "  (%g W); area: %lu\n", lk, area);
+    e = actsim_tc_energy (glob_sim, &ntrans);
+    if (ntrans > 0) {
+      fprintf (fp, "PRS switching: %lu transitions, %g fJ\n", ntrans, e);
+    }
   }
   else {
     /*-- find this process --*/
@@ -489,6 +460,70 @@ int process_getenergy (int argc, char **argv)
   return LISP_RET_TRUE;
 }
 
+/* "-" is stdout */
+static FILE *_open_out (const char *cmd, const char *file, const char *mode)
+{
+  FILE *fp;
+  if (strcmp (file, "-") == 0) {
+    return stdout;
+  }
+  fp = fopen (file, mode);
+  if (!fp) {
+    fprintf (stderr, "%s: could not open file `%s' for writing\n", cmd, file);
+  }
+  return fp;
+}
+
+int process_dumptc (int argc, char **argv)
+{
+  FILE *fp;
+  if (argc != 2) {
+    fprintf (stderr, "Usage: %s <filename>\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  fp = _open_out (argv[0], argv[1], "w");
+  if (!fp) {
+    return LISP_RET_ERROR;
+  }
+  actsim_tc_dump (glob_sim, fp);
+  if (fp != stdout) {
+    fclose (fp);
+  }
+  return LISP_RET_TRUE;
+}
+
+int process_tcsnap (int argc, char **argv)
+{
+  FILE *fp;
+  int verbose = 0;
+  if (argc == 3 && strcmp (argv[1], "-v") == 0) {
+    verbose = 1;
+  }
+  else if (argc != 2) {
+    fprintf (stderr, "Usage: %s [-v] <filename>\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  fp = _open_out (argv[0], argv[argc-1], "a");
+  if (!fp) {
+    return LISP_RET_ERROR;
+  }
+  actsim_tc_snapshot (glob_sim, fp, verbose);
+  if (fp != stdout) {
+    fclose (fp);
+  }
+  return LISP_RET_TRUE;
+}
+
+int process_tcreset (int argc, char **argv)
+{
+  if (argc != 1) {
+    fprintf (stderr, "Usage: %s\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  actsim_tc_reset (glob_sim);
+  return LISP_RET_TRUE;
+}
+
 int process_coverage (int argc, char **argv)
 {
   ActId *id;
@@ -583,106 +618,242 @@ int process_goto (int argc, char **argv)
 
 
 /*
- * Given an object pointer and the id within it, return the type and
- * offset.
+ * Name index. Names that resolve are remembered, so that repeated
+ * commands on the same name skip parsing and the instance table walk.
+ * The index is a trie with one level per dotted component. A node
+ * also remembers the instance table its prefix names, so that a new
+ * name under a known instance starts its walk there. The position of
+ * a name in the entry array is its handle.
  */
-static int id_obj_to_siminfo (ActSimObj *obj,
-			      ActId *id,
-			      int *ptype,
-			      int *poffset)
+struct name_index_entry {
+  char *s;
+  int type;			// type; 3 = output end of a channel
+  int offset;			// local offset within obj
+  ActSimObj *obj;
+  int gtype, goff;		// global type and offset
+};
+
+struct name_trie {
+  struct Hashtable *H;		// component -> struct name_trie *
+  ActInstTable *inst;		// instance named by this prefix, if known
+  int idx;			// entry for this name, or -1
+};
+
+static struct name_trie *name_root = NULL;
+static struct name_index_entry *name_ents = NULL;
+static int name_num = 0, name_max = 0;
+
+static struct name_trie *name_trie_new ()
 {
-  stateinfo_t *si;
-  act_connection *c;
-  int res;
-  
-  if (!obj || !id) return 0;
-  
-  si = glob_sp->getStateInfo (obj->getProc());
-  if (!si) {
-    fprintf (stderr, "Could not find info for process `%s'\n", obj->getProc()->getName());
-    return 0;
+  struct name_trie *t;
+  NEW (t, struct name_trie);
+  t->H = NULL;
+  t->inst = NULL;
+  t->idx = -1;
+  return t;
+}
+
+static void name_trie_free (struct name_trie *t)
+{
+  if (t->H) {
+    hash_bucket_t *b;
+    hash_iter_t it;
+    hash_iter_init (t->H, &it);
+    while ((b = hash_iter_next (t->H, &it))) {
+      name_trie_free ((struct name_trie *) b->v);
+    }
+    hash_free (t->H);
   }
+  FREE (t);
+}
 
-  InstType *it;
-  if (!(it = si->bnl->cur->FullLookup (id, NULL))) {
-    fprintf (stderr, "Could not find identifier `");
-    id->Print (stderr);
-    fprintf (stderr, "' within process `%s'\n", obj->getProc()->getName());
-    return 0;
+/*
+ * Copy the component of s that starts at s into buf; dots within an
+ * array index are part of the component. Returns the position of the
+ * separating `.' or the end of the string, or NULL if the component
+ * does not fit.
+ */
+static const char *name_component (const char *s, char *buf, int sz)
+{
+  int depth = 0;
+  int i = 0;
+
+  while (*s && (*s != '.' || depth > 0)) {
+    if (*s == '[') {
+      depth++;
+    }
+    else if (*s == ']') {
+      depth--;
+    }
+    if (i == sz-1) {
+      return NULL;
+    }
+    buf[i++] = *s++;
   }
+  buf[i] = '\0';
+  return s;
+}
 
-  if (!id->validateDeref (si->bnl->cur)) {
-    fprintf (stderr, "Array index is missing/out of bounds in `");
-    id->Print (stderr);
-    fprintf (stderr, "'!\n");
-    return 0;
+static struct name_trie *name_trie_child (struct name_trie *t, char *c,
+					  int create)
+{
+  hash_bucket_t *b;
+
+  if (!t->H) {
+    if (!create) {
+      return NULL;
+    }
+    t->H = hash_new (4);
+  }
+  b = hash_lookup (t->H, c);
+  if (!b) {
+    if (!create) {
+      return NULL;
+    }
+    b = hash_add (t->H, c);
+    b->v = name_trie_new ();
   }
+  return (struct name_trie *) b->v;
+}
 
-  if (TypeFactory::isParamType (it)) {
-    fprintf (stderr, "Operation only works for a circuit object, not parameter `");
-    id->Print (stderr);
-    fprintf (stderr, "'\n");
-    return 0;
+/* trie node for the full name s, or NULL */
+static struct name_trie *name_trie_find (const char *s, int create)
+{
+  char buf[1024];
+  struct name_trie *t;
+
+  if (!name_root) {
+    if (!create) {
+      return NULL;
+    }
+    name_root = name_trie_new ();
   }
+  t = name_root;
+  while (t) {
+    s = name_component (s, buf, sizeof (buf));
+    if (!s) {
+      return NULL;
+    }
+    t = name_trie_child (t, buf, create);
+    if (!*s) {
+      return t;
+    }
+    s++;
+  }
+  return NULL;
+}
 
-  // validate the ID first,  then call canonical pointer
-  c = id->Canonical (si->bnl->cur, true);
-  if (!c) {
-    fprintf (stderr, "Identifier `");
-    id->Print (stderr);
-    fprintf (stderr, "' not found in the design.\n");
-    return 0;
+static void name_index_clear ()
+{
+  if (!name_root) {
+    return;
   }
-  Assert (c, "What?");
+  for (int i=0; i < name_num; i++) {
+    FREE (name_ents[i].s);
+  }
+  if (name_ents) {
+    FREE (name_ents);
+  }
+  name_ents = NULL;
+  name_num = 0;
+  name_max = 0;
+  name_trie_free (name_root);
+  name_root = NULL;
+}
 
-  int type, offset;
+static int name_index_add (const char *s, int type, int offset,
+			   ActSimObj *obj)
+{
+  struct name_trie *t = name_trie_find (s, 1);
+
+  if (!t) {
+    /* a component too long for the index; the name is not remembered */
+    return -1;
+  }
+  if (name_num == name_max) {
+    name_max = (name_max == 0 ? 64 : name_max*2);
+    REALLOC (name_ents, struct name_index_entry, name_max);
+  }
+  name_ents[name_num].s = Strdup (s);
+  name_ents[name_num].type = type;
+  name_ents[name_num].offset = offset;
+  name_ents[name_num].obj = obj;
+  name_ents[name_num].gtype = (type == 3 ? 2 : type);
+  name_ents[name_num].goff = obj->getGlobalOffset (offset,
+						   name_ents[name_num].gtype);
+  t->idx = name_num;
+  return name_num++;
+}
 
-  res = glob_sp->getTypeOffset (si, c, &offset, &type, NULL);
-  if (!res) {
-    /* it is possible that it is an array reference */
-    Array *ta = NULL;
-    ActId *orig = id;
-    while (id->Rest()) {
-      id = id->Rest();
-    }
-    ta = id->arrayInfo();
-    if (ta) {
-      InstType *it;
-      id->setArray (NULL);
-      it = si->bnl->cur->FullLookup (orig, NULL);
-      if (!it) {
-	fprintf (stderr, "Could not find identifier `");
-	orig->Print (stderr);
-	fprintf (stderr, "' within process `%s'\n", obj->getProc()->getName());
-	id->setArray (ta);
-	return 0;
-      }
-      c = orig->Canonical (si->bnl->cur);
-      Assert (c, "Hmm...");
-      res = glob_sp->getTypeOffset (si, c, &offset, &type, NULL);
-      if (res) {
-	Assert (it->arrayInfo(), "What?");
-	offset += it->arrayInfo()->Offset (ta);
+/*
+ * Same as find_object(), but the instance tables reached are recorded
+ * in the trie along the way and reused by later lookups.
+ */
+static ActSimObj *name_find_object (const char *s, ActId **id)
+{
+  char buf[1024];
+  char cbuf[1024];
+  ActInstTable *x = glob_sim->getInstTable ();
+  struct name_trie *t;
+  hash_bucket_t *b;
+
+  if (!name_root) {
+    name_root = name_trie_new ();
+  }
+  t = name_root;
+  while (*id && x->H && !(*id)->isNamespace()) {
+    struct name_trie *u = NULL;
+    const char *next = NULL;
+
+    if (t && s) {
+      next = name_component (s, cbuf, sizeof (cbuf));
+      if (next) {
+	u = name_trie_child (t, cbuf, 0);
       }
-      id->setArray (ta);
     }
-    if (!res) {
-      fprintf (stderr, "Could not find identifier `");
-      orig->Print (stderr);
-      fprintf (stderr, "' within process `%s'\n", obj->getProc()->getName());
-      return 0;
+    if (u && u->inst) {
+      x = u->inst;
+    }
+    else {
+      ActId *tmp = (*id)->Rest();
+      (*id)->prune();
+      (*id)->sPrint (buf, 1024);
+      (*id)->Append (tmp);
+      b = hash_lookup (x->H, buf);
+      if (!b) {
+	break;
+      }
+      x = (ActInstTable *) b->v;
+      if (next && *next) {
+	u = name_trie_child (t, cbuf, 1);
+	u->inst = x;
+      }
+      else {
+	u = NULL;
+      }
     }
+    t = u;
+    s = (next && *next) ? next + 1 : NULL;
+    (*id) = (*id)->Rest();
   }
-  *ptype = type;
-  *poffset = offset;
-  return 1;
+  return x->obj;
 }
 
-
 static int id_to_siminfo_raw (char *s,
 			      int *ptype, int *poffset,
 			      ActSimObj **pobj)
 {
+  struct name_trie *t = name_trie_find (s, 0);
+  if (t && t->idx >= 0) {
+    struct name_index_entry *e = &name_ents[t->idx];
+    *ptype = e->type;
+    *poffset = e->offset;
+    if (pobj) {
+      *pobj = e->obj;
+    }
+    return 1;
+  }
+  
   ActId *id = my_parse_id (s);
   if (!id) {
     fprintf (stderr, "Could not parse `%s' into an identifier\n", s);
@@ -691,7 +862,7 @@ static int id_to_siminfo_raw (char *s,
 
   /* -- find object / id combo -- */
   ActId *tmp = id;
-  ActSimObj *obj = find_object (&tmp, glob_sim->getInstTable());
+  ActSimObj *obj = name_find_object (s, &tmp);
   int res;
   
   if (!obj) {
@@ -701,7 +872,7 @@ static int id_to_siminfo_raw (char *s,
   }
 
   /* -- now convert tmp into a local offset -- */
-  res = id_obj_to_siminfo (obj, tmp, ptype, poffset);
+  res = id_obj_to_siminfo (glob_sp, obj, tmp, ptype, poffset);
   if (!res) {
     delete id;
     return 0;
@@ -710,9 +881,35 @@ static int id_to_siminfo_raw (char *s,
     *pobj = obj;
   }
   delete id;
+  name_index_add (s, *ptype, *poffset, obj);
   return 1;
 }
 
+/* handle for a name, or -1 */
+static int name_to_handle (char *s)
+{
+  int type, offset;
+  struct name_trie *t;
+  
+  if (!id_to_siminfo_raw (s, &type, &offset, NULL)) {
+    return -1;
+  }
+  t = name_trie_find (s, 0);
+  return t ? t->idx : -1;
+}
+
+static struct name_index_entry *handle_to_entry (const char *cmd,
+						 const char *h)
+{
+  char *end;
+  long idx = strtol (h, &end, 10);
+  if (*h == '\0' || *end != '\0' || idx < 0 || idx >= name_num) {
+    fprintf (stderr, "%s: `%s' is not a valid handle\n", cmd, h);
+    return NULL;
+  }
+  return &name_ents[idx];
+}
+
 
 static int id_to_siminfo (char *s, int *ptype, int *poffset, ActSimObj **pobj)
 {
@@ -762,103 +959,96 @@ static int id_to_siminfo_glob_raw (char *s,
 }
 
 
-int process_set (int argc, char **argv)
+/*
+ * Set a Boolean (0, 1, or 2 for X) or an integer given its global
+ * offset, and propagate the change
+ */
+static int set_value_big (int type, int offset, BigInt &rd)
 {
-  if (argc != 3) {
-    fprintf (stderr, "Usage: %s <name> <val>\n", argv[0]);
-    return LISP_RET_ERROR;
-  }
-
-  int type, offset;
-
-  if (!id_to_siminfo_glob (argv[1], &type, &offset, NULL)) {
+  glob_dummy->setGid (offset);
+  if (!glob_sim->setEnv (type, offset, rd, glob_dummy)) {
+    fprintf(stderr, "Value does not fit into variable's bitwidth.\n");
     return LISP_RET_ERROR;
   }
+  return LISP_RET_TRUE;
+}
 
+/*
+ * Set a variable given its global offset
+ */
+static int set_value (const char *name, int type, int offset, const char *sval)
+{
   if (type == 2 || type == 3) {
-    printf ("'%s' is a channel; not currently supported!\n", argv[1]);
+    printf ("'%s' is a channel; not currently supported!\n", name);
     return LISP_RET_ERROR;
   }
 
-  int val;
-  
   if (type == 0) {
-    if (strcmp (argv[2], "0") == 0 || strcmp (argv[2], "#f") == 0) {
+    BigInt val;
+    if (strcmp (sval, "0") == 0 || strcmp (sval, "#f") == 0) {
       val = 0;
     }
-    else if (strcmp (argv[2], "1") == 0 || strcmp (argv[2], "#t") == 0) {
+    else if (strcmp (sval, "1") == 0 || strcmp (sval, "#t") == 0) {
       val = 1;
     }
-    else if (strcmp (argv[2], "X") == 0) {
+    else if (strcmp (sval, "X") == 0) {
       val = 2;
     }
     else {
       fprintf (stderr, "Boolean must be set to either 0, 1, or X\n");
       return LISP_RET_ERROR;
     }
-    const ActSim::watchpt_bucket *nm;
-    if ((nm = glob_sim->chkWatchPt (0, offset))) {
-      int oval = glob_sim->getBool (offset);
-      if (oval != val) {
-	BigInt tm = SimDES::CurTime();
-	printf ("[");
-	tm.decPrint (stdout, 20);
-	printf ("] <[env]> ");
-	printf ("%s := %c\n", nm->s, (val == 2 ? 'X' : ((char)val + '0')));
-
-	BigInt tmpv;
-	tmpv = val;
-
-	glob_sim->recordTrace (nm, type, ACT_CHAN_IDLE, tmpv);
-      }
-    }
-    glob_sim->setBool (offset, val);
+    return set_value_big (type, offset, val);
   }
-  else if (type == 1) {
-    BigInt *otmp = glob_sim->getInt (offset);
-    BigInt rd = BigInt::sscan (argv[2]);
+  else {
+    BigInt rd = BigInt::sscan (sval);
     if (rd.isNegative()) {
       fprintf (stderr, "Integers are unsigned.\n");
       return LISP_RET_ERROR;
     }
-    BigInt before = rd;
-    rd.setWidth (otmp->getWidth());
-    if (before != rd) {
-      fprintf(stderr, "Value does not fit into variable's bitwidth.\n");
-      return LISP_RET_ERROR;
-    }
+    return set_value_big (type, offset, rd);
+  }
+}
 
-    const ActSim::watchpt_bucket *nm;
-    if ((nm = glob_sim->chkWatchPt (1, offset))) {
-      if (*otmp != rd) {
-	BigInt tm = SimDES::CurTime();
-	printf ("[");
-	tm.decPrint (stdout, 20);
-	printf ("] <[env]> ");
-	printf ("%s := ", nm->s);
-	rd.decPrint (stdout);
-	printf (" (0x");
-	rd.hexPrint (stdout);
-	printf (")\n");
+/*
+ * Access by handle for the socket server
+ */
+int actsim_name_handle (const char *name)
+{
+  char *tmp = Strdup (name);
+  int h = name_to_handle (tmp);
+  FREE (tmp);
+  return h;
+}
 
-	glob_sim->recordTrace (nm, type, ACT_CHAN_IDLE, rd);
-      }
-    }
-    glob_sim->setInt (offset, rd);
+int actsim_handle_info (int h, int *type, int *goff)
+{
+  if (h < 0 || h >= name_num) {
+    return 0;
   }
-  else {
-    fatal_error ("Should not be here");
+  *type = name_ents[h].gtype;
+  *goff = name_ents[h].goff;
+  return 1;
+}
+
+int actsim_set_value (int type, int goff, BigInt &v)
+{
+  return set_value_big (type, goff, v) == LISP_RET_ERROR ? 0 : 1;
+}
+
+int process_set (int argc, char **argv)
+{
+  if (argc != 3) {
+    fprintf (stderr, "Usage: %s <name> <val>\n", argv[0]);
+    return LISP_RET_ERROR;
   }
 
-  SimDES **arr;
-  arr = glob_sim->getFO (offset, type);
-  glob_dummy->setGid (offset);
-  for (int i=0; i < glob_sim->numFanout (offset, type); i++) {
-    ActSimDES *p = dynamic_cast <ActSimDES *> (arr[i]);
-    Assert (p, "Hmm?");
-    p->propagate (glob_dummy);
+  int type, offset;
+
+  if (!id_to_siminfo_glob (argv[1], &type, &offset, NULL)) {
+    return LISP_RET_ERROR;
   }
-  return LISP_RET_TRUE;
+  return set_value (argv[1], type, offset, argv[2]);
 }
 
 int process_wakeup (int argc, char **argv)
@@ -1064,40 +1254,32 @@ int process_assert (int argc, char **argv)
   else return LISP_RET_TRUE;
 }
 
-int process_get (int argc, char **argv)
+/*
+ * Get the value of a variable given its global offset
+ */
+static int get_value (const char *name, int type, int offset, int display)
 {
-  if (argc != 2 && argc != 3) {
-    fprintf (stderr, "Usage: %s <name> [#f]\n", argv[0]);
-    return LISP_RET_ERROR;
-  }
-
-  int type, offset;
-
-  if (!id_to_siminfo_glob (argv[1], &type, &offset, NULL)) {
-    return LISP_RET_ERROR;
-  }
-
   bool is_list = false;
   unsigned long val;
   if (type == 0) {
     val = glob_sim->getBool (offset);
     LispSetReturnInt (val);
-    if (argc == 2) {
+    if (display) {
       if (val == 0) {
-	printf ("%s: 0\n", argv[1]);
+	printf ("%s: 0\n", name);
       }
       else if (val == 1) {
-	printf ("%s: 1\n", argv[1]);
+	printf ("%s: 1\n", name);
       }
       else {
-	printf ("%s: X\n", argv[1]);
+	printf ("%s: X\n", name);
       }
     }
   }
   else if (type == 1) {
     BigInt *ival = glob_sim->getInt (offset);
     if (!ival) {
-      printf ("%s: couldn't get integer `%s'?\n", argv[0], argv[1]);
+      printf ("%s: couldn't get integer `%s'?\n", "get", name);
       return LISP_RET_ERROR;
     }
     if (ival->getLen() > 1) {
@@ -1107,8 +1289,8 @@ int process_get (int argc, char **argv)
 	LispAppendReturnInt (ival->getVal (i));
       }
       LispSetReturnListEnd ();
-      if (argc == 2) {
-	printf ("%s: ", argv[1]);
+      if (display) {
+	printf ("%s: ", name);
 	ival->decPrint (stdout);
 	printf ("  (0x");
 	ival->hexPrint (stdout);
@@ -1118,57 +1300,157 @@ int process_get (int argc, char **argv)
     else {
       val = ival->getVal (0);
       LispSetReturnInt (val);
-      if (argc == 2) {
-	printf ("%s: %lu  (0x%lx)\n", argv[1], val, val);
+      if (display) {
+	printf ("%s: %lu  (0x%lx)\n", name, val, val);
       }
     }
   }
   else {
     act_channel_state *c = glob_sim->getChan (offset);
     if (WAITING_SENDER (c)) {
-      printf ("%s: waiting sender\n", argv[1]);
+      printf ("%s: waiting sender\n", name);
       LispSetReturnInt(1);
     }
     else if (WAITING_SEND_PROBE (c)) {
-      printf ("%s: waiting sender probe\n", argv[1]);
+      printf ("%s: waiting sender probe\n", name);
       LispSetReturnInt(2);
     }
     else if (WAITING_RECEIVER(c)) {
-      printf ("%s: waiting receiver\n", argv[1]);
+      printf ("%s: waiting receiver\n", name);
       LispSetReturnInt(3);
     }
     else if (WAITING_RECV_PROBE(c)) {
-      printf ("%s: waiting receiver probe\n", argv[1]);
+      printf ("%s: waiting receiver probe\n", name);
       LispSetReturnInt(4);
     }
     else {
-      printf ("%s: idle\n", argv[1]);
+      printf ("%s: idle\n", name);
       LispSetReturnInt(0);
     }
   }
   return is_list ? LISP_RET_LIST : LISP_RET_INT;
 }
 
-int process_mget (int argc, char **argv)
+int process_get (int argc, char **argv)
 {
-  if (argc < 2) {
-    fprintf (stderr, "Usage: %s <name1> <name2> ...\n", argv[0]);
+  if (argc != 2 && argc != 3) {
+    fprintf (stderr, "Usage: %s <name> [#f]\n", argv[0]);
     return LISP_RET_ERROR;
   }
 
   int type, offset;
 
-  for (int i=1; i < argc; i++) {
-    if (!id_to_siminfo_glob (argv[i], &type, &offset, NULL)) {
-      return LISP_RET_ERROR;
-    }
-
-    if (type == 2 || type == 3) {
-      printf ("'%s' is a channel; not currently supported!\n", argv[i]);
-      return LISP_RET_ERROR;
-    }
+  if (!id_to_siminfo_glob (argv[1], &type, &offset, NULL)) {
+    return LISP_RET_ERROR;
+  }
+  return get_value (argv[1], type, offset, argc == 2 ? 1 : 0);
+}
 
-    unsigned long val;
+int process_handle (int argc, char **argv)
+{
+  if (argc != 2) {
+    fprintf (stderr, "Usage: %s <name>\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  int h = name_to_handle (argv[1]);
+  if (h == -1) {
+    return LISP_RET_ERROR;
+  }
+  LispSetReturnInt (h);
+  return LISP_RET_INT;
+}
+
+int process_hget (int argc, char **argv)
+{
+  struct name_index_entry *e;
+  
+  if (argc != 2 && argc != 3) {
+    fprintf (stderr, "Usage: %s <handle> [#f]\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  if (!(e = handle_to_entry (argv[0], argv[1]))) {
+    return LISP_RET_ERROR;
+  }
+  return get_value (e->s, e->gtype, e->goff, argc == 2 ? 1 : 0);
+}
+
+int process_hset (int argc, char **argv)
+{
+  struct name_index_entry *e;
+  
+  if (argc != 3) {
+    fprintf (stderr, "Usage: %s <handle> <val>\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  if (!(e = handle_to_entry (argv[0], argv[1]))) {
+    return LISP_RET_ERROR;
+  }
+  return set_value (e->s, e->gtype, e->goff, argv[2]);
+}
+
+static int run_until_lookup (char *name, int *type, int *off)
+{
+  return id_to_siminfo_glob (name, type, off, NULL);
+}
+
+int process_run_until (int argc, char **argv)
+{
+  long timeout = 0;
+  
+  if (argc != 2 && argc != 3) {
+    fprintf (stderr, "Usage: %s <expr> [timeout]\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  if (argc == 3) {
+    sscanf (argv[2], "%ld", &timeout);
+    if (timeout <= 0) {
+      fprintf (stderr, "%s: zero/negative timeout?\n", argv[0]);
+      return LISP_RET_ERROR;
+    }
+  }
+
+  ActSimCond *c = ActSimCond::compile (glob_sim, argv[1], run_until_lookup);
+  if (!c) {
+    return LISP_RET_ERROR;
+  }
+  if (c->eval ()) {
+    c->release ();
+    return LISP_RET_TRUE;
+  }
+
+  c->arm ();
+  if (timeout > 0) {
+    glob_sim->Advance (timeout);
+  }
+  else {
+    glob_sim->runSim (NULL);
+  }
+  int hit = c->isTriggered ();
+  c->release ();
+  
+  return hit ? LISP_RET_TRUE : LISP_RET_FALSE;
+}
+
+int process_mget (int argc, char **argv)
+{
+  if (argc < 2) {
+    fprintf (stderr, "Usage: %s <name1> <name2> ...\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+
+  int type, offset;
+
+  for (int i=1; i < argc; i++) {
+    if (!id_to_siminfo_glob (argv[i], &type, &offset, NULL)) {
+      return LISP_RET_ERROR;
+    }
+
+    if (type == 2 || type == 3) {
+      printf ("'%s' is a channel; not currently supported!\n", argv[i]);
+      return LISP_RET_ERROR;
+    }
+
+    unsigned long val;
     if (type == 0) {
       val = glob_sim->getBool (offset);
       if (val == 0) {
@@ -1210,6 +1492,37 @@ int process_watch (int argc, char **argv)
   return LISP_RET_TRUE;
 }
 
+int process_watchall (int argc, char **argv)
+{
+  ActInstTable *inst;
+  
+  if (argc != 1 && argc != 2) {
+    fprintf (stderr, "Usage: %s [<instance>]\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+
+  if (argc == 1) {
+    inst = glob_sim->getInstTable ();
+  }
+  else {
+    ActId *id = my_parse_id (argv[1]);
+    if (id == NULL) {
+      fprintf (stderr, "Could not parse `%s' into an instance name\n",
+	       argv[1]);
+      return LISP_RET_ERROR;
+    }
+    inst = find_table (id, glob_sim->getInstTable ());
+    delete id;
+  }
+  if (!inst) {
+    fprintf (stderr, "%s: could not find instance `%s'\n", argv[0], argv[1]);
+    return LISP_RET_ERROR;
+  }
+  glob_sim->addWatchAll (inst);
+
+  return LISP_RET_TRUE;
+}
+
 int process_breakpt (int argc, char **argv)
 {
   if (argc != 2) {
@@ -1661,115 +1974,1088 @@ int process_stoplxt2 (int argc, char **argv)
   return process_stop_generic_trace (argv[0], "lxt2", "LXT2");
 }
 
-int process_timescale (int argc, char **argv)
+int process_createntrace (int argc, char **argv)
 {
-  double tm;
-  
   if (argc != 2) {
-    fprintf (stderr, "Usage: %s <t>\n", argv[0]);
+    fprintf (stderr, "Usage: %s <file>\n", argv[0]);
     return LISP_RET_ERROR;
   }
-  tm = atof (argv[1]);
-  if (tm <= 0) {
-    fprintf (stderr, "Timescale value has to be positive!");
+  if (glob_sim->hasNativeTrace ()) {
+    fprintf (stderr, "%s: closing current native trace file\n", argv[0]);
+    glob_sim->initTrace (TRACE_NATIVE, NULL);
+  }
+  if (!glob_sim->initTrace (TRACE_NATIVE, argv[1])) {
+    fprintf (stderr, "%s: could not create `%s'\n", argv[0], argv[1]);
     return LISP_RET_ERROR;
   }
-  glob_sim->setTimescale (tm);
   return LISP_RET_TRUE;
 }
 
-int process_get_sim_time (int argc, char **argv)
+int process_stopntrace (int argc, char **argv)
 {
   if (argc != 1) {
     fprintf (stderr, "Usage: %s\n", argv[0]);
     return LISP_RET_ERROR;
   }
-  if (!glob_sim) { 
-    fprintf (stderr, "%s: No simulation?\n", argv[0]);
+  if (!glob_sim->hasNativeTrace ()) {
+    fprintf (stderr, "%s: no current native trace file.\n", argv[0]);
     return LISP_RET_ERROR;
   }
-  double cur_time = glob_sim->curTimeMetricUnits ();
-  LispSetReturnFloat (cur_time*1e12); 
-  return LISP_RET_FLOAT;
+  glob_sim->initTrace (TRACE_NATIVE, NULL);
+  return LISP_RET_TRUE;
 }
 
-int process_get_sim_itime (int argc, char **argv)
+int process_trigger_window (int argc, char **argv)
 {
-  if (argc != 1) {
-    fprintf (stderr, "Usage: %s\n", argv[0]);
+  if (argc != 3) {
+    fprintf (stderr, "Usage: %s <pre> <post>\n", argv[0]);
     return LISP_RET_ERROR;
   }
-  if (!glob_sim) { 
-    fprintf (stderr, "%s: No simulation?\n", argv[0]);
+  glob_sim->setTraceWindow (strtoul (argv[1], NULL, 0),
+			    strtoul (argv[2], NULL, 0));
+  return LISP_RET_TRUE;
+}
+
+int process_trigger (int argc, char **argv)
+{
+  if (argc != 3) {
+    fprintf (stderr, "Usage: %s <name> <val>\n", argv[0]);
     return LISP_RET_ERROR;
   }
-  BigInt tm = SimDES::CurTime();
-  LispSetReturnInt (tm.getVal (0));
-  return LISP_RET_INT;
+
+  int type, offset;
+  unsigned long val;
+  ActSimObj *obj;
+
+  if (!id_to_siminfo (argv[1], &type, &offset, &obj)) {
+    return LISP_RET_ERROR;
+  }
+  if (type == 2 || type == 3) {
+    fprintf (stderr, "%s: use trigger_count for channels\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  if (type == 0 && (strcmp (argv[2], "X") == 0 || strcmp (argv[2], "x") == 0)) {
+    val = 2;
+  }
+  else {
+    val = strtoul (argv[2], NULL, 0);
+    if (type == 0 && val > 1) {
+      fprintf (stderr, "%s: Boolean value must be 0, 1, or X\n", argv[0]);
+      return LISP_RET_ERROR;
+    }
+  }
+  int goff = obj->getGlobalOffset (offset, type);
+  if (!glob_sim->chkWatchPt (type, goff) && !glob_sim->chkWatchAll (type, goff)) {
+    fprintf (stderr, "%s: warning, `%s' is not traced; trigger will not fire\n",
+	     argv[0], argv[1]);
+  }
+  glob_sim->addTrigger (type, goff, val);
+  return LISP_RET_TRUE;
 }
 
-int process_pending (int argc, char **argv)
+int process_trigger_count (int argc, char **argv)
 {
-  if (argc != 1 && argc != 2) {
-    fprintf (stderr, "Usage: %s [-v]\n", argv[0]);
+  if (argc != 3) {
+    fprintf (stderr, "Usage: %s <chan> <count>\n", argv[0]);
     return LISP_RET_ERROR;
   }
-  bool verbose = false;
-  if (argc == 2 && strcmp (argv[1], "-v") == 0) {
-    verbose = true;
+
+  int type, offset;
+  ActSimObj *obj;
+
+  if (!id_to_siminfo (argv[1], &type, &offset, &obj)) {
+    return LISP_RET_ERROR;
   }
-  else if (argc == 2) {
-    fprintf (stderr, "Usage: %s [-v]\n", argv[0]);
+  if (type != 2 && type != 3) {
+    fprintf (stderr, "%s: is not of channel type\n", argv[1]);
     return LISP_RET_ERROR;
   }
+  int goff = obj->getGlobalOffset (offset, type);
+  if (!glob_sim->chkWatchPt (2, goff)) {
+    fprintf (stderr, "%s: warning, `%s' is not traced; trigger will not fire\n",
+	     argv[0], argv[1]);
+  }
+  glob_sim->addTrigger (2, goff, strtoul (argv[2], NULL, 0));
+  return LISP_RET_TRUE;
+}
 
-  if (!SimDES::hasPendingEvent()) {
-    return LISP_RET_FALSE;
+int process_trigger_warn (int argc, char **argv)
+{
+  if (argc != 1) {
+    fprintf (stderr, "Usage: %s\n", argv[0]);
+    return LISP_RET_ERROR;
   }
-  
-  runPending (verbose);
+  glob_sim->setTriggerOnWarning (1);
   return LISP_RET_TRUE;
 }
 
+int process_trigger_clear (int argc, char **argv)
+{
+  if (argc != 1) {
+    fprintf (stderr, "Usage: %s\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  glob_sim->clearTriggers ();
+  return LISP_RET_TRUE;
+}
 
-struct LispCliCommand Cmds[] = {
-  { NULL, "Initialization and setup", NULL },
+/*
+ * Map a port name relative to instance <inst> to its channel
+ */
+static int chantok_port_goff (const char *inst, const char *port)
+{
+  char buf[1024];
+  int type, offset;
+  ActSimObj *obj;
 
-  { "echo", "[-n] args - display to screen", process_echo },
-  { "error", "<str> - report error and abort execution", process_error },
-  
-  { "initialize", "<proc> - initialize simulation for <proc>",
-    process_initialize },
+  if (inst) {
+    snprintf (buf, 1024, "%s.%s", inst, port);
+  }
+  else {
+    snprintf (buf, 1024, "%s", port);
+  }
+  if (!id_to_siminfo (buf, &type, &offset, &obj)) {
+    return -1;
+  }
+  if (type != 2) {
+    fprintf (stderr, "%s: is not of channel type\n", buf);
+    return -1;
+  }
+  return obj->getGlobalOffset (offset, type);
+}
 
-  { "mode", "reset|run - set running mode", process_mode },
-  
-  { "random", "[-u] [min max] - randomize timings; -u only randomizes unspecified times", process_random },
-  { "random_seed", "<val> - set random number seed", process_random_seed },
-  { "norandom", "- deterministic timing", process_norandom },
-  { "random_choice", "on|off - randomize non-deterministic choices", process_random_choice },
+/*
+ * Table of the channel ports of an instance, terminated by an entry
+ * with a NULL name
+ */
+static struct chantok_port *chantok_inst_ports (const char *inst,
+						 Process *proc, int *nports)
+{
+  struct chantok_port *p;
+  int n = 0, max = 4;
+  char buf[1024];
 
-#if 0
-  { "dumptc", "<file> - dump transition counts to a file", process_dumptc },
-#endif
+  MALLOC (p, struct chantok_port, max);
 
-  { NULL, "Running simulation", NULL },
+  for (int i=0; i < proc->getNumPorts(); i++) {
+    InstType *it = proc->getPortType (i);
+    int dir;
+    if (!TypeFactory::isChanType (it)) {
+      continue;
+    }
+    if (it->getDir() == Type::IN) {
+      dir = CHANTOK_IN;
+    }
+    else if (it->getDir() == Type::OUT) {
+      dir = CHANTOK_OUT;
+    }
+    else {
+      fprintf (stderr, "WARNING: port `%s' has no direction (or is bidirectional); skipped\n",
+	       proc->getPortName (i));
+      continue;
+    }
+
+    ActId *tmp = new ActId (proc->getPortName (i));
+    Arraystep *as = it->arrayInfo() ? it->arrayInfo()->stepper() : NULL;
+    do {
+      Array *a = NULL;
+      if (as) {
+	a = as->toArray ();
+	tmp->setArray (a);
+      }
+      tmp->sPrint (buf, 1024);
+      int goff = chantok_port_goff (inst, buf);
+      if (goff != -1) {
+	if (n == max - 1) {
+	  max *= 2;
+	  REALLOC (p, struct chantok_port, max);
+	}
+	p[n].name = Strdup (buf);
+	p[n].dir = dir;
+	p[n].goff = goff;
+	A_INIT (p[n].tok);
+	n++;
+      }
+      if (as) {
+	tmp->setArray (NULL);
+	delete a;
+	as->step ();
+      }
+    } while (as && !as->isend());
+    if (as) {
+      delete as;
+    }
+    delete tmp;
+  }
+  p[n].name = NULL;
+  A_INIT (p[n].tok);
+  *nports = n;
+  return p;
+}
 
-  { "step", "[n] - run the next [n] events", process_step },
-  { "advance", "<delay> - run for <delay> time", process_advance },
-  { "cycle", "- run until simulation stops", process_cycle },
+int process_chan_record (int argc, char **argv)
+{
+  if (argc != 3) {
+    fprintf (stderr, "Usage: %s <inst> <file>\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
 
-  { "pending", "- dump pending events", process_pending },
-  
-  { "set", "<name> <val> - set a variable to a value", process_set },
-  { "gc-retry", "<name> - re-try guards in a deadlocked process", process_wakeup },
-  { "skip-comm", "<name> - skip the communication action", process_skipcomm },
-  
-  { "get", "<name> [#f] - get value of a variable; optional arg turns off display", process_get },
-  { "mget", "<name1> <name2> ... - multi-get value of a variable", process_mget },
-  { "chcount", "<name> [#f] - return the number of completed actions on named channel", process_chcount },
+  ActId *id = my_parse_id (argv[1]);
+  if (id == NULL) {
+    fprintf (stderr, "Could not parse `%s' into an instance name\n",
+	     argv[1]);
+    return LISP_RET_ERROR;
+  }
+  ActInstTable *inst = find_table (id, glob_sim->getInstTable ());
+  delete id;
+  if (!inst || !inst->obj || !inst->obj->getProc()) {
+    fprintf (stderr, "%s: could not find instance `%s'\n", argv[0], argv[1]);
+    return LISP_RET_ERROR;
+  }
 
-  { "watch", "<n1> <n2> ... - add watchpoint for <n1> etc.", process_watch },
-  { "unwatch", "<n1> <n2> ... - delete watchpoint for <n1> etc.", process_unwatch },
+  int n;
+  struct chantok_port *p = chantok_inst_ports (argv[1],
+					       inst->obj->getProc(), &n);
+  if (n == 0) {
+    fprintf (stderr, "%s: `%s' has no channel ports\n", argv[0], argv[1]);
+    ChanReplay::freePorts (p);
+    return LISP_RET_ERROR;
+  }
+  int ret = glob_sim->tokenRecordStart (argv[2], n, p);
+  ChanReplay::freePorts (p);
+  if (!ret) {
+    fprintf (stderr, "%s: could not open `%s' for writing\n", argv[0], argv[2]);
+    return LISP_RET_ERROR;
+  }
+  return LISP_RET_TRUE;
+}
+
+int process_chan_record_stop (int argc, char **argv)
+{
+  if (argc != 1) {
+    fprintf (stderr, "Usage: %s\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  glob_sim->tokenRecordStop ();
+  return LISP_RET_TRUE;
+}
+
+int process_chan_replay (int argc, char **argv)
+{
+  const char *inst, *file;
+  
+  if (argc != 2 && argc != 3) {
+    fprintf (stderr, "Usage: %s [<inst>] <file>\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  if (argc == 3) {
+    inst = argv[1];
+    file = argv[2];
+  }
+  else {
+    inst = NULL;
+    file = argv[1];
+  }
+
+  int n;
+  struct chantok_port *p = ChanReplay::load (file, &n);
+  if (!p) {
+    fprintf (stderr, "%s: could not read token log `%s'\n", argv[0], file);
+    return LISP_RET_ERROR;
+  }
+  for (int i=0; i < n; i++) {
+    p[i].goff = chantok_port_goff (inst, p[i].name);
+    if (p[i].goff == -1) {
+      fprintf (stderr, "%s: port `%s' not replayed\n", argv[0], p[i].name);
+    }
+    else if (glob_sim->getChan (p[i].goff)->fragmented) {
+      fprintf (stderr, "%s: port `%s' is not a CHP channel; not replayed\n",
+	       argv[0], p[i].name);
+      p[i].goff = -1;
+    }
+  }
+  glob_sim->tokenReplay (p);
+  return LISP_RET_TRUE;
+}
+
+int process_server (int argc, char **argv)
+{
+  if (argc != 2) {
+    fprintf (stderr, "Usage: %s <path>\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  if (!actsim_server (glob_sim, argv[1])) {
+    return LISP_RET_ERROR;
+  }
+  return LISP_RET_TRUE;
+}
+
+int process_timescale (int argc, char **argv)
+{
+  double tm;
+  
+  if (argc != 2) {
+    fprintf (stderr, "Usage: %s <t>\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  tm = atof (argv[1]);
+  if (tm <= 0) {
+    fprintf (stderr, "Timescale value has to be positive!");
+    return LISP_RET_ERROR;
+  }
+  glob_sim->setTimescale (tm);
+  return LISP_RET_TRUE;
+}
+
+int process_get_sim_time (int argc, char **argv)
+{
+  if (argc != 1) {
+    fprintf (stderr, "Usage: %s\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  if (!glob_sim) { 
+    fprintf (stderr, "%s: No simulation?\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  double cur_time = glob_sim->curTimeMetricUnits ();
+  LispSetReturnFloat (cur_time*1e12); 
+  return LISP_RET_FLOAT;
+}
+
+int process_get_sim_itime (int argc, char **argv)
+{
+  if (argc != 1) {
+    fprintf (stderr, "Usage: %s\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  if (!glob_sim) { 
+    fprintf (stderr, "%s: No simulation?\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  BigInt tm = SimDES::CurTime();
+  LispSetReturnInt (tm.getVal (0));
+  return LISP_RET_INT;
+}
+
+int process_pending (int argc, char **argv)
+{
+  if (argc != 1 && argc != 2) {
+    fprintf (stderr, "Usage: %s [-v]\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  bool verbose = false;
+  if (argc == 2 && strcmp (argv[1], "-v") == 0) {
+    verbose = true;
+  }
+  else if (argc == 2) {
+    fprintf (stderr, "Usage: %s [-v]\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+
+  if (!SimDES::hasPendingEvent()) {
+    return LISP_RET_FALSE;
+  }
+  
+  runPending (verbose);
+  return LISP_RET_TRUE;
+}
+
+int process_stats (int argc, char **argv)
+{
+  if (argc == 1) {
+    actsim_perf_print (stdout);
+    return LISP_RET_TRUE;
+  }
+  if (argc == 2) {
+    if (strcmp (argv[1], "reset") == 0) {
+      actsim_perf_reset ();
+      return LISP_RET_TRUE;
+    }
+    else if (strcmp (argv[1], "on") == 0) {
+      actsim_perf_enable (1);
+      return LISP_RET_TRUE;
+    }
+    else if (strcmp (argv[1], "off") == 0) {
+      actsim_perf_enable (0);
+      return LISP_RET_TRUE;
+    }
+  }
+  fprintf (stderr, "Usage: %s [reset|on|off]\n", argv[0]);
+  return LISP_RET_ERROR;
+}
+
+int process_stats_dump (int argc, char **argv)
+{
+  if (argc == 2 && strcmp (argv[1], "off") == 0) {
+    actsim_perf_dump_start (NULL, 0);
+    return LISP_RET_TRUE;
+  }
+  if (argc != 3 || atol (argv[2]) <= 0) {
+    fprintf (stderr, "Usage: %s <file> <events>\n", argv[0]);
+    fprintf (stderr, "       %s off\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  if (!actsim_perf_dump_start (argv[1], atol (argv[2]))) {
+    fprintf (stderr, "%s: could not open file `%s'\n", argv[0], argv[1]);
+    return LISP_RET_ERROR;
+  }
+  return LISP_RET_TRUE;
+}
+
+int process_profile (int argc, char **argv)
+{
+  if (argc == 2) {
+    if (strcmp (argv[1], "on") == 0) {
+      actsim_prof_enable (1);
+      return LISP_RET_TRUE;
+    }
+    else if (strcmp (argv[1], "off") == 0) {
+      actsim_prof_enable (0);
+      return LISP_RET_TRUE;
+    }
+    else if (strcmp (argv[1], "reset") == 0) {
+      actsim_prof_reset (glob_sim->getInstTable());
+      return LISP_RET_TRUE;
+    }
+  }
+  fprintf (stderr, "Usage: %s on|off|reset\n", argv[0]);
+  return LISP_RET_ERROR;
+}
+
+int process_profile_dump (int argc, char **argv)
+{
+  ActId *id;
+  FILE *fp;
+  ActInstTable *inst;
+  int add_one = 0;
+
+  if (argc > 1 && strcmp (argv[1], "-f") == 0) {
+    add_one = 1;
+  }
+  if (argc != 2+add_one && argc != 3+add_one) {
+    fprintf (stderr, "Usage: %s [-f] <filename> [<instance-name>]\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+
+  if (argc == 2+add_one) {
+    id = NULL;
+    inst = glob_sim->getInstTable ();
+  }
+  else {
+    id = my_parse_id (argv[2+add_one]);
+    if (id == NULL) {
+      fprintf (stderr, "Could not parse `%s' into an instance name\n",
+	       argv[2+add_one]);
+      return LISP_RET_ERROR;
+    }
+    inst = find_table (id, glob_sim->getInstTable());
+    delete id;
+    if (!inst) {
+      fprintf (stderr, "%s: could not find instance `%s'\n", argv[0],
+	       argv[2+add_one]);
+      return LISP_RET_ERROR;
+    }
+  }
+
+  if (strcmp (argv[1+add_one], "-") == 0) {
+    fp = stdout;
+  }
+  else {
+    fp = fopen (argv[1+add_one], "w");
+    if (!fp) {
+      fprintf (stderr, "%s: could not open file `%s' for writing\n",
+	       argv[0], argv[1+add_one]);
+      return LISP_RET_ERROR;
+    }
+  }
+
+  const char *root = (argc == 2+add_one) ? "top" : argv[2+add_one];
+  if (add_one) {
+    actsim_prof_folded (fp, inst, root);
+  }
+  else {
+    actsim_prof_report (fp, inst, root);
+  }
+  if (fp != stdout) {
+    fclose (fp);
+  }
+  return LISP_RET_TRUE;
+}
+
+int process_progress (int argc, char **argv)
+{
+  if (argc == 2 && strcmp (argv[1], "off") == 0) {
+    actsim_mon_progress (0, NULL);
+    return LISP_RET_TRUE;
+  }
+  if ((argc != 2 && argc != 3) || atof (argv[1]) <= 0) {
+    fprintf (stderr, "Usage: %s <secs> [<file>]\n", argv[0]);
+    fprintf (stderr, "       %s off\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  if (!actsim_mon_progress (atof (argv[1]), argc == 3 ? argv[2] : NULL)) {
+    fprintf (stderr, "%s: could not open file `%s'\n", argv[0], argv[2]);
+    return LISP_RET_ERROR;
+  }
+  return LISP_RET_TRUE;
+}
+
+int process_watchdog (int argc, char **argv)
+{
+  if (argc == 2 && strcmp (argv[1], "off") == 0) {
+    for (int i=0; i < WD_NUM; i++) {
+      actsim_mon_watchdog (i, 0);
+    }
+    return LISP_RET_TRUE;
+  }
+  if (argc != 3) {
+    fprintf (stderr, "Usage: %s wall|events|time <limit>\n", argv[0]);
+    fprintf (stderr, "       %s off\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  if (strcmp (argv[1], "wall") == 0) {
+    actsim_mon_watchdog (WD_WALL, atof (argv[2]));
+  }
+  else if (strcmp (argv[1], "events") == 0) {
+    actsim_mon_watchdog (WD_EVENTS, atof (argv[2]));
+  }
+  else if (strcmp (argv[1], "time") == 0) {
+    actsim_mon_watchdog (WD_SIMTIME, atof (argv[2]));
+  }
+  else {
+    fprintf (stderr, "%s: unknown limit `%s'\n", argv[0], argv[1]);
+    return LISP_RET_ERROR;
+  }
+  return LISP_RET_TRUE;
+}
+
+int process_ckpt_every (int argc, char **argv)
+{
+  double v;
+  if (argc == 2 && strcmp (argv[1], "off") == 0) {
+    actsim_ckpt_every (NULL, 0, 0, NULL);
+    return LISP_RET_TRUE;
+  }
+  if (argc != 4) {
+    fprintf (stderr, "Usage: %s time|wall <interval> <dir>\n", argv[0]);
+    fprintf (stderr, "       %s off\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  v = atof (argv[2]);
+  if (v <= 0) {
+    fprintf (stderr, "%s: interval must be positive\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  if (strcmp (argv[1], "time") == 0) {
+    if (!actsim_ckpt_every (glob_sim, CKPT_SIMTIME, v, argv[3])) {
+      fprintf (stderr, "%s: could not use `%s'\n", argv[0], argv[3]);
+      return LISP_RET_ERROR;
+    }
+  }
+  else if (strcmp (argv[1], "wall") == 0) {
+    if (!actsim_ckpt_every (glob_sim, CKPT_WALLTIME, v, argv[3])) {
+      fprintf (stderr, "%s: could not use `%s'\n", argv[0], argv[3]);
+      return LISP_RET_ERROR;
+    }
+  }
+  else {
+    fprintf (stderr, "%s: unknown interval `%s'\n", argv[0], argv[1]);
+    return LISP_RET_ERROR;
+  }
+  return LISP_RET_TRUE;
+}
+
+/* names on a vector file header line "<tag> name name ...", as a
+   list of global Boolean offsets */
+static list_t *_vec_names (char *buf, const char *tag)
+{
+  list_t *l;
+  char *s = strtok (buf, " \t\n");
+  if (!s || strcmp (s, tag) != 0) {
+    fprintf (stderr, "vectors: expected `%s' line\n", tag);
+    return NULL;
+  }
+  l = list_new ();
+  while ((s = strtok (NULL, " \t\n"))) {
+    int type, offset;
+    if (!id_to_siminfo_glob (s, &type, &offset, NULL)) {
+      list_free (l);
+      return NULL;
+    }
+    if (type != 0) {
+      fprintf (stderr, "vectors: `%s' is not a Boolean\n", s);
+      list_free (l);
+      return NULL;
+    }
+    list_iappend (l, offset);
+  }
+  return l;
+}
+
+static int _vec_line (FILE *fp, char *buf, int sz)
+{
+  while (fgets (buf, sz, fp)) {
+    char *s = buf;
+    while (isspace (*s)) s++;
+    if (*s && *s != '#') {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void _vec_flush (FILE *out, PrsLaneSim *ls, int n, list_t *outs)
+{
+  unsigned long bad = ls->run ();
+  for (int l=0; l < n; l++) {
+    for (listitem_t *li = list_first (outs); li; li = list_next (li)) {
+      fprintf (out, "%s%c", li == list_first (outs) ? "" : " ",
+	       "01X"[ls->getLane (list_ivalue (li), l)]);
+    }
+    if (bad & (1UL << l)) {
+      fprintf (out, " # did not settle");
+    }
+    fprintf (out, "\n");
+  }
+}
+
+int process_vectors (int argc, char **argv)
+{
+  FILE *fp, *out;
+  char buf[10240];
+  list_t *ins, *outs;
+  PrsLaneSim *ls;
+  int ret = LISP_RET_ERROR;
+  int n = 0, nvec = 0;
+
+  if (argc != 3) {
+    fprintf (stderr, "Usage: %s <infile> <outfile>\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  fp = fopen (argv[1], "r");
+  if (!fp) {
+    fprintf (stderr, "%s: could not open `%s'\n", argv[0], argv[1]);
+    return LISP_RET_ERROR;
+  }
+  ins = NULL;
+  outs = NULL;
+  ls = NULL;
+  out = NULL;
+  if (!_vec_line (fp, buf, sizeof (buf)) ||
+      !(ins = _vec_names (buf, "in")) ||
+      !_vec_line (fp, buf, sizeof (buf)) ||
+      !(outs = _vec_names (buf, "out"))) {
+    goto done;
+  }
+  ls = new PrsLaneSim (glob_sim);
+  if (!ls->isValid ()) {
+    fprintf (stderr, "%s: pass transistors are not supported\n", argv[0]);
+    goto done;
+  }
+  out = fopen (argv[2], "w");
+  if (!out) {
+    fprintf (stderr, "%s: could not open `%s'\n", argv[0], argv[2]);
+    goto done;
+  }
+
+  /* PRS_LANES vectors at a time, each from the current state */
+  while (_vec_line (fp, buf, sizeof (buf))) {
+    char *s = strtok (buf, " \t\n");
+    if (n == 0) {
+      ls->loadState ();
+      ls->touchAll ();
+    }
+    for (listitem_t *li = list_first (ins); li; li = list_next (li)) {
+      int v;
+      if (!s || !strchr ("01Xx", *s) || s[1]) {
+	fprintf (stderr, "%s: vector %d: expected %d values of 0, 1, or X\n",
+		 argv[0], nvec + 1, list_length (ins));
+	goto done;
+      }
+      v = (*s == '0' ? 0 : (*s == '1' ? 1 : 2));
+      ls->setLanes (list_ivalue (li), 1UL << n, v);
+      s = strtok (NULL, " \t\n");
+    }
+    nvec++;
+    if (++n == PRS_LANES) {
+      _vec_flush (out, ls, n, outs);
+      n = 0;
+    }
+  }
+  if (n > 0) {
+    _vec_flush (out, ls, n, outs);
+  }
+  printf ("vectors: %d vectors, %lu rule evaluations\n", nvec,
+	  ls->numEvals ());
+  ret = LISP_RET_TRUE;
+
+done:
+  fclose (fp);
+  if (out) {
+    fclose (out);
+  }
+  if (ls) {
+    delete ls;
+  }
+  if (ins) {
+    list_free (ins);
+  }
+  if (outs) {
+    list_free (outs);
+  }
+  return ret;
+}
+
+/* list of ints to an array */
+static int *_vec_array (list_t *l)
+{
+  int *a;
+  int i = 0;
+  MALLOC (a, int, list_length (l) + 1);
+  for (listitem_t *li = list_first (l); li; li = list_next (li)) {
+    a[i++] = list_ivalue (li);
+  }
+  return a;
+}
+
+int process_faultsim (int argc, char **argv)
+{
+  FILE *fp, *report;
+  char buf[10240];
+  list_t *ins, *outs;
+  A_DECL (char, vecs);
+  int kinds = FAULT_STUCK | FAULT_TRANS;
+  int nvec = 0, nf, ndet;
+  int *ia, *oa;
+  int i = 1;
+  int ret = LISP_RET_ERROR;
+
+  if (i < argc && strcmp (argv[i], "-s") == 0) {
+    kinds = FAULT_STUCK;
+    i++;
+  }
+  else if (i < argc && strcmp (argv[i], "-t") == 0) {
+    kinds = FAULT_TRANS;
+    i++;
+  }
+  if (argc - i != 1 && argc - i != 2) {
+    fprintf (stderr, "Usage: %s [-s|-t] <vectors> [<report>]\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  fp = fopen (argv[i], "r");
+  if (!fp) {
+    fprintf (stderr, "%s: could not open `%s'\n", argv[0], argv[i]);
+    return LISP_RET_ERROR;
+  }
+  A_INIT (vecs);
+  ins = NULL;
+  outs = NULL;
+  ia = NULL;
+  oa = NULL;
+  report = NULL;
+  if (!_vec_line (fp, buf, sizeof (buf)) ||
+      !(ins = _vec_names (buf, "in")) ||
+      !_vec_line (fp, buf, sizeof (buf)) ||
+      !(outs = _vec_names (buf, "out"))) {
+    goto done;
+  }
+  while (_vec_line (fp, buf, sizeof (buf))) {
+    char *s = strtok (buf, " \t\n");
+    for (int j=0; j < list_length (ins); j++) {
+      if (!s || !strchr ("01Xx", *s) || s[1]) {
+	fprintf (stderr, "%s: vector %d: expected %d values of 0, 1, or X\n",
+		 argv[0], nvec + 1, list_length (ins));
+	goto done;
+      }
+      A_NEW (vecs, char);
+      A_NEXT (vecs) = (*s == '0' ? 0 : (*s == '1' ? 1 : 2));
+      A_INC (vecs);
+      s = strtok (NULL, " \t\n");
+    }
+    nvec++;
+  }
+  if (argc - i == 2) {
+    report = fopen (argv[i+1], "w");
+    if (!report) {
+      fprintf (stderr, "%s: could not open `%s'\n", argv[0], argv[i+1]);
+      goto done;
+    }
+  }
+  ia = _vec_array (ins);
+  oa = _vec_array (outs);
+  nf = actsim_faultsim (glob_sim, kinds, list_length (ins), ia,
+			list_length (outs), oa, nvec, vecs, report, &ndet);
+  if (nf < 0) {
+    goto done;
+  }
+  printf ("faultsim: %d vectors, %d faults, %d detected, coverage %.2f%%\n",
+	  nvec, nf, ndet, nf > 0 ? (100.0*ndet)/nf : 100.0);
+  ret = LISP_RET_TRUE;
+
+done:
+  fclose (fp);
+  if (report) {
+    fclose (report);
+  }
+  if (ins) {
+    list_free (ins);
+  }
+  if (outs) {
+    list_free (outs);
+  }
+  if (ia) {
+    FREE (ia);
+  }
+  if (oa) {
+    FREE (oa);
+  }
+  A_FREE (vecs);
+  return ret;
+}
+
+static int _run_script (void *cookie)
+{
+  FILE *fp = fopen ((char *) cookie, "r");
+  if (!fp) {
+    fprintf (stderr, "could not open script `%s'\n", (char *) cookie);
+    return 1;
+  }
+  while (!LispCliRun (fp)) {
+    if (LispInterruptExecution) {
+      break;
+    }
+  }
+  fclose (fp);
+  return 0;
+}
+
+int process_ensemble (int argc, char **argv)
+{
+  int jobs = sysconf (_SC_NPROCESSORS_ONLN);
+  const char *prefix = "ensemble";
+  int n, ret;
+  unsigned seed0, first;
+  int i = 1;
+
+  while (i+1 < argc && argv[i][0] == '-') {
+    if (strcmp (argv[i], "-j") == 0) {
+      jobs = atoi (argv[i+1]);
+    }
+    else if (strcmp (argv[i], "-o") == 0) {
+      prefix = argv[i+1];
+    }
+    else {
+      break;
+    }
+    i += 2;
+  }
+  if (argc - i != 3 || jobs <= 0 || (n = atoi (argv[i])) <= 0) {
+    fprintf (stderr, "Usage: %s [-j <jobs>] [-o <prefix>] <n> <seed> <script>\n",
+	     argv[0]);
+    return LISP_RET_ERROR;
+  }
+  seed0 = strtoul (argv[i+1], NULL, 0);
+
+  ret = actsim_ensemble (glob_sim, n, jobs, seed0, prefix,
+			 _run_script, argv[i+2], &first);
+  if (ret < 0) {
+    return LISP_RET_ERROR;
+  }
+  printf ("ensemble: %d runs, %d passed, %d failed", n, n - ret, ret);
+  if (ret > 0) {
+    printf ("; first failing seed: %u", first);
+  }
+  printf ("\n");
+  return ret == 0 ? LISP_RET_TRUE : LISP_RET_FALSE;
+}
+
+static int _branch_wait (pid_t p)
+{
+  int status;
+  while (waitpid (p, &status, 0) < 0) {
+    if (errno != EINTR) {
+      return -1;
+    }
+  }
+  return status;
+}
+
+/*
+  Snapshot the simulation with fork(). With no arguments the child
+  takes over the command line and the parent resumes from the
+  snapshot when it exits; otherwise each script runs in its own child,
+  all from the same snapshot, with output in <script>.out. With -o
+  <prefix>, the output goes to <prefix><file>.out instead, where <file>
+  is the script name without its directory.
+*/
+int process_branch (int argc, char **argv)
+{
+  pid_t p;
+  const char *prefix = NULL;
+  char **outs;
+  int nscr;
+
+  /* the children must not inherit pending trace output */
+  glob_sim->flushTrace ();
+  fflush (NULL);
+  if (argc == 1) {
+    p = fork ();
+    if (p < 0) {
+      fprintf (stderr, "%s: fork failed (%s)\n", argv[0], strerror (errno));
+      return LISP_RET_ERROR;
+    }
+    if (p == 0) {
+      glob_sim->detachTrace ();
+      printf ("branch: exploring from time ");
+      SimDES::CurTime().decPrint (stdout);
+      printf ("; exit to return to the snapshot\n");
+      while (!LispCliRun (stdin)) {
+	if (LispInterruptExecution) {
+	  fprintf (stderr, " *** interrupted\n");
+	}
+	clr_interrupt ();
+      }
+      fflush (NULL);
+      _exit (0);
+    }
+    _branch_wait (p);
+    clr_interrupt ();
+    printf ("branch: back at snapshot, time ");
+    SimDES::CurTime().decPrint (stdout);
+    printf ("\n");
+    return LISP_RET_TRUE;
+  }
+
+  if (strcmp (argv[1], "-o") == 0) {
+    if (argc < 4) {
+      fprintf (stderr, "Usage: %s [-o <prefix>] <script> ...\n", argv[0]);
+      return LISP_RET_ERROR;
+    }
+    prefix = argv[2];
+    argv += 2;
+    argc -= 2;
+  }
+  nscr = argc - 1;
+
+  pid_t *pids;
+  int nfail = 0;
+  MALLOC (pids, pid_t, nscr);
+  MALLOC (outs, char *, nscr);
+  for (int i=0; i < nscr; i++) {
+    const char *nm = argv[i+1];
+    if (prefix) {
+      const char *t = strrchr (nm, '/');
+      if (t) {
+	nm = t + 1;
+      }
+      MALLOC (outs[i], char, strlen (prefix) + strlen (nm) + 5);
+      sprintf (outs[i], "%s%s.out", prefix, nm);
+    }
+    else {
+      MALLOC (outs[i], char, strlen (nm) + 5);
+      sprintf (outs[i], "%s.out", nm);
+    }
+  }
+  for (int i=1; i < argc; i++) {
+    p = fork ();
+    if (p == 0) {
+      glob_sim->detachTrace ();
+      int fd = open (outs[i-1], O_WRONLY|O_CREAT|O_TRUNC, 0644);
+      if (fd < 0) {
+	_exit (3);
+      }
+      dup2 (fd, 1);
+      dup2 (fd, 2);
+      close (fd);
+      int ret = _run_script (argv[i]);
+      fflush (NULL);
+      _exit ((ret || glob_sim->numWarnings() > 0) ? 1 : 0);
+    }
+    pids[i-1] = p;
+    if (p < 0) {
+      fprintf (stderr, "%s: fork failed (%s)\n", argv[0], strerror (errno));
+    }
+  }
+  for (int i=1; i < argc; i++) {
+    int status = pids[i-1] < 0 ? -1 : _branch_wait (pids[i-1]);
+    printf ("branch %s: ", argv[i]);
+    if (status != -1 && WIFEXITED (status) && WEXITSTATUS (status) == 0) {
+      printf ("ok");
+    }
+    else {
+      nfail++;
+      if (status == -1) {
+	printf ("not run");
+      }
+      else if (WIFSIGNALED (status)) {
+	printf ("failed (signal %d)", WTERMSIG (status));
+      }
+      else {
+	printf ("failed (exit %d)", WEXITSTATUS (status));
+      }
+    }
+    printf ("; output in %s\n", outs[i-1]);
+    FREE (outs[i-1]);
+  }
+  FREE (outs);
+  FREE (pids);
+  clr_interrupt ();
+  return nfail == 0 ? LISP_RET_TRUE : LISP_RET_FALSE;
+}
+
+
+struct LispCliCommand Cmds[] = {
+  { NULL, "Initialization and setup", NULL },
+
+  { "echo", "[-n] args - display to screen", process_echo },
+  { "error", "<str> - report error and abort execution", process_error },
+  
+  { "initialize", "<proc> - initialize simulation for <proc>",
+    process_initialize },
+
+  { "mode", "reset|run - set running mode", process_mode },
+  
+  { "random", "[-u] [min max] - randomize timings; -u only randomizes unspecified times", process_random },
+  { "random_seed", "<val> - set random number seed", process_random_seed },
+  { "norandom", "- deterministic timing", process_norandom },
+  { "random_choice", "on|off - randomize non-deterministic choices", process_random_choice },
+  { "ensemble", "[-j <jobs>] [-o <prefix>] <n> <seed> <script> - run <script> from the current state with seeds <seed>..<seed>+<n>-1 in parallel", process_ensemble },
+  { "vectors", "<infile> <outfile> - zero-delay PRS simulation of the input vectors in <infile>, 64 at a time, from the current state", process_vectors },
+  { "faultsim", "[-s|-t] <vectors> [<report>] - fault coverage of the vectors for stuck-at (-s) and/or transition (-t) faults on production rule outputs", process_faultsim },
+
+  { "dumptc", "<file> - dump transition counts and switching energy of production rule outputs to a file", process_dumptc },
+  { "tcsnap", "[-v] <file> - append the transitions and switching energy since the last snapshot to a file", process_tcsnap },
+  { "tcreset", "- clear transition counts", process_tcreset },
+
+  { NULL, "Running simulation", NULL },
+
+  { "step", "[n] - run the next [n] events", process_step },
+  { "advance", "<delay> - run for <delay> time", process_advance },
+  { "cycle", "- run until simulation stops", process_cycle },
+  { "run-until", "<expr> [timeout] - run until <expr> is true, or for at most <timeout>", process_run_until },
+  { "progress", "<secs> [<file>]|off - report simulation progress every <secs> seconds", process_progress },
+  { "watchdog", "wall|events|time <limit>|off - stop each run after <limit> seconds, events, or simulation time; 0 clears", process_watchdog },
+  { "checkpoint-every", "time|wall <interval> <dir>|off - checkpoint to <dir> every <interval> of simulation time or wall-clock seconds", process_ckpt_every },
+
+  { "pending", "- dump pending events", process_pending },
+  { "branch", "[-o <prefix>] [<script> ...] - fork the simulation: explore interactively, or run each script from this point; the current state is kept", process_branch },
+  { "stats", "[reset|on|off] - show, clear, or enable simulator performance counters", process_stats },
+  { "stats_dump", "<file> <events>|off - write performance counters to <file> every <events> events", process_stats_dump },
+  
+  { "set", "<name> <val> - set a variable to a value", process_set },
+  { "gc-retry", "<name> - re-try guards in a deadlocked process", process_wakeup },
+  { "skip-comm", "<name> - skip the communication action", process_skipcomm },
+  
+  { "get", "<name> [#f] - get value of a variable; optional arg turns off display", process_get },
+  { "mget", "<name1> <name2> ... - multi-get value of a variable", process_mget },
+  { "handle", "<name> - return a handle for a variable, for use with hget/hset", process_handle },
+  { "hget", "<h> [#f] - get value of a variable using its handle", process_hget },
+  { "hset", "<h> <val> - set a variable to a value using its handle", process_hset },
+  { "chcount", "<name> [#f] - return the number of completed actions on named channel", process_chcount },
+
+  { "watch", "<n1> <n2> ... - add watchpoint for <n1> etc.", process_watch },
+  { "unwatch", "<n1> <n2> ... - delete watchpoint for <n1> etc.", process_unwatch },
+  { "watchall", "[<inst>] - trace all signals within <inst> (default: everything)", process_watchall },
   { "breakpt", "<n> - toggle breakpoint for <n>", process_breakpt },
   { "break", "<n> - toggle breakpoint for <n>", process_breakpt },
   { "assert", "<name> <value> - compares the value of a variable or the channel status to a wanted value - exists sim if exit-on-warn is set", process_assert },
@@ -1789,6 +3075,18 @@ struct LispCliCommand Cmds[] = {
   { "trace_stop", "[-fmt] - Stop trace file generation for specified format", process_stopalint },
   { "lxt2_start", "<file> - Create LXT2 format trace file for all watched values", process_createlxt2 },
   { "lxt2_stop", "- Stop LXT2 trace file generation", process_stoplxt2 },
+  { "ntrace_start", "<file> - Create indexed native trace file for all watched values (read with actsim-trace)", process_createntrace },
+  { "ntrace_stop", "- Stop native trace file generation", process_stopntrace },
+  { "trigger_window", "<pre> <post> - only trace <pre> time units before and <post> after a trigger", process_trigger_window },
+  { "trigger", "<name> <val> - trigger tracing when traced variable <name> becomes <val>", process_trigger },
+  { "trigger_count", "<chan> <n> - trigger tracing when traced channel <chan> completes <n> actions", process_trigger_count },
+  { "trigger_warn", "- trigger tracing on warnings", process_trigger_warn },
+  { "trigger_clear", "- remove all triggers and resume continuous tracing", process_trigger_clear },
+
+  { "chan_record", "<inst> <file> - log all tokens on the channel ports of <inst>", process_chan_record },
+  { "chan_record_stop", "- stop logging channel tokens", process_chan_record_stop },
+  { "chan_replay", "[<inst>] <file> - drive the channel ports of <inst> from a token log", process_chan_replay },
+  { "server", "<path> - serve the binary request protocol on a local socket", process_server },
 
 
 #if 0  
@@ -1813,6 +3111,8 @@ struct LispCliCommand Cmds[] = {
   { "procinfo", "<filename> [<inst-name>] - save the program counter for a process to file (- for stdout)", process_procinfo },
   { "energy", "[-v] <filename> [<inst-name>] - save energy usage to file (- for stdout)", process_getenergy },
   { "coverage", "<filename> [<inst-name>] - report coverage for guards", process_coverage },
+  { "profile", "on|off|reset - attribute events and host time to instances", process_profile },
+  { "profile_dump", "[-f] <filename> [<inst-name>] - save the profile sorted by cost; -f writes folded stacks for flamegraphs", process_profile_dump },
   { "goto", "[<inst-name>] <label> - for a single-threaded state, jump to label", process_goto }
 };
 
@@ -1858,11 +3158,28 @@ int main (int argc, char **argv)
   double d;
   int do_inline = 0;
   int monitors = 0;
-  while ((ch = getopt (argc, argv, "mS:p:nit:")) != -1) {
+  char *resume = NULL;
+  static struct option long_opts[] = {
+    { "resume", required_argument, NULL, 'R' },
+    { NULL, 0, NULL, 0 }
+  };
+  if (config_exists ("sim.profile_startup") &&
+      (config_get_int ("sim.profile_startup") == 1)) {
+    actsim_startup_on = 1;
+  }
+  while ((ch = getopt_long (argc, argv, "mS:p:nit:v", long_opts, NULL)) != -1) {
     switch (ch) {
+    case 'R':
+      resume = optarg;
+      break;
+
     case 'm':
       monitors = 1;
       break;
+
+    case 'v':
+      actsim_startup_on = 1;
+      break;
     case 't':
       d = atof (optarg);
       if (d <= 0) {
@@ -1920,9 +3237,12 @@ int main (int argc, char **argv)
   }
 
   /* read in the ACT file */
+  actsim_phase_begin ("read");
   glob_act = new Act (argv[optind]);
+  actsim_phase_end ();
 
   /* expand it */
+  actsim_phase_begin ("expand");
   glob_act->Expand ();
 
   /* map to cells: these get characterized */
@@ -1944,22 +3264,28 @@ int main (int argc, char **argv)
   if (!p->isExpanded()) {
     fatal_error ("Process `%s' is not expanded.", procname);
   }
+  actsim_phase_end ();
 
   /* inline if specified */
   if (do_inline) {
+    actsim_phase_begin ("inline");
     ActCHPFuncInline *ip = new ActCHPFuncInline (glob_act);
     ip->run (p);
+    actsim_phase_end ();
   }
   
   glob_top = p;
 
   /* do stuff here */
+  actsim_phase_begin ("state pass");
   glob_sp = new ActStatePass (glob_act);
   glob_sp->run (p);
+  actsim_phase_end ();
 
   /* check if we have an SDF file specified */
   SDF *sdf_data = NULL;
   if (config_exists ("sim.sdf_file")) {
+    actsim_phase_begin ("sdf");
     sdf_data = new SDF (config_get_int ("sim.sdf_mangled_names") ? true : false);
     if (!sdf_data->Read (config_get_string ("sim.sdf_file"))) {
       warning ("SDF file `%s': reading failed; omitting.",
@@ -1967,6 +3293,7 @@ int main (int argc, char **argv)
       delete sdf_data;
       sdf_data = NULL;
     }
+    actsim_phase_end ();
   }
   
   if (monitors) {
@@ -1976,11 +3303,24 @@ int main (int argc, char **argv)
     ActExclMonitor::enable = false;
   }
 
+  actsim_phase_begin ("build");
   glob_sim = new ActSim (p, sdf_data);
+  actsim_phase_end ();
   glob_dummy = new DummyObject ();
+  actsim_phase_begin ("init");
   glob_sim->runInit ();
+  actsim_phase_end ();
   ActExclConstraint::_sc = glob_sim;
 
+  if (resume && !actsim_ckpt_resume (glob_sim, resume)) {
+    fatal_error ("Could not resume from `%s'", resume);
+  }
+
+  if (actsim_startup_on) {
+    actsim_phase_report (stderr);
+    glob_sim->printCounts (stderr);
+  }
+
 
   signal (SIGINT, signal_handler);
 
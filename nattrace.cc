@@ -0,0 +1,607 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2026 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <string.h>
+#include <stdlib.h>
+#include <zlib.h>
+#include <common/misc.h>
+#include <act/tracelib.h>
+#include "nattrace.h"
+
+#define NATTRACE_MAGIC   "ACTSIMTR"
+#define NATTRACE_TRAILER "ACTSIMTX"
+#define NATTRACE_VERSION 1
+#define NATTRACE_CHUNK_MAGIC 0x43544341UL /* "ACTC" */
+
+/* uncompressed chunk size */
+#define NATTRACE_CHUNK_SIZE (1 << 18)
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Encoding helpers
+ *
+ *------------------------------------------------------------------------
+ */
+static void put_u32 (FILE *fp, unsigned long v)
+{
+  unsigned char b[4];
+  for (int i=0; i < 4; i++) {
+    b[i] = (v >> (8*i)) & 0xff;
+  }
+  fwrite (b, 1, 4, fp);
+}
+
+static void put_u64 (FILE *fp, unsigned long v)
+{
+  put_u32 (fp, v & 0xffffffffUL);
+  put_u32 (fp, (v >> 32) & 0xffffffffUL);
+}
+
+static int get_u32 (FILE *fp, unsigned long *v)
+{
+  unsigned char b[4];
+  if (fread (b, 1, 4, fp) != 4) {
+    return 0;
+  }
+  *v = 0;
+  for (int i=0; i < 4; i++) {
+    *v |= ((unsigned long)b[i]) << (8*i);
+  }
+  return 1;
+}
+
+static int get_u64 (FILE *fp, unsigned long *v)
+{
+  unsigned long lo, hi;
+  if (!get_u32 (fp, &lo) || !get_u32 (fp, &hi)) {
+    return 0;
+  }
+  *v = lo | (hi << 32);
+  return 1;
+}
+
+/* varints in the uncompressed chunk */
+static unsigned char *put_var (unsigned char *p, unsigned long v)
+{
+  while (v >= 0x80) {
+    *p++ = (v & 0x7f) | 0x80;
+    v >>= 7;
+  }
+  *p++ = v;
+  return p;
+}
+
+static const unsigned char *get_var (const unsigned char *p,
+				     const unsigned char *end,
+				     unsigned long *v)
+{
+  int sh = 0;
+  *v = 0;
+  while (p < end) {
+    *v |= ((unsigned long)(*p & 0x7f)) << sh;
+    if (!(*p++ & 0x80)) {
+      return p;
+    }
+    sh += 7;
+  }
+  return NULL;
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Writer
+ *
+ *------------------------------------------------------------------------
+ */
+NatTraceWriter::NatTraceWriter ()
+{
+  _fp = NULL;
+  _ts = 0;
+  _sigs = NULL;
+  _nsigs = 0;
+  _maxsigs = 0;
+  _started = 0;
+  _buf = NULL;
+  _len = 0;
+  _max = 0;
+  _nchg = 0;
+  _tmin = 0;
+  _tmax = 0;
+  _tlast = 0;
+  _inchunk = NULL;
+  _ids = NULL;
+  _nids = 0;
+  _chunks = NULL;
+  _nchunks = 0;
+  _maxchunks = 0;
+}
+
+NatTraceWriter *NatTraceWriter::create (const char *file, double timescale)
+{
+  FILE *fp = fopen (file, "wb");
+  if (!fp) {
+    return NULL;
+  }
+  NatTraceWriter *w = new NatTraceWriter ();
+  w->_fp = fp;
+  w->_ts = timescale;
+  return w;
+}
+
+int NatTraceWriter::addSignal (int type, const char *name, int width)
+{
+  if (_started) {
+    return -1;
+  }
+  if (_nsigs == _maxsigs) {
+    _maxsigs = (_maxsigs == 0 ? 64 : 2*_maxsigs);
+    REALLOC (_sigs, struct nattrace_sig, _maxsigs);
+  }
+  _sigs[_nsigs].name = Strdup (name);
+  _sigs[_nsigs].type = type;
+  _sigs[_nsigs].width = width;
+  return _nsigs++;
+}
+
+void NatTraceWriter::_header ()
+{
+  fwrite (NATTRACE_MAGIC, 1, 8, _fp);
+  put_u32 (_fp, NATTRACE_VERSION);
+  unsigned long tsbits;
+  memcpy (&tsbits, &_ts, sizeof (double));
+  put_u64 (_fp, tsbits);
+  put_u32 (_fp, _nsigs);
+  for (int i=0; i < _nsigs; i++) {
+    int len = strlen (_sigs[i].name);
+    put_u32 (_fp, _sigs[i].type);
+    put_u32 (_fp, _sigs[i].width);
+    put_u32 (_fp, len);
+    fwrite (_sigs[i].name, 1, len, _fp);
+  }
+
+  _max = NATTRACE_CHUNK_SIZE;
+  MALLOC (_buf, unsigned char, _max);
+  if (_nsigs > 0) {
+    MALLOC (_inchunk, unsigned char, _nsigs);
+    MALLOC (_ids, int, _nsigs);
+    for (int i=0; i < _nsigs; i++) {
+      _inchunk[i] = 0;
+    }
+  }
+  _started = 1;
+}
+
+static int _int_cmp (const void *a, const void *b)
+{
+  return *((const int *)a) - *((const int *)b);
+}
+
+void NatTraceWriter::_flush ()
+{
+  unsigned char *cbuf;
+  uLongf clen;
+
+  if (_nchg == 0) {
+    return;
+  }
+
+  clen = compressBound (_len);
+  MALLOC (cbuf, unsigned char, clen);
+  if (compress2 (cbuf, &clen, _buf, _len, Z_DEFAULT_COMPRESSION) != Z_OK) {
+    fatal_error ("nattrace: compression failed");
+  }
+
+  if (_nchunks == _maxchunks) {
+    _maxchunks = (_maxchunks == 0 ? 64 : 2*_maxchunks);
+    REALLOC (_chunks, struct nattrace_chunk, _maxchunks);
+  }
+  _chunks[_nchunks].off = ftell (_fp);
+  _chunks[_nchunks].tmin = _tmin;
+  _chunks[_nchunks].tmax = _tmax;
+  _nchunks++;
+
+  qsort (_ids, _nids, sizeof (int), _int_cmp);
+  put_u32 (_fp, NATTRACE_CHUNK_MAGIC);
+  put_u32 (_fp, _len);
+  put_u32 (_fp, clen);
+  put_u64 (_fp, _tmin);
+  put_u64 (_fp, _tmax);
+  put_u32 (_fp, _nids);
+  for (int i=0; i < _nids; i++) {
+    put_u32 (_fp, _ids[i]);
+    _inchunk[_ids[i]] = 0;
+  }
+  fwrite (cbuf, 1, clen, _fp);
+  FREE (cbuf);
+
+  _len = 0;
+  _nchg = 0;
+  _nids = 0;
+}
+
+/*
+ * change record: id, time delta, state, #words, words
+ */
+void NatTraceWriter::change (int id, unsigned long tm, int state,
+			     int nv, const unsigned long *v)
+{
+  unsigned char *p;
+  unsigned long bv;
+
+  if (!_started) {
+    _header ();
+  }
+  if (id < 0 || id >= _nsigs) {
+    return;
+  }
+  if (_sigs[id].type == NATTRACE_BOOL) {
+    if (v[0] == ACT_SIG_BOOL_FALSE) {
+      bv = NATTRACE_V0;
+    }
+    else if (v[0] == ACT_SIG_BOOL_TRUE) {
+      bv = NATTRACE_V1;
+    }
+    else {
+      bv = NATTRACE_VX;
+    }
+    v = &bv;
+    nv = 1;
+  }
+  if (_len + 10*(4 + nv) > _max) {
+    _flush ();
+    if (10*(4 + nv) > _max) {
+      _max = 10*(4 + nv);
+      REALLOC (_buf, unsigned char, _max);
+    }
+  }
+  if (_nchg == 0) {
+    _tmin = tm;
+    _tlast = tm;
+  }
+  if (tm < _tlast) {
+    /* times are expected to be non-decreasing */
+    tm = _tlast;
+  }
+  p = _buf + _len;
+  p = put_var (p, id);
+  p = put_var (p, tm - _tlast);
+  p = put_var (p, state);
+  p = put_var (p, nv);
+  for (int i=0; i < nv; i++) {
+    p = put_var (p, v[i]);
+  }
+  _len = p - _buf;
+  _tlast = tm;
+  _tmax = tm;
+  _nchg++;
+  if (!_inchunk[id]) {
+    _inchunk[id] = 1;
+    _ids[_nids++] = id;
+  }
+}
+
+NatTraceWriter::~NatTraceWriter ()
+{
+  if (!_started) {
+    _header ();
+  }
+  _flush ();
+
+  unsigned long idx = ftell (_fp);
+  put_u32 (_fp, _nchunks);
+  for (int i=0; i < _nchunks; i++) {
+    put_u64 (_fp, _chunks[i].off);
+    put_u64 (_fp, _chunks[i].tmin);
+    put_u64 (_fp, _chunks[i].tmax);
+  }
+  put_u64 (_fp, idx);
+  fwrite (NATTRACE_TRAILER, 1, 8, _fp);
+  fclose (_fp);
+
+  for (int i=0; i < _nsigs; i++) {
+    FREE (_sigs[i].name);
+  }
+  if (_sigs) {
+    FREE (_sigs);
+  }
+  if (_buf) {
+    FREE (_buf);
+  }
+  if (_inchunk) {
+    FREE (_inchunk);
+    FREE (_ids);
+  }
+  if (_chunks) {
+    FREE (_chunks);
+  }
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Reader
+ *
+ *------------------------------------------------------------------------
+ */
+NatTraceReader::NatTraceReader ()
+{
+  _fp = NULL;
+  _ts = 0;
+  _data = 0;
+  _sigs = NULL;
+  _nsigs = 0;
+  _chunks = NULL;
+  _nchunks = 0;
+}
+
+NatTraceReader::~NatTraceReader ()
+{
+  if (_fp) {
+    fclose (_fp);
+  }
+  for (int i=0; i < _nsigs; i++) {
+    FREE (_sigs[i].name);
+  }
+  if (_sigs) {
+    FREE (_sigs);
+  }
+  if (_chunks) {
+    FREE (_chunks);
+  }
+}
+
+NatTraceReader *NatTraceReader::open (const char *file)
+{
+  char magic[8];
+  unsigned long v, n, tsbits;
+  NatTraceReader *r;
+  FILE *fp;
+
+  fp = fopen (file, "rb");
+  if (!fp) {
+    return NULL;
+  }
+  r = new NatTraceReader ();
+  r->_fp = fp;
+
+  if (fread (magic, 1, 8, fp) != 8 ||
+      strncmp (magic, NATTRACE_MAGIC, 8) != 0 ||
+      !get_u32 (fp, &v) || v != NATTRACE_VERSION ||
+      !get_u64 (fp, &tsbits) ||
+      !get_u32 (fp, &n)) {
+    delete r;
+    return NULL;
+  }
+  memcpy (&r->_ts, &tsbits, sizeof (double));
+  if (n > 0) {
+    MALLOC (r->_sigs, struct nattrace_sig, n);
+  }
+  for (unsigned long i=0; i < n; i++) {
+    unsigned long type, width, len;
+    if (!get_u32 (fp, &type) || !get_u32 (fp, &width) ||
+	!get_u32 (fp, &len)) {
+      delete r;
+      return NULL;
+    }
+    MALLOC (r->_sigs[i].name, char, len + 1);
+    r->_nsigs++;
+    if (fread (r->_sigs[i].name, 1, len, fp) != len) {
+      delete r;
+      return NULL;
+    }
+    r->_sigs[i].name[len] = '\0';
+    r->_sigs[i].type = type;
+    r->_sigs[i].width = width;
+  }
+  r->_data = ftell (fp);
+
+  /* use the index if the file was closed properly; otherwise walk
+     the chunk headers */
+  if (!r->_read_index () && !r->_scan_chunks ()) {
+    delete r;
+    return NULL;
+  }
+  return r;
+}
+
+int NatTraceReader::_read_index ()
+{
+  char magic[8];
+  unsigned long idx, n;
+
+  if (fseek (_fp, -16, SEEK_END) != 0) {
+    return 0;
+  }
+  if (!get_u64 (_fp, &idx) || fread (magic, 1, 8, _fp) != 8 ||
+      strncmp (magic, NATTRACE_TRAILER, 8) != 0) {
+    return 0;
+  }
+  if (fseek (_fp, idx, SEEK_SET) != 0 || !get_u32 (_fp, &n)) {
+    return 0;
+  }
+  if (n > 0) {
+    MALLOC (_chunks, struct nattrace_chunk, n);
+  }
+  for (unsigned long i=0; i < n; i++) {
+    if (!get_u64 (_fp, &_chunks[i].off) ||
+	!get_u64 (_fp, &_chunks[i].tmin) ||
+	!get_u64 (_fp, &_chunks[i].tmax)) {
+      return 0;
+    }
+  }
+  _nchunks = n;
+  return 1;
+}
+
+int NatTraceReader::_scan_chunks ()
+{
+  unsigned long off = _data;
+  int max = 0;
+
+  if (_chunks) {
+    FREE (_chunks);
+    _chunks = NULL;
+  }
+  _nchunks = 0;
+  while (fseek (_fp, off, SEEK_SET) == 0) {
+    unsigned long magic, len, clen, tmin, tmax, nids;
+    if (!get_u32 (_fp, &magic) || magic != NATTRACE_CHUNK_MAGIC ||
+	!get_u32 (_fp, &len) || !get_u32 (_fp, &clen) ||
+	!get_u64 (_fp, &tmin) || !get_u64 (_fp, &tmax) ||
+	!get_u32 (_fp, &nids)) {
+      break;
+    }
+    if (_nchunks == max) {
+      max = (max == 0 ? 64 : 2*max);
+      REALLOC (_chunks, struct nattrace_chunk, max);
+    }
+    _chunks[_nchunks].off = off;
+    _chunks[_nchunks].tmin = tmin;
+    _chunks[_nchunks].tmax = tmax;
+    _nchunks++;
+    off += 32 + 4*nids + clen;
+  }
+  return 1;
+}
+
+int NatTraceReader::findSignal (const char *name)
+{
+  for (int i=0; i < _nsigs; i++) {
+    if (strcmp (_sigs[i].name, name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int NatTraceReader::scan (unsigned long t0, unsigned long t1,
+			  const unsigned char *sel,
+			  void (*fn) (void *, const struct nattrace_change *),
+			  void *cookie)
+{
+  unsigned char *buf = NULL, *cbuf = NULL;
+  unsigned long bufsz = 0, cbufsz = 0;
+  unsigned long *vals = NULL;
+  unsigned long nvals = 0;
+  int ret = 1;
+
+  for (int i=0; i < _nchunks && ret; i++) {
+    unsigned long magic, len, clen, tmin, tmax, nids;
+
+    if (_chunks[i].tmax < t0 || _chunks[i].tmin > t1) {
+      continue;
+    }
+    if (fseek (_fp, _chunks[i].off, SEEK_SET) != 0 ||
+	!get_u32 (_fp, &magic) || magic != NATTRACE_CHUNK_MAGIC ||
+	!get_u32 (_fp, &len) || !get_u32 (_fp, &clen) ||
+	!get_u64 (_fp, &tmin) || !get_u64 (_fp, &tmax) ||
+	!get_u32 (_fp, &nids)) {
+      ret = 0;
+      break;
+    }
+
+    /* skip chunks without any selected signal */
+    int found = (sel == NULL ? 1 : 0);
+    for (unsigned long j=0; j < nids; j++) {
+      unsigned long id;
+      if (!get_u32 (_fp, &id)) {
+	ret = 0;
+	break;
+      }
+      if (!found && id < (unsigned long)_nsigs && sel[id]) {
+	found = 1;
+      }
+    }
+    if (!ret) break;
+    if (!found) continue;
+
+    if (fseek (_fp, _chunks[i].off + 32 + 4*nids, SEEK_SET) != 0) {
+      ret = 0;
+      break;
+    }
+    if (clen > cbufsz) {
+      cbufsz = clen;
+      REALLOC (cbuf, unsigned char, cbufsz);
+    }
+    if (len > bufsz) {
+      bufsz = len;
+      REALLOC (buf, unsigned char, bufsz);
+    }
+    if (fread (cbuf, 1, clen, _fp) != clen) {
+      ret = 0;
+      break;
+    }
+    uLongf dlen = len;
+    if (uncompress (buf, &dlen, cbuf, clen) != Z_OK || dlen != len) {
+      ret = 0;
+      break;
+    }
+
+    const unsigned char *p = buf, *end = buf + len;
+    unsigned long tm = tmin;
+    while (p && p < end) {
+      unsigned long id, dt, state, nv;
+      struct nattrace_change c;
+
+      if (!(p = get_var (p, end, &id)) || !(p = get_var (p, end, &dt)) ||
+	  !(p = get_var (p, end, &state)) || !(p = get_var (p, end, &nv))) {
+	ret = 0;
+	break;
+      }
+      if (nv > nvals) {
+	nvals = nv;
+	REALLOC (vals, unsigned long, nvals);
+      }
+      for (unsigned long j=0; j < nv; j++) {
+	if (!(p = get_var (p, end, &vals[j]))) {
+	  ret = 0;
+	  break;
+	}
+      }
+      if (!ret) break;
+      tm += dt;
+      if (tm > t1) {
+	break;
+      }
+      if (tm < t0 || id >= (unsigned long)_nsigs || (sel && !sel[id])) {
+	continue;
+      }
+      c.id = id;
+      c.tm = tm;
+      c.state = state;
+      c.nv = nv;
+      c.v = vals;
+      (*fn) (cookie, &c);
+    }
+  }
+  if (buf) {
+    FREE (buf);
+  }
+  if (cbuf) {
+    FREE (cbuf);
+  }
+  if (vals) {
+    FREE (vals);
+  }
+  return ret;
+}
@@ -0,0 +1,149 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2026 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#ifndef __ACTSIM_NATTRACE_H__
+#define __ACTSIM_NATTRACE_H__
+
+#include <stdio.h>
+
+/*
+ * actsim native trace format
+ *
+ *  header : "ACTSIMTR", version, timescale, signal table
+ *  chunks : zlib-compressed blocks of changes. Each chunk header
+ *           has the time range and the sorted list of signal ids
+ *           that change in the chunk.
+ *  index  : (file offset, tmin, tmax) for each chunk, followed by a
+ *           trailer with the index offset.
+ *
+ * All integers are stored little-endian. Times are the low 64 bits
+ * of the simulation time in integer units. The timescale is a double,
+ * stored as its IEEE-754 bits in a little-endian 64-bit integer.
+ */
+
+#define NATTRACE_BOOL 0
+#define NATTRACE_INT  1
+#define NATTRACE_CHAN 2
+
+/* bool values */
+#define NATTRACE_V0 0
+#define NATTRACE_V1 1
+#define NATTRACE_VX 2
+
+struct nattrace_sig {
+  char *name;
+  int type;			// NATTRACE_BOOL, ...
+  int width;
+};
+
+struct nattrace_chunk {
+  unsigned long off;		// file offset of the chunk header
+  unsigned long tmin, tmax;	// time range of changes in the chunk
+};
+
+/* one change */
+struct nattrace_change {
+  int id;			// signal
+  unsigned long tm;		// time
+  int state;			// channel state, unused otherwise
+  int nv;			// number of value words
+  const unsigned long *v;	// value
+};
+
+
+class NatTraceWriter {
+public:
+  /* returns NULL on failure */
+  static NatTraceWriter *create (const char *file, double timescale);
+  ~NatTraceWriter ();		/* flush, write index, close */
+
+  /* signals can only be added before the first change */
+  int addSignal (int type, const char *name, int width);
+
+  /* Boolean values use the trace library encoding (ACT_SIG_BOOL_*) */
+  void change (int id, unsigned long tm, int state,
+	       int nv, const unsigned long *v);
+
+private:
+  NatTraceWriter ();
+  void _header ();
+  void _flush ();
+
+  FILE *_fp;
+  double _ts;
+
+  struct nattrace_sig *_sigs;
+  int _nsigs, _maxsigs;
+  int _started;
+
+  unsigned char *_buf;		// uncompressed chunk
+  unsigned long _len, _max;
+  unsigned long _tmin, _tmax, _tlast;
+  int _nchg;
+
+  unsigned char *_inchunk;	// signal present in current chunk
+  int *_ids;			// ... list of such signals
+  int _nids;
+
+  struct nattrace_chunk *_chunks;
+  int _nchunks, _maxchunks;
+};
+
+
+class NatTraceReader {
+public:
+  /* returns NULL on failure */
+  static NatTraceReader *open (const char *file);
+  ~NatTraceReader ();
+
+  int numSignals () { return _nsigs; }
+  const struct nattrace_sig *getSignal (int id) { return &_sigs[id]; }
+  int findSignal (const char *name); // -1 if not found
+  double getTimescale () { return _ts; }
+  int numChunks () { return _nchunks; }
+
+  /*
+   * Call fn for every change in [t0, t1] to one of the signals in
+   * sel (all signals if sel is NULL). Only chunks that overlap the
+   * time window and contain a selected signal are decompressed.
+   * Returns 0 on a read error.
+   */
+  int scan (unsigned long t0, unsigned long t1, const unsigned char *sel,
+	    void (*fn) (void *, const struct nattrace_change *),
+	    void *cookie);
+
+private:
+  NatTraceReader ();
+  int _read_index ();
+  int _scan_chunks ();
+
+  FILE *_fp;
+  double _ts;
+  unsigned long _data;		// offset of the first chunk
+
+  struct nattrace_sig *_sigs;
+  int _nsigs;
+
+  struct nattrace_chunk *_chunks;
+  int _nchunks;
+};
+
+#endif /* __ACTSIM_NATTRACE_H__ */
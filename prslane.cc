@@ -0,0 +1,523 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2026 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <stdio.h>
+#include "prslane.h"
+#include "prssim.h"
+
+#define LANE_END (PRSSIM_EXPR_FALSE + 1)
+
+/* evaluations per node before oscillating lanes are set to X */
+#define LANE_EVAL_LIMIT 100
+
+#define ALL_LANES (~0UL)
+
+PrsLaneSim::PrsLaneSim (ActSim *sim)
+{
+  int *cnt;
+  
+  _sim = sim;
+  _valid = 1;
+  _nbools = sim->getState()->numBools();
+  _nevals = 0;
+  _maxdepth = 1;
+  _f0 = NULL;
+  _f1 = NULL;
+  A_INIT (_code);
+  A_INIT (_rules);
+
+  MALLOC (_first, int, _nbools + 1);
+  for (int i=0; i < _nbools; i++) {
+    _first[i] = -1;
+  }
+  _walk (sim->getInstTable ());
+
+  /*-- driven nodes --*/
+  _nnodes = 0;
+  for (int i=0; i < _nbools; i++) {
+    if (_first[i] != -1) {
+      _nnodes++;
+    }
+  }
+  MALLOC (_nodes, int, _nnodes + 1);
+  _nnodes = 0;
+  for (int i=0; i < _nbools; i++) {
+    if (_first[i] != -1) {
+      _nodes[_nnodes++] = i;
+    }
+  }
+
+  /*-- fanout: count, then fill --*/
+  MALLOC (_fo_start, int, _nbools + 1);
+  MALLOC (cnt, int, _nbools + 1);
+  for (int i=0; i <= _nbools; i++) {
+    cnt[i] = 0;
+  }
+  for (int pass=0; pass < 2; pass++) {
+    for (int n=0; n < _nnodes; n++) {
+      for (int r = _first[_nodes[n]]; r != -1; r = _rules[r].next) {
+	for (int k=0; k < 4; k++) {
+	  int pc = (k < 2 ? _rules[r].up[k] : _rules[r].dn[k-2]);
+	  if (pc == -1) continue;
+	  for (; _code[pc] != LANE_END; pc++) {
+	    if (_code[pc] == PRSSIM_EXPR_VAR) {
+	      pc++;
+	      if (pass == 0) {
+		cnt[_code[pc]]++;
+	      }
+	      else {
+		_fo[_fo_start[_code[pc]] + cnt[_code[pc]]++] = _nodes[n];
+	      }
+	    }
+	  }
+	}
+      }
+    }
+    if (pass == 0) {
+      _fo_start[0] = 0;
+      for (int i=0; i < _nbools; i++) {
+	_fo_start[i+1] = _fo_start[i] + cnt[i];
+	cnt[i] = 0;
+      }
+      MALLOC (_fo, int, _fo_start[_nbools] + 1);
+    }
+  }
+  FREE (cnt);
+
+  MALLOC (_v, unsigned long, _nbools + 1);
+  MALLOC (_x, unsigned long, _nbools + 1);
+  MALLOC (_q, int, _nbools + 1);
+  MALLOC (_inq, char, _nbools + 1);
+  for (int i=0; i < _nbools; i++) {
+    _v[i] = 0;
+    _x[i] = ALL_LANES;
+    _inq[i] = 0;
+  }
+  _qhead = 0;
+  _qtail = 0;
+  MALLOC (_sv, unsigned long, _maxdepth);
+  MALLOC (_sx, unsigned long, _maxdepth);
+}
+
+PrsLaneSim::~PrsLaneSim ()
+{
+  A_FREE (_code);
+  A_FREE (_rules);
+  FREE (_first);
+  FREE (_nodes);
+  FREE (_fo_start);
+  FREE (_fo);
+  FREE (_v);
+  FREE (_x);
+  FREE (_q);
+  FREE (_inq);
+  FREE (_sv);
+  FREE (_sx);
+  clearForces ();
+}
+
+void PrsLaneSim::_walk (ActInstTable *t)
+{
+  if (t->obj) {
+    PrsSim *p = dynamic_cast<PrsSim *> (t->obj);
+    if (p) {
+      _add (p);
+    }
+  }
+  if (t->H) {
+    hash_bucket_t *b;
+    hash_iter_t it;
+    hash_iter_init (t->H, &it);
+    while ((b = hash_iter_next (t->H, &it))) {
+      _walk ((ActInstTable *) b->v);
+    }
+  }
+}
+
+void PrsLaneSim::_add (PrsSim *p)
+{
+  for (int i=0; i < p->numRules(); i++) {
+    prssim_stmt *s = p->getRule (i)->getStmt ();
+    if (s->type != PRSSIM_RULE) {
+      _valid = 0;
+      continue;
+    }
+    int gid = p->myGid (s->vid);
+    A_NEW (_rules, lane_rule);
+    for (int k=0; k < 2; k++) {
+      int d;
+      A_NEXT (_rules).up[k] = -1;
+      A_NEXT (_rules).dn[k] = -1;
+      if (s->up[k]) {
+	A_NEXT (_rules).up[k] = A_LEN (_code);
+	d = _compile (p, s->up[k]);
+	if (d > _maxdepth) _maxdepth = d;
+	A_NEW (_code, int);
+	A_NEXT (_code) = LANE_END;
+	A_INC (_code);
+      }
+      if (s->dn[k]) {
+	A_NEXT (_rules).dn[k] = A_LEN (_code);
+	d = _compile (p, s->dn[k]);
+	if (d > _maxdepth) _maxdepth = d;
+	A_NEW (_code, int);
+	A_NEXT (_code) = LANE_END;
+	A_INC (_code);
+      }
+    }
+    A_NEXT (_rules).obj = p->getRule (i);
+    A_NEXT (_rules).next = _first[gid];
+    _first[gid] = A_LEN (_rules);
+    A_INC (_rules);
+  }
+}
+
+/* emit postfix code for e; returns the stack depth it needs */
+int PrsLaneSim::_compile (PrsSim *p, prssim_expr *e)
+{
+  int a, b;
+  switch (e->type) {
+  case PRSSIM_EXPR_AND:
+  case PRSSIM_EXPR_OR:
+    a = _compile (p, e->l);
+    b = _compile (p, e->r) + 1;
+    A_NEW (_code, int);
+    A_NEXT (_code) = e->type;
+    A_INC (_code);
+    return a > b ? a : b;
+
+  case PRSSIM_EXPR_NOT:
+    a = _compile (p, e->l);
+    A_NEW (_code, int);
+    A_NEXT (_code) = e->type;
+    A_INC (_code);
+    return a;
+
+  case PRSSIM_EXPR_VAR:
+    A_NEW (_code, int);
+    A_NEXT (_code) = e->type;
+    A_INC (_code);
+    A_NEW (_code, int);
+    A_NEXT (_code) = p->myGid (e->vid);
+    A_INC (_code);
+    return 1;
+
+  case PRSSIM_EXPR_TRUE:
+  case PRSSIM_EXPR_FALSE:
+    A_NEW (_code, int);
+    A_NEXT (_code) = e->type;
+    A_INC (_code);
+    return 1;
+
+  default:
+    fatal_error ("What?");
+    break;
+  }
+  return 0;
+}
+
+/* three-valued evaluation of 64 lanes; X lanes have v = 0 */
+void PrsLaneSim::_eval (int pc, unsigned long *v, unsigned long *x)
+{
+  int sp = 0;
+  unsigned long av, ax, bv, bx;
+
+  if (pc == -1) {
+    *v = 0;
+    *x = 0;
+    return;
+  }
+  for (; _code[pc] != LANE_END; pc++) {
+    switch (_code[pc]) {
+    case PRSSIM_EXPR_AND:
+      sp--;
+      av = _sv[sp-1]; ax = _sx[sp-1];
+      bv = _sv[sp]; bx = _sx[sp];
+      _sv[sp-1] = av & bv;
+      _sx[sp-1] = ~((~av & ~ax) | (~bv & ~bx)) & ~(av & bv);
+      break;
+
+    case PRSSIM_EXPR_OR:
+      sp--;
+      av = _sv[sp-1] | _sv[sp];
+      _sv[sp-1] = av;
+      _sx[sp-1] = (_sx[sp-1] | _sx[sp]) & ~av;
+      break;
+
+    case PRSSIM_EXPR_NOT:
+      _sv[sp-1] = ~_sv[sp-1] & ~_sx[sp-1];
+      break;
+
+    case PRSSIM_EXPR_VAR:
+      pc++;
+      _sv[sp] = _v[_code[pc]];
+      _sx[sp] = _x[_code[pc]];
+      sp++;
+      break;
+
+    case PRSSIM_EXPR_TRUE:
+      _sv[sp] = ALL_LANES;
+      _sx[sp] = 0;
+      sp++;
+      break;
+
+    case PRSSIM_EXPR_FALSE:
+      _sv[sp] = 0;
+      _sx[sp] = 0;
+      sp++;
+      break;
+    }
+  }
+  *v = _sv[0];
+  *x = _sx[0];
+}
+
+void PrsLaneSim::_push (int gid)
+{
+  if (_inq[gid]) {
+    return;
+  }
+  _inq[gid] = 1;
+  _q[_qtail] = gid;
+  _qtail = (_qtail + 1) % (_nbools + 1);
+}
+
+void PrsLaneSim::_fanout (int gid)
+{
+  for (int i=_fo_start[gid]; i < _fo_start[gid+1]; i++) {
+    _push (_fo[i]);
+  }
+}
+
+/*
+ * Evaluate the drivers of gid, as OnePrsSim::propagate does for one
+ * value, and update its lanes. Multiple drivers are or-ed. With xout,
+ * lanes that change go to X. Returns the lanes that changed.
+ */
+unsigned long PrsLaneSim::_step (int gid, int xout)
+{
+  unsigned long uv = 0, ux = 0, uwv = 0, uwx = 0;
+  unsigned long dv = 0, dx = 0, dwv = 0, dwx = 0;
+  unsigned long tv, tx;
+  unsigned long u0, u1, uX, d0, d1, dX, uw, dw;
+  unsigned long cv, cx, s0, s1, sX, nv, nx, m;
+
+  for (int r = _first[gid]; r != -1; r = _rules[r].next) {
+    _eval (_rules[r].up[PRSSIM_NORM], &tv, &tx);
+    uv |= tv; ux |= tx;
+    _eval (_rules[r].up[PRSSIM_WEAK], &tv, &tx);
+    uwv |= tv; uwx |= tx;
+    _eval (_rules[r].dn[PRSSIM_NORM], &tv, &tx);
+    dv |= tv; dx |= tx;
+    _eval (_rules[r].dn[PRSSIM_WEAK], &tv, &tx);
+    dwv |= tv; dwx |= tx;
+  }
+  _nevals++;
+  ux &= ~uv; uwx &= ~uwv;
+  dx &= ~dv; dwx &= ~dwv;
+
+  /* weak pull only where the normal one is off */
+  uw = ~uv & ~ux & (uwv | uwx);
+  uv |= uw & uwv;
+  ux |= uw & uwx;
+  dw = ~dv & ~dx & (dwv | dwx);
+  dv |= dw & dwv;
+  dx |= dw & dwx;
+
+  u1 = uv; uX = ux; u0 = ~uv & ~ux;
+  d1 = dv; dX = dx; d0 = ~dv & ~dx;
+  cv = _v[gid];
+  cx = _x[gid];
+
+  s1 = (u1 & d0) | (u1 & (dX | d1) & ~uw & dw);
+  s0 = (u0 & d1) | ((u1 | uX) & d1 & uw & ~dw);
+  sX = (u0 & dX & cv) | (uX & d0 & ~cv & ~cx) | (uX & dX)
+    | (u1 & dX & ~(~uw & dw))
+    | (u1 & d1 & ~(uw & ~dw) & ~(~uw & dw))
+    | (uX & d1 & ~(uw & ~dw));
+
+  nv = (cv & ~(s0 | s1 | sX)) | s1;
+  nx = (cx & ~(s0 | s1 | sX)) | sX;
+  if (_f0) {
+    nv = (nv & ~_f0[gid]) | _f1[gid];
+    nx &= ~(_f0[gid] | _f1[gid]);
+  }
+  nv &= ~nx;
+
+  m = (nv ^ cv) | (nx ^ cx);
+  if (m) {
+    if (xout) {
+      nv &= ~m;
+      nx |= m;
+    }
+    _v[gid] = nv;
+    _x[gid] = nx;
+    _fanout (gid);
+  }
+  return m;
+}
+
+void PrsLaneSim::loadState ()
+{
+  ActSimState *st = _sim->getState ();
+  for (int i=0; i < _nbools; i++) {
+    switch (st->getBool (i)) {
+    case 0:
+      _v[i] = 0;
+      _x[i] = 0;
+      break;
+    case 1:
+      _v[i] = ALL_LANES;
+      _x[i] = 0;
+      break;
+    default:
+      _v[i] = 0;
+      _x[i] = ALL_LANES;
+      break;
+    }
+    if (_f0) {
+      _v[i] = (_v[i] & ~_f0[i]) | _f1[i];
+      _x[i] &= ~(_f0[i] | _f1[i]);
+    }
+  }
+}
+
+void PrsLaneSim::setLanes (int gid, unsigned long mask, int val)
+{
+  unsigned long ov = _v[gid], ox = _x[gid];
+
+  if (_f0) {
+    mask &= ~(_f0[gid] | _f1[gid]);
+  }
+  if (val == 0) {
+    _v[gid] &= ~mask;
+    _x[gid] &= ~mask;
+  }
+  else if (val == 1) {
+    _v[gid] |= mask;
+    _x[gid] &= ~mask;
+  }
+  else {
+    _v[gid] &= ~mask;
+    _x[gid] |= mask;
+  }
+  if (ov != _v[gid] || ox != _x[gid]) {
+    _fanout (gid);
+  }
+}
+
+int PrsLaneSim::getLane (int gid, int lane)
+{
+  unsigned long b = 1UL << lane;
+  if (_x[gid] & b) {
+    return 2;
+  }
+  return (_v[gid] & b) ? 1 : 0;
+}
+
+unsigned long PrsLaneSim::getMask (int gid, int val)
+{
+  if (val == 0) {
+    return ~_v[gid] & ~_x[gid];
+  }
+  else if (val == 1) {
+    return _v[gid];
+  }
+  return _x[gid];
+}
+
+void PrsLaneSim::forceLanes (int gid, unsigned long mask, int val)
+{
+  if (!_f0) {
+    MALLOC (_f0, unsigned long, _nbools + 1);
+    MALLOC (_f1, unsigned long, _nbools + 1);
+    for (int i=0; i < _nbools; i++) {
+      _f0[i] = 0;
+      _f1[i] = 0;
+    }
+  }
+  _f0[gid] &= ~mask;
+  _f1[gid] &= ~mask;
+  if (val == 0) {
+    _f0[gid] |= mask;
+  }
+  else if (val == 1) {
+    _f1[gid] |= mask;
+  }
+  if (val == 0 || val == 1) {
+    unsigned long ov = _v[gid], ox = _x[gid];
+    _v[gid] = (_v[gid] & ~mask) | (val ? mask : 0);
+    _x[gid] &= ~mask;
+    if (ov != _v[gid] || ox != _x[gid]) {
+      _fanout (gid);
+    }
+  }
+  _push (gid);
+}
+
+void PrsLaneSim::clearForces ()
+{
+  if (_f0) {
+    FREE (_f0);
+    FREE (_f1);
+    _f0 = NULL;
+    _f1 = NULL;
+  }
+}
+
+void PrsLaneSim::touchAll ()
+{
+  for (int i=0; i < _nnodes; i++) {
+    _push (_nodes[i]);
+  }
+}
+
+unsigned long PrsLaneSim::run ()
+{
+  unsigned long limit = (unsigned long)LANE_EVAL_LIMIT*(_nnodes + 1);
+  unsigned long n = 0;
+  unsigned long unsettled = 0;
+
+  while (_qhead != _qtail) {
+    int gid = _q[_qhead];
+    _qhead = (_qhead + 1) % (_nbools + 1);
+    _inq[gid] = 0;
+    if (_first[gid] == -1) {
+      continue;
+    }
+    if (n >= limit) {
+      unsettled |= _step (gid, 1);
+    }
+    else {
+      _step (gid, 0);
+    }
+    n++;
+    if (n >= 2*limit) {
+      /* give up */
+      while (_qhead != _qtail) {
+	_inq[_q[_qhead]] = 0;
+	_qhead = (_qhead + 1) % (_nbools + 1);
+      }
+      unsettled = ALL_LANES;
+    }
+  }
+  return unsettled;
+}
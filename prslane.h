@@ -0,0 +1,129 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2026 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#ifndef __ACTSIM_PRSLANE_H__
+#define __ACTSIM_PRSLANE_H__
+
+#include "actsim.h"
+
+/*
+ * Bit-parallel zero-delay simulation of the production rules of a
+ * design. Each Boolean holds PRS_LANES independent copies (lanes) as
+ * two bit-planes: a lane is X if its bit in x is set, otherwise its
+ * value is its bit in v. Rules are compiled to postfix code over
+ * global Boolean ids and evaluated a word at a time.
+ *
+ * Nodes are not delayed: a changed node schedules the nodes it fans
+ * out to, until nothing changes. Lanes that have not settled after a
+ * bounded number of evaluations are marked X. Nodes that are not
+ * driven by production rules keep their value, unless set.
+ *
+ * Pass transistors and transmission gates are not supported.
+ */
+#define PRS_LANES (8*(int)sizeof (unsigned long))
+
+class OnePrsSim;
+
+class PrsLaneSim {
+public:
+  PrsLaneSim (ActSim *sim);
+  ~PrsLaneSim ();
+
+  /* 0 if the design uses gates that cannot be simulated */
+  int isValid () { return _valid; }
+
+  /* copy the Boolean state of the simulation into all lanes */
+  void loadState ();
+
+  /* set lanes in mask of Boolean gid to 0, 1, or 2 (X) */
+  void setLanes (int gid, unsigned long mask, int val);
+
+  /* get the value of one lane: 0, 1, or 2 (X) */
+  int getLane (int gid, int lane);
+
+  /* lanes that are 0, 1, or X */
+  unsigned long getMask (int gid, int val);
+
+  /* lanes in mask of gid stay at 0/1 whatever the rules say;
+     val = -1 releases them */
+  void forceLanes (int gid, unsigned long mask, int val);
+  void clearForces ();
+
+  /* schedule every driven node */
+  void touchAll ();
+
+  /* run until no node changes; returns the lanes that did not settle */
+  unsigned long run ();
+
+  int numNodes () { return _nnodes; }
+  int isDriven (int gid) { return _first[gid] != -1; }
+
+  /* driven node with index 0 <= i < numNodes() */
+  int getNode (int i) { return _nodes[i]; }
+
+  /* a rule that drives gid, or NULL */
+  OnePrsSim *getDriver (int gid) {
+    return _first[gid] == -1 ? NULL : _rules[_first[gid]].obj;
+  }
+
+  unsigned long numEvals () { return _nevals; }
+
+private:
+  ActSim *_sim;
+  int _valid;
+  int _nbools;
+
+  unsigned long *_v, *_x;	// value and X planes
+  unsigned long *_f0, *_f1;	// forced lanes; NULL if none
+
+  A_DECL (int, _code);		// postfix rule code
+
+  struct lane_rule {
+    int up[2], dn[2];		// code offsets, -1 if none
+    int next;			// next driver of the same node
+    OnePrsSim *obj;
+  };
+  A_DECL (lane_rule, _rules);
+
+  int *_first;			// gid -> first driver, or -1
+  int _nnodes;
+  int *_nodes;			// driven gids
+
+  int *_fo_start, *_fo;		// gid -> driven gids that read it
+
+  int *_q, _qhead, _qtail;	// circular work queue of gids
+  char *_inq;
+
+  unsigned long *_sv, *_sx;	// evaluation stack
+  int _maxdepth;
+
+  unsigned long _nevals;
+
+  void _add (PrsSim *p);
+  int _compile (PrsSim *p, struct prssim_expr *e);
+  void _eval (int pc, unsigned long *v, unsigned long *x);
+  unsigned long _step (int gid, int xout);
+  void _push (int gid);
+  void _fanout (int gid);
+  void _walk (ActInstTable *t);
+};
+
+#endif /* __ACTSIM_PRSLANE_H__ */
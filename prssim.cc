@@ -44,9 +44,7 @@ PrsSim::~PrsSim()
       delete _inst_gate_delay[i];
     }
   }
-  if (_sim) {
-    FREE (_sim);
-  }
+  /* _sim is allocated from the simulation arena */
   if (_inst_gate_delay) {
     FREE (_inst_gate_delay);
   }
@@ -175,7 +173,8 @@ void PrsSim::computeFanout ()
   }
   if (count > 0) {
     _nobjs = count;
-    MALLOC (_sim, OnePrsSim, count);
+    ARENA_MALLOC (_sc->getArena(), _sim, OnePrsSim, count);
+    actsim_objcount.prs_rules += count;
   }
   count = 0;
   for (x = _g->getRules(); x; x = x->next) {
@@ -408,14 +407,23 @@ static void _record_inst_delays (ActSimCore *sc, act_prs_expr_t *e, int type)
 }
 	
 
+/*
+ * Nodes are built bottom-up in a temporary and then replaced by their
+ * canonical (hash-consed) copy.
+ */
 static prssim_expr *_convert_prs (ActSimCore *sc, act_prs_expr_t *e, int type)
 {
-  prssim_expr *x, *tmp;
+  prssim_expr n, v, *x, *tmp;
   int is_fall;
   
   if (!e) return NULL;
 
-  NEW (x, prssim_expr);
+  if (e->type == ACT_PRS_EXPR_NOT && (type == 0 || type == 1)) {
+    /* negation folded into the child */
+    return _convert_prs (sc, e->u.e.l, 1 - type);
+  }
+
+  x = &n;
   switch (e->type) {
   case ACT_PRS_EXPR_AND:
     if (type == 1) {
@@ -440,36 +448,25 @@ static prssim_expr *_convert_prs (ActSimCore *sc, act_prs_expr_t *e, int type)
     break;
 
   case ACT_PRS_EXPR_NOT:
-    if (type == 0) {
-      FREE (x);
-      x = _convert_prs (sc, e->u.e.l, 1);
-    }
-    else if (type == 1) {
-      FREE (x);
-      x = _convert_prs (sc, e->u.e.l, 0);
-    }
-    else {
-      x->type = PRSSIM_EXPR_NOT;
-      x->l = _convert_prs (sc, e->u.e.l, 2);
-      x->r = NULL;
-    }
+    x->type = PRSSIM_EXPR_NOT;
+    x->l = _convert_prs (sc, e->u.e.l, 2);
+    x->r = NULL;
     break;
 
   case ACT_PRS_EXPR_VAR:
+    tmp = &v;
+    tmp->type = PRSSIM_EXPR_VAR;
+    tmp->vid = sc->getLocalOffset (e->u.v.id, sc->cursi(), NULL);
     if (type != 0) {
       x->type = PRSSIM_EXPR_NOT;
-      NEW (x->l, prssim_expr);
+      x->l = sc->getPrsCons()->expr (sc->getArena(), tmp);
       x->r = NULL;
-      tmp = x->l;
       is_fall = 1;
     }
     else {
-      tmp = x;
+      *x = *tmp;
       is_fall = 0;
     }
-    tmp->type = PRSSIM_EXPR_VAR;
-    tmp->vid = sc->getLocalOffset (e->u.v.id, sc->cursi(), NULL);
-    tmp->c = e->u.v.id->Canonical (sc->cursi()->bnl->cur);
     if (current_ci) {
       /*-- look through SDF paths from e->u.v.id to current_stmt->c --*/
       ActId *out_id = current_stmt->c->toid();
@@ -596,6 +593,9 @@ static prssim_expr *_convert_prs (ActSimCore *sc, act_prs_expr_t *e, int type)
     x = NULL;
     break;
   }
+  if (x == &n) {
+    x = sc->getPrsCons()->expr (sc->getArena(), &n);
+  }
   return x;
 }
 
@@ -608,12 +608,11 @@ static void _merge_prs (ActSimCore *sc, struct prssim_expr **pe,
     *pe = ex;
   }
   else {
-    prssim_expr *x;
-    NEW (x, prssim_expr);
-    x->type = PRSSIM_EXPR_OR;
-    x->l = *pe;
-    x->r = ex;
-    *pe = x;
+    prssim_expr x;
+    x.type = PRSSIM_EXPR_OR;
+    x.l = *pe;
+    x.r = ex;
+    *pe = sc->getPrsCons()->expr (sc->getArena(), &x);
   }
   return;
 }
@@ -641,7 +640,7 @@ void PrsSimGraph::_add_one_rule (ActSimCore *sc, act_prs_lang_t *p, sdf_cell *ci
     }
   }
   if (!s) {
-    NEW (s, struct prssim_stmt);
+    ARENA_NEW (sc->getArena(), s, struct prssim_stmt);
     s->next = NULL;
     s->type = PRSSIM_RULE;
     s->vid = rhs;
@@ -735,7 +734,7 @@ void PrsSimGraph::_add_one_rule (ActSimCore *sc, act_prs_lang_t *p, sdf_cell *ci
 void PrsSimGraph::_add_one_gate (ActSimCore *sc, act_prs_lang_t *p)
 {
   struct prssim_stmt *s;
-  NEW (s, struct prssim_stmt);
+  ARENA_NEW (sc->getArena(), s, struct prssim_stmt);
   s->next = NULL;
   s->setDelayDefault ();
   if (p->u.p.g) {
@@ -812,39 +811,16 @@ PrsSimGraph::PrsSimGraph ()
   _labels = hash_new (4);
 }
 
-static void _free_prssim_expr (prssim_expr *e)
-{
-  if (!e) return;
-  switch (e->type) {
-  case PRSSIM_EXPR_AND:
-  case PRSSIM_EXPR_OR:
-    _free_prssim_expr (e->r);
-  case PRSSIM_EXPR_NOT:
-    _free_prssim_expr (e->l);
-    break;
-
-  case PRSSIM_EXPR_VAR:
-  case PRSSIM_EXPR_TRUE:
-  case PRSSIM_EXPR_FALSE:
-    break;
-
-  default:
-    fatal_error ("free_prssim_expr (%d) unknown\n", e->type);
-    break;
-  }
-  FREE (e);
-}
-
+/*
+ * Rules and expressions are allocated from the simulation arena; only
+ * the delay tables need to be released here.
+ */
 PrsSimGraph::~PrsSimGraph()
 {
   hash_free (_labels);
   while (_rules) {
     switch (_rules->type) {
     case PRSSIM_RULE:
-      _free_prssim_expr (_rules->up[0]);
-      _free_prssim_expr (_rules->up[1]);
-      _free_prssim_expr (_rules->dn[0]);
-      _free_prssim_expr (_rules->dn[1]);
       if (!_rules->std_delay) {
 	_rules->delay.delete_tables();
       }
@@ -855,13 +831,218 @@ PrsSimGraph::~PrsSimGraph()
     case PRSSIM_TGATE:
       break;
     }
+    _rules = _rules->next;
+  }
+  _tail = NULL;
+}
+
+/*------------------------------------------------------------------------
+ *
+ *  Hash-consing of PRS graphs
+ *
+ *------------------------------------------------------------------------
+ */
+PrsSimCons::PrsSimCons ()
+{
+  _exprs = ihash_new (8);
+  _graphs = ihash_new (4);
+  _all = list_new ();
+  _nexprs = 0;
+  _nshared = 0;
+}
+
+static void _free_chains (struct iHashtable *H)
+{
+  ihash_bucket_t *b;
+  ihash_iter_t it;
+  ihash_iter_init (H, &it);
+  while ((b = ihash_iter_next (H, &it))) {
+    list_free ((list_t *) b->v);
+  }
+  ihash_free (H);
+}
+
+PrsSimCons::~PrsSimCons ()
+{
+  _free_chains (_exprs);
+  _free_chains (_graphs);
+  for (listitem_t *li = list_first (_all); li; li = list_next (li)) {
+    delete (PrsSimGraph *) list_value (li);
+  }
+  list_free (_all);
+}
+
+#define CONS_MIX(h,v) ((h)*1000003UL ^ (unsigned long)(v))
+
+static unsigned long _expr_key (prssim_expr *x)
+{
+  unsigned long h = x->type;
+  switch (x->type) {
+  case PRSSIM_EXPR_AND:
+  case PRSSIM_EXPR_OR:
+  case PRSSIM_EXPR_NOT:
+    h = CONS_MIX (h, x->l);
+    h = CONS_MIX (h, x->r);
+    break;
+  case PRSSIM_EXPR_VAR:
+    h = CONS_MIX (h, x->vid);
+    break;
+  default:
+    break;
+  }
+  return h;
+}
+
+/* children are already canonical, so pointer equality suffices */
+static int _expr_eq (prssim_expr *a, prssim_expr *b)
+{
+  if (a->type != b->type) return 0;
+  switch (a->type) {
+  case PRSSIM_EXPR_AND:
+  case PRSSIM_EXPR_OR:
+  case PRSSIM_EXPR_NOT:
+    return (a->l == b->l && a->r == b->r);
+  case PRSSIM_EXPR_VAR:
+    return (a->vid == b->vid);
+  default:
+    return 1;
+  }
+}
+
+prssim_expr *PrsSimCons::expr (ActSimArena *a, prssim_expr *x)
+{
+  ihash_bucket_t *b;
+  prssim_expr *ret;
+  long key = (long) (_expr_key (x) >> 1);
+
+  b = ihash_lookup (_exprs, key);
+  if (b) {
+    for (listitem_t *li = list_first ((list_t *)b->v); li;
+	 li = list_next (li)) {
+      ret = (prssim_expr *) list_value (li);
+      if (_expr_eq (ret, x)) {
+	return ret;
+      }
+    }
+  }
+  else {
+    b = ihash_add (_exprs, key);
+    b->v = list_new ();
+  }
+  ARENA_NEW (a, ret, prssim_expr);
+  *ret = *x;
+  list_append ((list_t *)b->v, ret);
+  _nexprs++;
+  return ret;
+}
+
+static unsigned long _graph_key (PrsSimGraph *g)
+{
+  unsigned long h = 0;
+  for (prssim_stmt *s = g->getRules(); s; s = s->next) {
+    h = CONS_MIX (h, s->type);
+    if (s->type == PRSSIM_RULE) {
+      h = CONS_MIX (h, s->vid);
+      h = CONS_MIX (h, s->up[0]);
+      h = CONS_MIX (h, s->dn[0]);
+    }
+    else {
+      h = CONS_MIX (h, s->t1);
+      h = CONS_MIX (h, s->t2);
+    }
+  }
+  return h;
+}
+
+/*
+ * The connection of a rule belongs to the type that built the graph,
+ * so two types never share one; rules are the same if the outputs
+ * have the same name within their types.
+ */
+static int _conn_eq (act_connection *a, act_connection *b)
+{
+  ActId *x, *y;
+  int ret;
+
+  if (a == b) return 1;
+  if (!a || !b) return 0;
+  x = a->toid();
+  y = b->toid();
+  ret = x->isEqual (y) ? 1 : 0;
+  delete x;
+  delete y;
+  return ret;
+}
+
+static int _stmt_eq (prssim_stmt *a, prssim_stmt *b)
+{
+  if (a->type != b->type || a->unstab != b->unstab) return 0;
+
+  /* delay tables are instance-agnostic SDF data; never shared */
+  if (!a->simpleDelay() || !b->simpleDelay()) return 0;
+  if (a->delayUp (0) != b->delayUp (0) || a->delayDn (0) != b->delayDn (0)) {
+    return 0;
+  }
+  switch (a->type) {
+  case PRSSIM_RULE:
+    return (a->vid == b->vid &&
+	    a->up[0] == b->up[0] && a->up[1] == b->up[1] &&
+	    a->dn[0] == b->dn[0] && a->dn[1] == b->dn[1] &&
+	    _conn_eq (a->c, b->c));
+  case PRSSIM_PASSP:
+    return (a->t1 == b->t1 && a->t2 == b->t2 && a->_g == b->_g);
+  case PRSSIM_PASSN:
+    return (a->t1 == b->t1 && a->t2 == b->t2 && a->g == b->g);
+  case PRSSIM_TGATE:
+    return (a->t1 == b->t1 && a->t2 == b->t2 &&
+	    a->g == b->g && a->_g == b->_g);
+  }
+  return 0;
+}
+
+static int _graph_eq (PrsSimGraph *a, PrsSimGraph *b)
+{
+  prssim_stmt *x, *y;
+  for (x = a->getRules(), y = b->getRules(); x && y;
+       x = x->next, y = y->next) {
+    if (!_stmt_eq (x, y)) return 0;
+  }
+  return (x == NULL && y == NULL);
+}
+
+PrsSimGraph *PrsSimCons::graph (PrsSimGraph *g, int can_share)
+{
+  ihash_bucket_t *b;
+  long key;
 
-    _tail = _rules->next;
-    FREE (_rules);
-    _rules = _tail;
+  if (!can_share) {
+    list_append (_all, g);
+    return g;
+  }
+  key = (long) (_graph_key (g) >> 1);
+  b = ihash_lookup (_graphs, key);
+  if (b) {
+    for (listitem_t *li = list_first ((list_t *)b->v); li;
+	 li = list_next (li)) {
+      PrsSimGraph *h = (PrsSimGraph *) list_value (li);
+      if (_graph_eq (h, g)) {
+	/* rules are in the arena; only the label table is released */
+	delete g;
+	_nshared++;
+	return h;
+      }
+    }
+  }
+  else {
+    b = ihash_add (_graphs, key);
+    b->v = list_new ();
   }
+  list_append ((list_t *)b->v, g);
+  list_append (_all, g);
+  return g;
 }
 
+
 PrsSimGraph *PrsSimGraph::buildPrsSimGraph (ActSimCore *sc, act_prs *p,
 					    sdf_cell *ci)
 {
@@ -989,6 +1170,8 @@ static int _breakpt;
 	ed = (ob)->_proc->getDelay (ed);				\
 	(of)->flags = (1 + (x));					\
 	(of)->_pending = new Event (this, SIM_EV_MKTYPE ((x), 0), ed);	\
+	actsim_pending.prs++;						\
+	ACTSIM_PERF (PERF_EV_NEW);					\
       }									\
     }									\
   } while (0)
@@ -1012,6 +1195,9 @@ int OnePrsSim::Step (Event *ev)
 
   _breakpt = 0;
   _pending = NULL;
+  actsim_pending.prs--;
+  ACTSIM_PERF_EVENT (PERF_EV_PRS);
+  ACTSIM_PROF (_proc);
 
   /*-- fire rule --*/
   switch (_me->type) {
@@ -1147,9 +1333,13 @@ int OnePrsSim::matches (int val)
       if ((obj)->flags != PENDING_X) {					\
 	if ((obj)->_pending) {						\
 	  (obj)->_pending->Remove ();					\
+	  actsim_pending.prs--;						\
+	  ACTSIM_PERF (PERF_EV_CANCEL);					\
 	}								\
 	(obj)->flags = PENDING_X;					\
 	(obj)->_pending = new Event (this, SIM_EV_MKTYPE (2, 0), 1, cause); \
+	actsim_pending.prs++;						\
+	ACTSIM_PERF (PERF_EV_NEW);					\
       }									\
     }									\
     else {								\
@@ -1157,6 +1347,9 @@ int OnePrsSim::matches (int val)
 	(obj)->flags = 0;						\
 	if ((obj)->_pending) {						\
 	  (obj)->_pending->Remove();					\
+	  (obj)->_pending = NULL;					\
+	  actsim_pending.prs--;						\
+	  ACTSIM_PERF (PERF_EV_CANCEL);					\
 	}								\
       }									\
     }									\
@@ -1176,6 +1369,7 @@ void OnePrsSim::propagate (void *cause)
   else {
     causeid = -1;
   }
+  ACTSIM_PERF (PERF_PROPAGATE);
 
   /*-- fire rule --*/
   switch (_me->type) {
@@ -1465,15 +1659,17 @@ bool PrsSim::setBool (int lid, int v, OnePrsSim *me, ActSimObj *cause)
 #ifdef DUMP_ALL
   verb = 1;
 #endif  
+  ACTSIM_PERF (PERF_WATCH_CHK);
   if ((nm = _sc->chkWatchPt (0, off))) {
     verb = 1;
   }
+  else if (_sc->chkWatchAll (0, off)) {
+    verb = 4;
+  }
   if ((nm2 = _sc->chkBreakPt (0, off))) {
     verb |= 2;
   }
-  if (verb) {
-    oval = _sc->getBool (off);
-  }
+  oval = _sc->getBool (off);
 
 #ifdef DUMP_ALL
   char buf[100];
@@ -1484,6 +1680,10 @@ bool PrsSim::setBool (int lid, int v, OnePrsSim *me, ActSimObj *cause)
 #endif  
   
   if (_sc->setBool (off, v)) {
+    /* only count 0 <-> 1 changes; X is not a transition */
+    if (oval != v && oval != 2 && v != 2) {
+      _sc->incTC (off);
+    }
     if (verb) {
       if (oval != v) {
 	if (verb & 1) {
@@ -1507,9 +1707,15 @@ bool PrsSim::setBool (int lid, int v, OnePrsSim *me, ActSimObj *cause)
 	  printf ("*** breakpoint %s\n", nm2);
 	  _breakpt = 1;
 	}
+	if (verb & 4) {
+	  BigInt tmpv;
+	  tmpv = v;
+	  _sc->recordTraceAll (0, off, tmpv);
+	}
       }
     }
     arr = _sc->getFO (off, 0);
+    ACTSIM_PERF_ADD (PERF_FANOUT, _sc->numFanout (off, 0));
 #ifdef DUMP_ALL
     printf (" >>> fanout: %d\n", _sc->numFanout (off, 0));
 #endif
@@ -1668,6 +1874,9 @@ void OnePrsSim::flushPending ()
 {
   if (_pending) {
     _pending->Remove ();
+    _pending = NULL;
+    actsim_pending.prs--;
+    ACTSIM_PERF (PERF_EV_CANCEL);
     flags = PENDING_NONE;
   }
 }
@@ -1851,6 +2060,9 @@ int MultiPrsSim::Step (Event *ev)
 
   _breakpt = 0;
   _objs[0]->_pending = NULL;
+  actsim_pending.prs--;
+  ACTSIM_PERF_EVENT (PERF_EV_MPRS);
+  ACTSIM_PROF (_objs[0]->_proc);
 
   if (_objs[0]->flags == (1 + t)) {
     _objs[0]->flags = PENDING_NONE;
@@ -1961,6 +2173,7 @@ void MultiPrsSim::propagate (void *cause)
   else {
     causeid = -1;
   }
+  ACTSIM_PERF (PERF_PROPAGATE);
 
   int u_state, d_state, u_weak, d_weak, u_idx, d_idx;
   // compute u_state, d_state, u_weak, d_weak
@@ -216,10 +216,7 @@ struct prssim_expr {
     struct {
       prssim_expr *l, *r;
     };
-    struct {
-      int vid;
-      act_connection *c;
-    };
+    int vid;
   };
 };
 
@@ -308,6 +305,36 @@ struct prssim_stmt {
 };
   
 
+/*
+ * Structural sharing of PRS graphs. Expression nodes are hash-consed,
+ * so identical subtrees are stored once per simulation; rule graphs
+ * that are identical (including their delays) are shared across
+ * process types.
+ */
+class PrsSimGraph;
+
+class PrsSimCons {
+private:
+  struct iHashtable *_exprs;	// expr key -> list of expr nodes
+  struct iHashtable *_graphs;	// graph key -> list of graphs
+  list_t *_all;			// all graphs; owned here
+  int _nexprs, _nshared;
+
+public:
+  PrsSimCons ();
+  ~PrsSimCons ();
+
+  /* return the canonical copy of the node x */
+  prssim_expr *expr (ActSimArena *, prssim_expr *x);
+
+  /* return the canonical copy of g; g is deleted if it is replaced */
+  PrsSimGraph *graph (PrsSimGraph *g, int can_share);
+
+  int numExprs () { return _nexprs; }
+  int numShared () { return _nshared; }
+};
+
+
 class PrsSimGraph {
 private:
   struct prssim_stmt *_rules, *_tail;
@@ -387,6 +414,9 @@ class PrsSim : public ActSimObj {
   void updateDelays (act_prs *prs, sdf_celltype *ci);
 
   inline gate_delay_info *getInstDelay (OnePrsSim *sim);
+
+  int numRules () { return _nobjs; }
+  OnePrsSim *getRule (int i) { return &_sim[i]; }
   
  private:
   void _computeFanout (prssim_expr *, SimDES *);
@@ -422,8 +452,15 @@ public:
   void sPrintCause (char *buf, int sz);
   int causeGlobalIdx ();
   PrsSim *getPrsSim() { return _proc; }
+  struct prssim_stmt *getStmt() { return _me; }
   int getPending();
 
+  /* used to restore checkpoints */
+  void setPending (Event *ev, int type) {
+    _pending = ev;
+    flags = ev ? 1 + type : 0;
+  }
+
   friend class MultiPrsSim;
 };
 
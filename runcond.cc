@@ -0,0 +1,405 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2026 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <ctype.h>
+#include "runcond.h"
+
+enum runcond_opcode {
+  RC_VAR, RC_CONST,
+  RC_NOT,
+  RC_OR, RC_XOR, RC_AND,
+  RC_EQ, RC_NE, RC_LT, RC_LE, RC_GT, RC_GE,
+  RC_ADD, RC_SUB
+};
+
+struct runcond_op {
+  int op;
+  unsigned long v;		// constant, or variable index
+};
+
+#define RUNCOND_EV_WAKEUP 0
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Parser: recursive descent, emitting postfix
+ *
+ *------------------------------------------------------------------------
+ */
+struct runcond_parser {
+  ActSimCond *c;
+  const char *s;		// current position
+  const char *orig;
+  int (*lookup) (char *, int *, int *);
+  int err;
+
+  void skip () {
+    while (*s && isspace (*s)) s++;
+  }
+
+  void error (const char *msg) {
+    if (!err) {
+      fprintf (stderr, "run-until: %s at `%s' in `%s'\n", msg,
+	       *s ? s : "<end>", orig);
+    }
+    err = 1;
+  }
+
+  void emit (int op, unsigned long v) {
+    if (c->_nops == c->_maxops) {
+      c->_maxops *= 2;
+      REALLOC (c->_ops, struct runcond_op, c->_maxops);
+    }
+    c->_ops[c->_nops].op = op;
+    c->_ops[c->_nops].v = v;
+    c->_nops++;
+  }
+
+  int var (int type, int off) {
+    for (int i=0; i < c->_nvars; i++) {
+      if (c->_vtype[i] == type && c->_voff[i] == off) {
+	return i;
+      }
+    }
+    REALLOC (c->_vtype, int, c->_nvars + 1);
+    REALLOC (c->_voff, int, c->_nvars + 1);
+    c->_vtype[c->_nvars] = type;
+    c->_voff[c->_nvars] = off;
+    return c->_nvars++;
+  }
+
+  /* match a binary operator; longest match first */
+  int binop (const char **ops, const int *codes, int n) {
+    skip ();
+    for (int i=0; i < n; i++) {
+      int len = strlen (ops[i]);
+      if (strncmp (s, ops[i], len) == 0) {
+	s += len;
+	return codes[i];
+      }
+    }
+    return -1;
+  }
+
+  void primary () {
+    skip ();
+    if (err) return;
+    if (*s == '(') {
+      s++;
+      expr_or ();
+      skip ();
+      if (*s != ')') {
+	error ("missing `)'");
+	return;
+      }
+      s++;
+    }
+    else if (*s == '~' || (*s == '!' && s[1] != '=')) {
+      s++;
+      primary ();
+      emit (RC_NOT, 0);
+    }
+    else if (isdigit (*s)) {
+      char *end;
+      unsigned long v;
+      if (s[0] == '0' && (s[1] == 'b' || s[1] == 'B')) {
+	v = strtoul (s+2, &end, 2);
+      }
+      else {
+	v = strtoul (s, &end, 0);
+      }
+      s = end;
+      emit (RC_CONST, v);
+    }
+    else if (isalpha (*s) || *s == '_') {
+      const char *start = s;
+      while (*s && (isalnum (*s) || *s == '_' || *s == '.' || *s == '['
+		    || *s == ']' || *s == ':')) {
+	s++;
+      }
+      char *nm;
+      int type, off;
+      MALLOC (nm, char, s - start + 1);
+      memcpy (nm, start, s - start);
+      nm[s - start] = '\0';
+      if (!(*lookup) (nm, &type, &off)) {
+	FREE (nm);
+	err = 1;
+	return;
+      }
+      if (type != 0 && type != 1) {
+	fprintf (stderr, "run-until: `%s' is not a Boolean or integer\n", nm);
+	FREE (nm);
+	err = 1;
+	return;
+      }
+      if (type == 1 && c->_sc->getInt (off)->getWidth() > 64) {
+	fprintf (stderr, "run-until: `%s' is wider than 64 bits\n", nm);
+	FREE (nm);
+	err = 1;
+	return;
+      }
+      FREE (nm);
+      emit (RC_VAR, var (type, off));
+    }
+    else {
+      error ("syntax error");
+    }
+  }
+
+  void expr_add () {
+    static const char *ops[] = { "+", "-" };
+    static const int codes[] = { RC_ADD, RC_SUB };
+    int op;
+    primary ();
+    while (!err && (op = binop (ops, codes, 2)) != -1) {
+      primary ();
+      emit (op, 0);
+    }
+  }
+
+  void expr_cmp () {
+    static const char *ops[] = { "!=", "<=", ">=", "==", "=", "<", ">" };
+    static const int codes[] = { RC_NE, RC_LE, RC_GE, RC_EQ, RC_EQ, RC_LT, RC_GT };
+    int op;
+    expr_add ();
+    while (!err && (op = binop (ops, codes, 7)) != -1) {
+      expr_add ();
+      emit (op, 0);
+    }
+  }
+
+  void expr_and () {
+    static const char *ops[] = { "&" };
+    static const int codes[] = { RC_AND };
+    int op;
+    expr_cmp ();
+    while (!err && (op = binop (ops, codes, 1)) != -1) {
+      expr_cmp ();
+      emit (op, 0);
+    }
+  }
+
+  void expr_xor () {
+    static const char *ops[] = { "^" };
+    static const int codes[] = { RC_XOR };
+    int op;
+    expr_and ();
+    while (!err && (op = binop (ops, codes, 1)) != -1) {
+      expr_and ();
+      emit (op, 0);
+    }
+  }
+
+  void expr_or () {
+    static const char *ops[] = { "|" };
+    static const int codes[] = { RC_OR };
+    int op;
+    expr_xor ();
+    while (!err && (op = binop (ops, codes, 1)) != -1) {
+      expr_xor ();
+      emit (op, 0);
+    }
+  }
+};
+
+
+ActSimCond::ActSimCond (ActSimCore *sc)
+{
+  _sc = sc;
+  _maxops = 8;
+  _nops = 0;
+  MALLOC (_ops, struct runcond_op, _maxops);
+  _vtype = NULL;
+  _voff = NULL;
+  _nvars = 0;
+  _stk = NULL;
+  _armed = 0;
+  _hit = 0;
+  _pending = 0;
+  _released = 0;
+}
+
+ActSimCond::~ActSimCond ()
+{
+  disarm ();
+  FREE (_ops);
+  if (_vtype) {
+    FREE (_vtype);
+    FREE (_voff);
+  }
+  if (_stk) {
+    FREE (_stk);
+  }
+}
+
+ActSimCond *ActSimCond::compile (ActSimCore *sc, const char *s,
+				 int (*lookup) (char *, int *, int *))
+{
+  struct runcond_parser p;
+  ActSimCond *c = new ActSimCond (sc);
+
+  p.c = c;
+  p.s = s;
+  p.orig = s;
+  p.lookup = lookup;
+  p.err = 0;
+
+  p.expr_or ();
+  p.skip ();
+  if (!p.err && *p.s) {
+    p.error ("syntax error");
+  }
+  if (p.err) {
+    delete c;
+    return NULL;
+  }
+  MALLOC (c->_stk, unsigned long, c->_nops);
+  return c;
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Evaluation
+ *
+ *------------------------------------------------------------------------
+ */
+int ActSimCond::eval ()
+{
+  int sp = 0;
+  unsigned long a, b;
+
+  for (int i=0; i < _nops; i++) {
+    struct runcond_op *o = &_ops[i];
+    switch (o->op) {
+    case RC_VAR:
+      if (_vtype[o->v] == 0) {
+	a = _sc->getBool (_voff[o->v]);
+	if (a == 2) {
+	  return 0;
+	}
+      }
+      else {
+	a = _sc->getInt (_voff[o->v])->getVal (0);
+      }
+      _stk[sp++] = a;
+      break;
+
+    case RC_CONST:
+      _stk[sp++] = o->v;
+      break;
+
+    case RC_NOT:
+      _stk[sp-1] = (_stk[sp-1] == 0);
+      break;
+
+    default:
+      b = _stk[--sp];
+      a = _stk[sp-1];
+      switch (o->op) {
+      case RC_OR:  a = a | b; break;
+      case RC_XOR: a = a ^ b; break;
+      case RC_AND: a = a & b; break;
+      case RC_EQ:  a = (a == b); break;
+      case RC_NE:  a = (a != b); break;
+      case RC_LT:  a = (a < b); break;
+      case RC_LE:  a = (a <= b); break;
+      case RC_GT:  a = (a > b); break;
+      case RC_GE:  a = (a >= b); break;
+      case RC_ADD: a = a + b; break;
+      case RC_SUB: a = a - b; break;
+      }
+      _stk[sp-1] = a;
+      break;
+    }
+  }
+  return _stk[0] != 0;
+}
+
+void ActSimCond::arm ()
+{
+  if (_armed) {
+    return;
+  }
+  for (int i=0; i < _nvars; i++) {
+    _sc->incFanout (_voff[i], _vtype[i], this);
+  }
+  _armed = 1;
+  _hit = 0;
+}
+
+void ActSimCond::disarm ()
+{
+  if (!_armed) {
+    return;
+  }
+  for (int i=0; i < _nvars; i++) {
+    _sc->delFanout (_voff[i], _vtype[i], this);
+  }
+  _armed = 0;
+}
+
+/* a variable read by the condition changed */
+void ActSimCond::propagate (void *cause)
+{
+  if (!_armed || _hit || _pending) {
+    return;
+  }
+  if (eval ()) {
+    /* stop once the current event has been processed */
+    _pending = 1;
+    new Event (this, SIM_EV_MKTYPE (RUNCOND_EV_WAKEUP, 0), 0);
+    actsim_pending.other++;
+  }
+}
+
+int ActSimCond::Step (Event *ev)
+{
+  _pending = 0;
+  actsim_pending.other--;
+  if (_released) {
+    delete this;
+    return 1;
+  }
+  if (!_armed) {
+    return 1;
+  }
+  /* the condition may have been true only in the middle of a time
+     step; another change since the wakeup was scheduled could have
+     made it false again */
+  if (!eval ()) {
+    return 1;
+  }
+  _hit = 1;
+  return 0;
+}
+
+void ActSimCond::release ()
+{
+  disarm ();
+  if (_pending) {
+    _released = 1;
+  }
+  else {
+    delete this;
+  }
+}
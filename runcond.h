@@ -0,0 +1,95 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2026 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#ifndef __ACTSIM_RUNCOND_H__
+#define __ACTSIM_RUNCOND_H__
+
+#include "actsim.h"
+
+/*
+ * A condition over Booleans and integers (up to 64 bits), compiled
+ * once and re-evaluated only when one of the variables it reads
+ * changes.
+ *
+ *  expr : expr '|' expr
+ *       | expr '^' expr
+ *       | expr '&' expr
+ *       | expr ('=' | '==' | '!=' | '<' | '<=' | '>' | '>=') expr
+ *       | expr ('+' | '-') expr
+ *       | ('~' | '!') expr | '(' expr ')' | <name> | <integer>
+ *
+ * The operators are listed from the lowest to the highest precedence,
+ * one level per line.
+ * '~' and '!' are logical negation. The condition is false while any
+ * Boolean it reads is X.
+ */
+class ActSimCond : public ActSimDES {
+public:
+  /*
+   * Compile a condition; lookup maps a name to a global type and
+   * offset, and returns 0 if the name is not found. Returns NULL
+   * (with a message) on error.
+   */
+  static ActSimCond *compile (ActSimCore *sc, const char *s,
+			      int (*lookup) (char *name, int *type, int *off));
+  ~ActSimCond ();
+
+  int eval ();
+
+  /* add/remove the condition from the fanout of its variables */
+  void arm ();
+  void disarm ();
+
+  /* the condition became true while armed */
+  int isTriggered () { return _hit; }
+
+  void propagate (void *cause);
+  int Step (Event *ev);
+  void sPrintCause (char *buf, int sz) { snprintf (buf, sz, "run-until"); }
+
+  /*
+   * Release the condition. If a wakeup is still pending, it is freed
+   * when the wakeup is delivered.
+   */
+  void release ();
+
+private:
+  ActSimCond (ActSimCore *sc);
+
+  ActSimCore *_sc;
+
+  struct runcond_op *_ops;	// postfix program
+  int _nops, _maxops;
+
+  int *_vtype, *_voff;		// variables read
+  int _nvars;
+
+  unsigned long *_stk;
+
+  unsigned int _armed:1;
+  unsigned int _hit:1;
+  unsigned int _pending:1;	// wakeup scheduled
+  unsigned int _released:1;
+
+  friend struct runcond_parser;
+};
+
+#endif /* __ACTSIM_RUNCOND_H__ */
@@ -0,0 +1,732 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2026 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "server.h"
+#include "chantok.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define SRVCH_IDLE 0
+#define SRVCH_BUSY 1
+#define SRVCH_DONE 2
+
+#define SRVCH_SEND 0
+#define SRVCH_RECV 1
+
+/*
+ * Environment at the other end of a channel, for SEND/RECV
+ */
+class ServerChan : public ChanEnvStub {
+public:
+  ServerChan (ActSimCore *sc, int goff, const char *name)
+    : ChanEnvStub (sc, goff) {
+    _name = name;
+    state = SRVCH_IDLE;
+    dir = SRVCH_SEND;
+  }
+  ~ServerChan () { }
+
+  void start (int d) {
+    dir = d;
+    state = SRVCH_BUSY;
+    if (d == SRVCH_SEND) {
+      startSend (val, 0);
+    }
+    else {
+      startRecv (0);
+    }
+  }
+
+  void sPrintCause (char *buf, int sz) {
+    snprintf (buf, sz, "server:%s", _name);
+  }
+
+  int state;			// SRVCH_IDLE/BUSY/DONE
+  int dir;			// SRVCH_SEND/RECV
+  expr_multires val;		// value sent or received
+
+protected:
+  void done (const expr_multires *v) {
+    if (v) {
+      val = *v;
+    }
+    state = SRVCH_DONE;
+  }
+
+private:
+  const char *_name;
+};
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Connection state and buffers
+ *
+ *------------------------------------------------------------------------
+ */
+struct srv_state {
+  ActSim *sim;
+  int fd;
+
+  unsigned char *in;		// input buffer
+  unsigned long ilen, imax;
+  unsigned long ipos;		// start of the next request
+
+  const unsigned char *rp;	// current request payload
+  unsigned long rlen;
+  int rerr;			// payload was too short
+
+  unsigned char *out;		// output buffer
+  unsigned long olen, omax;
+
+  struct iHashtable *W;		// watched node -> handle
+  struct iHashtable *C;		// channel -> ServerChan
+
+  int ev_h;			// last event, to drop repeats
+  unsigned long ev_tm;
+  BigInt ev_v;
+};
+
+static void _out_grow (struct srv_state *s, unsigned long n)
+{
+  if (s->olen + n > s->omax) {
+    while (s->olen + n > s->omax) {
+      s->omax *= 2;
+    }
+    REALLOC (s->out, unsigned char, s->omax);
+  }
+}
+
+static void _out_u8 (struct srv_state *s, unsigned int x)
+{
+  _out_grow (s, 1);
+  s->out[s->olen++] = x & 0xff;
+}
+
+static void _out_u32 (struct srv_state *s, unsigned long x)
+{
+  _out_grow (s, 4);
+  for (int i=0; i < 4; i++) {
+    s->out[s->olen++] = (x >> (8*i)) & 0xff;
+  }
+}
+
+static void _out_u64 (struct srv_state *s, unsigned long x)
+{
+  _out_grow (s, 8);
+  for (int i=0; i < 8; i++) {
+    s->out[s->olen++] = (x >> (8*i)) & 0xff;
+  }
+}
+
+/* start a response frame; returns the position of the length field */
+static unsigned long _frame_start (struct srv_state *s, int status)
+{
+  unsigned long pos = s->olen;
+  _out_u32 (s, 0);
+  _out_u8 (s, status);
+  return pos;
+}
+
+static void _frame_end (struct srv_state *s, unsigned long pos)
+{
+  unsigned long len = s->olen - pos - 4;
+  for (int i=0; i < 4; i++) {
+    s->out[pos+i] = (len >> (8*i)) & 0xff;
+  }
+}
+
+static void _frame_err (struct srv_state *s, const char *msg)
+{
+  unsigned long pos = _frame_start (s, SRV_ERR);
+  int len = strlen (msg);
+  _out_grow (s, len);
+  memcpy (s->out + s->olen, msg, len);
+  s->olen += len;
+  _frame_end (s, pos);
+}
+
+static int _flush (struct srv_state *s)
+{
+  unsigned long done = 0;
+  while (done < s->olen) {
+    ssize_t n = send (s->fd, s->out + done, s->olen - done, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return 0;
+    }
+    done += n;
+  }
+  s->olen = 0;
+  return 1;
+}
+
+static unsigned long _in_n (struct srv_state *s, int bytes)
+{
+  unsigned long x = 0;
+  if (s->rlen < (unsigned long)bytes) {
+    s->rerr = 1;
+    s->rlen = 0;
+    return 0;
+  }
+  for (int i=0; i < bytes; i++) {
+    x |= ((unsigned long)s->rp[i]) << (8*i);
+  }
+  s->rp += bytes;
+  s->rlen -= bytes;
+  return x;
+}
+
+#define _in_u32(s) _in_n (s, 4)
+#define _in_u64(s) _in_n (s, 8)
+#define _in_i32(s) ((int)(unsigned int)_in_n (s, 4))
+
+static void _in_bigint (struct srv_state *s, BigInt &b)
+{
+  unsigned long nw = _in_u32 (s);
+  if (nw > s->rlen/8) {
+    s->rerr = 1;
+    return;
+  }
+  BigInt x (nw > 0 ? 64*nw : 1, 0, 0);
+  for (unsigned long i=0; i < nw; i++) {
+    x.setVal (i, _in_u64 (s));
+  }
+  b = x;
+}
+
+static void _out_bigint (struct srv_state *s, const BigInt &b)
+{
+  _out_u32 (s, b.getLen());
+  for (int i=0; i < b.getLen(); i++) {
+    _out_u64 (s, b.getVal (i));
+  }
+}
+
+static void _out_value (struct srv_state *s, int type, int goff)
+{
+  _out_u8 (s, type);
+  if (type == 0) {
+    _out_u32 (s, 1);
+    _out_u64 (s, s->sim->getBool (goff));
+  }
+  else if (type == 1) {
+    _out_bigint (s, *s->sim->getInt (goff));
+  }
+  else {
+    act_channel_state *c = s->sim->getChan (goff);
+    unsigned long v;
+    if (WAITING_SENDER (c)) {
+      v = 1;
+    }
+    else if (WAITING_SEND_PROBE (c)) {
+      v = 2;
+    }
+    else if (WAITING_RECEIVER (c)) {
+      v = 3;
+    }
+    else if (WAITING_RECV_PROBE (c)) {
+      v = 4;
+    }
+    else {
+      v = 0;
+    }
+    _out_u32 (s, 1);
+    _out_u64 (s, v);
+  }
+}
+
+static unsigned long _now ()
+{
+  return SimDES::CurTime().getVal (0);
+}
+
+/* change hook: stream watched changes back to the client */
+static void _srv_change (void *cookie, int type, unsigned long off,
+			 const BigInt &val)
+{
+  struct srv_state *s = (struct srv_state *) cookie;
+  ihash_bucket_t *b;
+
+  if (type > 1) {
+    return;
+  }
+  b = ihash_lookup (s->W, ((unsigned long)type) | (off << 2));
+  if (!b) {
+    return;
+  }
+  unsigned long tm = _now ();
+  BigInt v = val;
+  if (b->i == s->ev_h && tm == s->ev_tm && v == s->ev_v) {
+    return;
+  }
+  s->ev_h = b->i;
+  s->ev_tm = tm;
+  s->ev_v = v;
+
+  unsigned long pos = _frame_start (s, SRV_EVENT);
+  _out_u32 (s, b->i);
+  _out_u64 (s, tm);
+  _out_u8 (s, type);
+  _out_bigint (s, val);
+  _frame_end (s, pos);
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Requests
+ *
+ *------------------------------------------------------------------------
+ */
+static ServerChan *_srv_chan (struct srv_state *s, int h, const char **err)
+{
+  int type, goff;
+  ihash_bucket_t *b;
+
+  if (!actsim_handle_info (h, &type, &goff)) {
+    *err = "invalid handle";
+    return NULL;
+  }
+  if (type != 2) {
+    *err = "not a channel";
+    return NULL;
+  }
+  b = ihash_lookup (s->C, goff);
+  if (b) {
+    return (ServerChan *) b->v;
+  }
+  if (s->sim->getChan (goff)->fragmented) {
+    *err = "not a CHP channel";
+    return NULL;
+  }
+  b = ihash_add (s->C, goff);
+  b->v = new ServerChan (s->sim, goff, "client");
+  return (ServerChan *) b->v;
+}
+
+/* run until the channel action completes */
+static void _srv_chan_run (struct srv_state *s, ServerChan *ch,
+			   unsigned long maxsteps)
+{
+  unsigned long n = 0;
+  while (ch->state == SRVCH_BUSY && SimDES::hasPendingEvent()
+	 && (maxsteps == 0 || n < maxsteps)) {
+    s->sim->Step (1);
+    n++;
+  }
+  unsigned long pos = _frame_start (s, SRV_OK);
+  _out_u8 (s, ch->state == SRVCH_DONE ? 1 : 0);
+  _out_u64 (s, _now ());
+  if (ch->state == SRVCH_DONE) {
+    if (ch->dir == SRVCH_RECV) {
+      _out_u32 (s, ch->val.nvals);
+      for (int i=0; i < ch->val.nvals; i++) {
+	_out_u8 (s, 1);
+	_out_bigint (s, ch->val.v[i]);
+      }
+    }
+    ch->state = SRVCH_IDLE;
+  }
+  _frame_end (s, pos);
+}
+
+/* returns 0 to close the connection */
+static int _srv_request (struct srv_state *s, int op)
+{
+  unsigned long pos;
+  int type, goff;
+  const char *err = NULL;
+
+  switch (op) {
+  case SRV_HANDLE:
+    {
+      char *nm;
+      int h;
+      MALLOC (nm, char, s->rlen + 1);
+      memcpy (nm, s->rp, s->rlen);
+      nm[s->rlen] = '\0';
+      h = actsim_name_handle (nm);
+      FREE (nm);
+      if (h == -1) {
+	_frame_err (s, "name not found");
+	return 1;
+      }
+      actsim_handle_info (h, &type, &goff);
+      pos = _frame_start (s, SRV_OK);
+      _out_u32 (s, h);
+      _out_u8 (s, type);
+      _frame_end (s, pos);
+    }
+    break;
+
+  case SRV_GET:
+    {
+      unsigned long n = _in_u32 (s);
+      if (s->rerr || n != s->rlen/4) {
+	_frame_err (s, "bad request");
+	return 1;
+      }
+      pos = _frame_start (s, SRV_OK);
+      for (unsigned long i=0; i < n; i++) {
+	if (!actsim_handle_info (_in_i32 (s), &type, &goff)) {
+	  s->olen = pos;
+	  _frame_err (s, "invalid handle");
+	  return 1;
+	}
+	_out_value (s, type, goff);
+      }
+      _frame_end (s, pos);
+    }
+    break;
+
+  case SRV_SET:
+    {
+      unsigned long n = _in_u32 (s);
+      for (unsigned long i=0; !s->rerr && i < n; i++) {
+	BigInt v;
+	int h = _in_i32 (s);
+	_in_bigint (s, v);
+	if (s->rerr) {
+	  break;
+	}
+	if (!actsim_handle_info (h, &type, &goff)) {
+	  err = "invalid handle";
+	}
+	else if (type == 2) {
+	  err = "cannot set a channel";
+	}
+	else if (type == 0 && v.getVal (0) > 2) {
+	  err = "Boolean must be 0, 1, or 2";
+	}
+	else if (!actsim_set_value (type, goff, v)) {
+	  err = "set failed";
+	}
+	if (err) {
+	  break;
+	}
+      }
+      if (s->rerr) {
+	err = "bad request";
+      }
+      if (err) {
+	_frame_err (s, err);
+	return 1;
+      }
+      pos = _frame_start (s, SRV_OK);
+      _frame_end (s, pos);
+    }
+    break;
+
+  case SRV_STEP:
+  case SRV_ADVANCE:
+    {
+      unsigned long n = _in_u64 (s);
+      if (s->rerr || n == 0 || n > (unsigned long)LONG_MAX) {
+	_frame_err (s, "bad request");
+	return 1;
+      }
+      if (op == SRV_STEP) {
+	s->sim->Step (n);
+      }
+      else {
+	s->sim->Advance (n);
+      }
+      pos = _frame_start (s, SRV_OK);
+      _out_u8 (s, SimDES::hasPendingEvent() ? 1 : 0);
+      _out_u64 (s, _now ());
+      _frame_end (s, pos);
+    }
+    break;
+
+  case SRV_TIME:
+    pos = _frame_start (s, SRV_OK);
+    _out_u64 (s, _now ());
+    _frame_end (s, pos);
+    break;
+
+  case SRV_WATCH:
+    {
+      int h = _in_i32 (s);
+      if (s->rerr || !actsim_handle_info (h, &type, &goff)) {
+	_frame_err (s, "invalid handle");
+	return 1;
+      }
+      if (type == 2) {
+	_frame_err (s, "cannot watch a channel");
+	return 1;
+      }
+      unsigned long key = ((unsigned long)type) | (((unsigned long)goff) << 2);
+      if (!ihash_lookup (s->W, key)) {
+	ihash_add (s->W, key)->i = h;
+      }
+      s->sim->addWatchBit (type, goff);
+      pos = _frame_start (s, SRV_OK);
+      _frame_end (s, pos);
+    }
+    break;
+
+  case SRV_SEND:
+  case SRV_RECV:
+  case SRV_POLL:
+    {
+      int h = _in_i32 (s);
+      unsigned long maxsteps = _in_u64 (s);
+      ServerChan *ch;
+      if (s->rerr) {
+	_frame_err (s, "bad request");
+	return 1;
+      }
+      if (!(ch = _srv_chan (s, h, &err))) {
+	_frame_err (s, err);
+	return 1;
+      }
+      if (op == SRV_POLL) {
+	if (ch->state == SRVCH_IDLE) {
+	  _frame_err (s, "no pending channel action");
+	  return 1;
+	}
+	_srv_chan_run (s, ch, maxsteps);
+	return 1;
+      }
+      if (ch->state != SRVCH_IDLE) {
+	_frame_err (s, "channel action pending");
+	return 1;
+      }
+      if (op == SRV_SEND) {
+	unsigned long nv = _in_u32 (s);
+	if (s->rerr || nv == 0 || nv > s->rlen/4) {
+	  _frame_err (s, "bad request");
+	  return 1;
+	}
+	actsim_handle_info (h, &type, &goff);
+	expr_multires m (s->sim->getChan (goff)->data);
+	if (nv != 1 && m.nvals != (int)nv) {
+	  _frame_err (s, "wrong number of values for the channel");
+	  return 1;
+	}
+	for (unsigned long i=0; !s->rerr && i < nv; i++) {
+	  BigInt v;
+	  _in_bigint (s, v);
+	  if (m.nvals == (int)nv) {
+	    int w = m.v[i].getWidth();
+	    m.v[i] = v;
+	    m.v[i].setWidth (w);
+	  }
+	  else if (nv == 1) {
+	    m.setSingle (v);
+	  }
+	}
+	if (s->rerr) {
+	  _frame_err (s, "bad request");
+	  return 1;
+	}
+	ch->val = m;
+      }
+      ch->start (op == SRV_SEND ? SRVCH_SEND : SRVCH_RECV);
+      _srv_chan_run (s, ch, maxsteps);
+    }
+    break;
+
+  case SRV_QUIT:
+    pos = _frame_start (s, SRV_OK);
+    _frame_end (s, pos);
+    return 0;
+
+  default:
+    _frame_err (s, "unknown request");
+    break;
+  }
+  return 1;
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Server loop
+ *
+ *------------------------------------------------------------------------
+ */
+static int _srv_listen (const char *path)
+{
+  struct sockaddr_un addr;
+  struct stat st;
+  mode_t old;
+  int fd;
+
+  if (strlen (path) >= sizeof (addr.sun_path)) {
+    fprintf (stderr, "server: socket path `%s' is too long\n", path);
+    return -1;
+  }
+  if (lstat (path, &st) == 0) {
+    if (!S_ISSOCK (st.st_mode)) {
+      fprintf (stderr, "server: `%s' exists and is not a socket\n", path);
+      return -1;
+    }
+    unlink (path);
+  }
+
+  fd = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    perror ("server: socket");
+    return -1;
+  }
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, path);
+
+  /* only the current user can connect */
+  old = umask (077);
+  if (bind (fd, (struct sockaddr *)&addr, sizeof (addr)) < 0) {
+    umask (old);
+    perror ("server: bind");
+    close (fd);
+    return -1;
+  }
+  umask (old);
+  chmod (path, 0600);
+
+  if (listen (fd, 1) < 0) {
+    perror ("server: listen");
+    close (fd);
+    unlink (path);
+    return -1;
+  }
+  return fd;
+}
+
+/* serve requests until the client quits or disconnects */
+static void _srv_serve (struct srv_state *s)
+{
+  while (1) {
+    /* complete requests in the buffer */
+    while (s->ilen - s->ipos >= 4) {
+      const unsigned char *p = s->in + s->ipos;
+      unsigned long len = p[0] | (p[1] << 8) | (p[2] << 16)
+	| ((unsigned long)p[3] << 24);
+      if (len == 0) {
+	_frame_err (s, "bad request");
+	_flush (s);
+	return;
+      }
+      if (s->ilen - s->ipos - 4 < len) {
+	break;
+      }
+      s->rp = p + 5;
+      s->rlen = len - 1;
+      s->rerr = 0;
+      s->ipos += 4 + len;
+      if (!_srv_request (s, p[4])) {
+	_flush (s);
+	return;
+      }
+    }
+
+    /* out of requests: answer, then read more */
+    if (s->olen > 0 && !_flush (s)) {
+      return;
+    }
+    if (s->ipos > 0) {
+      memmove (s->in, s->in + s->ipos, s->ilen - s->ipos);
+      s->ilen -= s->ipos;
+      s->ipos = 0;
+    }
+    if (s->ilen == s->imax) {
+      s->imax *= 2;
+      REALLOC (s->in, unsigned char, s->imax);
+    }
+    ssize_t n = recv (s->fd, s->in + s->ilen, s->imax - s->ilen, 0);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return;
+    }
+    s->ilen += n;
+  }
+}
+
+int actsim_server (ActSim *sim, const char *path)
+{
+  struct srv_state s;
+  int lfd;
+
+  lfd = _srv_listen (path);
+  if (lfd < 0) {
+    return 0;
+  }
+  printf ("server: listening on `%s'\n", path);
+  fflush (stdout);
+
+  s.fd = accept (lfd, NULL, NULL);
+  close (lfd);
+  unlink (path);
+  if (s.fd < 0) {
+    perror ("server: accept");
+    return 0;
+  }
+
+  s.sim = sim;
+  s.imax = 65536;
+  s.ilen = 0;
+  s.ipos = 0;
+  MALLOC (s.in, unsigned char, s.imax);
+  s.omax = 65536;
+  s.olen = 0;
+  MALLOC (s.out, unsigned char, s.omax);
+  s.W = ihash_new (4);
+  s.C = ihash_new (4);
+  s.ev_h = -1;
+  s.ev_tm = 0;
+
+  sim->setChangeHook (_srv_change, &s);
+  _srv_serve (&s);
+  sim->setChangeHook (NULL, NULL);
+
+  close (s.fd);
+  FREE (s.in);
+  FREE (s.out);
+  ihash_free (s.W);
+
+  /* stubs with a pending action stay on the channel's wait list */
+  ihash_iter_t it;
+  ihash_bucket_t *b;
+  ihash_iter_init (s.C, &it);
+  while ((b = ihash_iter_next (s.C, &it))) {
+    ServerChan *ch = (ServerChan *) b->v;
+    if (ch->state != SRVCH_BUSY) {
+      delete ch;
+    }
+  }
+  ihash_free (s.C);
+
+  printf ("server: connection closed\n");
+  return 1;
+}
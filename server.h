@@ -0,0 +1,93 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2026 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#ifndef __ACTSIM_SERVER_H__
+#define __ACTSIM_SERVER_H__
+
+#include "actsim.h"
+
+/*
+ * Binary request/response protocol on a Unix domain socket, for
+ * driving the simulation from an external test harness.
+ *
+ *  request  : u32 length, u8 op, payload      (length covers op+payload)
+ *  response : u32 length, u8 status, payload
+ *
+ * All integers are little-endian. A status of SRV_OK/SRV_ERR answers
+ * the request; SRV_EVENT frames (watched changes) are sent before
+ * the answer to the request that caused them. An error payload is a
+ * message string. Requests are answered in order, so a client can
+ * pipeline any number of them.
+ *
+ * A value is: u8 type (0 bool, 1 int, 2 chan), u32 nwords, u64 words.
+ * Booleans are 0, 1, or 2 (X); channels report the same code as the
+ * `get' command.
+ *
+ *  SRV_HANDLE  name               -> i32 handle, u8 type
+ *  SRV_GET     u32 n, n x i32     -> n values
+ *  SRV_SET     u32 n, n x (i32 handle, u32 nwords, u64 words)
+ *  SRV_STEP    u64 n              -> u8 pending, u64 time
+ *  SRV_ADVANCE u64 delay          -> u8 pending, u64 time
+ *  SRV_TIME                       -> u64 time
+ *  SRV_WATCH   i32 handle         ; event: i32 handle, u64 time, value
+ *  SRV_SEND    i32 handle, u64 maxsteps, u32 nvals,
+ *              nvals x (u32 nwords, u64 words) -> u8 done, u64 time
+ *  SRV_RECV    i32 handle, u64 maxsteps
+ *                   -> u8 done, u64 time [, u32 nvals, nvals x value]
+ *  SRV_POLL    i32 handle, u64 maxsteps   (continue a SEND/RECV)
+ *  SRV_QUIT
+ *
+ * SEND/RECV act as the environment at the other end of a channel,
+ * and run the simulation until the action completes, there are no
+ * pending events, or maxsteps events (0 = no limit) have been run.
+ * An action that did not complete is continued with SRV_POLL. A
+ * SEND has either one value, or one per field of the channel type.
+ */
+
+#define SRV_HANDLE   1
+#define SRV_GET      2
+#define SRV_SET      3
+#define SRV_STEP     4
+#define SRV_ADVANCE  5
+#define SRV_TIME     6
+#define SRV_WATCH    7
+#define SRV_SEND     8
+#define SRV_RECV     9
+#define SRV_POLL    10
+#define SRV_QUIT    11
+
+#define SRV_OK    0
+#define SRV_ERR   1
+#define SRV_EVENT 2
+
+/*
+ * Serve one client on the socket `path'. The socket is only
+ * accessible to the current user. Returns 0 if the socket could not
+ * be created.
+ */
+int actsim_server (ActSim *sim, const char *path);
+
+/* provided by the command-line interface */
+int actsim_name_handle (const char *name);		// -1 if not found
+int actsim_handle_info (int h, int *type, int *goff);	// 0 if invalid
+int actsim_set_value (int type, int goff, BigInt &v);	// 0 on error
+
+#endif /* __ACTSIM_SERVER_H__ */
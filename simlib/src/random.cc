@@ -22,6 +22,8 @@
 
 #include <common/array.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "../../actsim_ext.h"
 
@@ -36,6 +38,38 @@ struct random_state {
 
 L_A_DECL(struct random_state, _rstate);
 
+/* checkpoints: the state of every random stream */
+static void* _rand_ckpt_save(int* len) {
+    void* buf;
+    *len = A_LEN(_rstate) * sizeof(struct random_state);
+    buf = malloc(*len > 0 ? *len : 1);
+    if (*len > 0) {
+        memcpy(buf, _rstate, *len);
+    }
+    return buf;
+}
+
+static int _rand_ckpt_restore(const void* buf, int len) {
+    const struct random_state* r = (const struct random_state*)buf;
+    if (len % sizeof(struct random_state) != 0) {
+        return 0;
+    }
+    A_LEN(_rstate) = 0;
+    for (int i = 0; i < (int)(len / sizeof(struct random_state)); i++) {
+        A_NEW(_rstate, struct random_state);
+        A_NEXT(_rstate) = r[i];
+        A_INC(_rstate);
+    }
+    return 1;
+}
+
+__attribute__((constructor)) static void _rand_ckpt_init() {
+    if (actsim_checkpoint_register) {
+        actsim_checkpoint_register("sim::rand", _rand_ckpt_save,
+                                   _rand_ckpt_restore);
+    }
+}
+
 #define CHECK_NUM_ARGS(s, n)                                                  \
     do {                                                                      \
         if (argc != (n)) {                                                    \
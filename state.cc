@@ -41,6 +41,8 @@ ActSimState::ActSimState (int bools, int ints, int chantot)
     bits = NULL;
   }
   hazards = NULL;
+  MALLOC (_tc, unsigned long, bools + 1);
+  clearTC ();
 
   nints = ints;
   if (nints > 0) {
@@ -73,6 +75,7 @@ ActSimState::~ActSimState()
   if (bits) {
     bitset_free (bits);
   }
+  FREE (_tc);
   if (ival) {
     FREE (ival);
   }
@@ -92,6 +95,53 @@ ActSimState::~ActSimState()
   list_free (extra_state);
 }
 		 
+ActSimArena::ActSimArena (int chunk)
+{
+  _hd = NULL;
+  _chunk = chunk;
+  _bytes = 0;
+}
+
+ActSimArena::~ActSimArena ()
+{
+  while (_hd) {
+    struct arena_chunk *tmp = _hd->next;
+    FREE (_hd);
+    _hd = tmp;
+  }
+}
+
+void *ActSimArena::alloc (int sz)
+{
+  char *ret;
+
+  sz = (sz + 15) & ~15;
+  if (!_hd || (_hd->used + sz > _hd->sz)) {
+    struct arena_chunk *c;
+    char *tmp;
+    int csz = (sz > _chunk ? sz : _chunk);
+    MALLOC (tmp, char, sizeof (struct arena_chunk) + csz + 16);
+    c = (struct arena_chunk *) tmp;
+    c->sz = csz;
+    c->used = 0;
+    if (_hd && (_hd->sz - _hd->used) > (csz - sz)) {
+      /* oversized request: keep filling the current chunk */
+      c->next = _hd->next;
+      _hd->next = c;
+      c->used = sz;
+      _bytes += sz;
+      return (void *) (((unsigned long)&c->_align[0] + 15) & ~15UL);
+    }
+    c->next = _hd;
+    _hd = c;
+  }
+  ret = (char *) (((unsigned long)&_hd->_align[0] + 15) & ~15UL);
+  ret += _hd->used;
+  _hd->used += sz;
+  _bytes += sz;
+  return ret;
+}
+
 BigInt *ActSimState::getInt (int x)
 {
   Assert (0 <= x && x < nints, "What");
@@ -124,6 +174,13 @@ int ActSimState::getBool (int x)
   }
 }
 
+void ActSimState::clearTC ()
+{
+  for (int i=0; i < nbools; i++) {
+    _tc[i] = 0;
+  }
+}
+
 bool ActSimState::setBool (int x, int v)
 {
   int special = 0;
@@ -147,6 +204,12 @@ bool ActSimState::setBool (int x, int v)
     }
   }
 
+  rawSetBool (x, v);
+  return true;
+}
+
+void ActSimState::rawSetBool (int x, int v)
+{
   if (v == 1) {
     bitset_set (bits, 3*x);
     bitset_clr (bits, 3*x+1);
@@ -158,7 +221,6 @@ bool ActSimState::setBool (int x, int v)
   else {
     bitset_set (bits, 3*x+1);
   }
-  return true;
 }
 
 void *ActSimState::allocState (int sz)
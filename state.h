@@ -61,6 +61,19 @@ class expr_multires {
     v->setVal (0, val);
   }
 
+  /* n untyped values; used to reload saved state */
+  void setRaw (int n) {
+    _delete_objects ();
+    _d = NULL;
+    nvals = n;
+    if (n > 0) {
+      MALLOC (v, BigInt, n);
+      for (int i=0; i < n; i++) {
+	new (&v[i]) BigInt;
+      }
+    }
+  }
+
   expr_multires (expr_multires &&m) {
     v = m.v;
     nvals = m.nvals;
@@ -0,0 +1,3 @@
+set a 0
+checkpoint-every time 10001 runs/151.act.ck
+advance 95000
@@ -0,0 +1,7 @@
+get a
+get b
+get c
+advance 15
+get a
+get b
+get c
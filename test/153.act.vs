@@ -0,0 +1,4 @@
+in x en
+out y z
+0 0
+1 0
@@ -0,0 +1,120 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2026 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+
+/*
+ * Driver for the actsim shared library (see ../libactsim.h).
+ *
+ *   libdriver [act options] <bad.act> <good.act>
+ *
+ * <bad.act> has no process called `test', so the first load must
+ * fail; <good.act> is 156.act. Each step prints one line.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "../libactsim.h"
+
+static int nwatch;
+
+static void watch_b (void *cookie, int h, unsigned long tm,
+		     int nw, const unsigned long *v)
+{
+  printf ("watch %s: h=%d t=%lu v=%lu\n", (char *) cookie, h, tm,
+	  nw > 0 ? v[0] : 99);
+  nwatch++;
+}
+
+static unsigned long getb (int h)
+{
+  unsigned long v;
+  if (actsim_lib_get (h, 1, &v) != 1) {
+    printf ("get %d: failed\n", h);
+    exit (1);
+  }
+  return v;
+}
+
+static void setb (int h, unsigned long v)
+{
+  if (!actsim_lib_set (h, 1, &v)) {
+    printf ("set %d: failed\n", h);
+    exit (1);
+  }
+}
+
+int main (int argc, char **argv)
+{
+  int a, b, b2, st;
+  unsigned long v;
+
+  actsim_lib_init (&argc, &argv);
+  if (argc != 3) {
+    fprintf (stderr, "Usage: %s [act options] <bad.act> <good.act>\n",
+	     argv[0]);
+    return 1;
+  }
+
+  /* nothing is loaded yet */
+  printf ("handle before load: %d\n", actsim_lib_handle ("a"));
+  printf ("step before load: %d\n", actsim_lib_step (1));
+
+  printf ("load %s: %d\n", argv[1], actsim_lib_load (argv[1], "test"));
+  printf ("handle after failed load: %d\n", actsim_lib_handle ("a"));
+
+  printf ("load %s: %d\n", argv[2], actsim_lib_load (argv[2], "test"));
+
+  a = actsim_lib_handle ("a");
+  b = actsim_lib_handle ("b");
+  b2 = actsim_lib_handle ("b");
+  printf ("handles: a=%d b=%d b=%d\n", a, b, b2);
+  printf ("types: a=%d b=%d bad=%d\n", actsim_lib_type (a),
+	  actsim_lib_type (b), actsim_lib_type (42));
+  printf ("init: a=%lu b=%lu\n", getb (a), getb (b));
+
+  /* out-of-range values are rejected */
+  v = 3;
+  printf ("set a 3: %d\n", actsim_lib_set (a, 1, &v));
+
+  printf ("watch b: %d\n", actsim_lib_watch (b, watch_b, (void *) "b"));
+
+  setb (a, 0);
+  st = actsim_lib_step (1);
+  printf ("step: %d t=%lu\n", st, actsim_lib_time ());
+  printf ("a=%lu b=%lu\n", getb (a), getb (b));
+
+  setb (a, 1);
+  st = actsim_lib_step (1);
+  printf ("step: %d t=%lu\n", st, actsim_lib_time ());
+  printf ("a=%lu b=%lu\n", getb (a), getb (b));
+
+  /* remove the callback; the next change is silent */
+  actsim_lib_watch (b, NULL, NULL);
+  setb (a, 0);
+  st = actsim_lib_step (1);
+  printf ("step: %d t=%lu\n", st, actsim_lib_time ());
+  printf ("a=%lu b=%lu watched=%d\n", getb (a), getb (b), nwatch);
+
+  /* a second design cannot be loaded on top of the first */
+  printf ("load %s: %d\n", argv[2], actsim_lib_load (argv[2], "test"));
+
+  actsim_lib_end ();
+  return 0;
+}
@@ -17,6 +17,11 @@ if [ ! x$ACT_TEST_INSTALL = x ] || [ ! -f ../actsim.$EXT ]; then
 else
   ACTTOOL=../actsim.$EXT
 fi
+if [ ! x$ACT_TEST_INSTALL = x ] || [ ! -f ../actsim-trace.$EXT ]; then
+  ACTTRACE=$ACT_HOME/bin/actsim-trace
+else
+  ACTTRACE=../actsim-trace.$EXT
+fi
 
 check_echo=0
 myecho()
@@ -66,13 +71,22 @@ do
              lim=8
            fi
         fi
+	cnf=sim.conf
+	if [ -f $i.conf ]
+	then
+	cnf=$i.conf
+	fi
 	if [ -f $i.scr ]
 	then
-	$ACTTOOL "$@" -cnf=sim.conf $i test > runs/$i.t.stdout 2> runs/$i.t.stderr < $i.scr
+	$ACTTOOL "$@" -cnf=$cnf $i test > runs/$i.t.stdout 2> runs/$i.t.stderr < $i.scr
 	else
-	$ACTTOOL "$@" -cnf=sim.conf $i test > runs/$i.t.stdout 2> runs/$i.t.stderr <<EOF
+	$ACTTOOL "$@" -cnf=$cnf $i test > runs/$i.t.stdout 2> runs/$i.t.stderr <<EOF
 cycle
 EOF
+	fi
+	if [ -f $i.post ]
+	then
+	ACTTOOL=$ACTTOOL ACTTRACE=$ACTTRACE sh $i.post >> runs/$i.t.stdout 2>> runs/$i.t.stderr
 	fi
         grep -v "WARNING: Boolean variable \`enable" runs/$i.t.stdout > runs/$i.tmp; mv runs/$i.tmp runs/$i.t.stdout
 	ok=1
@@ -0,0 +1,529 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2026 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+
+/*
+ * Client for the actsim socket server (see ../server.h).
+ *
+ *   srvclient <socket>
+ *       run the protocol checks against the design in 155.act, and
+ *       print one line per reply
+ *
+ *   srvclient -b <socket> <name> <n>
+ *       time <n> pipelined GET requests for <name>, and print the
+ *       number of requests per second
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+
+#define SRV_HANDLE   1
+#define SRV_GET      2
+#define SRV_SET      3
+#define SRV_STEP     4
+#define SRV_ADVANCE  5
+#define SRV_TIME     6
+#define SRV_WATCH    7
+#define SRV_SEND     8
+#define SRV_RECV     9
+#define SRV_POLL    10
+#define SRV_QUIT    11
+
+#define SRV_OK    0
+#define SRV_ERR   1
+#define SRV_EVENT 2
+
+static int fd;
+
+/* request being built */
+static unsigned char req[4096];
+static int rlen;
+
+/* reply */
+static unsigned char *rep;
+static unsigned long replen, rpos;
+static int status;
+
+static unsigned long t0;	/* time when the checks started */
+
+#define MAXH 16
+static const char *hname[MAXH];
+static int hval[MAXH];
+static int nh;
+
+static void die (const char *msg)
+{
+  fprintf (stderr, "srvclient: %s\n", msg);
+  exit (1);
+}
+
+static void put_n (unsigned long x, int bytes)
+{
+  for (int i=0; i < bytes; i++) {
+    req[rlen++] = (x >> (8*i)) & 0xff;
+  }
+}
+
+static void begin (int op)
+{
+  rlen = 4;
+  req[rlen++] = op;
+}
+
+static void put_u32 (unsigned long x) { put_n (x, 4); }
+static void put_u64 (unsigned long x) { put_n (x, 8); }
+
+/* finish the request and append it to buf */
+static int end (unsigned char *buf, int pos)
+{
+  unsigned long len = rlen - 4;
+  for (int i=0; i < 4; i++) {
+    req[i] = (len >> (8*i)) & 0xff;
+  }
+  memcpy (buf + pos, req, rlen);
+  return pos + rlen;
+}
+
+static void write_all (const unsigned char *buf, unsigned long len)
+{
+  while (len > 0) {
+    ssize_t n = write (fd, buf, len);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      die ("write failed");
+    }
+    buf += n;
+    len -= n;
+  }
+}
+
+static void send_req (void)
+{
+  unsigned char buf[4096];
+  write_all (buf, end (buf, 0));
+}
+
+static void read_all (unsigned char *buf, unsigned long len)
+{
+  while (len > 0) {
+    ssize_t n = read (fd, buf, len);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      die ("connection closed");
+    }
+    buf += n;
+    len -= n;
+  }
+}
+
+static unsigned long get_n (int bytes)
+{
+  unsigned long x = 0;
+  if (rpos + bytes > replen) {
+    die ("short reply");
+  }
+  for (int i=0; i < bytes; i++) {
+    x |= ((unsigned long)rep[rpos+i]) << (8*i);
+  }
+  rpos += bytes;
+  return x;
+}
+
+#define get_u8()  get_n (1)
+#define get_u32() get_n (4)
+#define get_u64() get_n (8)
+
+static void read_frame (void)
+{
+  unsigned char hdr[4];
+  read_all (hdr, 4);
+  replen = hdr[0] | (hdr[1] << 8) | (hdr[2] << 16)
+    | ((unsigned long)hdr[3] << 24);
+  if (replen == 0) {
+    die ("empty reply");
+  }
+  rep = (unsigned char *) realloc (rep, replen);
+  read_all (rep, replen);
+  rpos = 0;
+  status = get_u8 ();
+}
+
+static const char *hstr (int h)
+{
+  for (int i=0; i < nh; i++) {
+    if (hval[i] == h) {
+      return hname[i];
+    }
+  }
+  return "?";
+}
+
+/* a value: type, words; only single-word values are printed */
+static void print_value (void)
+{
+  int type = get_u8 ();
+  unsigned long nw = get_u32 ();
+  unsigned long v = 0;
+  for (unsigned long i=0; i < nw; i++) {
+    unsigned long w = get_u64 ();
+    if (i == 0) {
+      v = w;
+    }
+  }
+  if (type == 0 && v == 2) {
+    printf ("X");
+  }
+  else {
+    printf ("%lu", v);
+  }
+}
+
+/* read the reply to one request, printing any events before it */
+static int reply (const char *what)
+{
+  while (1) {
+    read_frame ();
+    if (status != SRV_EVENT) {
+      break;
+    }
+    int h = (int)get_u32 ();
+    unsigned long tm = get_u64 ();
+    printf ("  event %s time=+%lu value=", hstr (h), tm - t0);
+    print_value ();
+    printf ("\n");
+  }
+  printf ("%s:", what);
+  if (status == SRV_ERR) {
+    printf (" error: %.*s\n", (int)replen - 1, (char *)rep + 1);
+    return 0;
+  }
+  if (status != SRV_OK) {
+    die ("bad status");
+  }
+  return 1;
+}
+
+static int handle (const char *name)
+{
+  char buf[128];
+  begin (SRV_HANDLE);
+  memcpy (req + rlen, name, strlen (name));
+  rlen += strlen (name);
+  send_req ();
+  snprintf (buf, 128, "handle %s", name);
+  if (!reply (buf)) {
+    return -1;
+  }
+  int h = (int)get_u32 ();
+  int type = get_u8 ();
+  printf (" type %d\n", type);
+  if (nh < MAXH) {
+    hname[nh] = name;
+    hval[nh] = h;
+    nh++;
+  }
+  return h;
+}
+
+static void get (int n, int *h)
+{
+  begin (SRV_GET);
+  put_u32 (n);
+  for (int i=0; i < n; i++) {
+    put_u32 ((unsigned int)h[i]);
+  }
+  send_req ();
+  if (reply ("get")) {
+    for (int i=0; i < n; i++) {
+      printf (" %s=", hstr (h[i]));
+      print_value ();
+    }
+    printf ("\n");
+  }
+}
+
+static void set (const char *what, int h, unsigned long v)
+{
+  begin (SRV_SET);
+  put_u32 (1);
+  put_u32 ((unsigned int)h);
+  put_u32 (1);
+  put_u64 (v);
+  send_req ();
+  if (reply (what)) {
+    printf (" ok\n");
+  }
+}
+
+static void simple (const char *what, int op, int h, int has_h)
+{
+  begin (op);
+  if (has_h) {
+    put_u32 ((unsigned int)h);
+  }
+  send_req ();
+  if (reply (what)) {
+    printf (" ok\n");
+  }
+}
+
+static void step (const char *what, unsigned long n)
+{
+  begin (SRV_STEP);
+  put_u64 (n);
+  send_req ();
+  if (reply (what)) {
+    int pending = get_u8 ();
+    unsigned long tm = get_u64 ();
+    printf (" pending=%d time=+%lu\n", pending, tm - t0);
+  }
+}
+
+/* reply to SEND/RECV/POLL */
+static void chan_reply (const char *what)
+{
+  if (!reply (what)) {
+    return;
+  }
+  int done = get_u8 ();
+  get_u64 ();
+  printf (" done=%d", done);
+  if (done && rpos < replen) {
+    unsigned long nv = get_u32 ();
+    for (unsigned long i=0; i < nv; i++) {
+      printf (" value=");
+      print_value ();
+    }
+  }
+  printf ("\n");
+}
+
+static void send_vals (const char *what, int h, int nv, unsigned long *v)
+{
+  begin (SRV_SEND);
+  put_u32 ((unsigned int)h);
+  put_u64 (0);
+  put_u32 (nv);
+  for (int i=0; i < nv; i++) {
+    put_u32 (1);
+    put_u64 (v[i]);
+  }
+  send_req ();
+  chan_reply (what);
+}
+
+static void recv_poll (const char *what, int op, int h)
+{
+  begin (op);
+  put_u32 ((unsigned int)h);
+  put_u64 (0);
+  send_req ();
+  chan_reply (what);
+}
+
+static void connect_to (const char *path)
+{
+  struct sockaddr_un addr;
+
+  if (strlen (path) >= sizeof (addr.sun_path)) {
+    die ("socket path too long");
+  }
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, path);
+
+  /* the server may still be starting */
+  for (int i=0; i < 200; i++) {
+    fd = socket (AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+      die ("socket failed");
+    }
+    if (connect (fd, (struct sockaddr *)&addr, sizeof (addr)) == 0) {
+      return;
+    }
+    close (fd);
+    usleep (50000);
+  }
+  die ("could not connect");
+}
+
+static void checks (void)
+{
+  int a, b, x, L, R;
+  int hs[4];
+  unsigned long v[2];
+
+  begin (SRV_TIME);
+  send_req ();
+  if (!reply ("time")) {
+    exit (1);
+  }
+  t0 = get_u64 ();
+  printf (" ok\n");
+
+  a = handle ("a");
+  b = handle ("b");
+  x = handle ("u.x");
+  L = handle ("L");
+  R = handle ("R");
+  handle ("nosuch");
+
+  simple ("watch b", SRV_WATCH, b, 1);
+  simple ("watch L", SRV_WATCH, L, 1);
+
+  hs[0] = a; hs[1] = b; hs[2] = x; hs[3] = L;
+  get (4, hs);
+  hs[0] = 12345;
+  get (1, hs);
+
+  set ("set a=0", a, 0);
+  set ("set a=3", a, 3);
+  begin (SRV_SET);
+  put_u32 (1);
+  put_u32 ((unsigned int)L);
+  put_u32 (1);
+  put_u64 (1);
+  send_req ();
+  if (reply ("set L")) {
+    printf (" ok\n");
+  }
+
+  step ("step 5", 5);
+  step ("step 0", 0);
+  hs[0] = a; hs[1] = b;
+  get (2, hs);
+
+  v[0] = 5;
+  send_vals ("send L 5", L, 1, v);
+  recv_poll ("recv R", SRV_RECV, R);
+  v[0] = 1; v[1] = 2;
+  send_vals ("send L 1 2", L, 2, v);
+  send_vals ("send a 1", a, 1, v);
+  recv_poll ("poll R", SRV_POLL, R);
+
+  /* the receive cannot complete until the next send */
+  recv_poll ("recv R", SRV_RECV, R);
+  recv_poll ("recv R", SRV_RECV, R);
+  v[0] = 7;
+  send_vals ("send L 7", L, 1, v);
+  recv_poll ("poll R", SRV_POLL, R);
+  hs[0] = x;
+  get (1, hs);
+
+  begin (99);
+  send_req ();
+  if (reply ("op 99")) {
+    printf (" ok\n");
+  }
+
+  /* pipelined requests are answered in order */
+  {
+    unsigned char buf[4096];
+    int pos = 0;
+    for (int i=0; i < 3; i++) {
+      begin (SRV_GET);
+      put_u32 (1);
+      put_u32 ((unsigned int)(i == 1 ? a : b));
+      pos = end (buf, pos);
+    }
+    write_all (buf, pos);
+    for (int i=0; i < 3; i++) {
+      if (reply ("pipelined get")) {
+	printf (" ");
+	print_value ();
+	printf ("\n");
+      }
+    }
+  }
+
+  simple ("quit", SRV_QUIT, 0, 0);
+}
+
+/* n pipelined GETs, in batches */
+static void bench (const char *name, long n)
+{
+  static unsigned char buf[65536];
+  struct timeval t1, t2;
+  long sent = 0, done = 0;
+  int h;
+
+  h = handle (name);
+  if (h < 0) {
+    exit (1);
+  }
+  gettimeofday (&t1, NULL);
+  while (done < n) {
+    int pos = 0;
+    while (sent < n && sent - done < 1024 && pos + 64 < (int)sizeof (buf)) {
+      begin (SRV_GET);
+      put_u32 (1);
+      put_u32 ((unsigned int)h);
+      pos = end (buf, pos);
+      sent++;
+    }
+    write_all (buf, pos);
+    while (done < sent) {
+      read_frame ();
+      if (status == SRV_OK) {
+	done++;
+      }
+      else if (status != SRV_EVENT) {
+	die ("request failed");
+      }
+    }
+  }
+  gettimeofday (&t2, NULL);
+
+  double dt = (t2.tv_sec - t1.tv_sec) + (t2.tv_usec - t1.tv_usec)*1e-6;
+  if (dt <= 0) {
+    dt = 1e-6;
+  }
+  printf ("ops=%ld time=%.3f ops_per_s=%.0f\n", n, dt, n/dt);
+
+  begin (SRV_QUIT);
+  send_req ();
+  read_frame ();
+}
+
+int main (int argc, char **argv)
+{
+  setvbuf (stdout, NULL, _IOLBF, 0);
+  if (argc == 2) {
+    connect_to (argv[1]);
+    checks ();
+  }
+  else if (argc == 5 && strcmp (argv[1], "-b") == 0) {
+    connect_to (argv[2]);
+    bench (argv[3], atol (argv[4]));
+  }
+  else {
+    fprintf (stderr, "Usage: %s <socket>\n", argv[0]);
+    fprintf (stderr, "       %s -b <socket> <name> <n>\n", argv[0]);
+    return 1;
+  }
+  close (fd);
+  return 0;
+}
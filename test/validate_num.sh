@@ -10,6 +10,11 @@ if [ ! x$ACT_TEST_INSTALL = x ] || [ ! -f ../actsim.$EXT ]; then
 else
   ACTTOOL=../actsim.$EXT
 fi
+if [ ! x$ACT_TEST_INSTALL = x ] || [ ! -f ../actsim-trace.$EXT ]; then
+  ACTTRACE=$ACT_HOME/bin/actsim-trace
+else
+  ACTTRACE=../actsim-trace.$EXT
+fi
 
 if [ $# -eq 0 ]
 then
@@ -25,12 +30,21 @@ fi
 
 for i in $list
 do
+	cnf=sim.conf
+	if [ -f $i.conf ]
+	then
+	cnf=$i.conf
+	fi
 	if [ -f $i.scr ]
 	then
-	$ACTTOOL -cnf=sim.conf $i test > runs/$i.stdout 2> runs/$i.stderr < $i.scr
+	$ACTTOOL -cnf=$cnf $i test > runs/$i.stdout 2> runs/$i.stderr < $i.scr
 	else
-	$ACTTOOL -cnf=sim.conf $i test > runs/$i.stdout 2> runs/$i.stderr <<EOF
+	$ACTTOOL -cnf=$cnf $i test > runs/$i.stdout 2> runs/$i.stderr <<EOF
 cycle
 EOF
 	fi
+	if [ -f $i.post ]
+	then
+	ACTTOOL=$ACTTOOL ACTTRACE=$ACTTRACE sh $i.post >> runs/$i.stdout 2>> runs/$i.stderr
+	fi
 done
@@ -468,6 +468,7 @@ void XyceActInterface::_addProcess (XyceSim *xc)
 
   if (!_pending) {
     _pending = new Event (xc, SIM_EV_MKTYPE (0,0), 0);
+    actsim_pending.other++;
   }
 }
 
@@ -1173,6 +1174,7 @@ void XyceActInterface::step()
     }
   }
   _pending = new Event (_analog_inst[0], SIM_EV_MKTYPE (0, 0), sim_dt);
+  actsim_pending.other++;
 #endif
 }
 
@@ -1191,6 +1193,9 @@ XyceSim::~XyceSim()
 int XyceSim::Step (Event * /*ev*/)
 {
   /* run simulation for X units of delay */
+  actsim_pending.other--;
+  ACTSIM_PERF_EVENT (PERF_EV_XYCE);
+  ACTSIM_PROF (this);
   XyceActInterface::getXyceInterface()->step ();
   return 1;
 }
@@ -1240,6 +1245,7 @@ void XyceSim::setGlobalBool (int off, int v)
 {
   _sc->setBool (off, v);
   SimDES **arr = _sc->getFO (off, 0);
+  ACTSIM_PERF_ADD (PERF_FANOUT, _sc->numFanout (off, 0));
   for (int i=0; i < _sc->numFanout (off, 0); i++) {
     ActSimDES *p = dynamic_cast<ActSimDES *>(arr[i]);
     Assert (p, "What?");